@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Alignment of feature columns, targets and weights: one cache line, and the
+// width of the widest vector registers
+constexpr std::size_t SIMD_ALIGNMENT = 64;
+
+// Allocator whose storage starts on a SIMD_ALIGNMENT boundary
+template <typename T>
+struct AlignedAllocator {
+    using value_type = T;
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+            throw std::bad_array_new_length();
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(SIMD_ALIGNMENT)));
+    }
+
+    void deallocate(T* p, std::size_t) {
+        ::operator delete(p, std::align_val_t(SIMD_ALIGNMENT));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U>&) const {
+        return true;
+    }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// AlignedAllocator that default-initializes the elements of `resize` and of
+// sized construction instead of value-initializing them, so buffers that are
+// written before they are read are not zero-filled first
+template <typename T>
+struct DefaultInitAllocator : AlignedAllocator<T> {
+    DefaultInitAllocator() = default;
+
+    template <typename U>
+    DefaultInitAllocator(const DefaultInitAllocator<U>&) {}
+
+    template <typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new (static_cast<void*>(p)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+template <typename T>
+using UninitializedVector = std::vector<T, DefaultInitAllocator<T>>;
+
+// `n` rounded up to whole SIMD_ALIGNMENT blocks of `T`, so consecutive arrays
+// of that length in one aligned allocation each start aligned
+template <typename T>
+constexpr std::size_t padded_size(std::size_t n) {
+    constexpr std::size_t block = SIMD_ALIGNMENT / sizeof(T);
+    return (n + block - 1) / block * block;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "Aligned.h"
+#include "Dataset.h"
+
+// Rows of one mini-batch gathered into contiguous columns, laid out like a
+// Matrix so the evaluator reads it exactly as it reads a whole dataset
+template <typename T>
+struct Batch {
+    std::vector<int> rows;  // dataset row of each batch row
+    std::size_t stride = 0;
+    int nfeatures = 0;
+    bool weighted = false;
+    AlignedVector<T> X;
+    AlignedVector<T> y;
+    AlignedVector<T> weights;
+
+    [[nodiscard]] std::size_t size() const { return rows.size(); }
+
+    [[nodiscard]] ColumnView<T> columns() const {
+        return ColumnView<T>{X.data(), stride, rows.size(), nfeatures};
+    }
+};
+
+/*
+ * Source of mini-batches for `options.batching`. Rows are drawn from epochs:
+ * shuffled orders of all the rows of the dataset, consumed `batch_size` rows
+ * at a time, so each row is used once per epoch rather than sampled with
+ * replacement on every call. A batch that runs past the end of an epoch takes
+ * its remaining rows from the next one.
+ *
+ * The sampler keeps one batch and reuses its buffers, so gathering a batch
+ * allocates nothing once they have grown. The batch returned by `next` stays
+ * valid until the following call, which lets a parent and its child be scored
+ * on the same rows. Samplers are not thread-safe; see `thread_batch_sampler`.
+ */
+template <typename T>
+class BatchSampler {
+public:
+    explicit BatchSampler(std::size_t batch_size, std::uint64_t seed = std::random_device{}()) :
+            batch_size(batch_size), gen(seed) {
+        if (batch_size == 0)
+            throw std::invalid_argument("Batch size must be positive");
+    }
+
+    [[nodiscard]] std::size_t size() const { return batch_size; }
+
+    // Gather the next `batch_size` rows of the epoch into the batch. A new
+    // dataset, or one of a different size, starts a new epoch.
+    template <typename L, typename... D>
+    const Batch<T>& next(const Dataset<T, L, D...>& dataset) {
+        if (dataset.n <= 0)
+            throw std::invalid_argument("Cannot draw a batch from an empty dataset");
+        if (&dataset != source || order.size() != static_cast<std::size_t>(dataset.n)) {
+            source = &dataset;
+            order.resize(dataset.n);
+            std::iota(order.begin(), order.end(), 0);
+            position = order.size();
+        }
+
+        batch.rows.resize(batch_size);
+        for (std::size_t i = 0; i < batch_size; ++i) {
+            if (position == order.size()) {
+                std::shuffle(order.begin(), order.end(), gen);
+                position = 0;
+            }
+            batch.rows[i] = order[position++];
+        }
+
+        const ColumnView<T> X = dataset.columns();
+        batch.stride = padded_size<T>(batch_size);
+        batch.nfeatures = dataset.nfeatures;
+        batch.weighted = dataset.weighted;
+        batch.X.resize(batch.stride * static_cast<std::size_t>(dataset.nfeatures));
+        for (int feature = 0; feature < dataset.nfeatures; ++feature) {
+            const T* column = X.column(feature);
+            T* gathered = batch.X.data() + static_cast<std::size_t>(feature) * batch.stride;
+            for (std::size_t i = 0; i < batch_size; ++i)
+                gathered[i] = column[batch.rows[i]];
+        }
+        batch.y.resize(batch_size);
+        for (std::size_t i = 0; i < batch_size; ++i)
+            batch.y[i] = dataset.y.value()[batch.rows[i]];
+        batch.weights.resize(dataset.weighted ? batch_size : 0);
+        for (std::size_t i = 0; i < batch.weights.size(); ++i)
+            batch.weights[i] = dataset.weights.value()[batch.rows[i]];
+        return batch;
+    }
+
+private:
+    std::size_t batch_size;
+    std::mt19937_64 gen;
+    const void* source = nullptr;
+    std::vector<int> order;
+    std::size_t position = 0;
+    Batch<T> batch;
+};
+
+// The calling thread's sampler of `batch_size` rows, replaced if the batch
+// size changes
+template <typename T>
+BatchSampler<T>& thread_batch_sampler(std::size_t batch_size) {
+    thread_local std::unique_ptr<BatchSampler<T>> sampler;
+    if (!sampler || sampler->size() != batch_size)
+        sampler = std::make_unique<BatchSampler<T>>(batch_size);
+    return *sampler;
+}
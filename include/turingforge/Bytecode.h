@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Constants.h"
+#include "Dataset.h"
+#include "Evaluate.h"
+#include "Expression.h"
+#include "OperatorEnum.h"
+
+// Where an instruction reads or writes a value
+enum class ArgKind : std::uint8_t {
+    FEATURE,   // a dataset column
+    CONSTANT,  // a constant slot of the tree, read at run time
+    SCALAR,    // a scalar register, computed once per evaluation
+    REGISTER   // a tile-sized column register
+};
+
+struct Arg {
+    ArgKind kind;
+    std::uint16_t index;
+};
+
+// One operator application. Builtin operators carry their resolved tile kernel;
+// custom ones have null kernels and go through the function table by `op`.
+template <typename T>
+struct Instruction {
+    UnaryKernel<T> unary;
+    BinaryKernel<T> binary;
+    std::uint8_t degree;
+    std::uint16_t op;
+    Arg a;
+    Arg b;
+    Arg dst;
+};
+
+// A tree compiled into linear register code. Operators that only depend on
+// constants are hoisted into `scalar_code`, which runs once per evaluation;
+// `tile_code` runs once per tile. Constants are read from their slots when the
+// program runs, so changing the values of the constants does not invalidate
+// it; changing the nodes does.
+template <typename T>
+struct Program {
+    std::vector<ExprNode> source;
+    OperatorSignature operators;
+    std::vector<Instruction<T>> scalar_code;
+    std::vector<Instruction<T>> tile_code;
+    std::uint16_t nscalars = 0;
+    std::uint16_t nregisters = 0;
+    Arg result{ArgKind::CONSTANT, 0};
+
+    // Whether the program was compiled from this tree and an operator table
+    // with the same signature, such as a copy of the one it was compiled with
+    [[nodiscard]] bool compiled_from(const Expression<T>& tree, const OperatorEnum& operators_) const {
+        return source == tree.nodes && operators_.matches(operators);
+    }
+};
+
+// Register files for running a program; reuse it across calls
+template <typename T>
+struct ProgramWorkspace {
+    std::vector<T> registers;
+    std::vector<T> scalars;
+
+    void reserve(const Program<T>& program) {
+        if (registers.size() < program.nregisters * static_cast<std::size_t>(EVAL_TILE_SIZE))
+            registers.resize(program.nregisters * static_cast<std::size_t>(EVAL_TILE_SIZE));
+        if (scalars.size() < program.nscalars)
+            scalars.resize(program.nscalars);
+    }
+};
+
+// Compile the tree by simulating its postfix evaluation. A column register is
+// released as soon as its value is consumed and reused for the next result,
+// so the register count is the peak number of live intermediate columns.
+template <typename T>
+Program<T> compile(const Expression<T>& tree, const OperatorEnum& operators) {
+    Program<T> program;
+    program.source = tree.nodes;
+    program.operators = operators.signature();
+
+    std::vector<Arg> stack;
+    std::vector<std::uint16_t> free_registers;
+    auto is_scalar = [](Arg arg) { return arg.kind == ArgKind::CONSTANT || arg.kind == ArgKind::SCALAR; };
+    auto release = [&](Arg arg) {
+        if (arg.kind == ArgKind::REGISTER)
+            free_registers.push_back(arg.index);
+    };
+
+    for (const ExprNode& node : tree.nodes) {
+        if (node.kind == NodeKind::CONSTANT) {
+            stack.push_back(Arg{ArgKind::CONSTANT, node.index});
+            continue;
+        }
+        if (node.kind == NodeKind::FEATURE) {
+            stack.push_back(Arg{ArgKind::FEATURE, node.index});
+            continue;
+        }
+
+        Instruction<T> instruction{nullptr, nullptr, node.degree, node.index, {}, {}, {}};
+        if (node.degree == 1) {
+            instruction.unary = unary_kernel<T>(operators.unaop_id(node.index));
+            instruction.a = stack.back();
+            stack.pop_back();
+        } else {
+            instruction.binary = binary_kernel<T>(operators.binop_id(node.index));
+            instruction.b = stack.back();
+            stack.pop_back();
+            instruction.a = stack.back();
+            stack.pop_back();
+        }
+
+        if (is_scalar(instruction.a) && (node.degree == 1 || is_scalar(instruction.b))) {
+            instruction.dst = Arg{ArgKind::SCALAR, program.nscalars++};
+            program.scalar_code.push_back(instruction);
+        } else {
+            release(instruction.a);
+            if (node.degree == 2)
+                release(instruction.b);
+            std::uint16_t reg;
+            if (free_registers.empty()) {
+                reg = program.nregisters++;
+            } else {
+                reg = free_registers.back();
+                free_registers.pop_back();
+            }
+            instruction.dst = Arg{ArgKind::REGISTER, reg};
+            program.tile_code.push_back(instruction);
+        }
+        stack.push_back(instruction.dst);
+    }
+
+    program.result = stack.back();
+    return program;
+}
+
+// Return the program cached in `cache`, recompiling it only if the tree's
+// nodes or the operator table changed since it was compiled. This writes
+// `cache`, so it must not be read by another thread at the same time.
+template <typename T>
+const Program<T>& cached_program(std::shared_ptr<const Program<T>>& cache, const Expression<T>& tree,
+                                 const OperatorEnum& operators) {
+    if (!cache || !cache->compiled_from(tree, operators))
+        cache = std::make_shared<const Program<T>>(compile(tree, operators));
+    return *cache;
+}
+
+template <typename T>
+Operand<T> _load(Arg arg, const std::vector<T>& constants, const ColumnView<T>& X, std::size_t row,
+                 ProgramWorkspace<T>& workspace) {
+    switch (arg.kind) {
+        case ArgKind::FEATURE: return Operand<T>{X.column(arg.index) + row, T(0), false};
+        case ArgKind::CONSTANT: return Operand<T>{nullptr, constants[arg.index], true};
+        case ArgKind::SCALAR: return Operand<T>{nullptr, workspace.scalars[arg.index], true};
+        case ArgKind::REGISTER: break;
+    }
+    return Operand<T>{workspace.registers.data() + arg.index * EVAL_TILE_SIZE, T(0), false};
+}
+
+template <typename T>
+void _execute(const Instruction<T>& instruction, Operand<T>& a, const Operand<T>& b, T* dst, int m,
+              const OperatorEnum& operators) {
+    if (instruction.degree == 1) {
+        if (instruction.unary)
+            instruction.unary(a, dst, m);
+        else
+            _custom_unary(operators, instruction.op, a, dst, m);
+    } else {
+        if (instruction.binary)
+            instruction.binary(a, b, dst, m);
+        else
+            _custom_binary(operators, instruction.op, a, b, dst, m);
+    }
+}
+
+// Run the scalar part of the program for the current constants
+template <typename T>
+void prepare(const Program<T>& program, const std::vector<T>& constants, const OperatorEnum& operators,
+             ProgramWorkspace<T>& workspace) {
+    workspace.reserve(program);
+    const ColumnView<T> none{nullptr, 0, 0, 0};
+    for (const Instruction<T>& instruction : program.scalar_code) {
+        Operand<T> a = _load(instruction.a, constants, none, 0, workspace);
+        Operand<T> b = instruction.degree == 2 ? _load(instruction.b, constants, none, 0, workspace) : a;
+        _execute<T>(instruction, a, b, nullptr, 0, operators);
+        workspace.scalars[instruction.dst.index] = a.value;
+    }
+}
+
+// Run the tile part of the program on rows `[row, row + m)`; `prepare` must
+// have been called for the current constants. Like `eval_tile`, the result may
+// point into `X` or the workspace, and the last instruction writes into `out`
+// when it is given.
+template <typename T>
+Operand<T> run_tile(const Program<T>& program, const std::vector<T>& constants, const ColumnView<T>& X,
+                    const OperatorEnum& operators, std::size_t row, int m, ProgramWorkspace<T>& workspace,
+                    T* out = nullptr) {
+    const std::size_t ninstructions = program.tile_code.size();
+    for (std::size_t i = 0; i < ninstructions; ++i) {
+        const Instruction<T>& instruction = program.tile_code[i];
+        Operand<T> a = _load(instruction.a, constants, X, row, workspace);
+        Operand<T> b = instruction.degree == 2 ? _load(instruction.b, constants, X, row, workspace) : a;
+        T* dst = (i + 1 == ninstructions && out != nullptr)
+                 ? out
+                 : workspace.registers.data() + instruction.dst.index * EVAL_TILE_SIZE;
+        _execute(instruction, a, b, dst, m, operators);
+        if (i + 1 == ninstructions)
+            return a;
+    }
+    return _load(program.result, constants, X, row, workspace);
+}
+
+// Evaluate the program on every row of `X` into `out`. Like `eval_tree_array`,
+// returns false at the first tile with a NaN or infinite output.
+template <typename T>
+bool eval_program_array(const Program<T>& program, const std::vector<T>& constants, const ColumnView<T>& X,
+                        const OperatorEnum& operators, T* out, ProgramWorkspace<T>& workspace) {
+    prepare(program, constants, operators, workspace);
+    for (std::size_t row = 0; row < X.n; row += EVAL_TILE_SIZE) {
+        int m = static_cast<int>(std::min<std::size_t>(EVAL_TILE_SIZE, X.n - row));
+        store_operand(run_tile(program, constants, X, operators, row, m, workspace, out + row), out + row, m);
+        if (!all_finite(out + row, static_cast<std::size_t>(m))) {
+            _record_nonfinite_abort(row, X.n);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Evaluate the program on every row of `X`; returns the prediction and whether it is complete
+template <typename T>
+std::pair<std::vector<T>, bool> eval_program_array(const Program<T>& program, const std::vector<T>& constants,
+                                                   const ColumnView<T>& X, const OperatorEnum& operators) {
+    thread_local ProgramWorkspace<T> workspace;
+    std::vector<T> out(X.n);
+    bool complete = eval_program_array(program, constants, X, operators, out.data(), workspace);
+    return {std::move(out), complete};
+}
@@ -1,123 +1,112 @@
 #pragma once
 
-#include <iostream>
-#include <vector>
-#include <map>
-#include <string>
 #include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <tuple>
+#include <vector>
 
-template<typename CT>
-bool flag_bin_operator_complexity(Node tree, std::string op, std::vector<CT> cons, Options options) {
-    return any_of(tree.begin(), tree.end(), [&](Node subtree) {
-        if (subtree.degree == 2 && subtree.op == op) {
-            if (cons[0] > -1 && past_complexity_limit(subtree.l, options, cons[0])) {
-                return true;
-            }
-            if (cons[1] > -1 && past_complexity_limit(subtree.r, options, cons[1])) {
-                return true;
-            }
-        }
-        return false;
-    });
-}
+#include "Complexity.h"
+#include "Expression.h"
 
-template<typename CT>
-bool flag_una_operator_complexity(Node tree, std::string op, CT cons, Options options) {
-    return any_of(tree.begin(), tree.end(), [&](Node subtree) {
-        if (subtree.degree == 1 && tree.op == op) {
-            return past_complexity_limit(subtree.l, options, cons);
-        }
-        return false;
-    });
-}
-
-template<typename CT>
-int count_max_nestedness(Node tree, int degree, std::string op) {
-    auto nestedness = tree_mapreduce(
-            [](auto t) { return 0; },  // Leafs
-            [&](auto t) { return (t.degree == degree && t.op == op) ? 1 : 0; },  // Branches
-            [](auto p, auto... c) { return p + std::max(c...); },  // Reduce
-            tree,
-    );
-    // Remove count of self:
-    auto is_self = tree.degree == degree && tree.op == op;
-    return nestedness - (is_self ? 1 : 0);
+// Whether an application of binary operator `op` has a left operand more
+// complex than `max_left` or a right operand more complex than `max_right`,
+// given the `subtree_complexities` of the tree. A limit of -1 is no limit.
+template <typename T>
+bool flag_bin_operator_complexity(const Expression<T>& tree, const std::vector<int>& complexities, int op,
+                                  int max_left, int max_right) {
+    for (std::size_t i = 0; i < tree.nodes.size(); ++i) {
+        const ExprNode& node = tree.nodes[i];
+        if (node.kind != NodeKind::BINARY || node.index != op)
+            continue;
+        if (max_left > -1 && complexities[left_child(tree, i)] > max_left)
+            return true;
+        if (max_right > -1 && complexities[i - 1] > max_right)
+            return true;
+    }
+    return false;
 }
 
-template<typename CT>
-bool flag_una_operator_complexity(Node tree, std::string op, CT cons, Options options) {
-    return any_of(tree.begin(), tree.end(), [&](Node subtree) {
-        if (subtree.degree == 1 && tree.op == op) {
-            return past_complexity_limit(subtree.l, options, cons);
-        }
-        return false;
-    });
+// Whether an application of unary operator `op` has an operand more complex than `max_operand`
+template <typename T>
+bool flag_una_operator_complexity(const Expression<T>& tree, const std::vector<int>& complexities, int op,
+                                  int max_operand) {
+    for (std::size_t i = 0; i < tree.nodes.size(); ++i) {
+        const ExprNode& node = tree.nodes[i];
+        if (node.kind == NodeKind::UNARY && node.index == op && complexities[i - 1] > max_operand)
+            return true;
+    }
+    return false;
 }
 
-template<typename CT>
-int count_max_nestedness(Node tree, int degree, std::string op) {
-    auto nestedness = tree_mapreduce(
-            [](auto t) { return 0; },  // Leafs
-            [&](auto t) { return (t.degree == degree && t.op == op) ? 1 : 0; },  // Branches
-            [](auto p, auto... c) { return p + std::max(c...); },  // Reduce
-            tree,
-    );
-    // Remove count of self:
-    auto is_self = tree.degree == degree && tree.op == op;
-    return nestedness - (is_self ? 1 : 0);
+// Largest number of applications of the operator (`degree`, `op`) on one path
+// down from each node, the node itself included
+template <typename T>
+std::vector<int> _nestedness(const Expression<T>& tree, int degree, int op) {
+    std::vector<int> nestedness(tree.nodes.size());
+    for (std::size_t i = 0; i < tree.nodes.size(); ++i) {
+        const ExprNode& node = tree.nodes[i];
+        int below = 0;
+        if (node.degree >= 1)
+            below = nestedness[i - 1];
+        if (node.degree == 2)
+            below = std::max(below, nestedness[left_child(tree, i)]);
+        nestedness[i] = below + (node.degree == degree && node.index == op ? 1 : 0);
+    }
+    return nestedness;
 }
 
-bool flag_illegal_nests(Node tree, Options options) {
-    if (options.nested_constraints.empty()) {
+// Whether the tree breaks `options.nested_constraints`: each entry limits how
+// deeply one operator may be nested inside the operands of another
+template <typename T>
+bool flag_illegal_nests(const Expression<T>& tree, const Options& options) {
+    if (!options.nested_constraints || options.nested_constraints->empty())
         return false;
-    }
-    for (auto [degree, op_idx, op_constraint] : options.nested_constraints) {
-        for (auto [nested_degree, nested_op_idx, max_nestedness] : op_constraint) {
-            if (auto subtree = find_if(tree.begin(), tree.end(), [&](Node subtree) {
-                    if (subtree.degree == degree && subtree.op == op_idx) {
-                        auto nestedness = count_max_nestedness(subtree.l, nested_degree, nested_op_idx);
-                        return nestedness > max_nestedness;
-                    }
-                    return false;
-                }); subtree != tree.end()) {
-                return true;
+    for (const auto& [degree, op, constraints] : *options.nested_constraints) {
+        for (const auto& [nested_degree, nested_op, max_nestedness] : constraints) {
+            std::vector<int> nestedness = _nestedness(tree, nested_degree, nested_op);
+            for (std::size_t i = 0; i < tree.nodes.size(); ++i) {
+                const ExprNode& node = tree.nodes[i];
+                if (node.degree != degree || node.index != op)
+                    continue;
+                // Do not count the node itself
+                bool self = node.degree == nested_degree && node.index == nested_op;
+                if (nestedness[i] - (self ? 1 : 0) > max_nestedness)
+                    return true;
             }
         }
     }
     return false;
 }
 
-bool check_constraints(Node tree, Options options, int maxsize, optional<int> cursize = nullopt) {
-    if ((cursize ? *cursize : compute_complexity(tree, options)) > maxsize) {
+// Whether the tree satisfies the size, depth, operand complexity and nesting
+// constraints of `options`. `cursize` is the tree's complexity, if known.
+template <typename T>
+bool check_constraints(const Expression<T>& tree, const Options& options, int maxsize,
+                       std::optional<int> cursize = std::nullopt) {
+    std::vector<int> complexities = subtree_complexities(tree, options);
+    if (cursize.value_or(complexities.back()) > maxsize)
         return false;
-    }
-    if (count_depth(tree) > options.maxdepth) {
+    if (count_depth(tree) > options.maxdepth)
         return false;
-    }
-    for (int i = 0; i < options.nbin; ++i) {
-        auto [cons1, cons2] = options.bin_constraints[i];
-        if (cons1 == -1 || cons2 == -1) {
+    for (std::size_t op = 0; op < options.bin_constraints.size(); ++op) {
+        auto [max_left, max_right] = options.bin_constraints[op];
+        if (max_left == -1 && max_right == -1)
             continue;
-        }
-        if (flag_bin_operator_complexity(tree, i, {cons1, cons2}, options)) {
+        if (flag_bin_operator_complexity(tree, complexities, static_cast<int>(op), max_left, max_right))
             return false;
-        }
     }
-    for (int i = 0; i < options.nuna; ++i) {
-        auto cons = options.una_constraints[i];
-        if (cons == -1) {
+    for (std::size_t op = 0; op < options.una_constraints.size(); ++op) {
+        int max_operand = options.una_constraints[op];
+        if (max_operand == -1)
             continue;
-        }
-        if (flag_una_operator_complexity(tree, i, cons, options)) {
+        if (flag_una_operator_complexity(tree, complexities, static_cast<int>(op), max_operand))
             return false;
-        }
     }
-    if (flag_illegal_nests(tree, options)) {
-        return false;
-    }
-    return true;
+    return !flag_illegal_nests(tree, options);
 }
 
-bool check_constraints(Node tree, Options options) {
-    return check_constraints(tree, options.maxsize);
-}
\ No newline at end of file
+template <typename T>
+bool check_constraints(const Expression<T>& tree, const Options& options) {
+    return check_constraints(tree, options, options.maxsize);
+}
@@ -1,55 +1,55 @@
 #pragma once
 
-#include <iostream>
+#include <cmath>
+#include <cstddef>
 #include <vector>
-#include <map>
-#include <string>
-#include <algorithm>
 
-struct Node {
-    bool constant;
-    int degree;
-    std::string op;
-};
+#include "Expression.h"
 
-struct Options {
-    struct ComplexityMapping {
-        bool use;
-        int constant_complexity;
-        int variable_complexity;
-        std::map<std::string, int> unaop_complexities;
-        std::map<std::string, int> binop_complexities;
-    } complexity_mapping;
-};
-
-template<typename CT>
-bool past_complexity_limit(Node tree, Options options, CT limit) {
-    return compute_complexity(tree, options) > limit;
-}
-
-template<typename CT>
-int compute_complexity(Node tree, Options options) {
-    if (options.complexity_mapping.use) {
-        auto raw_complexity = _compute_complexity(tree, options);
-        return static_cast<int>(std::round(raw_complexity));
-    } else {
-        return count_nodes(tree);
+// Complexity of every subtree of the tree, indexed by its root node: its
+// number of nodes or, with `options.complexity_mapping.use`, the sum of the
+// complexities the mapping gives its constants, variables and operators,
+// rounded to the nearest integer
+template <typename T>
+std::vector<int> subtree_complexities(const Expression<T>& tree, const Options& options) {
+    const auto& cmap = options.complexity_mapping;
+    std::vector<int> complexities(tree.nodes.size());
+    if (!cmap.use) {
+        for (std::size_t i = 0; i < tree.nodes.size(); ++i)
+            complexities[i] = static_cast<int>(tree.nodes[i].size);
+        return complexities;
     }
+    std::vector<double> raw(tree.nodes.size());
+    for (std::size_t i = 0; i < tree.nodes.size(); ++i) {
+        const ExprNode& node = tree.nodes[i];
+        switch (node.kind) {
+            case NodeKind::CONSTANT:
+                raw[i] = static_cast<double>(cmap.constant_complexity);
+                break;
+            case NodeKind::FEATURE:
+                raw[i] = static_cast<double>(cmap.variable_complexity);
+                break;
+            case NodeKind::UNARY:
+                raw[i] = static_cast<double>(cmap.unaop_complexities[node.index]) + raw[i - 1];
+                break;
+            case NodeKind::BINARY:
+                raw[i] = static_cast<double>(cmap.binop_complexities[node.index]) + raw[left_child(tree, i)] + raw[i - 1];
+                break;
+        }
+        complexities[i] = static_cast<int>(std::round(raw[i]));
+    }
+    return complexities;
 }
 
-template<typename CT>
-CT _compute_complexity(Node tree, Options options) {
-    auto cmap = options.complexity_mapping;
-    auto constant_complexity = cmap.constant_complexity;
-    auto variable_complexity = cmap.variable_complexity;
-    auto unaop_complexities = cmap.unaop_complexities;
-    auto binop_complexities = cmap.binop_complexities;
+// Complexity of the whole tree; see `subtree_complexities`
+template <typename T>
+int compute_complexity(const Expression<T>& tree, const Options& options) {
+    if (!options.complexity_mapping.use)
+        return static_cast<int>(count_nodes(tree));
+    return subtree_complexities(tree, options).back();
+}
 
-    return tree_mapreduce(
-            t -> t.constant ? constant_complexity : variable_complexity,
-            t -> t.degree == 1 ? unaop_complexities[t.op] : binop_complexities[t.op],
-            +,
-            tree,
-            CT
-    );
-}
\ No newline at end of file
+template <typename T>
+bool past_complexity_limit(const Expression<T>& tree, const Options& options, int limit) {
+    return compute_complexity(tree, options) > limit;
+}
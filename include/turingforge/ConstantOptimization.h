@@ -6,23 +6,37 @@
 #include <algorithm>
 #include <random>
 
-// Proxy function for optimization
+#include "Bytecode.h"
+#include "Expression.h"
+#include "Gradient.h"
+#include "Optim.h"
+#include "Scoring.h"
+
+// Proxy function for optimization. Only the constants change between calls,
+// so the tree is compiled once and its program is run for every evaluation.
 template <typename T, typename L>
-L opt_func(const std::vector<T>& x, const Dataset<T, L>& dataset, Node<T>* tree, const std::vector<Node<T>*>& constant_nodes, const Options& options)
+L opt_func(const std::vector<T>& x, const Dataset<T, L>& dataset, Expression<T>& tree, const Program<T>& program, const Options& options)
 {
-_set_constants(x, constant_nodes);
+_set_constants(x, tree);
 // TODO: This should use score_func batching.
-L loss = eval_loss(tree, dataset, options);
+L loss = eval_loss(program, tree, dataset, options);
 return loss;
 }
 
-template <typename T>
-void _set_constants(const std::vector<T>& x, const std::vector<Node<T>*>& constant_nodes)
-{
-for (std::size_t i = 0; i < x.size(); ++i)
+// Proxy function with its gradient with respect to the constants, from a
+// forward- or reverse-mode pass over the tree
+template <typename T, typename L>
+L opt_grad_func(const std::vector<T>& x, std::vector<T>& gradient, const Dataset<T, L>& dataset, Expression<T>& tree, const Options& options)
 {
-constant_nodes[i]->val = x[i];
+_set_constants(x, tree);
+return eval_loss_and_gradient(tree, dataset, options, gradient);
 }
+
+// Constants live in one slot array, so setting them is a single copy
+template <typename T>
+void _set_constants(const std::vector<T>& x, Expression<T>& tree)
+{
+std::copy(x.begin(), x.end(), tree.constants.begin());
 }
 
 // Use Nelder-Mead to optimize the constants in an equation
@@ -32,6 +46,8 @@ std::pair<PopMember<T, L>, double> optimize_constants(const Dataset<T, L>& datas
     int nconst = count_constants(member.tree);
     if (nconst == 0)
         return std::make_pair(member, 0.0);
+    if (has_constant_gradient(member.tree, options) && (nconst == 1 || options.optimizer_algorithm == "BFGS"))
+        return _optimize_constants_gradient(dataset, member, options);
     if constexpr (std::is_same_v<T, std::complex<T>>)
     {
         // TODO: Make this more general. Also, do we even need Newton here at all??
@@ -65,19 +81,11 @@ std::pair<PopMember<T, L>, double> optimize_constants(const Dataset<T, L>& datas
 template <typename T, typename L>
 std::pair<PopMember<T, L>, double> _optimize_constants(const Dataset<T, L>& dataset, const PopMember<T, L>& member, const Options& options, const Optim::Algorithm& algorithm, const Optim::OptimizerOptions& optimizer_options)
 {
-    Node<T>* tree = member.tree;
-    std::vector<Node<T>*> constant_nodes;
-    for (Node<T>* node : tree)
-    {
-        if (node->degree == 0 && node->constant)
-            constant_nodes.push_back(node);
-    }
-    std::vector<T> x0(constant_nodes.size());
-    for (std::size_t i = 0; i < constant_nodes.size(); ++i)
-    {
-        x0[i] = constant_nodes[i]->val;
-    }
-    auto f = [&](const std::vector<T>& x) { return opt_func(x, dataset, tree, constant_nodes, options); };
+    PopMember<T, L> new_member = copy_pop_member(member);
+    Expression<T>& tree = new_member.tree;
+    std::vector<T> x0 = tree.constants;
+    const Program<T>& program = cached_program(new_member.program, tree, options.operators);
+    auto f = [&](const std::vector<T>& x) { return opt_func(x, dataset, tree, program, options); };
     auto result = Optim::optimize(f, x0, algorithm, optimizer_options);
     double num_evals = result.f_calls;
     // Try other initial conditions:
@@ -94,17 +102,60 @@ std::pair<PopMember<T, L>, double> _optimize_constants(const Dataset<T, L>& data
         }
     }
 
+    _finish_optimization(dataset, new_member, x0, result, num_evals, options);
+    return std::make_pair(new_member, num_evals);
+}
+
+// BFGS on the exact gradient of the loss, for losses and operators that
+// `eval_loss_and_gradient` can differentiate. An iteration whose unit step is
+// accepted costs one gradient pass, and each shorter trial step one loss pass.
+// Gradient passes count as `gradient_cost` evaluations.
+template <typename T, typename L>
+std::pair<PopMember<T, L>, double> _optimize_constants_gradient(const Dataset<T, L>& dataset, const PopMember<T, L>& member, const Options& options)
+{
+    PopMember<T, L> new_member = copy_pop_member(member);
+    Expression<T>& tree = new_member.tree;
+    std::vector<T> x0 = tree.constants;
+    const Program<T>& program = cached_program(new_member.program, tree, options.operators);
+    auto f = [&](const std::vector<T>& x) { return opt_func(x, dataset, tree, program, options); };
+    auto fg = [&](const std::vector<T>& x, std::vector<T>& g) { return opt_grad_func(x, g, dataset, tree, options); };
+    const double g_cost = gradient_cost(tree);
+    auto result = Optim::optimize(f, fg, x0, Optim::BFGS{}, options.optimizer_options);
+    double num_evals = result.f_calls + result.g_calls * g_cost;
+    for (int i = 1; i <= options.optimizer_nrestarts; ++i)
+    {
+        std::vector<T> new_start(x0.size());
+        std::transform(x0.begin(), x0.end(), new_start.begin(), [&](const T& val) { return val * (T(1) + T(1 / 2.0) * std::normal_distribution<T>()(std::mt19937(std::random_device{}()))); });
+        auto tmpresult = Optim::optimize(f, fg, new_start, Optim::BFGS{}, options.optimizer_options);
+        num_evals += tmpresult.f_calls + tmpresult.g_calls * g_cost;
+
+        if (tmpresult.minimum < result.minimum)
+        {
+            result = tmpresult;
+        }
+    }
+
+    _finish_optimization(dataset, new_member, x0, result, num_evals, options);
+    return std::make_pair(new_member, num_evals);
+}
+
+// Keep the best constants found and rescore the member, or restore the
+// original constants if the optimizer did not converge
+template <typename T, typename L, typename R>
+void _finish_optimization(const Dataset<T, L>& dataset, PopMember<T, L>& new_member, const std::vector<T>& x0, const R& result, double& num_evals, const Options& options)
+{
+    Expression<T>& tree = new_member.tree;
     if (Optim::converged(result))
     {
-        _set_constants(result.minimizer, constant_nodes);
-        auto [score, loss] = score_func(dataset, member, options);
+        _set_constants(result.minimizer, tree);
+        auto [score, loss] = score_func(dataset, new_member, options);
+        new_member.score = score;
+        new_member.loss = loss;
         num_evals += 1.0;
-        member.birth = get_birth_order(options.deterministic);
+        new_member.birth = get_birth_order(options.deterministic);
     }
     else
     {
-        _set_constants(x0, constant_nodes);
+        _set_constants(x0, tree);
     }
-
-    return std::make_pair(member, num_evals);
 }
\ No newline at end of file
@@ -3,10 +3,17 @@
 #include <unordered_map>
 #include <string>
 #include <any>
+#include <type_traits>
 
 constexpr int MAX_DEGREE = 2;
 constexpr int BATCH_DIM = 1;
 constexpr int FEATURE_DIM = 0;
+// Number of rows evaluated together; scratch buffers for one tile stay in L1
+constexpr int EVAL_TILE_SIZE = 256;
+// Type that sums over rows of `T` are accumulated in. Single precision sums
+// drift after a few thousand rows, so they are accumulated in double.
+template <typename T>
+using accumulator_t = std::conditional_t<std::is_same_v<T, float>, double, T>;
 using RecordType = std::unordered_map<std::string, std::any>;
 
 using DataType = double;
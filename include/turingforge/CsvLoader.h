@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "Aligned.h"
+#include "Dataset.h"
+#include "DatasetFile.h"
+#include "ThreadPool.h"
+
+// Bytes of CSV per parsing task, see load_csv
+constexpr std::size_t CSV_CHUNK_BYTES = std::size_t(1) << 20;
+
+struct CsvOptions {
+    std::optional<std::string> target;   // name of the target column; the last column if not set
+    std::optional<std::string> weights;  // name of the weight column, if any
+    char delimiter = ',';
+    std::size_t chunk_bytes = CSV_CHUNK_BYTES;
+};
+
+// Column roles of a CSV file, from its header row
+struct _CsvColumns {
+    std::size_t count = 0;
+    std::size_t target = 0;
+    std::optional<std::size_t> weights;
+    std::vector<int> feature;  // feature index of each column, -1 for the target and weights
+    std::vector<std::string> varMap;
+};
+
+// `field` without surrounding spaces and, for header names, quotes
+inline std::string_view _csv_trim(std::string_view field) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t'))
+        field.remove_prefix(1);
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\t' || field.back() == '\r'))
+        field.remove_suffix(1);
+    return field;
+}
+
+inline _CsvColumns _csv_columns(std::string_view header, const CsvOptions& options) {
+    std::vector<std::string> names;
+    while (true) {
+        std::size_t stop = header.find(options.delimiter);
+        std::string_view name = _csv_trim(header.substr(0, stop));
+        if (name.size() >= 2 && name.front() == '"' && name.back() == '"')
+            name = name.substr(1, name.size() - 2);
+        names.emplace_back(name);
+        if (stop == std::string_view::npos)
+            break;
+        header.remove_prefix(stop + 1);
+    }
+    auto index = [&](const std::string& name) {
+        auto found = std::find(names.begin(), names.end(), name);
+        if (found == names.end())
+            throw std::invalid_argument("CSV header has no column named " + name);
+        return static_cast<std::size_t>(found - names.begin());
+    };
+
+    _CsvColumns columns;
+    columns.count = names.size();
+    columns.target = options.target ? index(*options.target) : names.size() - 1;
+    if (options.weights)
+        columns.weights = index(*options.weights);
+    if (names.size() < 2 || columns.weights == columns.target)
+        throw std::invalid_argument("CSV needs a target column and at least one feature column");
+    for (std::size_t column = 0; column < names.size(); ++column) {
+        if (column == columns.target || column == columns.weights) {
+            columns.feature.push_back(-1);
+        } else {
+            columns.feature.push_back(static_cast<int>(columns.varMap.size()));
+            columns.varMap.push_back(names[column]);
+        }
+    }
+    return columns;
+}
+
+// End of the line starting at `line`, i.e. its '\n' or `end`
+inline const char* _csv_line_end(const char* line, const char* end) {
+    const void* newline = std::memchr(line, '\n', static_cast<std::size_t>(end - line));
+    return newline == nullptr ? end : static_cast<const char*>(newline);
+}
+
+// Start of the line after the one ending at `stop`, or `end`
+inline const char* _csv_next_line(const char* stop, const char* end) {
+    return stop < end ? stop + 1 : end;
+}
+
+// Whether the line [line, stop) holds no fields, e.g. the empty line that
+// ends a file or a lone '\r'
+inline bool _csv_blank(const char* line, const char* stop) {
+    return stop == line || (stop - line == 1 && *line == '\r');
+}
+
+/*
+ * Load the CSV file `path` into a dataset: a header row of column names, then
+ * one row of numbers per line. The target and the optional weights are picked
+ * by name in `options`, every other column is a feature, and varMap holds the
+ * feature names. Fields are plain numbers, parsed with `std::from_chars`;
+ * blank lines are skipped and quoted fields are not supported.
+ *
+ * The file is mapped and split into byte ranges of `options.chunk_bytes`. On
+ * `pool`, the ranges are aligned to line boundaries and their rows counted in
+ * parallel, then each range is parsed straight into its rows of the feature
+ * columns, targets and weights, so no row-major copy is made.
+ */
+template <typename T, typename L>
+Dataset<T, L, Matrix<T>> load_csv(const std::string& path, const CsvOptions& options = CsvOptions(),
+                                  ThreadPool* pool = nullptr) {
+    MappedFile file(path);
+    const char* begin = reinterpret_cast<const char*>(file.data());
+    const char* end = begin + file.size();
+    if (begin == end)
+        throw std::invalid_argument(path + " is empty");
+    const char* header_end = _csv_line_end(begin, end);
+    _CsvColumns columns = _csv_columns(std::string_view(begin, header_end - begin), options);
+    const char* body = _csv_next_line(header_end, end);
+
+    auto run = [&](std::size_t n, auto&& f) {
+        if (pool == nullptr) {
+            for (std::size_t i = 0; i < n; ++i)
+                f(i);
+        } else {
+            pool->parallel_for(n, f);
+        }
+    };
+
+    // Chunk `i` starts at the first line that starts at or after its nominal
+    // start, so each line belongs to exactly one chunk
+    const std::size_t chunk_bytes = std::max<std::size_t>(options.chunk_bytes, 1);
+    const std::size_t nchunks = std::max<std::size_t>(1, (static_cast<std::size_t>(end - body) + chunk_bytes - 1) / chunk_bytes);
+    std::vector<const char*> starts(nchunks + 1, end);
+    run(nchunks, [&](std::size_t chunk) {
+        if (chunk == 0) {
+            starts[0] = body;
+            return;
+        }
+        const char* nominal = body + chunk * chunk_bytes;
+        starts[chunk] = nominal[-1] == '\n' ? nominal : _csv_next_line(_csv_line_end(nominal, end), end);
+    });
+    std::vector<std::size_t> offsets(nchunks + 1, 0);
+    run(nchunks, [&](std::size_t chunk) {
+        std::size_t rows = 0;
+        for (const char* line = starts[chunk]; line < starts[chunk + 1];) {
+            const char* stop = _csv_line_end(line, starts[chunk + 1]);
+            rows += !_csv_blank(line, stop);
+            line = _csv_next_line(stop, starts[chunk + 1]);
+        }
+        offsets[chunk + 1] = rows;
+    });
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    if (offsets.back() > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+        throw std::invalid_argument(path + " has more rows than a dataset holds");
+
+    const auto n = static_cast<int>(offsets.back());
+    const auto nfeatures = static_cast<int>(columns.varMap.size());
+    Matrix<T> X(nfeatures, n);
+    std::optional<AlignedVector<T>> y(std::in_place, n);
+    std::optional<AlignedVector<T>> weights;
+    if (columns.weights)
+        weights.emplace(n);
+
+    // Where each column's values go, indexed by row
+    std::vector<T*> destinations(columns.count);
+    for (std::size_t column = 0; column < columns.count; ++column) {
+        if (column == columns.target)
+            destinations[column] = y->data();
+        else if (column == columns.weights)
+            destinations[column] = weights->data();
+        else
+            destinations[column] = X.data() + static_cast<std::size_t>(columns.feature[column]) * X.stride;
+    }
+    run(nchunks, [&](std::size_t chunk) {
+        std::size_t row = offsets[chunk];
+        for (const char* line = starts[chunk]; line < starts[chunk + 1];) {
+            const char* stop = _csv_line_end(line, starts[chunk + 1]);
+            if (_csv_blank(line, stop)) {
+                line = _csv_next_line(stop, starts[chunk + 1]);
+                continue;
+            }
+            const char* field = line;
+            for (std::size_t column = 0; column < columns.count; ++column) {
+                while (field < stop && (*field == ' ' || *field == '\t'))
+                    ++field;
+                T value;
+                auto [next, error] = std::from_chars(field, stop, value);
+                while (next < stop && (*next == ' ' || *next == '\t' || *next == '\r'))
+                    ++next;
+                bool last = column + 1 == columns.count;
+                if (error != std::errc() || (last ? next != stop : (next == stop || *next != options.delimiter))) {
+                    const char* bad = std::find(field, stop, options.delimiter);
+                    throw std::invalid_argument(path + ": data row " + std::to_string(row + 1) + ", column "
+                                                + std::to_string(column + 1) + ": expected " + std::to_string(columns.count)
+                                                + " numbers, found '" + std::string(_csv_trim(std::string_view(field, bad - field))) + "'");
+                }
+                destinations[column][row] = value;
+                field = last ? stop : next + 1;
+            }
+            ++row;
+            line = _csv_next_line(stop, starts[chunk + 1]);
+        }
+    });
+
+    Dataset<T, L, Matrix<T>> dataset(std::move(X), std::move(y), std::move(weights));
+    dataset.varMap = std::move(columns.varMap);
+    return dataset;
+}
@@ -1,13 +1,102 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
 #include <vector>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <any>
+#include <numeric>
+#include <optional>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 
+#include "Aligned.h"
 #include "Constants.h"
+#include "ThreadPool.h"
 
-template <typename T, typename L, typename AX, typename AY = std::optional<std::vector<T>>, typename AW = std::optional<std::vector<T>>, typename NT = std::tuple<>>
+// Rows per block when transposing row-major input, see Matrix
+constexpr std::size_t TRANSPOSE_BLOCK_ROWS = 256;
+
+// Dense [nfeatures, n] feature matrix; each feature is one contiguous column
+// of rows starting on a SIMD_ALIGNMENT boundary, so the evaluator reads a
+// feature leaf in place. Columns are `stride` rows apart: `n` padded to whole
+// SIMD_ALIGNMENT blocks. The padding rows are zero and never evaluated.
+template <typename T>
+struct Matrix {
+    std::array<int, 2> dims;
+    std::size_t stride;
+    AlignedVector<T> values;
+
+    Matrix(int nfeatures, int n) : dims{nfeatures, n}, stride(padded_size<T>(n)), values(nfeatures * stride) {}
+
+    // Transpose of `row_major`, which holds the `nfeatures` values of each row
+    // in turn, as read from a CSV file. Blocks of TRANSPOSE_BLOCK_ROWS rows are
+    // transposed on `pool` if given; each writes its own part of every column.
+    Matrix(std::span<const T> row_major, int nfeatures, ThreadPool* pool = nullptr) :
+            Matrix(nfeatures, _rows(row_major.size(), nfeatures)) {
+        const std::size_t n = static_cast<std::size_t>(dims[BATCH_DIM]);
+        const std::size_t nblocks = (n + TRANSPOSE_BLOCK_ROWS - 1) / TRANSPOSE_BLOCK_ROWS;
+        auto transpose = [&](std::size_t block) {
+            std::size_t begin = block * TRANSPOSE_BLOCK_ROWS;
+            std::size_t end = std::min(n, begin + TRANSPOSE_BLOCK_ROWS);
+            for (int feature = 0; feature < nfeatures; ++feature) {
+                T* column = values.data() + static_cast<std::size_t>(feature) * stride;
+                for (std::size_t row = begin; row < end; ++row)
+                    column[row] = row_major[row * nfeatures + feature];
+            }
+        };
+        if (pool == nullptr) {
+            for (std::size_t block = 0; block < nblocks; ++block)
+                transpose(block);
+        } else {
+            pool->parallel_for(nblocks, transpose);
+        }
+    }
+
+    [[nodiscard]] std::array<int, 2> shape() const { return dims; }
+    [[nodiscard]] const T* data() const { return values.data(); }
+    [[nodiscard]] T* data() { return values.data(); }
+    T& operator()(int feature, int row) { return values[static_cast<std::size_t>(feature) * stride + row]; }
+    const T& operator()(int feature, int row) const { return values[static_cast<std::size_t>(feature) * stride + row]; }
+
+private:
+    static int _rows(std::size_t size, int nfeatures) {
+        if (nfeatures <= 0 || size % static_cast<std::size_t>(nfeatures) != 0)
+            throw std::invalid_argument("Row-major features must hold whole rows of nfeatures values");
+        return static_cast<int>(size / static_cast<std::size_t>(nfeatures));
+    }
+};
+
+// Non-owning view of the features as one contiguous column of rows per feature
+template <typename T>
+struct ColumnView {
+    const T* data;
+    std::size_t stride;  // distance between the first rows of two features
+    std::size_t n;
+    int nfeatures;
+
+    [[nodiscard]] const T* column(int feature) const {
+        return data + static_cast<std::size_t>(feature) * stride;
+    }
+};
+
+template <typename T>
+class SubtreeCache;
+
+template <typename L>
+class FitnessMemo;
+
+template <typename T>
+struct ShuffledRows;
+
+// Targets and weights are kept in aligned storage like the feature columns;
+// plain vectors passed to the constructor are copied into it.
+template <typename T, typename L, typename AX, typename AY = std::optional<AlignedVector<T>>, typename AW = std::optional<AlignedVector<T>>, typename NT = std::tuple<>>
 struct Dataset {
     AX X;
     AY y;
@@ -20,17 +109,63 @@ struct Dataset {
     bool use_baseline;
     L baseline_loss;
     std::vector<std::string> varMap;
+    std::shared_ptr<SubtreeCache<T>> subtree_cache;  // shared by every population scoring against this dataset
+    std::shared_ptr<FitnessMemo<L>> fitness_memo;     // scores of trees already evaluated on this dataset
+    std::shared_ptr<ShuffledRows<T>> shuffled_rows;   // row order that racing scores on, see Racing.h
 
-    Dataset(AX X_, AY y_ = std::nullopt, AW weights_ = std::nullopt, NT extra_ = NT(), L loss_type_ = L()) :
-            X(X_), y(y_), n(X_.shape()[BATCH_DIM]), nfeatures(X_.shape()[FEATURE_DIM]), weighted(weights_.has_value()), weights(weights_), extra(extra_), avg_y(std::nullopt), use_baseline(true), baseline_loss(T(1)), varMap(nfeatures) {
+    Dataset(AX X_, AY y_ = std::nullopt, AW weights_ = std::nullopt, NT extra_ = NT()) :
+            X(std::move(X_)), y(std::move(y_)), n(X.shape()[BATCH_DIM]), nfeatures(X.shape()[FEATURE_DIM]), weighted(weights_.has_value()), weights(std::move(weights_)), extra(extra_), avg_y(std::nullopt), use_baseline(true), baseline_loss(L(1)) {
         if (y.has_value()) {
-            avg_y = weighted ? (y.value() * weights.value()).sum() / weights.value().sum() : y.value().mean();
-        }
-        if (varMap.empty()) {
-            for (int i = 0; i < nfeatures; ++i) {
-                varMap[i] = "x" + std::to_string(i + 1);
+            const auto& ys = y.value();
+            using A = accumulator_t<T>;
+            if (weighted) {
+                const auto& ws = weights.value();
+                avg_y = static_cast<T>(std::inner_product(ys.begin(), ys.end(), ws.begin(), A(0)) / std::accumulate(ws.begin(), ws.end(), A(0)));
+            } else {
+                avg_y = static_cast<T>(std::accumulate(ys.begin(), ys.end(), A(0)) / static_cast<A>(n));
             }
         }
-        baseline_loss = loss_type_.has_value() ? loss_type_ : T();
+        varMap.reserve(nfeatures);
+        for (int i = 0; i < nfeatures; ++i) {
+            varMap.push_back("x" + std::to_string(i + 1));
+        }
+    }
+
+    Dataset(AX X_, const std::vector<T>& y_, const std::optional<std::vector<T>>& weights_ = std::nullopt,
+            NT extra_ = NT()) :
+            Dataset(std::move(X_), AY(std::in_place, y_.begin(), y_.end()),
+                    weights_ ? AW(std::in_place, weights_->begin(), weights_->end()) : AW(), std::move(extra_)) {}
+
+    // Column access for the evaluator; `X` must store each feature contiguously
+    [[nodiscard]] ColumnView<T> columns() const {
+        std::size_t stride = static_cast<std::size_t>(n);
+        if constexpr (requires { X.stride; })
+            stride = X.stride;
+        return ColumnView<T>{X.data(), stride, static_cast<std::size_t>(n), nfeatures};
+    }
+};
+
+// Copy of the dataset with its features, targets and weights stored as `U`,
+// e.g. float for a single precision search; losses stay in `L`
+template <typename U, typename T, typename L, typename AX, typename AY, typename AW>
+Dataset<U, L, Matrix<U>> to_precision(const Dataset<T, L, AX, AY, AW>& dataset) {
+    using AlignedValues = std::optional<AlignedVector<U>>;
+    auto convert = [](const auto& values) { return AlignedValues(std::in_place, values.begin(), values.end()); };
+    Matrix<U> X(dataset.nfeatures, dataset.n);
+    ColumnView<T> columns = dataset.columns();
+    for (int feature = 0; feature < dataset.nfeatures; ++feature) {
+        const T* column = columns.column(feature);
+        std::copy(column, column + dataset.n, X.data() + static_cast<std::size_t>(feature) * X.stride);
     }
-};
\ No newline at end of file
+    AlignedValues y;
+    if (dataset.y.has_value())
+        y = convert(dataset.y.value());
+    AlignedValues weights;
+    if (dataset.weighted)
+        weights = convert(dataset.weights.value());
+    Dataset<U, L, Matrix<U>> converted(std::move(X), std::move(y), std::move(weights));
+    converted.use_baseline = dataset.use_baseline;
+    converted.baseline_loss = dataset.baseline_loss;
+    converted.varMap = dataset.varMap;
+    return converted;
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Aligned.h"
+#include "Constants.h"
+#include "Dataset.h"
+
+/*
+ * Binary dataset files
+ *
+ * A dataset file holds one Dataset as it is laid out in memory, so that a
+ * search maps it read-only instead of parsing it: every process that maps the
+ * same file shares its pages through the page cache. The file is
+ *
+ *   DatasetFileHeader                      (DATASET_FILE_VERSION)
+ *   varMap                                 names, each followed by '\0'
+ *   X      at header.features_offset       nfeatures columns of `stride` values
+ *   y      at header.targets_offset        n values, if DATASET_FILE_TARGETS
+ *   w      at header.weights_offset        n values, if DATASET_FILE_WEIGHTED
+ *
+ * with every block starting on a SIMD_ALIGNMENT boundary and the column
+ * padding zero, as in Matrix. Values are stored in the byte order of the
+ * writer; `byte_order` tells a reader on another machine to convert first.
+ */
+
+constexpr std::array<char, 8> DATASET_FILE_MAGIC = {'T', 'F', 'D', 'A', 'T', 'A', '\0', '\0'};
+constexpr std::uint32_t DATASET_FILE_VERSION = 1;
+constexpr std::uint32_t DATASET_FILE_BYTE_ORDER = 0x01020304;
+
+// Header flags
+constexpr std::uint32_t DATASET_FILE_TARGETS = 1;
+constexpr std::uint32_t DATASET_FILE_WEIGHTED = 2;
+constexpr std::uint32_t DATASET_FILE_BASELINE = 4;  // `baseline_loss` is used to normalize scores
+
+struct DatasetFileHeader {
+    std::array<char, 8> magic = DATASET_FILE_MAGIC;
+    std::uint32_t version = DATASET_FILE_VERSION;
+    std::uint32_t byte_order = DATASET_FILE_BYTE_ORDER;
+    std::uint32_t value_bytes = 0;  // 4 for float32 values, 8 for float64
+    std::uint32_t flags = 0;
+    std::uint64_t n = 0;
+    std::uint64_t nfeatures = 0;
+    std::uint64_t stride = 0;
+    double avg_y = 0;
+    double baseline_loss = 1;
+    std::uint64_t names_bytes = 0;
+    std::uint64_t features_offset = 0;
+    std::uint64_t targets_offset = 0;
+    std::uint64_t weights_offset = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<DatasetFileHeader>);
+
+// `offset` rounded up to the next SIMD_ALIGNMENT boundary
+constexpr std::uint64_t _aligned_offset(std::uint64_t offset) {
+    return (offset + SIMD_ALIGNMENT - 1) / SIMD_ALIGNMENT * SIMD_ALIGNMENT;
+}
+
+// Read-only mapping of a whole file, unmapped when the last owner lets go
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "Cannot open " + path);
+        struct stat info {};
+        if (::fstat(fd, &info) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "Cannot stat " + path);
+        }
+        bytes = static_cast<std::size_t>(info.st_size);
+        if (bytes > 0) {
+            void* mapped = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped == MAP_FAILED) {
+                int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "Cannot map " + path);
+            }
+            address = static_cast<const std::byte*>(mapped);
+        }
+        // The mapping keeps the file open
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (address != nullptr)
+            ::munmap(const_cast<std::byte*>(address), bytes);
+    }
+
+    [[nodiscard]] const std::byte* data() const { return address; }
+    [[nodiscard]] std::size_t size() const { return bytes; }
+
+private:
+    const std::byte* address = nullptr;
+    std::size_t bytes = 0;
+};
+
+// Feature matrix read in place from a mapped dataset file; the same layout
+// and accessors as Matrix, but read-only
+template <typename T>
+struct MappedMatrix {
+    std::shared_ptr<const MappedFile> file;
+    const T* values;
+    std::array<int, 2> dims;
+    std::size_t stride;
+
+    [[nodiscard]] std::array<int, 2> shape() const { return dims; }
+    [[nodiscard]] const T* data() const { return values; }
+    const T& operator()(int feature, int row) const { return values[static_cast<std::size_t>(feature) * stride + row]; }
+};
+
+// Dataset whose features, targets and weights all point into a mapped file
+template <typename T, typename L>
+using MappedDataset = Dataset<T, L, MappedMatrix<T>, std::optional<std::span<const T>>, std::optional<std::span<const T>>>;
+
+/*
+ * Write `dataset` to `path` in the dataset file format. The baseline loss and
+ * `use_baseline` are stored as they are, so call `update_baseline_loss` with
+ * the search's loss first if it matters to the readers.
+ */
+template <typename T, typename L, typename AX, typename AY, typename AW, typename NT>
+void write_dataset_file(const Dataset<T, L, AX, AY, AW, NT>& dataset, const std::string& path) {
+    static_assert(std::is_floating_point_v<T> && (sizeof(T) == 4 || sizeof(T) == 8),
+                  "Dataset files store float32 or float64 values");
+    const auto n = static_cast<std::uint64_t>(dataset.n);
+    DatasetFileHeader header;
+    header.value_bytes = sizeof(T);
+    header.n = n;
+    header.nfeatures = static_cast<std::uint64_t>(dataset.nfeatures);
+    header.stride = padded_size<T>(dataset.n);
+    if (dataset.y.has_value()) {
+        header.flags |= DATASET_FILE_TARGETS;
+        header.avg_y = static_cast<double>(dataset.avg_y.value());
+    }
+    if (dataset.weighted)
+        header.flags |= DATASET_FILE_WEIGHTED;
+    if (dataset.use_baseline)
+        header.flags |= DATASET_FILE_BASELINE;
+    header.baseline_loss = static_cast<double>(dataset.baseline_loss);
+
+    std::string names;
+    for (const std::string& name : dataset.varMap) {
+        if (name.find('\0') != std::string::npos)
+            throw std::invalid_argument("Feature names must not contain '\\0'");
+        names += name;
+        names += '\0';
+    }
+    header.names_bytes = names.size();
+    header.features_offset = _aligned_offset(sizeof(DatasetFileHeader) + names.size());
+    std::uint64_t end = header.features_offset + header.nfeatures * header.stride * sizeof(T);
+    if (dataset.y.has_value()) {
+        header.targets_offset = _aligned_offset(end);
+        end = header.targets_offset + n * sizeof(T);
+    }
+    if (dataset.weighted) {
+        header.weights_offset = _aligned_offset(end);
+        end = header.weights_offset + n * sizeof(T);
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::system_error(errno, std::generic_category(), "Cannot create " + path);
+    auto write = [&](const void* data, std::uint64_t bytes) {
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+    };
+    auto pad_to = [&](std::uint64_t offset) {
+        static const std::array<char, SIMD_ALIGNMENT> zeros{};
+        auto position = static_cast<std::uint64_t>(out.tellp());
+        write(zeros.data(), offset - position);
+    };
+    write(&header, sizeof(header));
+    write(names.data(), names.size());
+    pad_to(header.features_offset);
+    ColumnView<T> columns = dataset.columns();
+    const std::vector<T> padding(header.stride - n, T(0));
+    for (int feature = 0; feature < dataset.nfeatures; ++feature) {
+        write(columns.column(feature), n * sizeof(T));
+        write(padding.data(), padding.size() * sizeof(T));
+    }
+    if (dataset.y.has_value()) {
+        pad_to(header.targets_offset);
+        write(dataset.y.value().data(), n * sizeof(T));
+    }
+    if (dataset.weighted) {
+        pad_to(header.weights_offset);
+        write(dataset.weights.value().data(), n * sizeof(T));
+    }
+    out.close();
+    if (!out)
+        throw std::system_error(errno, std::generic_category(), "Cannot write " + path);
+}
+
+// Header of the mapped dataset file `file`, checked against the file's size
+// and against values of type `T`
+template <typename T>
+DatasetFileHeader _dataset_file_header(const MappedFile& file, const std::string& path) {
+    DatasetFileHeader header;
+    if (file.size() < sizeof(header))
+        throw std::invalid_argument(path + " is not a dataset file");
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != DATASET_FILE_MAGIC)
+        throw std::invalid_argument(path + " is not a dataset file");
+    if (header.version != DATASET_FILE_VERSION)
+        throw std::invalid_argument(path + " has dataset file version " + std::to_string(header.version)
+                                    + ", expected " + std::to_string(DATASET_FILE_VERSION));
+    if (header.byte_order != DATASET_FILE_BYTE_ORDER)
+        throw std::invalid_argument(path + " was written with a different byte order");
+    if (header.value_bytes != sizeof(T))
+        throw std::invalid_argument(path + " stores float" + std::to_string(8 * header.value_bytes)
+                                    + " values; map it with that precision and convert with to_precision");
+
+    auto fits = [&](std::uint64_t offset, std::uint64_t count) {
+        return offset % SIMD_ALIGNMENT == 0 && offset <= file.size()
+               && count <= (file.size() - offset) / sizeof(T);
+    };
+    bool valid = header.n <= static_cast<std::uint64_t>(std::numeric_limits<int>::max())
+                 && header.nfeatures <= static_cast<std::uint64_t>(std::numeric_limits<int>::max())
+                 && header.stride >= header.n && header.names_bytes <= file.size() - sizeof(header)
+                 && (header.nfeatures == 0 || header.stride <= std::numeric_limits<std::uint64_t>::max() / header.nfeatures)
+                 && fits(header.features_offset, header.nfeatures * header.stride)
+                 && (!(header.flags & DATASET_FILE_TARGETS) || fits(header.targets_offset, header.n))
+                 && (!(header.flags & DATASET_FILE_WEIGHTED) || fits(header.weights_offset, header.n));
+    if (!valid)
+        throw std::invalid_argument(path + " is truncated or has an invalid header");
+    return header;
+}
+
+// The `\0`-terminated feature names that follow the header
+inline std::vector<std::string> _dataset_file_names(const MappedFile& file, const DatasetFileHeader& header) {
+    std::vector<std::string> names;
+    const char* begin = reinterpret_cast<const char*>(file.data()) + sizeof(header);
+    const char* end = begin + header.names_bytes;
+    while (begin < end) {
+        const char* stop = std::find(begin, end, '\0');
+        names.emplace_back(begin, stop);
+        begin = stop + 1;
+    }
+    if (names.size() != header.nfeatures)
+        throw std::invalid_argument("Dataset file has " + std::to_string(names.size()) + " feature names for "
+                                    + std::to_string(header.nfeatures) + " features");
+    return names;
+}
+
+/*
+ * Map the dataset file `path` read-only and return a dataset that reads it in
+ * place: nothing is parsed or copied, and `avg_y` and the baseline come from
+ * the header. The mapping lives as long as the dataset and its copies.
+ */
+template <typename T, typename L>
+MappedDataset<T, L> map_dataset(const std::string& path) {
+    auto file = std::make_shared<const MappedFile>(path);
+    DatasetFileHeader header = _dataset_file_header<T>(*file, path);
+    auto at = [&](std::uint64_t offset) { return reinterpret_cast<const T*>(file->data() + offset); };
+    std::vector<std::string> names = _dataset_file_names(*file, header);
+
+    const auto n = static_cast<int>(header.n);
+    MappedMatrix<T> X{file, at(header.features_offset), {static_cast<int>(header.nfeatures), n}, header.stride};
+    std::optional<std::span<const T>> weights;
+    if (header.flags & DATASET_FILE_WEIGHTED)
+        weights.emplace(at(header.weights_offset), header.n);
+    // The targets are set after construction, which would otherwise recompute avg_y
+    MappedDataset<T, L> dataset(std::move(X), std::nullopt, std::move(weights));
+    if (header.flags & DATASET_FILE_TARGETS) {
+        dataset.y.emplace(at(header.targets_offset), header.n);
+        dataset.avg_y = static_cast<T>(header.avg_y);
+    }
+    dataset.use_baseline = (header.flags & DATASET_FILE_BASELINE) != 0;
+    dataset.baseline_loss = static_cast<L>(header.baseline_loss);
+    dataset.varMap = std::move(names);
+    return dataset;
+}
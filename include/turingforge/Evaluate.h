@@ -0,0 +1,369 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "Constants.h"
+#include "Dataset.h"
+#include "Expression.h"
+#include "OperatorEnum.h"
+#include "Operators.h"
+#include "Simd.h"
+
+// A value on the evaluation stack: either the rows of the current tile starting
+// at `ptr`, or a single value shared by every row (a constant, or an operator
+// applied to constants only)
+template <typename T>
+struct Operand {
+    const T* ptr;
+    T value;
+    bool scalar;
+};
+
+// Scratch space for evaluating a tree one tile at a time. Each stack slot owns
+// one tile-sized buffer, so the whole workspace of a typical tree fits in L1.
+template <typename T>
+struct TileWorkspace {
+    std::vector<T> scratch;
+    std::vector<Operand<T>> stack;
+
+    void reserve(const Expression<T>& tree) {
+        auto depth = static_cast<std::size_t>(count_max_stack(tree));
+        if (stack.size() < depth) {
+            stack.resize(depth);
+            scratch.resize(depth * EVAL_TILE_SIZE);
+        }
+    }
+};
+
+// Run a unary kernel written against `simd::Pack`/`simd::Scalar`
+template <typename T, typename F>
+void _unary_packed(F f, Operand<T>& x, T* dst, int m) {
+    if (x.scalar) {
+        x.value = f(simd::Scalar<T>{x.value}).v;
+        return;
+    }
+    simd::map<T>(f, x.ptr, dst, static_cast<std::size_t>(m));
+    x = Operand<T>{dst, T(0), false};
+}
+
+// Run a unary scalar function on every row
+template <typename T, typename F>
+void _unary_elementwise(F f, Operand<T>& x, T* dst, int m) {
+    if (x.scalar) {
+        x.value = f(x.value);
+        return;
+    }
+    const T* src = x.ptr;
+    for (int i = 0; i < m; ++i)
+        dst[i] = f(src[i]);
+    x = Operand<T>{dst, T(0), false};
+}
+
+// Run a binary kernel written against `simd::Pack`/`simd::Scalar`. Scalar
+// operands are broadcast once instead of being expanded into a column.
+template <typename T, typename F>
+void _binary_packed(F f, Operand<T>& a, const Operand<T>& b, T* dst, int m) {
+    using P = simd::Pack<T>;
+    using S = simd::Scalar<T>;
+    constexpr int w = static_cast<int>(P::width);
+    if (a.scalar && b.scalar) {
+        a.value = f(S{a.value}, S{b.value}).v;
+        return;
+    }
+    int i = 0;
+    if (a.scalar) {
+        P av = P::broadcast(a.value);
+        for (; i + w <= m; i += w)
+            f(av, P::load(b.ptr + i)).store(dst + i);
+        for (; i < m; ++i)
+            f(S{a.value}, S::load(b.ptr + i)).store(dst + i);
+    } else if (b.scalar) {
+        P bv = P::broadcast(b.value);
+        for (; i + w <= m; i += w)
+            f(P::load(a.ptr + i), bv).store(dst + i);
+        for (; i < m; ++i)
+            f(S::load(a.ptr + i), S{b.value}).store(dst + i);
+    } else {
+        for (; i + w <= m; i += w)
+            f(P::load(a.ptr + i), P::load(b.ptr + i)).store(dst + i);
+        for (; i < m; ++i)
+            f(S::load(a.ptr + i), S::load(b.ptr + i)).store(dst + i);
+    }
+    a = Operand<T>{dst, T(0), false};
+}
+
+// Run a binary scalar function on every row
+template <typename T, typename F>
+void _binary_elementwise(F f, Operand<T>& a, const Operand<T>& b, T* dst, int m) {
+    if (a.scalar && b.scalar) {
+        a.value = f(a.value, b.value);
+        return;
+    }
+    if (a.scalar) {
+        for (int i = 0; i < m; ++i)
+            dst[i] = f(a.value, b.ptr[i]);
+    } else if (b.scalar) {
+        for (int i = 0; i < m; ++i)
+            dst[i] = f(a.ptr[i], b.value);
+    } else {
+        for (int i = 0; i < m; ++i)
+            dst[i] = f(a.ptr[i], b.ptr[i]);
+    }
+    a = Operand<T>{dst, T(0), false};
+}
+
+// Tile kernel of a builtin operator. The result is left in the first operand,
+// as a column in `dst` or as a scalar if every operand is a scalar.
+template <typename T>
+using UnaryKernel = void (*)(Operand<T>& x, T* dst, int m);
+
+template <typename T>
+using BinaryKernel = void (*)(Operand<T>& a, const Operand<T>& b, T* dst, int m);
+
+template <typename T, UnaryOperator Op>
+void _unary_kernel(Operand<T>& x, T* dst, int m) {
+    if constexpr (Op == UnaryOperator::NEG)
+        _unary_packed([](auto v) { return -v; }, x, dst, m);
+    else if constexpr (Op == UnaryOperator::SQUARE)
+        _unary_packed([](auto v) { return v * v; }, x, dst, m);
+    else if constexpr (Op == UnaryOperator::CUBE)
+        _unary_packed([](auto v) { return v * v * v; }, x, dst, m);
+    else if constexpr (Op == UnaryOperator::ABS)
+        _unary_packed([](auto v) { return abs(v); }, x, dst, m);
+    else if constexpr (Op == UnaryOperator::SQRT)
+        // IEEE square root already returns NaN for negative inputs, like safe_sqrt
+        _unary_packed([](auto v) { return sqrt(v); }, x, dst, m);
+    else if constexpr (Op == UnaryOperator::RELU)
+        _unary_packed([](auto v) { return (v + abs(v)) * decltype(v)::broadcast(T(0.5)); }, x, dst, m);
+    else if constexpr (Op == UnaryOperator::EXP)
+        _unary_elementwise([](T v) { return std::exp(v); }, x, dst, m);
+    else if constexpr (Op == UnaryOperator::LOG)
+        _unary_elementwise(safe_log<T>, x, dst, m);
+    else if constexpr (Op == UnaryOperator::LOG2)
+        _unary_elementwise(safe_log2<T>, x, dst, m);
+    else if constexpr (Op == UnaryOperator::LOG10)
+        _unary_elementwise(safe_log10<T>, x, dst, m);
+    else if constexpr (Op == UnaryOperator::LOG1P)
+        _unary_elementwise(safe_log1p<T>, x, dst, m);
+    else if constexpr (Op == UnaryOperator::SIN)
+        _unary_elementwise([](T v) { return std::sin(v); }, x, dst, m);
+    else if constexpr (Op == UnaryOperator::COS)
+        _unary_elementwise([](T v) { return std::cos(v); }, x, dst, m);
+    else if constexpr (Op == UnaryOperator::TANH)
+        _unary_elementwise([](T v) { return std::tanh(v); }, x, dst, m);
+    else if constexpr (Op == UnaryOperator::ACOSH)
+        _unary_elementwise(safe_acosh<T>, x, dst, m);
+    else if constexpr (Op == UnaryOperator::ATANH_CLIP)
+        _unary_elementwise(atanh_clip<T>, x, dst, m);
+    else if constexpr (Op == UnaryOperator::GAMMA)
+        _unary_elementwise(gamma<T>, x, dst, m);
+}
+
+template <typename T, BinaryOperator Op>
+void _binary_kernel(Operand<T>& a, const Operand<T>& b, T* dst, int m) {
+    if constexpr (Op == BinaryOperator::PLUS)
+        _binary_packed([](auto x, auto y) { return x + y; }, a, b, dst, m);
+    else if constexpr (Op == BinaryOperator::SUB)
+        _binary_packed([](auto x, auto y) { return x - y; }, a, b, dst, m);
+    else if constexpr (Op == BinaryOperator::MULT)
+        _binary_packed([](auto x, auto y) { return x * y; }, a, b, dst, m);
+    else if constexpr (Op == BinaryOperator::DIV)
+        _binary_packed([](auto x, auto y) { return x / y; }, a, b, dst, m);
+    else if constexpr (Op == BinaryOperator::POW)
+        _binary_elementwise(safe_pow<T>, a, b, dst, m);
+    else if constexpr (Op == BinaryOperator::GREATER)
+        _binary_packed([](auto x, auto y) { return greater(x, y); }, a, b, dst, m);
+    else if constexpr (Op == BinaryOperator::LOGICAL_OR)
+        _binary_packed([](auto x, auto y) { return logical_or(x, y); }, a, b, dst, m);
+    else if constexpr (Op == BinaryOperator::LOGICAL_AND)
+        _binary_packed([](auto x, auto y) { return logical_and(x, y); }, a, b, dst, m);
+}
+
+// Kernel of a builtin unary operator, or nullptr for CUSTOM
+template <typename T>
+UnaryKernel<T> unary_kernel(UnaryOperator op) {
+    switch (op) {
+        case UnaryOperator::NEG: return _unary_kernel<T, UnaryOperator::NEG>;
+        case UnaryOperator::SQUARE: return _unary_kernel<T, UnaryOperator::SQUARE>;
+        case UnaryOperator::CUBE: return _unary_kernel<T, UnaryOperator::CUBE>;
+        case UnaryOperator::ABS: return _unary_kernel<T, UnaryOperator::ABS>;
+        case UnaryOperator::SQRT: return _unary_kernel<T, UnaryOperator::SQRT>;
+        case UnaryOperator::RELU: return _unary_kernel<T, UnaryOperator::RELU>;
+        case UnaryOperator::EXP: return _unary_kernel<T, UnaryOperator::EXP>;
+        case UnaryOperator::LOG: return _unary_kernel<T, UnaryOperator::LOG>;
+        case UnaryOperator::LOG2: return _unary_kernel<T, UnaryOperator::LOG2>;
+        case UnaryOperator::LOG10: return _unary_kernel<T, UnaryOperator::LOG10>;
+        case UnaryOperator::LOG1P: return _unary_kernel<T, UnaryOperator::LOG1P>;
+        case UnaryOperator::SIN: return _unary_kernel<T, UnaryOperator::SIN>;
+        case UnaryOperator::COS: return _unary_kernel<T, UnaryOperator::COS>;
+        case UnaryOperator::TANH: return _unary_kernel<T, UnaryOperator::TANH>;
+        case UnaryOperator::ACOSH: return _unary_kernel<T, UnaryOperator::ACOSH>;
+        case UnaryOperator::ATANH_CLIP: return _unary_kernel<T, UnaryOperator::ATANH_CLIP>;
+        case UnaryOperator::GAMMA: return _unary_kernel<T, UnaryOperator::GAMMA>;
+        case UnaryOperator::CUSTOM: break;
+    }
+    return nullptr;
+}
+
+// Kernel of a builtin binary operator, or nullptr for CUSTOM
+template <typename T>
+BinaryKernel<T> binary_kernel(BinaryOperator op) {
+    switch (op) {
+        case BinaryOperator::PLUS: return _binary_kernel<T, BinaryOperator::PLUS>;
+        case BinaryOperator::SUB: return _binary_kernel<T, BinaryOperator::SUB>;
+        case BinaryOperator::MULT: return _binary_kernel<T, BinaryOperator::MULT>;
+        case BinaryOperator::DIV: return _binary_kernel<T, BinaryOperator::DIV>;
+        case BinaryOperator::POW: return _binary_kernel<T, BinaryOperator::POW>;
+        case BinaryOperator::GREATER: return _binary_kernel<T, BinaryOperator::GREATER>;
+        case BinaryOperator::LOGICAL_OR: return _binary_kernel<T, BinaryOperator::LOGICAL_OR>;
+        case BinaryOperator::LOGICAL_AND: return _binary_kernel<T, BinaryOperator::LOGICAL_AND>;
+        case BinaryOperator::CUSTOM: break;
+    }
+    return nullptr;
+}
+
+// Apply the custom unary operator `op` through the function table
+template <typename T>
+void _custom_unary(const OperatorEnum& operators, std::size_t op, Operand<T>& x, T* dst, int m) {
+    const auto& f = operators.unaops[op];
+    _unary_elementwise([&f](T v) { return static_cast<T>(f(v)); }, x, dst, m);
+}
+
+// Apply the custom binary operator `op` through the function table
+template <typename T>
+void _custom_binary(const OperatorEnum& operators, std::size_t op, Operand<T>& a, const Operand<T>& b, T* dst, int m) {
+    const auto& f = operators.binops[op];
+    _binary_elementwise([&f](T x, T y) { return static_cast<T>(f(x, y)); }, a, b, dst, m);
+}
+
+// Apply unary operator `op` to `x`, writing a column result into `dst`
+template <typename T>
+void _eval_unary(const OperatorEnum& operators, std::size_t op, Operand<T>& x, T* dst, int m) {
+    if (UnaryKernel<T> kernel = unary_kernel<T>(operators.unaop_id(op)))
+        kernel(x, dst, m);
+    else
+        _custom_unary(operators, op, x, dst, m);
+}
+
+// Apply binary operator `op` to `a` and `b`, leaving the result in `a`
+template <typename T>
+void _eval_binary(const OperatorEnum& operators, std::size_t op, Operand<T>& a, const Operand<T>& b, T* dst, int m) {
+    if (BinaryKernel<T> kernel = binary_kernel<T>(operators.binop_id(op)))
+        kernel(a, b, dst, m);
+    else
+        _custom_binary(operators, op, a, b, dst, m);
+}
+
+// Evaluate rows `[row, row + m)` of the tree, with `m <= EVAL_TILE_SIZE`.
+// Intermediate columns live in the workspace and feature leaves are read in
+// place from `X`, so the result may point into either: consume it before the
+// next call. If `out` is given, the root operator writes straight into it.
+template <typename T>
+Operand<T> eval_tile(const Expression<T>& tree, const ColumnView<T>& X, const OperatorEnum& operators,
+                     std::size_t row, int m, TileWorkspace<T>& workspace, T* out = nullptr) {
+    Operand<T>* stack = workspace.stack.data();
+    T* scratch = workspace.scratch.data();
+    const std::size_t root = tree.root();
+    int top = -1;
+    for (std::size_t i = 0; i <= root; ++i) {
+        const ExprNode& node = tree.nodes[i];
+        switch (node.kind) {
+            case NodeKind::CONSTANT:
+                stack[++top] = Operand<T>{nullptr, tree.constants[node.index], true};
+                break;
+            case NodeKind::FEATURE:
+                stack[++top] = Operand<T>{X.column(node.index) + row, T(0), false};
+                break;
+            case NodeKind::UNARY: {
+                T* dst = (i == root && out != nullptr) ? out : scratch + top * EVAL_TILE_SIZE;
+                _eval_unary(operators, node.index, stack[top], dst, m);
+                break;
+            }
+            case NodeKind::BINARY: {
+                --top;
+                T* dst = (i == root && out != nullptr) ? out : scratch + top * EVAL_TILE_SIZE;
+                _eval_binary(operators, node.index, stack[top], stack[top + 1], dst, m);
+                break;
+            }
+        }
+    }
+    return stack[0];
+}
+
+// Copy the rows of an operand into `out`, unless they are already there
+template <typename T>
+void store_operand(const Operand<T>& x, T* out, int m) {
+    if (x.scalar)
+        std::fill(out, out + m, x.value);
+    else if (x.ptr != out)
+        std::copy(x.ptr, x.ptr + m, out);
+}
+
+// Whether every value is finite: `x * 0` is zero for finite values and NaN otherwise
+template <typename T>
+bool all_finite(const T* x, std::size_t n) {
+    using P = simd::Pack<T>;
+    P acc = P::broadcast(T(0));
+    P zero = P::broadcast(T(0));
+    std::size_t i = 0;
+    for (; i + P::width <= n; i += P::width)
+        acc = acc + P::load(x + i) * zero;
+    T rest = reduce_add(acc);
+    for (; i < n; ++i)
+        rest += x[i] * T(0);
+    return rest == T(0);
+}
+
+// Evaluations stopped before the last row, over the whole process. The safe
+// operators return NaN for invalid inputs, so a tree that is invalid on one row
+// is usually invalid on many; rows after the first bad tile are never evaluated.
+struct EarlyAbortStats {
+    std::atomic<std::size_t> nonfinite_aborts{0};
+    std::atomic<std::size_t> bound_aborts{0};
+    std::atomic<std::size_t> rows_skipped{0};
+};
+
+inline EarlyAbortStats& early_abort_stats() {
+    static EarlyAbortStats stats;
+    return stats;
+}
+
+// Record an evaluation that stopped at `row` of `n` because of a non-finite output
+inline void _record_nonfinite_abort(std::size_t row, std::size_t n) {
+    EarlyAbortStats& stats = early_abort_stats();
+    stats.nonfinite_aborts.fetch_add(1, std::memory_order_relaxed);
+    stats.rows_skipped.fetch_add(n - row, std::memory_order_relaxed);
+}
+
+// Evaluate the tree on every row of `X` into `out`. Returns false as soon as a
+// tile has a NaN or infinite output, in which case the tree is considered
+// invalid and the rows after that tile are left unwritten.
+template <typename T>
+bool eval_tree_array(const Expression<T>& tree, const ColumnView<T>& X, const OperatorEnum& operators,
+                     T* out, TileWorkspace<T>& workspace) {
+    workspace.reserve(tree);
+    for (std::size_t row = 0; row < X.n; row += EVAL_TILE_SIZE) {
+        int m = static_cast<int>(std::min<std::size_t>(EVAL_TILE_SIZE, X.n - row));
+        store_operand(eval_tile(tree, X, operators, row, m, workspace, out + row), out + row, m);
+        if (!all_finite(out + row, static_cast<std::size_t>(m))) {
+            _record_nonfinite_abort(row, X.n);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Evaluate the tree on every row of `X`; returns the prediction and whether it is complete
+template <typename T>
+std::pair<std::vector<T>, bool> eval_tree_array(const Expression<T>& tree, const ColumnView<T>& X,
+                                                const OperatorEnum& operators) {
+    thread_local TileWorkspace<T> workspace;
+    std::vector<T> out(X.n);
+    bool complete = eval_tree_array(tree, X, operators, out.data(), workspace);
+    return {std::move(out), complete};
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Kind of a node in a flat expression
+enum class NodeKind : std::uint8_t {
+    CONSTANT,
+    FEATURE,
+    UNARY,
+    BINARY
+};
+
+// A single node of a flat expression. Nodes are stored in postfix order, so the
+// children of a node always precede it and the subtree rooted at `i` is the
+// contiguous range `[i - size + 1, i]`. The right child of a binary node is at
+// `i - 1` and its left child at `i - 1 - nodes[i - 1].size`.
+// `index` is the operator index for branches, the feature index for variables
+// and the constant slot for constants.
+struct ExprNode {
+    NodeKind kind;
+    std::uint8_t degree;
+    std::uint16_t index;
+    std::uint32_t size;
+
+    bool operator==(const ExprNode&) const = default;
+};
+
+static_assert(std::is_trivially_copyable_v<ExprNode>, "ExprNode must stay trivially copyable");
+static_assert(sizeof(ExprNode) == 8, "ExprNode should fit in a single 8-byte word");
+
+// Flat, index-based expression. The nodes are kept in a single contiguous
+// postfix array and the constants in a slot array ordered by their position in
+// that array, so copying a tree is one memcpy per array and every traversal is
+// a linear scan.
+template <typename T>
+struct Expression {
+    std::vector<ExprNode> nodes;
+    std::vector<T> constants;
+
+    [[nodiscard]] std::size_t root() const {
+        return nodes.size() - 1;
+    }
+
+    [[nodiscard]] const ExprNode& root_node() const {
+        return nodes.back();
+    }
+
+    bool operator==(const Expression<T>&) const = default;
+};
+
+template <typename T>
+Expression<T> make_constant(T val) {
+    return Expression<T>{{ExprNode{NodeKind::CONSTANT, 0, 0, 1}}, {val}};
+}
+
+template <typename T>
+Expression<T> make_feature(int feature) {
+    return Expression<T>{{ExprNode{NodeKind::FEATURE, 0, static_cast<std::uint16_t>(feature), 1}}, {}};
+}
+
+template <typename T>
+Expression<T> make_unary(int op, Expression<T> child) {
+    auto size = static_cast<std::uint32_t>(child.nodes.size() + 1);
+    child.nodes.push_back(ExprNode{NodeKind::UNARY, 1, static_cast<std::uint16_t>(op), size});
+    return child;
+}
+
+template <typename T>
+Expression<T> make_binary(int op, Expression<T> left, const Expression<T>& right) {
+    auto size = static_cast<std::uint32_t>(left.nodes.size() + right.nodes.size() + 1);
+    auto offset = static_cast<std::uint16_t>(left.constants.size());
+    left.nodes.reserve(size);
+    for (ExprNode node : right.nodes) {
+        if (node.kind == NodeKind::CONSTANT)
+            node.index = static_cast<std::uint16_t>(node.index + offset);
+        left.nodes.push_back(node);
+    }
+    left.nodes.push_back(ExprNode{NodeKind::BINARY, 2, static_cast<std::uint16_t>(op), size});
+    left.constants.insert(left.constants.end(), right.constants.begin(), right.constants.end());
+    return left;
+}
+
+// Copy a tree. Both arrays are trivially copyable, so this is one memcpy each.
+template <typename T>
+Expression<T> copy_node(const Expression<T>& tree) {
+    return tree;
+}
+
+// Copy of the tree with its constants stored as `U`, e.g. to report the result
+// of a single precision search in double
+template <typename U, typename T>
+Expression<U> to_precision(const Expression<T>& tree) {
+    return Expression<U>{tree.nodes, std::vector<U>(tree.constants.begin(), tree.constants.end())};
+}
+
+// Index of the first (left-most) node of the subtree rooted at `i`
+template <typename T>
+std::size_t subtree_begin(const Expression<T>& tree, std::size_t i) {
+    return i + 1 - tree.nodes[i].size;
+}
+
+template <typename T>
+std::size_t right_child(const Expression<T>& tree, std::size_t i) {
+    return i - 1;
+}
+
+template <typename T>
+std::size_t left_child(const Expression<T>& tree, std::size_t i) {
+    return tree.nodes[i].degree == 1 ? i - 1 : i - 1 - tree.nodes[i - 1].size;
+}
+
+template <typename T>
+std::size_t count_nodes(const Expression<T>& tree) {
+    return tree.nodes.size();
+}
+
+template <typename T>
+std::size_t count_constants(const Expression<T>& tree) {
+    return tree.constants.size();
+}
+
+template <typename T>
+bool has_constants(const Expression<T>& tree) {
+    return !tree.constants.empty();
+}
+
+template <typename T>
+bool has_operators(const Expression<T>& tree) {
+    return tree.nodes.size() > 1;
+}
+
+// Number of constants stored before node `i`, i.e. the first constant slot
+// used by a subtree starting at `i`
+template <typename T>
+std::size_t constants_before(const Expression<T>& tree, std::size_t i) {
+    return static_cast<std::size_t>(std::count_if(tree.nodes.begin(), tree.nodes.begin() + i, [](const ExprNode& node) {
+        return node.kind == NodeKind::CONSTANT;
+    }));
+}
+
+template <typename T>
+int count_depth(const Expression<T>& tree) {
+    std::vector<int> stack;
+    stack.reserve(tree.nodes.size());
+    for (const ExprNode& node : tree.nodes) {
+        if (node.degree == 0) {
+            stack.push_back(1);
+        } else if (node.degree == 1) {
+            stack.back() += 1;
+        } else {
+            int right = stack.back();
+            stack.pop_back();
+            stack.back() = std::max(stack.back(), right) + 1;
+        }
+    }
+    return stack.back();
+}
+
+// Maximum number of values live at once while evaluating the tree left to right
+template <typename T>
+int count_max_stack(const Expression<T>& tree) {
+    int depth = 0;
+    int max_depth = 0;
+    for (const ExprNode& node : tree.nodes) {
+        depth += 1 - node.degree;
+        max_depth = std::max(max_depth, depth);
+    }
+    return max_depth;
+}
+
+// Renumber the constant slots so that they follow postfix order again
+template <typename T>
+void reindex_constants(Expression<T>& tree, std::size_t from = 0) {
+    auto slot = static_cast<std::uint16_t>(constants_before(tree, from));
+    for (std::size_t i = from; i < tree.nodes.size(); ++i) {
+        if (tree.nodes[i].kind == NodeKind::CONSTANT)
+            tree.nodes[i].index = slot++;
+    }
+}
+
+// Return the subtree rooted at `i` as a standalone expression
+template <typename T>
+Expression<T> extract_subtree(const Expression<T>& tree, std::size_t i) {
+    std::size_t begin = subtree_begin(tree, i);
+    std::size_t cbegin = constants_before(tree, begin);
+    Expression<T> sub;
+    sub.nodes.assign(tree.nodes.begin() + begin, tree.nodes.begin() + i + 1);
+    std::size_t nconst = 0;
+    for (ExprNode& node : sub.nodes) {
+        if (node.kind == NodeKind::CONSTANT)
+            node.index = static_cast<std::uint16_t>(nconst++);
+    }
+    sub.constants.assign(tree.constants.begin() + cbegin, tree.constants.begin() + cbegin + nconst);
+    return sub;
+}
+
+// Replace the subtree rooted at `i` with `sub`, in place. Ancestors are exactly
+// the later nodes whose range covers `i`, so their sizes are fixed in one scan.
+template <typename T>
+void replace_subtree(Expression<T>& tree, std::size_t i, const Expression<T>& sub) {
+    std::size_t begin = subtree_begin(tree, i);
+    std::size_t old_size = tree.nodes[i].size;
+    std::size_t new_size = sub.nodes.size();
+    std::size_t cbegin = constants_before(tree, begin);
+    auto old_nconst = static_cast<std::size_t>(std::count_if(tree.nodes.begin() + begin, tree.nodes.begin() + i + 1, [](const ExprNode& node) {
+        return node.kind == NodeKind::CONSTANT;
+    }));
+
+    for (std::size_t j = i + 1; j < tree.nodes.size(); ++j) {
+        if (j + 1 - tree.nodes[j].size <= begin)
+            tree.nodes[j].size = static_cast<std::uint32_t>(tree.nodes[j].size + new_size - old_size);
+    }
+
+    tree.nodes.erase(tree.nodes.begin() + begin, tree.nodes.begin() + i + 1);
+    tree.nodes.insert(tree.nodes.begin() + begin, sub.nodes.begin(), sub.nodes.end());
+    tree.constants.erase(tree.constants.begin() + cbegin, tree.constants.begin() + cbegin + old_nconst);
+    tree.constants.insert(tree.constants.begin() + cbegin, sub.constants.begin(), sub.constants.end());
+    reindex_constants(tree, begin);
+}
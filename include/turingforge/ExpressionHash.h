@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "Expression.h"
+#include "OperatorEnum.h"
+
+inline std::uint64_t _mix_hash(std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+inline std::uint64_t _combine_hash(std::uint64_t seed, std::uint64_t value) {
+    return _mix_hash(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+inline bool _commutative(BinaryOperator op) {
+    return op == BinaryOperator::PLUS || op == BinaryOperator::MULT ||
+           op == BinaryOperator::LOGICAL_OR || op == BinaryOperator::LOGICAL_AND;
+}
+
+// The mantissa of a constant, of magnitude below 1, rounded to steps of
+// `tolerance`. Tolerances below the machine epsilon cannot tell more values
+// apart and would overflow the step count, so they round to epsilon steps.
+template <typename T>
+std::int64_t _mantissa_step(T mantissa, T tolerance) {
+    return static_cast<std::int64_t>(std::round(mantissa / std::max(tolerance, std::numeric_limits<T>::epsilon())));
+}
+
+// Hash of a constant. With a zero tolerance the bits are hashed, otherwise the
+// mantissa is rounded to steps of `tolerance`, so values within roughly that
+// relative distance usually share a hash.
+template <typename T>
+std::uint64_t _constant_hash(T value, T tolerance) {
+    if (tolerance > T(0) && std::isfinite(value) && value != T(0)) {
+        int exponent;
+        T mantissa = std::frexp(value, &exponent);
+        auto step = _mantissa_step(mantissa, tolerance);
+        return _combine_hash(static_cast<std::uint64_t>(step), static_cast<std::uint64_t>(exponent));
+    }
+    if (value == T(0))
+        value = T(0);  // -0.0 and 0.0 hash equal
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(T) < sizeof(bits) ? sizeof(T) : sizeof(bits));
+    return bits;
+}
+
+// Structural hash of every subtree, indexed by its root node. Constants hash by
+// value rather than by slot, and the operands of builtin commutative operators
+// are ordered, so equal subtrees of different trees hash equal.
+template <typename T>
+std::vector<std::uint64_t> subtree_hashes(const Expression<T>& tree, const OperatorEnum& operators,
+                                          T constant_tolerance = T(0)) {
+    std::vector<std::uint64_t> hashes(tree.nodes.size());
+    for (std::size_t i = 0; i < tree.nodes.size(); ++i) {
+        const ExprNode& node = tree.nodes[i];
+        std::uint64_t h = _mix_hash(static_cast<std::uint64_t>(node.kind) + 1);
+        switch (node.kind) {
+            case NodeKind::CONSTANT:
+                h = _combine_hash(h, _constant_hash(tree.constants[node.index], constant_tolerance));
+                break;
+            case NodeKind::FEATURE:
+            case NodeKind::UNARY:
+                h = _combine_hash(h, node.index);
+                if (node.degree == 1)
+                    h = _combine_hash(h, hashes[i - 1]);
+                break;
+            case NodeKind::BINARY: {
+                std::uint64_t left = hashes[left_child(tree, i)];
+                std::uint64_t right = hashes[i - 1];
+                if (_commutative(operators.binop_id(node.index)) && right < left)
+                    std::swap(left, right);
+                h = _combine_hash(_combine_hash(_combine_hash(h, node.index), left), right);
+                break;
+            }
+        }
+        hashes[i] = h;
+    }
+    return hashes;
+}
+
+// Structural hash of the whole tree; see `subtree_hashes`
+template <typename T>
+std::uint64_t expression_hash(const Expression<T>& tree, const OperatorEnum& operators, T constant_tolerance = T(0)) {
+    return subtree_hashes(tree, operators, constant_tolerance).back();
+}
+
+// Append a constant to a canonical form as two words: its rounded mantissa
+// and exponent, or its bits and a marker that no exponent takes
+template <typename T>
+void _append_constant(T value, T tolerance, std::vector<std::uint64_t>& form) {
+    if (tolerance > T(0) && std::isfinite(value) && value != T(0)) {
+        int exponent;
+        T mantissa = std::frexp(value, &exponent);
+        form.push_back(static_cast<std::uint64_t>(_mantissa_step(mantissa, tolerance)));
+        form.push_back(static_cast<std::uint64_t>(static_cast<std::int64_t>(exponent)));
+        return;
+    }
+    form.push_back(_constant_hash(value, T(0)));
+    form.push_back(~std::uint64_t(0));
+}
+
+template <typename T>
+void _append_canonical(const Expression<T>& tree, std::size_t i, const std::vector<std::uint64_t>& hashes,
+                       const OperatorEnum& operators, T tolerance, std::vector<std::uint64_t>& form) {
+    const ExprNode& node = tree.nodes[i];
+    if (node.degree == 2) {
+        std::size_t left = left_child(tree, i);
+        std::size_t right = i - 1;
+        if (_commutative(operators.binop_id(node.index)) && hashes[right] < hashes[left])
+            std::swap(left, right);
+        _append_canonical(tree, left, hashes, operators, tolerance, form);
+        _append_canonical(tree, right, hashes, operators, tolerance, form);
+    } else if (node.degree == 1) {
+        _append_canonical(tree, i - 1, hashes, operators, tolerance, form);
+    }
+    std::uint64_t index = node.kind == NodeKind::CONSTANT ? 0 : node.index;
+    form.push_back(static_cast<std::uint64_t>(node.kind) | (index << 8));
+    if (node.kind == NodeKind::CONSTANT)
+        _append_constant(tree.constants[node.index], tolerance, form);
+}
+
+// Canonical form of the subtree rooted at `i`, given the `subtree_hashes` of
+// the tree computed with the same tolerance: its nodes in postfix order with
+// the operands of commutative operators ordered as the hash orders them, and
+// its constants by value. Subtrees with equal forms are equal up to the
+// constant tolerance, so a table keyed by hash compares forms to rule out a
+// collision. Equal subtrees whose operands have colliding hashes may still
+// get different forms, which only costs a lookup.
+template <typename T>
+std::vector<std::uint64_t> canonical_form(const Expression<T>& tree, std::size_t i,
+                                          const std::vector<std::uint64_t>& hashes, const OperatorEnum& operators,
+                                          T constant_tolerance = T(0)) {
+    std::vector<std::uint64_t> form;
+    form.reserve(tree.nodes[i].size + 2 * tree.constants.size());
+    _append_canonical(tree, i, hashes, operators, constant_tolerance, form);
+    return form;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Expression.h"
+#include "ExpressionHash.h"
+#include "OperatorEnum.h"
+
+// Score of a tree as computed on the full dataset
+template <typename L>
+struct MemoEntry {
+    L score;
+    L loss;
+    int complexity;
+};
+
+// Key of a tree in a fitness memo: its structural hash, and its canonical
+// form to tell it apart from another tree with the same hash
+struct MemoKey {
+    std::uint64_t hash = 0;
+    std::vector<std::uint64_t> form;
+};
+
+// Memo key of the tree, with constants compared up to `constant_tolerance`
+template <typename T>
+MemoKey memo_key(const Expression<T>& tree, const OperatorEnum& operators, T constant_tolerance) {
+    std::vector<std::uint64_t> hashes = subtree_hashes(tree, operators, constant_tolerance);
+    std::vector<std::uint64_t> form = canonical_form(tree, tree.root(), hashes, operators, constant_tolerance);
+    return MemoKey{hashes.back(), std::move(form)};
+}
+
+struct FitnessMemoStats {
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t insertions = 0;
+    std::size_t evictions = 0;
+    std::size_t collisions = 0;  // lookups whose hash matched another tree
+    std::size_t size = 0;
+
+    [[nodiscard]] double hit_rate() const {
+        std::size_t lookups = hits + misses;
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+    }
+};
+
+// Concurrent table from the structural hash of a tree (see `expression_hash`)
+// to its score, so that a candidate identical to one scored earlier costs one
+// lookup instead of a pass over the data. Entries keep the canonical form of
+// their tree, and a lookup whose form differs is a miss, so a hash collision
+// cannot give a tree another tree's score. The table is split into shards with
+// their own lock; each shard holds at most `capacity / FITNESS_MEMO_SHARDS`
+// entries and drops its oldest one when full.
+template <typename L>
+class FitnessMemo {
+public:
+    static constexpr std::size_t FITNESS_MEMO_SHARDS = 16;
+
+    FitnessMemo(const OperatorEnum& operators, std::size_t capacity, double constant_tolerance)
+            : operators(operators.signature()),
+              shard_capacity((capacity + FITNESS_MEMO_SHARDS - 1) / FITNESS_MEMO_SHARDS),
+              constant_tolerance(constant_tolerance) {}
+
+    // Whether hashes computed with this operator table can be looked up here:
+    // the table the memo was made for, or one with the same signature
+    [[nodiscard]] bool bound_to(const OperatorEnum& operators_) const {
+        return operators_.matches(operators);
+    }
+
+    [[nodiscard]] double tolerance() const {
+        return constant_tolerance;
+    }
+
+    std::optional<MemoEntry<L>> find(const MemoKey& key) {
+        Shard& shard = shard_of(key.hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key.hash);
+        if (it == shard.entries.end() || it->second.form != key.form) {
+            shard.counters.collisions += it != shard.entries.end();
+            ++shard.counters.misses;
+            return std::nullopt;
+        }
+        ++shard.counters.hits;
+        return it->second.entry;
+    }
+
+    void insert(MemoKey key, const MemoEntry<L>& entry) {
+        Shard& shard = shard_of(key.hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!shard.entries.emplace(key.hash, Stored{entry, std::move(key.form)}).second)
+            return;
+        shard.order.push_back(key.hash);
+        ++shard.counters.insertions;
+        if (shard.entries.size() > shard_capacity) {
+            shard.entries.erase(shard.order.front());
+            shard.order.pop_front();
+            ++shard.counters.evictions;
+        }
+    }
+
+    [[nodiscard]] FitnessMemoStats stats() const {
+        FitnessMemoStats total;
+        for (const Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total.hits += shard.counters.hits;
+            total.misses += shard.counters.misses;
+            total.insertions += shard.counters.insertions;
+            total.evictions += shard.counters.evictions;
+            total.collisions += shard.counters.collisions;
+            total.size += shard.entries.size();
+        }
+        return total;
+    }
+
+    // Drop every entry, e.g. when the baseline loss used by the scores changes
+    void clear() {
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.entries.clear();
+            shard.order.clear();
+        }
+    }
+
+private:
+    struct Stored {
+        MemoEntry<L> entry;
+        std::vector<std::uint64_t> form;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::uint64_t, Stored> entries;
+        std::deque<std::uint64_t> order;  // insertion order, oldest first
+        FitnessMemoStats counters;
+    };
+
+    Shard& shard_of(std::uint64_t key) {
+        return shards[key % FITNESS_MEMO_SHARDS];
+    }
+
+    OperatorSignature operators;
+    std::size_t shard_capacity;
+    double constant_tolerance;
+    std::array<Shard, FITNESS_MEMO_SHARDS> shards;
+};
@@ -0,0 +1,586 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Constants.h"
+#include "Dataset.h"
+#include "Evaluate.h"
+#include "Expression.h"
+#include "OperatorEnum.h"
+#include "Scoring.h"
+#include "Simd.h"
+#include "Loss/LossFunctions.h"
+
+// Whether every operator of the tree has a known derivative, i.e. none is custom
+template <typename T>
+bool is_differentiable(const Expression<T>& tree, const OperatorEnum& operators) {
+    return std::none_of(tree.nodes.begin(), tree.nodes.end(), [&](const ExprNode& node) {
+        return (node.kind == NodeKind::UNARY && operators.unaop_id(node.index) == UnaryOperator::CUSTOM) ||
+               (node.kind == NodeKind::BINARY && operators.binop_id(node.index) == BinaryOperator::CUSTOM);
+    });
+}
+
+// Digamma function, the derivative of log(gamma(x))
+template <typename T>
+T _digamma(T x) {
+    if (x <= T(0) && x == std::floor(x))
+        return std::numeric_limits<T>::quiet_NaN();
+    const T pi = T(3.14159265358979323846);
+    if (x < T(0.5))
+        return _digamma(T(1) - x) - pi / std::tan(pi * x);
+    T result = T(0);
+    for (; x < T(6); x += T(1))
+        result -= T(1) / x;
+    T f = T(1) / (x * x);
+    return result + std::log(x) - T(0.5) / x -
+           f * (T(1) / 12 - f * (T(1) / 120 - f * (T(1) / 252 - f * (T(1) / 240 - f / 132))));
+}
+
+// Dot product of two tiles, with independent partial sums so that the additions
+// are not one serial dependency chain
+template <typename T>
+accumulator_t<T> _tile_dot(const T* a, const T* b, int m) {
+    using A = accumulator_t<T>;
+    constexpr int LANES = 8;
+    A partial[LANES] = {};
+    int i = 0;
+    for (; i + LANES <= m; i += LANES) {
+        for (int j = 0; j < LANES; ++j)
+            partial[j] += static_cast<A>(a[i + j] * b[i + j]);
+    }
+    A s = A(0);
+    for (; i < m; ++i)
+        s += static_cast<A>(a[i] * b[i]);
+    for (A p : partial)
+        s += p;
+    return s;
+}
+
+// A value on the dual evaluation stack: the rows of the current tile and, if
+// the subtree contains constants, the derivatives of those rows with respect to
+// every constant, as one column of EVAL_TILE_SIZE rows per constant
+template <typename T>
+struct DualOperand {
+    const T* value;
+    T* tangent;  // nullptr if the subtree has no constants
+};
+
+// Scratch space for forward-mode evaluation. Each stack slot owns a value tile
+// and one tangent tile per constant, so it is meant for trees with few constants.
+template <typename T>
+struct DualWorkspace {
+    std::size_t nconstants = 0;
+    std::size_t depth = 0;
+    std::vector<T> values;          // one tile per stack slot, plus a spare one for results
+    std::vector<T> tangents;        // `nconstants` tiles per stack slot
+    std::vector<T> partials;        // derivatives of an operator with respect to its two operands
+    std::vector<T*> value_buffers;  // value tile of each slot; results are swapped in from the spare
+    std::vector<DualOperand<T>> stack;
+
+    void reserve(const Expression<T>& tree) {
+        depth = static_cast<std::size_t>(count_max_stack(tree));
+        nconstants = tree.constants.size();
+        values.resize((depth + 1) * EVAL_TILE_SIZE);
+        tangents.resize(std::max<std::size_t>(depth * nconstants, 1) * EVAL_TILE_SIZE);
+        partials.resize(2 * EVAL_TILE_SIZE);
+        value_buffers.resize(depth + 1);
+        for (std::size_t slot = 0; slot <= depth; ++slot)
+            value_buffers[slot] = values.data() + slot * EVAL_TILE_SIZE;
+        stack.resize(depth);
+    }
+
+    [[nodiscard]] T* tangent(std::size_t slot) {
+        return tangents.data() + slot * nconstants * EVAL_TILE_SIZE;
+    }
+};
+
+// Apply `f`, written against `simd::Pack`/`simd::Scalar`, lane-wise to two tiles
+template <typename T, typename F>
+void _map_tiles(F f, const T* a, const T* b, T* out, int m) {
+    using P = simd::Pack<T>;
+    using S = simd::Scalar<T>;
+    constexpr int w = static_cast<int>(P::width);
+    int i = 0;
+    for (; i + w <= m; i += w)
+        f(P::load(a + i), P::load(b + i)).store(out + i);
+    for (; i < m; ++i)
+        f(S::load(a + i), S::load(b + i)).store(out + i);
+}
+
+template <typename T>
+void _multiply_tiles(const T* a, const T* b, T* out, int m) {
+    _map_tiles([](auto u, auto v) { return u * v; }, a, b, out, m);
+}
+
+// out += a * b
+template <typename T>
+void _multiply_add_tiles(const T* a, const T* b, T* out, int m) {
+    using P = simd::Pack<T>;
+    using S = simd::Scalar<T>;
+    constexpr int w = static_cast<int>(P::width);
+    int i = 0;
+    for (; i + w <= m; i += w)
+        (P::load(out + i) + P::load(a + i) * P::load(b + i)).store(out + i);
+    for (; i < m; ++i)
+        (S::load(out + i) + S::load(a + i) * S::load(b + i)).store(out + i);
+}
+
+// Derivative of a unary operator through a scalar function of its input and output
+template <typename T, typename F>
+void _unary_partials(F partial, const T* x, const T* y, T* g, int m) {
+    for (int i = 0; i < m; ++i)
+        g[i] = partial(x[i], y[i]);
+}
+
+// Derivative of `y = op(x)` with respect to `x`, on every row. Derivatives
+// that are arithmetic in `x` and `y` run on packs.
+template <typename T>
+void _unary_derivative(UnaryOperator op, const T* x, const T* y, T* g, int m) {
+    switch (op) {
+        case UnaryOperator::NEG: std::fill(g, g + m, T(-1)); break;
+        case UnaryOperator::SQUARE:
+            _map_tiles([](auto u, auto) { return u + u; }, x, y, g, m);
+            break;
+        case UnaryOperator::CUBE:
+            _map_tiles([](auto u, auto) { return u * u * decltype(u)::broadcast(T(3)); }, x, y, g, m);
+            break;
+        case UnaryOperator::ABS:
+            _unary_partials([](T u, T) { return u > T(0) ? T(1) : (u < T(0) ? T(-1) : T(0)); }, x, y, g, m);
+            break;
+        case UnaryOperator::SQRT:
+            _map_tiles([](auto, auto v) { return decltype(v)::broadcast(T(0.5)) / v; }, x, y, g, m);
+            break;
+        case UnaryOperator::RELU: _unary_partials([](T u, T) { return u > T(0) ? T(1) : T(0); }, x, y, g, m); break;
+        case UnaryOperator::EXP: std::copy(y, y + m, g); break;
+        case UnaryOperator::LOG:
+            _map_tiles([](auto u, auto) { return decltype(u)::broadcast(T(1)) / u; }, x, y, g, m);
+            break;
+        case UnaryOperator::LOG2:
+            _map_tiles([](auto u, auto) { return decltype(u)::broadcast(T(1.44269504088896340736)) / u; },
+                       x, y, g, m);
+            break;
+        case UnaryOperator::LOG10:
+            _map_tiles([](auto u, auto) { return decltype(u)::broadcast(T(0.43429448190325182765)) / u; },
+                       x, y, g, m);
+            break;
+        case UnaryOperator::LOG1P:
+            _map_tiles([](auto u, auto) {
+                using P = decltype(u);
+                return P::broadcast(T(1)) / (P::broadcast(T(1)) + u);
+            }, x, y, g, m);
+            break;
+        case UnaryOperator::SIN: _unary_partials([](T u, T) { return std::cos(u); }, x, y, g, m); break;
+        case UnaryOperator::COS: _unary_partials([](T u, T) { return -std::sin(u); }, x, y, g, m); break;
+        case UnaryOperator::TANH:
+            _map_tiles([](auto, auto v) { return decltype(v)::broadcast(T(1)) - v * v; }, x, y, g, m);
+            break;
+        case UnaryOperator::ACOSH:
+            _unary_partials([](T u, T) { return T(1) / std::sqrt(u * u - T(1)); }, x, y, g, m);
+            break;
+        case UnaryOperator::ATANH_CLIP:
+            _unary_partials([](T u, T) {
+                T clipped = std::fmod(u + 1, T(2)) - 1;
+                return T(1) / (T(1) - clipped * clipped);
+            }, x, y, g, m);
+            break;
+        case UnaryOperator::GAMMA: _unary_partials([](T u, T v) { return v * _digamma(u); }, x, y, g, m); break;
+        case UnaryOperator::CUSTOM: throw std::invalid_argument("Custom operators have no derivative");
+    }
+}
+
+// Derivatives of `y = op(a, b)` with respect to `a` and `b`, on every row
+template <typename T>
+void _binary_derivative(BinaryOperator op, const T* a, const T* b, const T* y, T* ga, T* gb, int m) {
+    switch (op) {
+        case BinaryOperator::PLUS:
+            std::fill(ga, ga + m, T(1));
+            std::fill(gb, gb + m, T(1));
+            break;
+        case BinaryOperator::SUB:
+            std::fill(ga, ga + m, T(1));
+            std::fill(gb, gb + m, T(-1));
+            break;
+        case BinaryOperator::MULT:
+            std::copy(b, b + m, ga);
+            std::copy(a, a + m, gb);
+            break;
+        case BinaryOperator::DIV:
+            _map_tiles([](auto v, auto) { return decltype(v)::broadcast(T(1)) / v; }, b, y, ga, m);
+            _map_tiles([](auto v, auto w) { return -w / v; }, b, y, gb, m);
+            break;
+        case BinaryOperator::POW:
+            for (int i = 0; i < m; ++i) {
+                ga[i] = b[i] * std::pow(a[i], b[i] - T(1));
+                gb[i] = a[i] > T(0) ? y[i] * std::log(a[i]) : T(0);
+            }
+            break;
+        case BinaryOperator::GREATER:
+        case BinaryOperator::LOGICAL_OR:
+        case BinaryOperator::LOGICAL_AND:
+            // Piecewise constant
+            std::fill(ga, ga + m, T(0));
+            std::fill(gb, gb + m, T(0));
+            break;
+        case BinaryOperator::CUSTOM: throw std::invalid_argument("Custom operators have no derivative");
+    }
+}
+
+// Evaluate rows `[row, row + m)` of the tree together with their derivatives
+// with respect to every constant, propagating dual numbers through each
+// operator. Values are computed by the same kernels as `eval_tile`. The
+// result points into `X` or the workspace: consume it before the next call.
+template <typename T>
+DualOperand<T> eval_dual_tile(const Expression<T>& tree, const ColumnView<T>& X, const OperatorEnum& operators,
+                              std::size_t row, int m, DualWorkspace<T>& workspace) {
+    const std::size_t nconstants = workspace.nconstants;
+    const std::size_t spare = workspace.depth;
+    DualOperand<T>* stack = workspace.stack.data();
+    T* ga = workspace.partials.data();
+    T* gb = ga + EVAL_TILE_SIZE;
+    int top = -1;
+    for (const ExprNode& node : tree.nodes) {
+        switch (node.kind) {
+            case NodeKind::CONSTANT: {
+                ++top;
+                T* value = workspace.value_buffers[top];
+                T* tangent = workspace.tangent(top);
+                std::fill(value, value + m, tree.constants[node.index]);
+                for (std::size_t k = 0; k < nconstants; ++k)
+                    std::fill(tangent + k * EVAL_TILE_SIZE, tangent + k * EVAL_TILE_SIZE + m, T(k == node.index));
+                stack[top] = DualOperand<T>{value, tangent};
+                break;
+            }
+            case NodeKind::FEATURE:
+                ++top;
+                stack[top] = DualOperand<T>{X.column(node.index) + row, nullptr};
+                break;
+            case NodeKind::UNARY: {
+                DualOperand<T>& x = stack[top];
+                T* y = workspace.value_buffers[spare];
+                Operand<T> result{x.value, T(0), false};
+                _eval_unary(operators, node.index, result, y, m);
+                if (x.tangent != nullptr) {
+                    _unary_derivative(operators.unaop_id(node.index), x.value, y, ga, m);
+                    for (std::size_t k = 0; k < nconstants; ++k) {
+                        T* d = x.tangent + k * EVAL_TILE_SIZE;
+                        _multiply_tiles(d, ga, d, m);
+                    }
+                }
+                std::swap(workspace.value_buffers[top], workspace.value_buffers[spare]);
+                x.value = workspace.value_buffers[top];
+                break;
+            }
+            case NodeKind::BINARY: {
+                --top;
+                DualOperand<T>& a = stack[top];
+                const DualOperand<T>& b = stack[top + 1];
+                T* y = workspace.value_buffers[spare];
+                Operand<T> result{a.value, T(0), false};
+                _eval_binary(operators, node.index, result, Operand<T>{b.value, T(0), false}, y, m);
+                if (a.tangent != nullptr || b.tangent != nullptr) {
+                    _binary_derivative(operators.binop_id(node.index), a.value, b.value, y, ga, gb, m);
+                    T* d = workspace.tangent(top);
+                    for (std::size_t k = 0; k < nconstants; ++k) {
+                        T* dk = d + k * EVAL_TILE_SIZE;
+                        const T* da = a.tangent == nullptr ? nullptr : a.tangent + k * EVAL_TILE_SIZE;
+                        const T* db = b.tangent == nullptr ? nullptr : b.tangent + k * EVAL_TILE_SIZE;
+                        if (da != nullptr && db != nullptr) {
+                            _multiply_tiles(ga, da, dk, m);
+                            _multiply_add_tiles(gb, db, dk, m);
+                        } else if (da != nullptr) {
+                            _multiply_tiles(ga, da, dk, m);
+                        } else {
+                            _multiply_tiles(gb, db, dk, m);
+                        }
+                    }
+                    a.tangent = d;
+                }
+                std::swap(workspace.value_buffers[top], workspace.value_buffers[spare]);
+                a.value = workspace.value_buffers[top];
+                break;
+            }
+        }
+    }
+    return stack[0];
+}
+
+// Evaluate the tree on every row of `X` into `out`, and the derivatives of the
+// outputs with respect to every constant into `gradient`, as one column of
+// `X.n` rows per constant. Returns false at the first tile with a NaN or
+// infinite output.
+template <typename T>
+bool eval_grad_tree_array(const Expression<T>& tree, const ColumnView<T>& X, const OperatorEnum& operators,
+                          T* out, T* gradient, DualWorkspace<T>& workspace) {
+    workspace.reserve(tree);
+    const std::size_t nconstants = workspace.nconstants;
+    for (std::size_t row = 0; row < X.n; row += EVAL_TILE_SIZE) {
+        int m = static_cast<int>(std::min<std::size_t>(EVAL_TILE_SIZE, X.n - row));
+        DualOperand<T> result = eval_dual_tile(tree, X, operators, row, m, workspace);
+        std::copy(result.value, result.value + m, out + row);
+        for (std::size_t k = 0; k < nconstants; ++k) {
+            T* column = gradient + k * X.n + row;
+            if (result.tangent == nullptr)
+                std::fill(column, column + m, T(0));
+            else
+                std::copy(result.tangent + k * EVAL_TILE_SIZE, result.tangent + k * EVAL_TILE_SIZE + m, column);
+        }
+        if (!all_finite(out + row, static_cast<std::size_t>(m))) {
+            _record_nonfinite_abort(row, X.n);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Evaluate the tree and its derivatives with respect to the constants on every
+// row of `X`; returns the prediction, the derivatives and whether it is complete
+template <typename T>
+std::tuple<std::vector<T>, std::vector<T>, bool> eval_grad_tree_array(const Expression<T>& tree,
+                                                                      const ColumnView<T>& X,
+                                                                      const OperatorEnum& operators) {
+    thread_local DualWorkspace<T> workspace;
+    std::vector<T> out(X.n);
+    std::vector<T> gradient(X.n * tree.constants.size());
+    bool complete = eval_grad_tree_array(tree, X, operators, out.data(), gradient.data(), workspace);
+    return {std::move(out), std::move(gradient), complete};
+}
+
+// Sum of the (weighted) losses of one tile of outputs, with the weighted
+// derivative of each loss with respect to its output written to `dloss`
+template <typename T, typename LossFunction>
+accumulator_t<T> _loss_and_deriv_tile(const LossFunction& loss, const T* output, const T* y, const T* w, int m,
+                                      T* dloss) {
+    const auto n = static_cast<std::size_t>(m);
+    std::span<T> gradient(dloss, n);
+    return static_cast<accumulator_t<T>>(
+            w == nullptr ? sum_with_derivs(loss, std::span<const T>(output, n), std::span<const T>(y, n), gradient)
+                         : sum_with_derivs(loss, std::span<const T>(output, n), std::span<const T>(y, n),
+                                           std::span<const T>(w, n), gradient));
+}
+
+// Sum of the (weighted) elementwise losses over the rows of `X`, and its
+// gradient with respect to the constants accumulated into `gradient`, in one
+// fused pass. The derivative of the loss comes from its `deriv` method.
+template <typename T, typename LossFunction>
+TiledLoss<T> eval_loss_gradient_tiled(const Expression<T>& tree, const ColumnView<T>& X, const OperatorEnum& operators,
+                                      const T* y, const T* w, LossFunction loss, T* gradient,
+                                      DualWorkspace<T>& workspace) {
+    using A = accumulator_t<T>;
+    thread_local std::vector<T> dloss(EVAL_TILE_SIZE);
+    thread_local std::vector<A> accumulated;
+    workspace.reserve(tree);
+    const std::size_t nconstants = workspace.nconstants;
+    accumulated.assign(nconstants, A(0));
+    A total = A(0);
+    for (std::size_t row = 0; row < X.n; row += EVAL_TILE_SIZE) {
+        int m = static_cast<int>(std::min<std::size_t>(EVAL_TILE_SIZE, X.n - row));
+        DualOperand<T> result = eval_dual_tile(tree, X, operators, row, m, workspace);
+        if (!all_finite(result.value, static_cast<std::size_t>(m))) {
+            _record_nonfinite_abort(row, X.n);
+            return {total, false, row};
+        }
+        total += _loss_and_deriv_tile(loss, result.value, y + row, w == nullptr ? nullptr : w + row, m, dloss.data());
+        if (result.tangent == nullptr)
+            continue;
+        for (std::size_t k = 0; k < nconstants; ++k)
+            accumulated[k] += _tile_dot(dloss.data(), result.tangent + k * EVAL_TILE_SIZE, m);
+    }
+    std::transform(accumulated.begin(), accumulated.end(), gradient, [](A g) { return static_cast<T>(g); });
+    return {total, true, X.n};
+}
+
+// Scratch space for reverse-mode evaluation: the output tile of every node,
+// kept from the forward pass, and the adjoint tile of every node that depends
+// on a constant. Its size grows with the tree but not with its constants.
+template <typename T>
+struct ReverseWorkspace {
+    std::vector<T> values;
+    std::vector<T> adjoints;
+    std::vector<T> partials;        // derivatives of an operator with respect to its two operands
+    std::vector<const T*> outputs;  // rows of the output of each node, in `values` or `X`
+    std::vector<bool> depends;      // whether the subtree of each node contains a constant
+
+    void reserve(const Expression<T>& tree) {
+        const std::size_t n = tree.nodes.size();
+        values.resize(n * EVAL_TILE_SIZE);
+        adjoints.resize(n * EVAL_TILE_SIZE);
+        partials.resize(2 * EVAL_TILE_SIZE);
+        outputs.resize(n);
+        depends.assign(n, false);
+        for (std::size_t i = 0; i < n; ++i) {
+            const ExprNode& node = tree.nodes[i];
+            depends[i] = node.kind == NodeKind::CONSTANT ||
+                         (node.degree >= 1 && depends[i - 1]) ||
+                         (node.degree == 2 && depends[left_child(tree, i)]);
+        }
+    }
+
+    [[nodiscard]] T* value(std::size_t node) {
+        return values.data() + node * EVAL_TILE_SIZE;
+    }
+
+    [[nodiscard]] T* adjoint(std::size_t node) {
+        return adjoints.data() + node * EVAL_TILE_SIZE;
+    }
+};
+
+// Evaluate rows `[row, row + m)` of the tree, keeping the output of every node
+// in the workspace for `reverse_tile`. Returns the output of the root.
+template <typename T>
+const T* forward_tile(const Expression<T>& tree, const ColumnView<T>& X, const OperatorEnum& operators,
+                      std::size_t row, int m, ReverseWorkspace<T>& workspace) {
+    for (std::size_t i = 0; i < tree.nodes.size(); ++i) {
+        const ExprNode& node = tree.nodes[i];
+        T* dst = workspace.value(i);
+        switch (node.kind) {
+            case NodeKind::CONSTANT:
+                std::fill(dst, dst + m, tree.constants[node.index]);
+                workspace.outputs[i] = dst;
+                continue;
+            case NodeKind::FEATURE:
+                workspace.outputs[i] = X.column(node.index) + row;
+                continue;
+            case NodeKind::UNARY: {
+                Operand<T> x{workspace.outputs[i - 1], T(0), false};
+                _eval_unary(operators, node.index, x, dst, m);
+                break;
+            }
+            case NodeKind::BINARY: {
+                Operand<T> a{workspace.outputs[left_child(tree, i)], T(0), false};
+                _eval_binary(operators, node.index, a, Operand<T>{workspace.outputs[i - 1], T(0), false}, dst, m);
+                break;
+            }
+        }
+        workspace.outputs[i] = dst;
+    }
+    return workspace.outputs[tree.root()];
+}
+
+// Propagate `seed`, the derivative of a scalar with respect to every output row
+// of the tile evaluated by `forward_tile`, from the root down to the constants,
+// and add the derivatives of the scalar with respect to each constant into
+// `gradient`. The flat postfix order is the tape: every node has one parent,
+// so its adjoint is set once, after its parent's, by walking the nodes
+// backwards. Subtrees without constants are skipped.
+template <typename T>
+void reverse_tile(const Expression<T>& tree, const OperatorEnum& operators, const T* seed, int m,
+                  accumulator_t<T>* gradient, ReverseWorkspace<T>& workspace) {
+    thread_local std::vector<T> ones(EVAL_TILE_SIZE, T(1));
+    T* ga = workspace.partials.data();
+    T* gb = ga + EVAL_TILE_SIZE;
+    const std::size_t root = tree.root();
+    if (!workspace.depends[root])
+        return;
+    std::copy(seed, seed + m, workspace.adjoint(root));
+    for (std::size_t i = root + 1; i-- > 0;) {
+        if (!workspace.depends[i])
+            continue;
+        const ExprNode& node = tree.nodes[i];
+        const T* adjoint = workspace.adjoint(i);
+        if (node.kind == NodeKind::CONSTANT) {
+            gradient[node.index] += _tile_dot(adjoint, ones.data(), m);
+        } else if (node.degree == 1) {
+            _unary_derivative(operators.unaop_id(node.index), workspace.outputs[i - 1], workspace.outputs[i], ga, m);
+            _multiply_tiles(adjoint, ga, workspace.adjoint(i - 1), m);
+        } else if (node.degree == 2) {
+            std::size_t left = left_child(tree, i);
+            _binary_derivative(operators.binop_id(node.index), workspace.outputs[left], workspace.outputs[i - 1],
+                               workspace.outputs[i], ga, gb, m);
+            if (workspace.depends[left])
+                _multiply_tiles(adjoint, ga, workspace.adjoint(left), m);
+            if (workspace.depends[i - 1])
+                _multiply_tiles(adjoint, gb, workspace.adjoint(i - 1), m);
+        }
+    }
+}
+
+// Reverse-mode counterpart of `eval_loss_gradient_tiled`: one forward and one
+// reverse sweep per tile, whatever the number of constants
+template <typename T, typename LossFunction>
+TiledLoss<T> eval_loss_gradient_tiled(const Expression<T>& tree, const ColumnView<T>& X, const OperatorEnum& operators,
+                                      const T* y, const T* w, LossFunction loss, T* gradient,
+                                      ReverseWorkspace<T>& workspace) {
+    using A = accumulator_t<T>;
+    thread_local std::vector<T> dloss(EVAL_TILE_SIZE);
+    thread_local std::vector<A> accumulated;
+    workspace.reserve(tree);
+    accumulated.assign(tree.constants.size(), A(0));
+    A total = A(0);
+    for (std::size_t row = 0; row < X.n; row += EVAL_TILE_SIZE) {
+        int m = static_cast<int>(std::min<std::size_t>(EVAL_TILE_SIZE, X.n - row));
+        const T* output = forward_tile(tree, X, operators, row, m, workspace);
+        if (!all_finite(output, static_cast<std::size_t>(m))) {
+            _record_nonfinite_abort(row, X.n);
+            return {total, false, row};
+        }
+        total += _loss_and_deriv_tile(loss, output, y + row, w == nullptr ? nullptr : w + row, m, dloss.data());
+        reverse_tile(tree, operators, dloss.data(), m, accumulated.data(), workspace);
+    }
+    std::transform(accumulated.begin(), accumulated.end(), gradient, [](A g) { return static_cast<T>(g); });
+    return {total, true, X.n};
+}
+
+// Forward mode carries one tangent per constant through every operator, while
+// reverse mode costs about one extra sweep whatever the count; below this many
+// constants forward mode is cheaper
+constexpr std::size_t REVERSE_MODE_MIN_CONSTANTS = 3;
+
+// Whether `eval_loss_and_gradient` uses reverse mode for the tree
+template <typename T>
+bool use_reverse_mode(const Expression<T>& tree) {
+    return tree.constants.size() >= REVERSE_MODE_MIN_CONSTANTS;
+}
+
+// Cost of one `eval_loss_and_gradient` call in evaluations of the loss alone,
+// measured on 16k rows over the constant counts each mode is used for
+constexpr double FORWARD_MODE_GRADIENT_COST = 3.0;
+constexpr double REVERSE_MODE_GRADIENT_COST = 2.5;
+
+template <typename T>
+double gradient_cost(const Expression<T>& tree) {
+    return use_reverse_mode(tree) ? REVERSE_MODE_GRADIENT_COST : FORWARD_MODE_GRADIENT_COST;
+}
+
+// Whether `eval_loss_and_gradient` can differentiate the loss of the tree
+template <typename T>
+bool has_constant_gradient(const Expression<T>& tree, const Options& options) {
+    using LossFunction = std::decay_t<decltype(options.elementwise_loss)>;
+    if constexpr (std::is_base_of_v<SupervisedLoss, LossFunction> || std::is_same_v<LossFunction, AnyLoss>)
+        return has_constants(tree) && is_differentiable(tree, options.operators);
+    else
+        return false;
+}
+
+// Evaluate the loss of the tree over the whole dataset and write its gradient
+// with respect to the constants into `gradient`, in forward or reverse mode
+// depending on the number of constants
+template <typename T, typename L, typename... D>
+L eval_loss_and_gradient(const Expression<T>& tree, const Dataset<T, L, D...>& dataset, const Options& options,
+                         std::vector<T>& gradient) {
+    thread_local DualWorkspace<T> forward;
+    thread_local ReverseWorkspace<T> reverse;
+    gradient.resize(tree.constants.size());
+    const T* weights = dataset.weighted ? dataset.weights.value().data() : nullptr;
+    TiledLoss<T> result = use_reverse_mode(tree)
+            ? eval_loss_gradient_tiled(tree, dataset.columns(), options.operators, dataset.y.value().data(), weights,
+                                       options.elementwise_loss, gradient.data(), reverse)
+            : eval_loss_gradient_tiled(tree, dataset.columns(), options.operators, dataset.y.value().data(), weights,
+                                       options.elementwise_loss, gradient.data(), forward);
+    if (!result.complete)
+        return std::numeric_limits<L>::infinity();
+    using A = accumulator_t<T>;
+    A normalization = weights == nullptr ? static_cast<A>(dataset.n) : std::accumulate(weights, weights + dataset.n, A(0));
+    for (T& g : gradient)
+        g = static_cast<T>(g / normalization);
+    return static_cast<L>(result.sum / normalization);
+}
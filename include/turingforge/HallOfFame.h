@@ -18,7 +18,7 @@ struct HallOfFame {
         int actualMaxsize = options.maxsize + MAX_DEGREE;
         members.reserve(actualMaxsize);
         for (int i = 0; i < actualMaxsize; ++i) {
-            Node<T>* node = new Node<T>(T(1));
+            Expression<T> node = make_constant<T>(T(1));
             PopMember<T, L> popMember(node, L(0), L(INFINITY), options);
             HallOfFameMember hofMember{popMember, false};
             members.push_back(hofMember);
@@ -29,7 +29,7 @@ struct HallOfFame {
         HallOfFame<T, L> copy;
         copy.members.reserve(members.size());
         for (const auto& member : members) {
-            Node<T>* nodeCopy = member.member.tree->copy();
+            Expression<T> nodeCopy = copy_node(member.member.tree);
             PopMember<T, L> popMember(nodeCopy, member.member.loss, member.member.score, member.member.options);
             HallOfFameMember hofMember{popMember, member.exists};
             copy.members.push_back(hofMember);
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "LossFunctions.h"
+#include "Parallel.h"
+
+/*
+ * LossAccumulator
+ *
+ * Sum of a loss over a stream of rows that arrive in chunks of outputs,
+ * targets and optional weights, as when scoring a dataset that is read from
+ * disk or generated piece by piece. Memory is constant in the chunk sizes and
+ * logarithmic in the number of rows: the accumulator keeps one run of
+ * PAIRWISE_BASE_SIZE rows, sums each full run with the batched `sum`, and
+ * combines the run sums pairwise as a binary counter. The result therefore
+ * depends only on the rows and their order, not on how they were chunked,
+ * and its rounding error grows with the logarithm of the number of rows.
+ *
+ * Rows added without weights have weight one, so `mean` is the plain mean of
+ * an unweighted stream and the normalized weighted sum otherwise, as with the
+ * `normalize` option of `sum`.
+ */
+template <typename  L, typename T = double>
+class LossAccumulator {
+public:
+    explicit LossAccumulator(L loss = L()) : loss(std::move(loss)) {}
+
+    // Add the losses of one chunk of rows
+    void add(std::span<const T> outputs, std::span<const T> targets) {
+        if (outputs.size() != targets.size()) {
+            throw std::invalid_argument("Outputs and targets must have the same size");
+        }
+        _add(outputs, targets, std::span<const T>());
+    }
+
+    // Add the losses of one chunk of rows, each multiplied by its weight
+    void add(std::span<const T> outputs, std::span<const T> targets, std::span<const T> weights) {
+        if (outputs.size() != targets.size() || outputs.size() != weights.size()) {
+            throw std::invalid_argument("Outputs, targets, and weights must have the same size");
+        }
+        _add(outputs, targets, weights);
+    }
+
+    // Number of rows added so far
+    [[nodiscard]] std::size_t count() const {
+        return rows;
+    }
+
+    // Sum of the weights of the rows added so far
+    [[nodiscard]] double weight() const {
+        return _total().weight;
+    }
+
+    // Sum of the (weighted) losses of the rows added so far
+    [[nodiscard]] double sum() const {
+        return _total().value;
+    }
+
+    // Sum of the (weighted) losses divided by the sum of the weights
+    [[nodiscard]] double mean() const {
+        LossSum total = _total();
+        if (total.weight == 0) {
+            throw std::invalid_argument(rows == 0 ? "No rows were added" : "Weights must not be all zero");
+        }
+        return total.value / total.weight;
+    }
+
+    // Forget every row added so far
+    void reset() {
+        rows = 0;
+        pending = 0;
+        runs = 0;
+        levels.clear();
+    }
+
+private:
+    void _add(std::span<const T> outputs, std::span<const T> targets, std::span<const T> weights) {
+        rows += outputs.size();
+        while (!outputs.empty()) {
+            std::size_t m = std::min(outputs.size(), PAIRWISE_BASE_SIZE - pending);
+            std::copy_n(outputs.begin(), m, run_outputs.begin() + pending);
+            std::copy_n(targets.begin(), m, run_targets.begin() + pending);
+            if (weights.empty()) {
+                std::fill_n(run_weights.begin() + pending, m, T(1));
+            } else {
+                std::copy_n(weights.begin(), m, run_weights.begin() + pending);
+                weights = weights.subspan(m);
+            }
+            outputs = outputs.subspan(m);
+            targets = targets.subspan(m);
+            pending += m;
+            if (pending == PAIRWISE_BASE_SIZE) {
+                _push(_run_sum());
+                pending = 0;
+            }
+        }
+    }
+
+    // Loss and weight sums of the buffered rows
+    [[nodiscard]] LossSum _run_sum() const {
+        std::span<const T> weights(run_weights.data(), pending);
+        double w = 0;
+        for (T weight : weights) {
+            w += weight;
+        }
+        return {::sum(loss, std::span<const T>(run_outputs.data(), pending),
+                      std::span<const T>(run_targets.data(), pending), weights, false), w};
+    }
+
+    // Add one full run; `levels[k]` holds the sum of 2^k runs when bit k of `runs` is set
+    void _push(LossSum s) {
+        std::size_t k = 0;
+        for (; runs & (std::size_t(1) << k); ++k) {
+            LossSum older = levels[k];
+            older += s;
+            s = older;
+        }
+        if (k == levels.size()) {
+            levels.emplace_back();
+        }
+        levels[k] = s;
+        ++runs;
+    }
+
+    [[nodiscard]] LossSum _total() const {
+        LossSum total = pending == 0 ? LossSum{} : _run_sum();
+        for (std::size_t k = 0; k < levels.size(); ++k) {
+            if (runs & (std::size_t(1) << k)) {
+                LossSum older = levels[k];
+                older += total;
+                total = older;
+            }
+        }
+        return total;
+    }
+
+    L loss;
+    std::size_t rows = 0;
+    std::size_t pending = 0;  // rows in the current run
+    std::size_t runs = 0;     // full runs so far
+    std::array<T, PAIRWISE_BASE_SIZE> run_outputs{};
+    std::array<T, PAIRWISE_BASE_SIZE> run_targets{};
+    std::array<T, PAIRWISE_BASE_SIZE> run_weights{};
+    std::vector<LossSum> levels;
+};
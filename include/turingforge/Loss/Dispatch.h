@@ -0,0 +1,119 @@
+#pragma once
+
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "LossFunctions.h"
+
+// Runtime selected losses
+//
+// The losses are plain structs, so a function templated on the loss type
+// calls them directly. A loss that is only known at runtime, such as the
+// `elementwise_loss` of the options, is held in an `AnyLoss` instead: every
+// batched entry point visits the variant once and then runs the loop of the
+// concrete loss, so the per-element cost is the same as for a static loss.
+
+using LossVariant = std::variant<
+        L2DistLoss, L1DistLoss, LPDistLoss, PeriodicLoss, HuberLoss, L1EpsilonInsLoss, EpsilonInsLoss,
+        L2EpsilonInsLoss, LogitDistLoss, QuantileLoss, LogCoshLoss,
+        ZeroOneLoss, PerceptronLoss, LogitMarginLoss, L1HingeLoss, HingeLoss, L2HingeLoss, SmoothedL1HingeLoss,
+        ModifiedHuberLoss, L2MarginLoss, ExpLoss, SigmoidLoss, DWDMarginLoss,
+        MisclassLoss, PoissonLoss, CrossEntropyLoss,
+        FastMathLoss<LogitDistLoss>, FastMathLoss<LogCoshLoss>, FastMathLoss<LogitMarginLoss>,
+        FastMathLoss<ExpLoss>, FastMathLoss<SigmoidLoss>, FastMathLoss<CrossEntropyLoss>>;
+
+/*
+ * AnyLoss
+ *
+ * One of the supervised losses, chosen at runtime. Defaults to `L2DistLoss`.
+ * The scalar members visit the variant on every call; prefer the batched
+ * `sum` and `mean` overloads, or `visit_loss`, in loops.
+ */
+struct AnyLoss {
+    LossVariant loss;
+
+    AnyLoss() : loss(L2DistLoss()) {}
+
+    template <typename  L> requires std::is_base_of_v<SupervisedLoss, L>
+    AnyLoss(L l) : loss(std::move(l)) {}
+
+    double operator()(double output, double target) const {
+        return std::visit([=](const auto& l) { return _value(l, output, target); }, loss);
+    }
+
+    double deriv(double output, double target) const {
+        return std::visit([=](const auto& l) { return _deriv(l, output, target); }, loss);
+    }
+
+    double deriv2(double output, double target) const {
+        return std::visit([=](const auto& l) { return _deriv2(l, output, target); }, loss);
+    }
+
+    // Whether the variant holds a loss of type `L`
+    template <typename  L>
+    [[nodiscard]] bool holds() const {
+        return std::holds_alternative<L>(loss);
+    }
+};
+
+/*
+ * Call `f` with the loss itself, or with the concrete loss held by an
+ * `AnyLoss`. Batched code calls this once per batch and loops inside `f`.
+ */
+template <typename  L, typename F>
+decltype(auto) visit_loss(L& loss, F&& f) {
+    return f(loss);
+}
+
+template <typename F>
+decltype(auto) visit_loss(AnyLoss& loss, F&& f) {
+    return std::visit(std::forward<F>(f), loss.loss);
+}
+
+template <typename F>
+decltype(auto) visit_loss(const AnyLoss& loss, F&& f) {
+    return std::visit(std::forward<F>(f), loss.loss);
+}
+
+/*
+ * Return sum of `loss` values over the spans `outputs` and `targets`.
+ */
+template <typename T>
+double sum(const AnyLoss& loss, std::span<const T> outputs, std::span<const T> targets) {
+    return visit_loss(loss, [&](const auto& l) { return sum(l, outputs, targets); });
+}
+
+/*
+ * Return sum of `loss` values over the spans `outputs` and `targets`.
+ * The `weights` determine the importance of each observation. The option
+ * `normalize` divides the result by the sum of the weights.
+ */
+template <typename T>
+double sum(const AnyLoss& loss, std::span<const T> outputs, std::span<const T> targets, std::span<const T> weights,
+           bool normalize = true) {
+    return visit_loss(loss, [&](const auto& l) { return sum(l, outputs, targets, weights, normalize); });
+}
+
+/*
+ * Return sum of `loss` values over the spans `outputs` and `targets`, writing
+ * the first and second derivatives of every loss as a side effect.
+ */
+template <typename T>
+double sum_with_derivs(const AnyLoss& loss, std::span<const T> outputs, std::span<const T> targets,
+                       std::span<T> gradient, std::span<T> hessian = {}) {
+    return visit_loss(loss, [&](const auto& l) { return sum_with_derivs(l, outputs, targets, gradient, hessian); });
+}
+
+/*
+ * Weighted counterpart of the above; the sum of the weights is left to the
+ * caller.
+ */
+template <typename T>
+double sum_with_derivs(const AnyLoss& loss, std::span<const T> outputs, std::span<const T> targets,
+                       std::span<const T> weights, std::span<T> gradient, std::span<T> hessian = {}) {
+    return visit_loss(loss, [&](const auto& l) {
+        return sum_with_derivs(l, outputs, targets, weights, gradient, hessian);
+    });
+}
@@ -19,6 +19,7 @@
  */
 
 struct LPDistLoss : DistanceLoss {
+    using DistanceLoss::operator();
     double p;
 
     explicit LPDistLoss(double p) : p(p) {}
@@ -27,7 +28,7 @@ struct LPDistLoss : DistanceLoss {
         return std::pow(std::abs(difference), p);
     }
 
-    [[nodiscard]] double deriv(double difference) const {
+    [[nodiscard]] double deriv(double difference) const override {
         if (difference == 0) {
             return double(0);
         } else {
@@ -35,7 +36,7 @@ struct LPDistLoss : DistanceLoss {
         }
     }
 
-    [[nodiscard]] double deriv2(double difference) const {
+    [[nodiscard]] double deriv2(double difference) const override {
         if (difference == 0) {
             return double(0);
         } else {
@@ -101,17 +102,18 @@ struct LPDistLoss : DistanceLoss {
  */
 
 struct L1DistLoss : LPDistLoss {
+    using LPDistLoss::operator();
     explicit L1DistLoss(double p = 1) : LPDistLoss(p) {}
 
     constexpr double operator()(double difference) const override {
         return std::abs(difference);
     }
 
-    constexpr double deriv(double difference) override {
+    constexpr double deriv(double difference) const override {
         return std::signbit(difference) ? -1 : 1;
     }
 
-    constexpr double deriv2(double) override {
+    constexpr double deriv2(double) const override {
         return double(0);
     }
 
@@ -161,16 +163,17 @@ struct L1DistLoss : LPDistLoss {
  */
 
 struct L2DistLoss : LPDistLoss {
+    using LPDistLoss::operator();
     explicit L2DistLoss(double p = 2) : LPDistLoss(p) {}
     constexpr double operator()(double difference) const override {
         return std::abs(difference) * std::abs(difference);
     }
 
-    constexpr double deriv(double difference) override {
+    constexpr double deriv(double difference) const override {
         return 2.0 * difference;
     }
 
-    constexpr double deriv2(double) override {
+    constexpr double deriv2(double) const override {
         return 2.0;
     }
 
@@ -218,6 +221,7 @@ struct L2DistLoss : LPDistLoss {
  */
 
 struct PeriodicLoss : DistanceLoss {
+    using DistanceLoss::operator();
     double k;  // k = 2π / circumference
 
     explicit PeriodicLoss(double circ) {
@@ -231,11 +235,11 @@ struct PeriodicLoss : DistanceLoss {
         return 1 - std::cos(difference * k);
     }
 
-    [[nodiscard]] double deriv(double difference) const {
+    [[nodiscard]] double deriv(double difference) const override {
         return k * std::sin(difference * k);
     }
 
-    [[nodiscard]] double deriv2(double difference) const {
+    [[nodiscard]] double deriv2(double difference) const override {
         return std::pow(k, 2) * std::cos(difference * k);
     }
 
@@ -286,6 +290,7 @@ struct PeriodicLoss : DistanceLoss {
  */
 
 struct HuberLoss : DistanceLoss {
+    using DistanceLoss::operator();
     double d;  // boundary between quadratic and linear loss
 
     explicit HuberLoss(double d) {
@@ -304,7 +309,7 @@ struct HuberLoss : DistanceLoss {
         }
     }
 
-    [[nodiscard]] auto deriv(double difference) const {
+    [[nodiscard]] double deriv(double difference) const override {
         if (std::abs(difference) <= d) {
             return difference;  // quadratic
         } else {
@@ -312,7 +317,7 @@ struct HuberLoss : DistanceLoss {
         }
     }
 
-    [[nodiscard]] auto deriv2(double difference) const {
+    [[nodiscard]] double deriv2(double difference) const override {
         return std::abs(difference) <= d ? double(1) : double(0);
     }
 
@@ -367,6 +372,7 @@ struct HuberLoss : DistanceLoss {
  */
 
 struct L1EpsilonInsLoss : DistanceLoss {
+    using DistanceLoss::operator();
     double eps;
 
     explicit L1EpsilonInsLoss(double eps) {
@@ -380,11 +386,11 @@ struct L1EpsilonInsLoss : DistanceLoss {
         return std::max(double(0), std::abs(difference) - eps);
     }
 
-    [[nodiscard]] double deriv(double difference) const {
+    [[nodiscard]] double deriv(double difference) const override {
         return std::abs(difference) <= eps ? double(0) : static_cast<double>(std::signbit(difference) ? -1 : 1);
     }
 
-    constexpr double deriv2(double) override {
+    constexpr double deriv2(double) const override {
         return double(0);
     }
 
@@ -443,6 +449,7 @@ struct EpsilonInsLoss : L1EpsilonInsLoss {
  */
 
 struct L2EpsilonInsLoss : DistanceLoss {
+    using DistanceLoss::operator();
     double eps;
 
     explicit L2EpsilonInsLoss(double eps) {
@@ -456,12 +463,12 @@ struct L2EpsilonInsLoss : DistanceLoss {
         return std::abs(std::pow(std::max(double(0), std::abs(difference) - eps), 2));
     }
 
-    [[nodiscard]] double deriv(double difference) const {
+    [[nodiscard]] double deriv(double difference) const override {
         auto abs_diff = std::abs(difference);
         return abs_diff <= eps ? double(0) : double(2) * std::copysign(abs_diff - eps, difference);
     }
 
-    [[nodiscard]] double deriv2(double difference) const {
+    [[nodiscard]] double deriv2(double difference) const override {
         return std::abs(difference) <= eps ? double(0) : double(2);
     }
 
@@ -514,16 +521,17 @@ struct L2EpsilonInsLoss : DistanceLoss {
  */
 
 struct LogitDistLoss : DistanceLoss {
+    using DistanceLoss::operator();
     double operator()(double difference) const override {
         auto er = std::exp(difference);
         return -std::log(double(4)) - difference + 2 * std::log(double(1) + er);
     }
 
-    constexpr double deriv(double difference) override {
+    constexpr double deriv(double difference) const override {
         return std::tanh(difference / double(2));
     }
 
-    constexpr double deriv2(double difference) override {
+    constexpr double deriv2(double difference) const override {
         auto er = std::exp(difference);
         return double(2) * er / std::abs(std::pow(double(1) + er, 2));
     }
@@ -583,15 +591,16 @@ struct QuantileLoss : DistanceLoss {
 
     explicit QuantileLoss(double tau) : tau(tau) {}
 
-    constexpr double operator()(double diff) {
+    using DistanceLoss::operator();
+    constexpr double operator()(double diff) const override {
         return diff * (diff > 0 ? 1 - tau : -tau);
     }
 
-    [[nodiscard]] double deriv(double diff) const {
+    [[nodiscard]] double deriv(double diff) const override {
         return (diff > 0 ? 1 - tau : -tau);
     }
 
-    constexpr double deriv2(double) override {
+    constexpr double deriv2(double) const override {
         return 0.0;
     }
 
@@ -648,15 +657,16 @@ struct QuantileLoss : DistanceLoss {
  */
 
 struct LogCoshLoss : DistanceLoss {
+    using DistanceLoss::operator();
     constexpr double operator()(double diff) const override {
         return log_cosh(diff);
     }
 
-    constexpr double deriv(double diff) override {
+    constexpr double deriv(double diff) const override {
         return std::tanh(diff);
     }
 
-    constexpr double deriv2(double diff) override {
+    constexpr double deriv2(double diff) const override {
         double sech_diff = 1.0 / std::cosh(diff);
         return sech_diff * sech_diff;
     }
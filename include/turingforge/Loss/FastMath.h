@@ -0,0 +1,398 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "Traits.h"
+#include "Margin.h"
+#include "Distance.h"
+#include "Other.h"
+
+// Fast math
+//
+// Branch-free approximations of exp, expm1, log, log1p and tanh. They use only
+// arithmetic, comparisons that compile to blends, and integer operations on
+// the bit patterns, so the LOSS_LANES loops of the batched losses vectorize
+// with them, which they do not with calls into the C library. Maximum errors
+// against the C library, measured by test/Loss/fast_math.cpp:
+//
+//   fast_exp    1 ULP   results below DBL_MIN are flushed to zero
+//   fast_expm1  2 ULP
+//   fast_log    1 ULP   for every positive input, subnormals included
+//   fast_log1p  1 ULP
+//   fast_tanh   4 ULP
+//
+// Special values follow the C library: NaN in, NaN out; exp overflows to inf,
+// log(0) is -inf and log of a negative number is NaN.
+//
+// The approximations are opt-in through the `FastMathLoss` meta-loss below.
+
+// The approximations only vectorize once inlined into the loss loops
+#if defined(__GNUC__)
+#define TF_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define TF_ALWAYS_INLINE __forceinline
+#else
+#define TF_ALWAYS_INLINE inline
+#endif
+
+constexpr double FAST_MATH_ROUND = 0x1.8p52;  // x + FAST_MATH_ROUND rounds x to an integer, for |x| < 2^51
+constexpr double FAST_MATH_LOG2E = 1.4426950408889634;
+constexpr double FAST_MATH_LN2_HI = 6.93147180369123816490e-01;  // ln(2) with the low 21 bits clear
+constexpr double FAST_MATH_LN2_LO = 1.90821492927058770002e-10;  // ln(2) - FAST_MATH_LN2_HI
+constexpr double FAST_MATH_EXP_MAX = 709.782712893384;  // log(DBL_MAX)
+constexpr double FAST_MATH_EXP_MIN = -708.3964185322641;  // log(DBL_MIN)
+
+// e^x as 2^k * (1 + q), with q = e^r - 1 and |r| <= ln(2)/2
+struct _ExpParts {
+    double q;
+    std::int64_t k;
+};
+
+TF_ALWAYS_INLINE _ExpParts _exp_parts(double x) {
+    double shifted = x * FAST_MATH_LOG2E + FAST_MATH_ROUND;
+    double n = shifted - FAST_MATH_ROUND;
+    double r = (x - n * FAST_MATH_LN2_HI) - n * FAST_MATH_LN2_LO;
+    // Taylor series of e^r - 1 to degree 14, as r + r^2 p(r) so the leading
+    // term is exact; the remainder is below 2^-60 * r
+    double p = 1.0 / 87178291200;
+    p = p * r + 1.0 / 6227020800;
+    p = p * r + 1.0 / 479001600;
+    p = p * r + 1.0 / 39916800;
+    p = p * r + 1.0 / 3628800;
+    p = p * r + 1.0 / 362880;
+    p = p * r + 1.0 / 40320;
+    p = p * r + 1.0 / 5040;
+    p = p * r + 1.0 / 720;
+    p = p * r + 1.0 / 120;
+    p = p * r + 1.0 / 24;
+    p = p * r + 1.0 / 6;
+    p = p * r + 0.5;
+    // The low bits of `shifted` hold n as an integer
+    std::int64_t k = std::bit_cast<std::int64_t>(shifted) - std::bit_cast<std::int64_t>(FAST_MATH_ROUND);
+    return {r + r * r * p, k};
+}
+
+// 2^k for k in [-1022, 1023]
+TF_ALWAYS_INLINE double _exp2i(std::int64_t k) {
+    return std::bit_cast<double>(static_cast<std::uint64_t>(k + 1023) << 52);
+}
+
+TF_ALWAYS_INLINE double _fast_exp(double x) {
+    // NaN passes the clamp
+    double c = x > FAST_MATH_EXP_MAX ? FAST_MATH_EXP_MAX : (x < FAST_MATH_EXP_MIN ? FAST_MATH_EXP_MIN : x);
+    _ExpParts e = _exp_parts(c);
+    // 2^1024 overflows on its own, so the top of the range scales in two steps
+    std::int64_t top = e.k > 1023;
+    double y = (1 + e.q) * _exp2i(e.k - top) * (top ? 2.0 : 1.0);
+    y = x > FAST_MATH_EXP_MAX ? std::numeric_limits<double>::infinity() : y;
+    return x < FAST_MATH_EXP_MIN ? 0.0 : y;
+}
+
+TF_ALWAYS_INLINE double _fast_expm1(double x) {
+    // Below -40, e^x - 1 rounds to -1
+    double c = x > FAST_MATH_EXP_MAX ? FAST_MATH_EXP_MAX : (x < -40 ? -40 : x);
+    _ExpParts e = _exp_parts(c);
+    std::int64_t top = e.k > 1023;
+    double scale = _exp2i(e.k - top);
+    // 2^k * q + (2^k - 1) keeps the accuracy of q around zero, where k is 0
+    double y = top ? scale * (1 + e.q) * 2.0 - 1 : scale * e.q + (scale - 1);
+    return x > FAST_MATH_EXP_MAX ? std::numeric_limits<double>::infinity() : y;
+}
+
+TF_ALWAYS_INLINE double _fast_log(double x) {
+    // fdlibm's log: x = 2^k * m with m in [sqrt(2)/2, sqrt(2)), and
+    // log(m) = 2 atanh(s), s = (m - 1) / (m + 1), by a minimax polynomial in s^2
+    constexpr double LG1 = 6.666666666666735130e-01;
+    constexpr double LG2 = 3.999999999940941908e-01;
+    constexpr double LG3 = 2.857142874366239149e-01;
+    constexpr double LG4 = 2.222219843214978396e-01;
+    constexpr double LG5 = 1.818357216161805012e-01;
+    constexpr double LG6 = 1.531383769920937332e-01;
+    constexpr double LG7 = 1.479819860511658591e-01;
+
+    // Subnormals are scaled into the normal range first
+    bool subnormal = x < std::numeric_limits<double>::min();
+    std::uint64_t bits = std::bit_cast<std::uint64_t>(subnormal ? x * 0x1p54 : x);
+    // The exponent field as a double, through the mantissa of 2^52
+    double k = std::bit_cast<double>((bits >> 52) | 0x4330000000000000) - 0x1p52 - (subnormal ? 1077 : 1023);
+    double m = std::bit_cast<double>((bits & 0x000fffffffffffff) | 0x3ff0000000000000);
+    bool high = m > 1.4142135623730951;
+    m = high ? 0.5 * m : m;
+    k = high ? k + 1 : k;
+
+    double f = m - 1;
+    double hfsq = 0.5 * f * f;
+    double s = f / (2 + f);
+    double z = s * s;
+    double w = z * z;
+    double r = z * (LG1 + w * (LG3 + w * (LG5 + w * LG7))) + w * (LG2 + w * (LG4 + w * LG6));
+    double y = k * FAST_MATH_LN2_HI - ((hfsq - (s * (hfsq + r) + k * FAST_MATH_LN2_LO)) - f);
+
+    y = x == std::numeric_limits<double>::infinity() ? x : y;
+    y = x == 0 ? -std::numeric_limits<double>::infinity() : y;
+    // Negative numbers and NaN
+    return x >= 0 ? y : std::numeric_limits<double>::quiet_NaN();
+}
+
+TF_ALWAYS_INLINE double _fast_log1p(double x) {
+    double u = 1 + x;
+    // log(u) misses the rounding error of 1 + x; add it back to first order
+    double y = _fast_log(u);
+    // The correction is NaN, and dropped, only where u is 0 or infinite
+    double correction = (x - (u - 1)) / u;
+    return correction == correction ? y + correction : y;
+}
+
+TF_ALWAYS_INLINE double _fast_tanh(double x) {
+    // tanh(|x|) rounds to 1 from 19.1 on
+    double a = std::abs(x);
+    a = a > 20 ? 20 : a;
+    double e = _fast_expm1(2 * a);
+    return std::copysign(e / (e + 2), x);
+}
+
+// The approximations for use outside the losses
+inline double fast_exp(double x) {
+    return _fast_exp(x);
+}
+
+inline double fast_expm1(double x) {
+    return _fast_expm1(x);
+}
+
+inline double fast_log(double x) {
+    return _fast_log(x);
+}
+
+inline double fast_log1p(double x) {
+    return _fast_log1p(x);
+}
+
+inline double fast_tanh(double x) {
+    return _fast_tanh(x);
+}
+
+/*
+ * FastMathLoss
+ *
+ * The loss `L` computed with the fast math approximations above where it
+ * needs exp, log or tanh: LogitDistLoss, LogCoshLoss, LogitMarginLoss,
+ * ExpLoss, SigmoidLoss and CrossEntropyLoss. Any other loss is computed
+ * exactly as `L`. The values differ from those of `L` by a few ULP of the
+ * terms they are made of.
+ *
+ * Unlike `CrossEntropyLoss`, the fast cross-entropy does not throw for an
+ * output or target outside [0, 1]; it returns NaN there, which scoring
+ * treats like any other non-finite loss.
+ */
+template <typename  L>
+struct FastMathLoss : SupervisedLoss {
+    L loss;
+
+    FastMathLoss(L loss = L()) : loss(loss) {}
+
+    double operator()(double output, double target) const;
+
+    double deriv(double output, double target) const override;
+
+    double deriv2(double output, double target) const override;
+
+    // Functions for checking properties
+    constexpr bool isminimizable() override {
+        return loss.isminimizable();
+    }
+
+    constexpr bool isdifferentiable() override {
+        return loss.isdifferentiable();
+    }
+
+    constexpr bool istwicedifferentiable() override {
+        return loss.istwicedifferentiable();
+    }
+
+    constexpr bool isconvex() override {
+        return loss.isconvex();
+    }
+
+    constexpr bool isstrictlyconvex() override {
+        return loss.isstrictlyconvex();
+    }
+
+    constexpr bool isstronglyconvex() override {
+        return loss.isstronglyconvex();
+    }
+
+    constexpr bool isnemitski() override {
+        return loss.isnemitski();
+    }
+
+    constexpr bool isunivfishercons() override {
+        return loss.isunivfishercons();
+    }
+
+    constexpr bool isfishercons() override {
+        return loss.isfishercons();
+    }
+
+    constexpr bool islipschitzcont() override {
+        return loss.islipschitzcont();
+    }
+
+    constexpr bool islocallylipschitzcont() override {
+        return loss.islocallylipschitzcont();
+    }
+
+    constexpr bool isclipable() override {
+        return loss.isclipable();
+    }
+
+    constexpr bool ismarginbased() override {
+        return loss.ismarginbased();
+    }
+
+    constexpr bool isclasscalibrated() override {
+        return loss.isclasscalibrated();
+    }
+
+    constexpr bool isdistancebased() override {
+        return loss.isdistancebased();
+    }
+
+    constexpr bool issymmetric() override {
+        return loss.issymmetric();
+    }
+};
+
+// e / (1 + e)^2, the second derivative of the logistic losses at log(e). It
+// is the same for 1 / e, so callers pass e = exp(-|x|), which cannot overflow.
+TF_ALWAYS_INLINE double _logistic_curvature(double e) {
+    double d = 1 + e;
+    return e / (d * d);
+}
+
+/*
+ * Values and derivatives with the approximations. The generic overloads
+ * compute `loss` exactly.
+ */
+template <typename  L>
+TF_ALWAYS_INLINE double _fast_value(const L& loss, double output, double target) {
+    return _value(loss, output, target);
+}
+
+template <typename  L>
+TF_ALWAYS_INLINE double _fast_deriv(const L& loss, double output, double target) {
+    return _deriv(loss, output, target);
+}
+
+template <typename  L>
+TF_ALWAYS_INLINE double _fast_deriv2(const L& loss, double output, double target) {
+    return _deriv2(loss, output, target);
+}
+
+TF_ALWAYS_INLINE double _fast_value(const LogitDistLoss&, double output, double target) {
+    double difference = output - target;
+    return -1.3862943611198906 - difference + 2 * _fast_log1p(_fast_exp(difference));  // -log(4)
+}
+
+TF_ALWAYS_INLINE double _fast_deriv(const LogitDistLoss&, double output, double target) {
+    return _fast_tanh((output - target) / 2);
+}
+
+TF_ALWAYS_INLINE double _fast_deriv2(const LogitDistLoss&, double output, double target) {
+    return 2 * _logistic_curvature(_fast_exp(-std::abs(output - target)));
+}
+
+TF_ALWAYS_INLINE double _fast_value(const LogCoshLoss&, double output, double target) {
+    // log(cosh(x)) = |x| + log1p(exp(-2|x|)) - log(2)
+    double a = std::abs(output - target);
+    return a + _fast_log1p(_fast_exp(-2 * a)) - 0.6931471805599453;
+}
+
+TF_ALWAYS_INLINE double _fast_deriv(const LogCoshLoss&, double output, double target) {
+    return _fast_tanh(output - target);
+}
+
+TF_ALWAYS_INLINE double _fast_deriv2(const LogCoshLoss&, double output, double target) {
+    // sech(x)^2 = 4 e / (1 + e)^2 with e = exp(-2|x|), without cancellation
+    return 4 * _logistic_curvature(_fast_exp(-2 * std::abs(output - target)));
+}
+
+TF_ALWAYS_INLINE double _fast_value(const LogitMarginLoss&, double output, double target) {
+    return _fast_log1p(_fast_exp(-output * target));
+}
+
+TF_ALWAYS_INLINE double _fast_deriv(const LogitMarginLoss&, double output, double target) {
+    return -target / (1 + _fast_exp(output * target));
+}
+
+TF_ALWAYS_INLINE double _fast_deriv2(const LogitMarginLoss&, double output, double target) {
+    return target * target * _logistic_curvature(_fast_exp(-std::abs(output * target)));
+}
+
+TF_ALWAYS_INLINE double _fast_value(const ExpLoss&, double output, double target) {
+    return _fast_exp(-output * target);
+}
+
+TF_ALWAYS_INLINE double _fast_deriv(const ExpLoss&, double output, double target) {
+    return -target * _fast_exp(-output * target);
+}
+
+TF_ALWAYS_INLINE double _fast_deriv2(const ExpLoss&, double output, double target) {
+    return target * target * _fast_exp(-output * target);
+}
+
+TF_ALWAYS_INLINE double _fast_value(const SigmoidLoss&, double output, double target) {
+    return 1 - _fast_tanh(output * target);
+}
+
+TF_ALWAYS_INLINE double _fast_deriv(const SigmoidLoss&, double output, double target) {
+    return -target * 4 * _logistic_curvature(_fast_exp(-2 * std::abs(output * target)));
+}
+
+TF_ALWAYS_INLINE double _fast_deriv2(const SigmoidLoss&, double output, double target) {
+    double agreement = output * target;
+    double sech2 = 4 * _logistic_curvature(_fast_exp(-2 * std::abs(agreement)));
+    return target * target * 2 * _fast_tanh(agreement) * sech2;
+}
+
+TF_ALWAYS_INLINE double _fast_value(const CrossEntropyLoss&, double output, double target) {
+    // The terms of a zero weight are dropped, so log(0) gives no 0 * inf
+    double positive = target == 0 ? 0.0 : target * _fast_log(output);
+    double negative = target == 1 ? 0.0 : (1 - target) * _fast_log(1 - output);
+    // Bitwise, as a short-circuit chain keeps the loop from vectorizing
+    bool valid = (output >= 0) & (output <= 1) & (target >= 0) & (target <= 1);
+    return valid ? -(positive + negative) : std::numeric_limits<double>::quiet_NaN();
+}
+
+template <typename  L>
+double FastMathLoss<L>::operator()(double output, double target) const {
+    return _fast_value(loss, output, target);
+}
+
+template <typename  L>
+double FastMathLoss<L>::deriv(double output, double target) const {
+    return _fast_deriv(loss, output, target);
+}
+
+template <typename  L>
+double FastMathLoss<L>::deriv2(double output, double target) const {
+    return _fast_deriv2(loss, output, target);
+}
+
+template <typename  L>
+TF_ALWAYS_INLINE double _value(const FastMathLoss<L>& loss, double output, double target) {
+    return _fast_value(loss.loss, output, target);
+}
+
+template <typename  L>
+TF_ALWAYS_INLINE double _deriv(const FastMathLoss<L>& loss, double output, double target) {
+    return _fast_deriv(loss.loss, output, target);
+}
+
+template <typename  L>
+TF_ALWAYS_INLINE double _deriv2(const FastMathLoss<L>& loss, double output, double target) {
+    return _fast_deriv2(loss.loss, output, target);
+}
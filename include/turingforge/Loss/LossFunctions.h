@@ -1,8 +1,12 @@
 #pragma once
 
-#include <vector>
+#include <cstddef>
 #include <functional>
+#include <span>
+#include <vector>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 #include "Traits.h"
 
@@ -16,58 +20,416 @@
 #include "Weighted.h"
 
 // Aggregated behaviour
+//
+// The losses themselves work on `double`. Outputs, targets and weights may be
+// stored in any floating point type, e.g. `float` for single precision
+// searches; each element is promoted and every sum is accumulated in `double`.
+//
+// The batched overloads on `std::span` do the work for all the others. They
+// call the representing function of the concrete loss type directly instead
+// of through the virtual `operator()(double)`, so the loss inlines into the
+// loop, and keep LOSS_LANES independent partial sums that the compiler can
+// map onto vector registers.
+
+constexpr std::size_t LOSS_LANES = 8;
 
 /*
- * Return sum of `loss` values over the iterables `outputs` and `targets`.
+ * Return the value of `loss` at one `output` and `target`, without virtual
+ * dispatch. The static type of `loss` decides which loss is evaluated.
  */
 template <typename  L>
-double sum(const L& loss, const std::vector<double>& outputs, const std::vector<double>& targets) {
+inline double _value(const L& loss, double output, double target) {
+    if constexpr (std::is_base_of_v<MarginLoss, L>) {
+        return loss.L::operator()(output * target);
+    } else if constexpr (std::is_base_of_v<DistanceLoss, L>) {
+        return loss.L::operator()(output - target);
+    } else {
+        return loss(output, target);
+    }
+}
+
+template <typename  L>
+inline double _value(const ScaledLoss<L>& loss, double output, double target) {
+    return loss.k * _value(loss.loss, output, target);
+}
+
+template <typename  L>
+inline double _value(const WeightedMarginLoss<L>& loss, double output, double target) {
+    // We interpret the W to be the weight of the positive class
+    return (target > 0 ? loss.weight : 1 - loss.weight) * _value(loss.loss, output, target);
+}
+
+/*
+ * Return the first and second derivative of `loss` with respect to `output`,
+ * without virtual dispatch, through the representing function of distance-
+ * and margin-based losses.
+ */
+template <typename  L>
+inline double _deriv(const L& loss, double output, double target) {
+    if constexpr (std::is_base_of_v<MarginLoss, L>) {
+        return target * loss.L::deriv(output * target);
+    } else if constexpr (std::is_base_of_v<DistanceLoss, L>) {
+        return loss.L::deriv(output - target);
+    } else {
+        return loss.L::deriv(output, target);
+    }
+}
+
+template <typename  L>
+inline double _deriv2(const L& loss, double output, double target) {
+    if constexpr (std::is_base_of_v<MarginLoss, L>) {
+        return target * target * loss.L::deriv2(output * target);
+    } else if constexpr (std::is_base_of_v<DistanceLoss, L>) {
+        return loss.L::deriv2(output - target);
+    } else {
+        return loss.L::deriv2(output, target);
+    }
+}
+
+template <typename  L>
+inline double _deriv(const ScaledLoss<L>& loss, double output, double target) {
+    return loss.k * _deriv(loss.loss, output, target);
+}
+
+template <typename  L>
+inline double _deriv2(const ScaledLoss<L>& loss, double output, double target) {
+    return loss.k * _deriv2(loss.loss, output, target);
+}
+
+template <typename  L>
+inline double _deriv(const WeightedMarginLoss<L>& loss, double output, double target) {
+    return (target > 0 ? loss.weight : 1 - loss.weight) * _deriv(loss.loss, output, target);
+}
+
+template <typename  L>
+inline double _deriv2(const WeightedMarginLoss<L>& loss, double output, double target) {
+    return (target > 0 ? loss.weight : 1 - loss.weight) * _deriv2(loss.loss, output, target);
+}
+
+// Compile-time fusion of the meta-losses
+//
+// The batched loops do not evaluate ScaledLoss and WeightedMarginLoss layer by
+// layer. `_fuse` peels every wrapper off at compile time and folds them into a
+// single scale, applied once to the sum (or once per row together with the
+// observation weight), and at most one pair of class weights, picked per row
+// with a select on the sign of the target. A stack such as
+// `ScaledLoss<WeightedMarginLoss<HingeLoss>>` thus runs the same loop as
+// `HingeLoss` plus one multiplication, and the scale of a bare loss is the
+// constant 1 that the compiler removes.
+
+// Class weighting of a loss without WeightedMarginLoss: none
+struct _Unweighted {
+    double operator()(double value, double) const {
+        return value;
+    }
+};
+
+// Weight of the positive and the negative class
+struct _ClassWeights {
+    double positive;
+    double negative;
+
+    double operator()(double value, double target) const {
+        return (target > 0 ? positive : negative) * value;
+    }
+};
+
+// Innermost loss of a stack of meta-losses, with their combined scale and class weights
+template <typename  L, typename ClassWeight = _Unweighted>
+struct _Fused {
+    const L& loss;
+    double scale = 1;
+    ClassWeight class_weight{};
+};
+
+inline _ClassWeights _with_class_weight(_Unweighted, double weight) {
+    return {weight, 1 - weight};
+}
+
+inline _ClassWeights _with_class_weight(_ClassWeights weights, double weight) {
+    return {weights.positive * weight, weights.negative * (1 - weight)};
+}
+
+template <typename  L>
+_Fused<L> _fuse(const L& loss) {
+    return {loss};
+}
+
+template <typename  L>
+auto _fuse(const ScaledLoss<L>& loss) {
+    auto inner = _fuse(loss.loss);
+    inner.scale *= loss.k;
+    return inner;
+}
+
+template <typename  L>
+auto _fuse(const WeightedMarginLoss<L>& loss) {
+    auto inner = _fuse(loss.loss);
+    auto class_weight = _with_class_weight(inner.class_weight, loss.weight);
+    return _Fused<std::remove_cvref_t<decltype(inner.loss)>, decltype(class_weight)>{inner.loss, inner.scale,
+                                                                                       class_weight};
+}
+
+// Value of the innermost loss with the class weights, but not the scale, applied
+template <typename  L, typename ClassWeight>
+inline double _value(const _Fused<L, ClassWeight>& fused, double output, double target) {
+    return fused.class_weight(_value(fused.loss, output, target), target);
+}
+
+template <typename  L, typename ClassWeight>
+inline double _deriv(const _Fused<L, ClassWeight>& fused, double output, double target) {
+    return fused.class_weight(_deriv(fused.loss, output, target), target);
+}
+
+template <typename  L, typename ClassWeight>
+inline double _deriv2(const _Fused<L, ClassWeight>& fused, double output, double target) {
+    return fused.class_weight(_deriv2(fused.loss, output, target), target);
+}
+
+// Innermost loss of `L` once the meta-losses are fused
+template <typename  L>
+using _fused_loss_t = std::remove_cvref_t<decltype(_fuse(std::declval<const L&>()).loss)>;
+
+template <typename  L>
+constexpr bool _class_weighted_v =
+        !std::is_same_v<decltype(_fuse(std::declval<const L&>()).class_weight), _Unweighted>;
+
+// Compile-time counterparts of `isdistancebased` and `ismarginbased`, seeing
+// through ScaledLoss. A class-weighted loss needs the sign of each target, so
+// it is neither: its value is not a function of the residual or agreement alone.
+template <typename  L>
+constexpr bool is_distance_loss_v = std::is_base_of_v<DistanceLoss, _fused_loss_t<L>> && !_class_weighted_v<L>;
+
+template <typename  L>
+constexpr bool is_margin_loss_v = std::is_base_of_v<MarginLoss, _fused_loss_t<L>> && !_class_weighted_v<L>;
+
+/*
+ * Return the derivative of `loss` with respect to `output`.
+ */
+template <typename  L>
+double deriv(const L& loss, double output, double target) {
+    return _deriv(loss, output, target);
+}
+
+/*
+ * Return the second derivative of `loss` with respect to `output`.
+ */
+template <typename  L>
+double deriv2(const L& loss, double output, double target) {
+    return _deriv2(loss, output, target);
+}
+
+/*
+ * Return sum of `loss` values over the spans `outputs` and `targets`.
+ */
+template <typename  L, typename T>
+double sum(const L& loss, std::span<const T> outputs, std::span<const T> targets) {
     if (outputs.size() != targets.size()) {
         throw std::invalid_argument("Outputs and targets must have the same size");
     }
+    const auto fused = _fuse(loss);
+    const std::size_t n = outputs.size();
+    double partial[LOSS_LANES] = {};
+    std::size_t i = 0;
+    for (; i + LOSS_LANES <= n; i += LOSS_LANES) {
+        for (std::size_t j = 0; j < LOSS_LANES; ++j) {
+            partial[j] += _value(fused, outputs[i + j], targets[i + j]);
+        }
+    }
     double s = 0;
-    for (size_t i = 0; i < outputs.size(); ++i) {
-        s += loss(outputs[i], targets[i]);
+    for (; i < n; ++i) {
+        s += _value(fused, outputs[i], targets[i]);
     }
-    return s;
+    for (double p : partial) {
+        s += p;
+    }
+    return fused.scale * s;
 }
 
 /*
- * Return sum of `loss` values over the iterables `outputs` and `targets`.
+ * Return sum of `loss` values over the spans `outputs` and `targets`.
  * The `weights` determine the importance of each observation. The option
  * `normalize` divides the result by the sum of the weights.
  */
-template <typename  L>
-double sum(const L& loss, const std::vector<double>& outputs, const std::vector<double>& targets,
-      const std::vector<double>& weights, bool normalize = true) {
+template <typename  L, typename T>
+double sum(const L& loss, std::span<const T> outputs, std::span<const T> targets, std::span<const T> weights,
+           bool normalize = true) {
     if (outputs.size() != targets.size() || outputs.size() != weights.size()) {
         throw std::invalid_argument("Outputs, targets, and weights must have the same size");
     }
+    const auto fused = _fuse(loss);
+    const std::size_t n = outputs.size();
+    double partial[LOSS_LANES] = {};
+    double partial_weights[LOSS_LANES] = {};
+    std::size_t i = 0;
+    for (; i + LOSS_LANES <= n; i += LOSS_LANES) {
+        for (std::size_t j = 0; j < LOSS_LANES; ++j) {
+            partial[j] += static_cast<double>(weights[i + j]) * _value(fused, outputs[i + j], targets[i + j]);
+            partial_weights[j] += weights[i + j];
+        }
+    }
     double s = 0;
-    double n = 0;
-    for (size_t i = 0; i < outputs.size(); ++i) {
-        s += weights[i] * loss(outputs[i], targets[i]);
-        n += weights[i];
+    double w = 0;
+    for (; i < n; ++i) {
+        s += static_cast<double>(weights[i]) * _value(fused, outputs[i], targets[i]);
+        w += weights[i];
+    }
+    for (std::size_t j = 0; j < LOSS_LANES; ++j) {
+        s += partial[j];
+        w += partial_weights[j];
     }
-    if (normalize && n == 0) {
+    if (normalize && w == 0) {
         throw std::invalid_argument("Weights must not be all zero");
     }
-    return s / (normalize ? n : 1);
+    return fused.scale * s / (normalize ? w : 1);
+}
+
+// Shared loop of the `sum_with_derivs` overloads; `weights` may be null. The
+// derivatives are written to local blocks first, which keeps the loss loop
+// free of stores that might alias the inputs. The scale of the fused loss is
+// folded into the weight of each row.
+template <bool SECOND, typename  L, typename T>
+double _sum_with_derivs(const L& loss, std::span<const T> outputs, std::span<const T> targets, const T* weights,
+                        T* gradient, T* hessian) {
+    const auto fused = _fuse(loss);
+    const double scale = fused.scale;
+    const std::size_t n = outputs.size();
+    double partial[LOSS_LANES] = {};
+    double first[LOSS_LANES];
+    double second[LOSS_LANES];
+    std::size_t i = 0;
+    for (; i + LOSS_LANES <= n; i += LOSS_LANES) {
+        for (std::size_t j = 0; j < LOSS_LANES; ++j) {
+            double o = outputs[i + j];
+            double t = targets[i + j];
+            double w = weights == nullptr ? scale : scale * static_cast<double>(weights[i + j]);
+            partial[j] += w * _value(fused, o, t);
+            first[j] = w * _deriv(fused, o, t);
+            if constexpr (SECOND) {
+                second[j] = w * _deriv2(fused, o, t);
+            }
+        }
+        for (std::size_t j = 0; j < LOSS_LANES; ++j) {
+            gradient[i + j] = static_cast<T>(first[j]);
+            if constexpr (SECOND) {
+                hessian[i + j] = static_cast<T>(second[j]);
+            }
+        }
+    }
+    double s = 0;
+    for (; i < n; ++i) {
+        double w = weights == nullptr ? scale : scale * static_cast<double>(weights[i]);
+        s += w * _value(fused, outputs[i], targets[i]);
+        gradient[i] = static_cast<T>(w * _deriv(fused, outputs[i], targets[i]));
+        if constexpr (SECOND) {
+            hessian[i] = static_cast<T>(w * _deriv2(fused, outputs[i], targets[i]));
+        }
+    }
+    for (double p : partial) {
+        s += p;
+    }
+    return s;
 }
 
 /*
- * Return mean of `loss` values over the iterables `outputs` and `targets`.
+ * Return sum of `loss` values over the spans `outputs` and `targets`, and in
+ * the same pass write the derivative of each loss with respect to its output
+ * to `gradient` and, unless it is empty, the second derivative to `hessian`.
  */
-template <typename  L>
-double mean(const L& loss, const std::vector<double>& outputs, const std::vector<double>& targets) {
-    if (outputs.size() != targets.size()) {
-        throw std::invalid_argument("Outputs and targets must have the same size");
+template <typename  L, typename T>
+double sum_with_derivs(const L& loss, std::span<const T> outputs, std::span<const T> targets, std::span<T> gradient,
+                       std::span<T> hessian = {}) {
+    if (outputs.size() != targets.size() || outputs.size() != gradient.size() ||
+        (!hessian.empty() && outputs.size() != hessian.size())) {
+        throw std::invalid_argument("Outputs, targets, and derivatives must have the same size");
     }
-    double m = 0;
-    for (size_t i = 0; i < outputs.size(); ++i) {
-        m += loss(outputs[i], targets[i]);
+    return hessian.empty()
+           ? _sum_with_derivs<false>(loss, outputs, targets, static_cast<const T*>(nullptr), gradient.data(), static_cast<T*>(nullptr))
+           : _sum_with_derivs<true>(loss, outputs, targets, static_cast<const T*>(nullptr), gradient.data(),
+                                    hessian.data());
+}
+
+/*
+ * Return sum of `loss` values over the spans `outputs` and `targets`, each
+ * multiplied by its weight, and write the weighted first and second
+ * derivatives as above. The sum of the weights is left to the caller.
+ */
+template <typename  L, typename T>
+double sum_with_derivs(const L& loss, std::span<const T> outputs, std::span<const T> targets,
+                       std::span<const T> weights, std::span<T> gradient, std::span<T> hessian = {}) {
+    if (outputs.size() != targets.size() || outputs.size() != weights.size() || outputs.size() != gradient.size() ||
+        (!hessian.empty() && outputs.size() != hessian.size())) {
+        throw std::invalid_argument("Outputs, targets, weights, and derivatives must have the same size");
     }
-    return m / outputs.size();
+    return hessian.empty()
+           ? _sum_with_derivs<false>(loss, outputs, targets, weights.data(), gradient.data(), static_cast<T*>(nullptr))
+           : _sum_with_derivs<true>(loss, outputs, targets, weights.data(), gradient.data(), hessian.data());
+}
+
+/*
+ * Return mean of `loss` values over the spans `outputs` and `targets`.
+ */
+template <typename  L, typename T>
+double mean(const L& loss, std::span<const T> outputs, std::span<const T> targets) {
+    return sum(loss, outputs, targets) / outputs.size();
+}
+
+/*
+ * Return mean of `loss` values over the spans `outputs` and `targets`.
+ * The `weights` determine the importance of each observation. The option
+ * `normalize` divides the result by the sum of the weights.
+ */
+template <typename  L, typename T>
+double mean(const L& loss, std::span<const T> outputs, std::span<const T> targets, std::span<const T> weights,
+            bool normalize = true) {
+    return sum(loss, outputs, targets, weights, normalize);
+}
+
+/*
+ * Return sum of `loss` values over the iterables `outputs` and `targets`.
+ */
+template <typename  L, typename T>
+double sum(const L& loss, const std::vector<T>& outputs, const std::vector<T>& targets) {
+    return sum(loss, std::span<const T>(outputs), std::span<const T>(targets));
+}
+
+/*
+ * Return sum of `loss` values over the iterables `outputs` and `targets`.
+ * The `weights` determine the importance of each observation. The option
+ * `normalize` divides the result by the sum of the weights.
+ */
+template <typename  L, typename T>
+double sum(const L& loss, const std::vector<T>& outputs, const std::vector<T>& targets,
+      const std::vector<T>& weights, bool normalize = true) {
+    return sum(loss, std::span<const T>(outputs), std::span<const T>(targets), std::span<const T>(weights),
+               normalize);
+}
+
+/*
+ * Return sum of `loss` values over the `n` contiguous `outputs` and `targets`.
+ * Used to reduce one evaluation tile at a time.
+ */
+template <typename  L, typename T>
+double sum(const L& loss, const T* outputs, const T* targets, std::size_t n) {
+    return sum(loss, std::span<const T>(outputs, n), std::span<const T>(targets, n));
+}
+
+/*
+ * Return sum of `loss` values over the `n` contiguous `outputs` and `targets`,
+ * each multiplied by its weight. The sum of the weights is left to the caller.
+ */
+template <typename  L, typename T>
+double sum(const L& loss, const T* outputs, const T* targets, const T* weights, std::size_t n) {
+    return sum(loss, std::span<const T>(outputs, n), std::span<const T>(targets, n), std::span<const T>(weights, n),
+               false);
+}
+
+/*
+ * Return mean of `loss` values over the iterables `outputs` and `targets`.
+ */
+template <typename  L, typename T>
+double mean(const L& loss, const std::vector<T>& outputs, const std::vector<T>& targets) {
+    return mean(loss, std::span<const T>(outputs), std::span<const T>(targets));
 }
 
 /*
@@ -75,20 +437,18 @@ double mean(const L& loss, const std::vector<double>& outputs, const std::vector
  * The `weights` determine the importance of each observation. The option
  * `normalize` divides the result by the sum of the weights.
  */
-template <typename  L>
-double mean(const L& loss, const std::vector<double>& outputs, const std::vector<double>& targets,
-       const std::vector<double>& weights, bool normalize = true) {
-    if (outputs.size() != targets.size() || outputs.size() != weights.size()) {
-        throw std::invalid_argument("Outputs, targets, and weights must have the same size");
-    }
-    double m = 0;
-    double n = 0;
-    for (size_t i = 0; i < outputs.size(); ++i) {
-        m += weights[i] * loss(outputs[i], targets[i]);
-        n += weights[i];
-    }
-    if (normalize && n == 0) {
-        throw std::invalid_argument("Weights must not be all zero");
-    }
-    return m / (normalize ? n : 1);
-}
\ No newline at end of file
+template <typename  L, typename T>
+double mean(const L& loss, const std::vector<T>& outputs, const std::vector<T>& targets,
+       const std::vector<T>& weights, bool normalize = true) {
+    return mean(loss, std::span<const T>(outputs), std::span<const T>(targets), std::span<const T>(weights),
+                normalize);
+}
+
+// Opt-in approximations of exp, log and tanh
+#include "FastMath.h"
+
+// Several quantiles in one pass
+#include "MultiQuantile.h"
+
+// Runtime selection
+#include "Dispatch.h"
\ No newline at end of file
@@ -24,19 +24,19 @@ struct ZeroOneLoss : public MarginLoss {
         return (std::signbit(agreement) ? 1 : 0);
     }
 
-    constexpr double deriv(double target, double output) override {
+    constexpr double deriv(double target, double output) const override {
         return double(0);
     }
 
-    constexpr double deriv2(double target, double output) override {
+    constexpr double deriv2(double target, double output) const override {
         return double(0);
     }
 
-    constexpr double deriv(double agreement) override {
+    constexpr double deriv(double agreement) const override {
         return double(0);
     }
 
-    constexpr double deriv2(double agreement) override {
+    constexpr double deriv2(double agreement) const override {
         return double(0);
     }
 
@@ -99,11 +99,11 @@ struct PerceptronLoss : public MarginLoss {
         return std::max(double(0), -agreement);
     }
 
-    constexpr double deriv(double agreement) override {
+    constexpr double deriv(double agreement) const override {
         return (agreement >= double(0)) ? double(0) : -double(1);
     }
 
-    constexpr double deriv2(double agreement) override {
+    constexpr double deriv2(double agreement) const override {
         return double(0);
     }
 
@@ -161,11 +161,11 @@ struct LogitMarginLoss : public MarginLoss {
         return std::log1p(std::exp(-agreement));
     }
 
-    constexpr double deriv(double agreement) override {
+    constexpr double deriv(double agreement) const override {
         return -double(1) / (double(1) + std::exp(agreement));
     }
 
-    constexpr double deriv2(double agreement) override {
+    constexpr double deriv2(double agreement) const override {
         auto exp_t = std::exp(agreement);
         return exp_t / std::abs(std::pow(double(1) + exp_t, double(2)));
     }
@@ -229,11 +229,11 @@ struct L1HingeLoss : public MarginLoss {
         return std::max(double(0), double(1) - agreement);
     }
 
-    constexpr double deriv(double agreement) override {
+    constexpr double deriv(double agreement) const override {
         return agreement >= double(1) ? double(0) : -double(1);
     }
 
-    constexpr double deriv2(double agreement) override {
+    constexpr double deriv2(double agreement) const override {
         return double(0);
     }
 
@@ -299,11 +299,11 @@ struct L2HingeLoss : public MarginLoss {
         return agreement >= double(1) ? double(0) : std::pow(double(1) - agreement, 2);
     }
 
-    constexpr double deriv(double agreement) override {
+    constexpr double deriv(double agreement) const override {
         return agreement >= double(1) ? double(0) : double(2) * (agreement - double(1));
     }
 
-    constexpr double deriv2(double agreement) override {
+    constexpr double deriv2(double agreement) const override {
         return agreement >= double(1) ? double(0) : double(2);
     }
 
@@ -381,7 +381,7 @@ struct SmoothedL1HingeLoss : public MarginLoss {
         }
     }
 
-    [[nodiscard]] constexpr double deriv(double agreement) override {
+    [[nodiscard]] constexpr double deriv(double agreement) const override {
         if (agreement >= 1 - gamma) {
             return agreement >= 1 ? double(0) : (agreement - double(1)) / gamma;
         } else {
@@ -389,7 +389,7 @@ struct SmoothedL1HingeLoss : public MarginLoss {
         }
     }
 
-    [[nodiscard]] constexpr double deriv2(double agreement) override {
+    [[nodiscard]] constexpr double deriv2(double agreement) const override {
         if (agreement < 1 - gamma || agreement > 1) {
             return double(0);
         } else {
@@ -460,7 +460,7 @@ struct ModifiedHuberLoss : public MarginLoss {
         }
     }
 
-    constexpr double deriv(double agreement) override {
+    constexpr double deriv(double agreement) const override {
         if (agreement >= -1) {
             return agreement > 1 ? double(0) : double(2) * agreement - double(2);
         } else {
@@ -468,7 +468,7 @@ struct ModifiedHuberLoss : public MarginLoss {
         }
     }
 
-    constexpr double deriv2(double agreement) override {
+    constexpr double deriv2(double agreement) const override {
         if (agreement < -1 || agreement > 1) {
             return double(0);
         } else {
@@ -535,11 +535,11 @@ struct L2MarginLoss : public MarginLoss {
         return std::pow(double(1) - agreement, 2);
     }
 
-    constexpr double deriv(double agreement) override {
+    constexpr double deriv(double agreement) const override {
         return double(2) * (agreement - double(1));
     }
 
-    constexpr double deriv2(double agreement) override {
+    constexpr double deriv2(double agreement) const override {
         return double(2);
     }
 
@@ -607,11 +607,11 @@ struct ExpLoss : public MarginLoss {
         return std::exp(-agreement);
     }
 
-    constexpr double deriv(double agreement) override {
+    constexpr double deriv(double agreement) const override {
         return -std::exp(-agreement);
     }
 
-    constexpr double deriv2(double agreement) override {
+    constexpr double deriv2(double agreement) const override {
         return std::exp(-agreement);
     }
 
@@ -678,11 +678,11 @@ struct SigmoidLoss : public MarginLoss {
         return double(1) - std::tanh(agreement);
     }
 
-    constexpr double deriv(double agreement) override {
+    constexpr double deriv(double agreement) const override {
         return -abs2(sech(agreement));
     }
 
-    constexpr double deriv2(double agreement) override {
+    constexpr double deriv2(double agreement) const override {
         return double(2) * std::tanh(agreement) * abs2(sech(agreement));
     }
 
@@ -766,7 +766,7 @@ struct DWDMarginLoss : MarginLoss {
         }
     }
 
-    double deriv(double agreement) override {
+    double deriv(double agreement) const override {
         if (agreement <= q / (q + 1)) {
             return -double(1);
         } else {
@@ -774,7 +774,7 @@ struct DWDMarginLoss : MarginLoss {
         }
     }
 
-    double deriv2(double agreement) override {
+    double deriv2(double agreement) const override {
         if (agreement <= q / (q + 1)) {
             return double(0);
         } else {
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "LossFunctions.h"
+
+/*
+ * MultiQuantileLoss
+ *
+ * The pinball losses of QuantileLoss at several quantiles `taus` at once, for
+ * fitting a band of conditional quantiles with one expression family. With
+ * residuals `r = output - target`, the loss at `tau` is
+ *
+ * ```math
+ * \sum_i L_\tau(r_i) = (1 - \tau) \sum_{r_i > 0} r_i - \tau \sum_{r_i \le 0} r_i
+ * ```
+ *
+ * so one pass that sums the positive and the non-positive residuals yields
+ * every quantile's loss, at the cost of a single QuantileLoss however many
+ * quantiles are asked for.
+ */
+struct MultiQuantileLoss {
+    std::vector<double> taus;
+
+    explicit MultiQuantileLoss(std::vector<double> taus) : taus(std::move(taus)) {
+        for (double tau : this->taus) {
+            if (!(tau >= 0 && tau <= 1)) {
+                throw std::invalid_argument("Quantiles must be in [0, 1]");
+            }
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        return taus.size();
+    }
+};
+
+// Sums of the positive and of the non-positive (weighted) residuals
+struct ResidualParts {
+    double above = 0;
+    double below = 0;
+
+    ResidualParts& operator+=(const ResidualParts& other) {
+        above += other.above;
+        below += other.below;
+        return *this;
+    }
+};
+
+/*
+ * Return the pinball loss at each quantile of `loss` from the sums of the
+ * residual parts, in the order of `loss.taus`.
+ */
+inline std::vector<double> quantile_losses(const MultiQuantileLoss& loss, const ResidualParts& parts) {
+    std::vector<double> losses(loss.size());
+    for (std::size_t k = 0; k < loss.size(); ++k) {
+        losses[k] = (1 - loss.taus[k]) * parts.above - loss.taus[k] * parts.below;
+    }
+    return losses;
+}
+
+// Shared loop of the `residual_parts` overloads; `weights` is only read when
+// WEIGHTED. The parts are split with `max` rather than a branch on the sign,
+// which keeps the loop vectorized, and a NaN residual reaches both parts and
+// so every loss.
+template <bool WEIGHTED, typename T>
+ResidualParts _residual_parts(std::span<const T> outputs, std::span<const T> targets, const T* weights) {
+    auto residual = [&](std::size_t i) {
+        double r = static_cast<double>(outputs[i]) - static_cast<double>(targets[i]);
+        if constexpr (WEIGHTED) {
+            r *= static_cast<double>(weights[i]);
+        }
+        return r;
+    };
+    const std::size_t n = outputs.size();
+    double above[LOSS_LANES] = {};
+    double below[LOSS_LANES] = {};
+    std::size_t i = 0;
+    for (; i + LOSS_LANES <= n; i += LOSS_LANES) {
+        for (std::size_t j = 0; j < LOSS_LANES; ++j) {
+            double r = residual(i + j);
+            double positive = std::max(r, 0.0);
+            above[j] += positive;
+            below[j] += r - positive;
+        }
+    }
+    ResidualParts parts;
+    for (; i < n; ++i) {
+        double r = residual(i);
+        double positive = std::max(r, 0.0);
+        parts.above += positive;
+        parts.below += r - positive;
+    }
+    for (std::size_t j = 0; j < LOSS_LANES; ++j) {
+        parts.above += above[j];
+        parts.below += below[j];
+    }
+    return parts;
+}
+
+/*
+ * Return the sums of the positive and of the non-positive residuals
+ * `outputs - targets`.
+ */
+template <typename T>
+ResidualParts residual_parts(std::span<const T> outputs, std::span<const T> targets) {
+    if (outputs.size() != targets.size()) {
+        throw std::invalid_argument("Outputs and targets must have the same size");
+    }
+    return _residual_parts<false>(outputs, targets, static_cast<const T*>(nullptr));
+}
+
+/*
+ * Return the sums of the positive and of the non-positive residuals, each
+ * multiplied by its weight. Weights are non-negative, so they do not move a
+ * residual from one part to the other.
+ */
+template <typename T>
+ResidualParts residual_parts(std::span<const T> outputs, std::span<const T> targets, std::span<const T> weights) {
+    if (outputs.size() != targets.size() || outputs.size() != weights.size()) {
+        throw std::invalid_argument("Outputs, targets, and weights must have the same size");
+    }
+    return _residual_parts<true>(outputs, targets, weights.data());
+}
+
+/*
+ * Return the sum of the pinball losses over the spans `outputs` and `targets`
+ * at each quantile of `loss`, from one pass over the residuals.
+ */
+template <typename T>
+std::vector<double> sum(const MultiQuantileLoss& loss, std::span<const T> outputs, std::span<const T> targets) {
+    return quantile_losses(loss, residual_parts(outputs, targets));
+}
+
+/*
+ * Return the weighted sum of the pinball losses at each quantile of `loss`.
+ * The option `normalize` divides the results by the sum of the weights.
+ */
+template <typename T>
+std::vector<double> sum(const MultiQuantileLoss& loss, std::span<const T> outputs, std::span<const T> targets,
+                        std::span<const T> weights, bool normalize = true) {
+    std::vector<double> losses = quantile_losses(loss, residual_parts(outputs, targets, weights));
+    if (normalize) {
+        double w = 0;
+        for (T weight : weights) {
+            w += weight;
+        }
+        if (w == 0) {
+            throw std::invalid_argument("Weights must not be all zero");
+        }
+        for (double& l : losses) {
+            l /= w;
+        }
+    }
+    return losses;
+}
+
+/*
+ * Return the mean pinball loss over the spans `outputs` and `targets` at each
+ * quantile of `loss`.
+ */
+template <typename T>
+std::vector<double> mean(const MultiQuantileLoss& loss, std::span<const T> outputs, std::span<const T> targets) {
+    std::vector<double> losses = sum(loss, outputs, targets);
+    for (double& l : losses) {
+        l /= static_cast<double>(outputs.size());
+    }
+    return losses;
+}
+
+/*
+ * Return the mean pinball loss over the spans `outputs` and `targets` at each
+ * quantile of `loss`. The `weights` determine the importance of each
+ * observation. The option `normalize` divides the results by the sum of the
+ * weights.
+ */
+template <typename T>
+std::vector<double> mean(const MultiQuantileLoss& loss, std::span<const T> outputs, std::span<const T> targets,
+                         std::span<const T> weights, bool normalize = true) {
+    return sum(loss, outputs, targets, weights, normalize);
+}
@@ -14,11 +14,11 @@
  */
 
 struct MisclassLoss : SupervisedLoss {
-    double operator()(bool agreement) {
+    double operator()(bool agreement) const {
         return !agreement;
     }
 
-    auto operator()(double output, double target) {
+    auto operator()(double output, double target) const {
         return (*this)(target == output);
     }
 
@@ -30,11 +30,11 @@ struct MisclassLoss : SupervisedLoss {
         return double(0);
     }
 
-    constexpr double deriv(double output, double target) override {
+    constexpr double deriv(double output, double target) const override {
         return deriv(target == output);
     }
 
-    constexpr double deriv2(double output, double target) override {
+    constexpr double deriv2(double output, double target) const override {
         return deriv2(target == output);
     }
 
@@ -88,15 +88,15 @@ struct MisclassLoss : SupervisedLoss {
  */
 
 struct PoissonLoss : SupervisedLoss {
-    auto operator()(double output, double target) {
+    auto operator()(double output, double target) const {
         return std::exp(output) - target * output;
     }
 
-    constexpr double deriv(double output, double target) override {
+    constexpr double deriv(double output, double target) const override {
         return std::exp(output) - target;
     }
 
-    constexpr double deriv2(double output, double target) override {
+    constexpr double deriv2(double output, double target) const override {
         return std::exp(output);
     }
 
@@ -138,7 +138,7 @@ struct PoissonLoss : SupervisedLoss {
  */
 
 struct CrossEntropyLoss : SupervisedLoss {
-    auto operator()(double output, double target) {
+    auto operator()(double output, double target) const {
         if (target >= 0 && target <= 1) {
             if (output >= 0 && output <= 1) {
                 if (target == 0) {
@@ -156,11 +156,11 @@ struct CrossEntropyLoss : SupervisedLoss {
         }
     }
 
-    constexpr double deriv(double output, double target) override {
+    constexpr double deriv(double output, double target) const override {
         return (1 - target) / (1 - output) - target / output;
     }
 
-    constexpr double deriv2(double output, double target) override {
+    constexpr double deriv2(double output, double target) const override {
         return (1 - target) / std::pow(1 - output, 2) + target / std::pow(output, 2);
     }
 
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "LossFunctions.h"
+#include "../ThreadPool.h"
+
+// Deterministic parallel reduction
+//
+// The rows are split into blocks of REDUCTION_BLOCK_SIZE, whatever the number
+// of threads. Each block is summed pairwise down to runs of
+// PAIRWISE_BASE_SIZE rows, which go through the batched `sum`, and the block
+// partials are again combined pairwise in block order. The summation tree
+// depends only on the number of rows, so the result is bit-identical with or
+// without a pool and for any pool size, and its rounding error grows with
+// the logarithm of the number of rows rather than linearly.
+
+constexpr std::size_t REDUCTION_BLOCK_SIZE = std::size_t(1) << 15;
+constexpr std::size_t PAIRWISE_BASE_SIZE = 256;
+
+// Sum of losses over some rows, and the sum of their weights
+struct LossSum {
+    double value = 0;
+    double weight = 0;
+
+    LossSum& operator+=(const LossSum& other) {
+        value += other.value;
+        weight += other.weight;
+        return *this;
+    }
+};
+
+/*
+ * Return the sum of `values` added pairwise, halving the range at each level.
+ */
+template <typename T>
+T pairwise_sum(std::span<const T> values) {
+    if (values.empty()) {
+        return T{};
+    }
+    if (values.size() == 1) {
+        return values[0];
+    }
+    std::size_t half = values.size() / 2;
+    T s = pairwise_sum(values.first(half));
+    s += pairwise_sum(values.subspan(half));
+    return s;
+}
+
+/*
+ * Return the pairwise sum of `loss` values over one block of rows. Without
+ * `weights` every row has weight one.
+ */
+template <typename  L, typename T>
+LossSum _pairwise_loss_sum(const L& loss, std::span<const T> outputs, std::span<const T> targets,
+                           std::span<const T> weights) {
+    const std::size_t n = outputs.size();
+    if (n <= PAIRWISE_BASE_SIZE) {
+        if (weights.empty()) {
+            return {sum(loss, outputs, targets), static_cast<double>(n)};
+        }
+        double w = 0;
+        for (T weight : weights) {
+            w += weight;
+        }
+        return {sum(loss, outputs, targets, weights, false), w};
+    }
+    std::size_t half = n / 2;
+    LossSum s = _pairwise_loss_sum(loss, outputs.first(half), targets.first(half),
+                                   weights.empty() ? weights : weights.first(half));
+    s += _pairwise_loss_sum(loss, outputs.subspan(half), targets.subspan(half),
+                            weights.empty() ? weights : weights.subspan(half));
+    return s;
+}
+
+/*
+ * Run `block(i, begin, end)` for every block of REDUCTION_BLOCK_SIZE rows out
+ * of `n`, on `pool` if given, and return the pairwise sum of the results.
+ */
+template <typename R, typename BlockFunction>
+R reduce_blocks(std::size_t n, BlockFunction block, ThreadPool* pool) {
+    const std::size_t nblocks = (n + REDUCTION_BLOCK_SIZE - 1) / REDUCTION_BLOCK_SIZE;
+    std::vector<R> partials(nblocks);
+    auto run = [&](std::size_t i) {
+        std::size_t begin = i * REDUCTION_BLOCK_SIZE;
+        partials[i] = block(i, begin, std::min(n, begin + REDUCTION_BLOCK_SIZE));
+    };
+    if (pool == nullptr) {
+        for (std::size_t i = 0; i < nblocks; ++i) {
+            run(i);
+        }
+    } else {
+        pool->parallel_for(nblocks, run);
+    }
+    return pairwise_sum(std::span<const R>(partials));
+}
+
+// Weighted or unweighted loss sum over all blocks
+template <typename  L, typename T>
+LossSum _parallel_loss_sum(const L& loss, std::span<const T> outputs, std::span<const T> targets,
+                           std::span<const T> weights, ThreadPool* pool) {
+    return reduce_blocks<LossSum>(outputs.size(), [&](std::size_t, std::size_t begin, std::size_t end) {
+        return _pairwise_loss_sum(loss, outputs.subspan(begin, end - begin), targets.subspan(begin, end - begin),
+                                  weights.empty() ? weights : weights.subspan(begin, end - begin));
+    }, pool);
+}
+
+/*
+ * Return sum of `loss` values over the spans `outputs` and `targets` with the
+ * deterministic reduction, on `pool` if given.
+ */
+template <typename  L, typename T>
+double parallel_sum(const L& loss, std::span<const T> outputs, std::span<const T> targets,
+                    ThreadPool* pool = nullptr) {
+    if (outputs.size() != targets.size()) {
+        throw std::invalid_argument("Outputs and targets must have the same size");
+    }
+    return _parallel_loss_sum(loss, outputs, targets, std::span<const T>(), pool).value;
+}
+
+/*
+ * Return sum of `loss` values over the spans `outputs` and `targets`, each
+ * multiplied by its weight, with the deterministic reduction. The option
+ * `normalize` divides the result by the sum of the weights.
+ */
+template <typename  L, typename T>
+double parallel_sum(const L& loss, std::span<const T> outputs, std::span<const T> targets,
+                    std::span<const T> weights, bool normalize = true, ThreadPool* pool = nullptr) {
+    if (outputs.size() != targets.size() || outputs.size() != weights.size()) {
+        throw std::invalid_argument("Outputs, targets, and weights must have the same size");
+    }
+    LossSum s = _parallel_loss_sum(loss, outputs, targets, weights, pool);
+    if (normalize && s.weight == 0) {
+        throw std::invalid_argument("Weights must not be all zero");
+    }
+    return s.value / (normalize ? s.weight : 1);
+}
+
+/*
+ * Return mean of `loss` values over the spans `outputs` and `targets` with
+ * the deterministic reduction, on `pool` if given.
+ */
+template <typename  L, typename T>
+double parallel_mean(const L& loss, std::span<const T> outputs, std::span<const T> targets,
+                     ThreadPool* pool = nullptr) {
+    return parallel_sum(loss, outputs, targets, pool) / outputs.size();
+}
+
+/*
+ * Return the weighted mean of `loss` values with the deterministic reduction.
+ */
+template <typename  L, typename T>
+double parallel_mean(const L& loss, std::span<const T> outputs, std::span<const T> targets,
+                     std::span<const T> weights, ThreadPool* pool = nullptr) {
+    return parallel_sum(loss, outputs, targets, weights, true, pool);
+}
@@ -15,12 +15,12 @@ struct ScaledLoss : SupervisedLoss {
     }
     
     // Functions for differentiability at a point
-    double deriv(double output, double target) override {
-        return k * loss.deriv(output, target);
+    double deriv(double output, double target) const override {
+        return k * static_cast<const SupervisedLoss&>(loss).deriv(output, target);
     }
 
-    double deriv2(double output, double target) override {
-        return k * loss.deriv2(output, target);
+    double deriv2(double output, double target) const override {
+        return k * static_cast<const SupervisedLoss&>(loss).deriv2(output, target);
     }
 
     // Functions for checking properties
@@ -30,21 +30,21 @@ struct Loss {
 
     // Compute the analytical derivative with respect to the `output` for the `loss` function.
     // Note that `target` and `output` can be of different numeric type, in which case promotion is performed in the manner appropriate for the given loss.
-    virtual double deriv(double, double) {
+    virtual double deriv(double, double) const {
         return double(0);
     }
 
-    virtual double deriv(double) {
+    virtual double deriv(double) const {
         return double(0);
     }
 
     // Compute the second derivative with respect to the `output` for the `loss` function.
     // Note that `target` and `output` can be of different numeric type, in which case promotion is performed in the manner appropriate for the given loss.
-    virtual double deriv2(double, double) {
+    virtual double deriv2(double, double) const {
         return double(0);
     }
 
-    virtual double deriv2(double) {
+    virtual double deriv2(double) const {
         return double(0);
     }
 };
@@ -162,17 +162,17 @@ inline SupervisedLoss operator*(double scalar, const SupervisedLoss& loss) {
 // A supervised loss that can be simplified to `L(ŷ, y) = L(ŷ - y)`
 // is considered **distance-based**.
 struct DistanceLoss : public SupervisedLoss {
-    using SupervisedLoss::operator();
+    using SupervisedLoss::operator(), SupervisedLoss::deriv, SupervisedLoss::deriv2;
     constexpr double operator()(double output, double target) const {
         return (*this)(output - target);
     }
 
-    double deriv(double output, double target) override {
-        return SupervisedLoss::deriv(output - target);
+    double deriv(double output, double target) const override {
+        return deriv(output - target);
     }
 
-    double deriv2(double output, double target) override {
-        return SupervisedLoss::deriv2(output - target);
+    double deriv2(double output, double target) const override {
+        return deriv2(output - target);
     }
 
     bool isclipable() override {
@@ -205,12 +205,12 @@ struct MarginLoss : public SupervisedLoss {
         return isconvex() && isdifferentiable(0) && deriv(0) < 0;
     }
 
-    double deriv(double output, double target) override {
+    double deriv(double output, double target) const override {
         return target * deriv(output * target);
     }
 
-    double deriv2(double output, double target) override {
-        return deriv2(output * target);
+    double deriv2(double output, double target) const override {
+        return target * target * deriv2(output * target);
     }
 };
 
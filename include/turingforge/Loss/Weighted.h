@@ -23,21 +23,21 @@ struct WeightedMarginLoss : SupervisedLoss {
             return (1 - weight) * loss(output, target);
     }
 
-    double deriv(double output, double target) override {
+    double deriv(double output, double target) const override {
         // We interpret the W to be the weight of the positive class
         if (target > 0) {
-            return static_cast<double>(weight) * loss.deriv(output, target);
+            return static_cast<double>(weight) * static_cast<const SupervisedLoss&>(loss).deriv(output, target);
         } else {
-            return (1 - static_cast<double>(weight)) * loss.deriv(output, target);
+            return (1 - static_cast<double>(weight)) * static_cast<const SupervisedLoss&>(loss).deriv(output, target);
         }
     }
 
-    double deriv2(double output, double target) override {
+    double deriv2(double output, double target) const override {
         // We interpret the W to be the weight of the positive class
         if (target > 0) {
-            return static_cast<double>(weight) * loss.deriv2(output, target);
+            return static_cast<double>(weight) * static_cast<const SupervisedLoss&>(loss).deriv2(output, target);
         } else {
-            return (1 - static_cast<double>(weight)) * loss.deriv2(output, target);
+            return (1 - static_cast<double>(weight)) * static_cast<const SupervisedLoss&>(loss).deriv2(output, target);
         }
     }
 
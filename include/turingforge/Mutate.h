@@ -1,13 +1,21 @@
 #include <cmath>
 #include <algorithm>
 #include <random>
+#include <tuple>
+
+#include "CheckConstraints.h"
+#include "Expression.h"
+#include "Scoring.h"
+#include "MutationFunctions.h"
+#include "PopulationMember.h"
+#include "Racing.h"
 
 void condition_mutation_weights(MutationWeights &weights, PopMember &member, Options &options, int curmaxsize) {
-    if (member.tree.degree == 0) {
+    if (member.tree.root_node().degree == 0) {
         weights.mutate_operator = 0.0;
         weights.delete_node = 0.0;
         weights.simplify = 0.0;
-        if (!member.tree.constant) {
+        if (member.tree.root_node().kind != NodeKind::CONSTANT) {
             weights.optimize = 0.0;
             weights.mutate_constant = 0.0;
         }
@@ -43,8 +51,12 @@ std::tuple<PopMember<T, L>, bool, double> next_generation(Dataset <T, L> &datase
     double num_evals = 0.0;
     int nfeatures = dataset.nfeatures;
     auto weights = options.mutation_weights;
-    auto [beforeScore, beforeLoss] = options.batching ? std::make_tuple(num_evals += (options.batch_size / dataset.n), score_func_batch(dataset, member, options))
-                                                      : std::make_tuple(member.score, member.loss);
+    // With batching, the parent and the child are scored on the same batch
+    const Batch<T>* batch = options.batching ? &thread_batch_sampler<T>(options.batch_size).next(dataset) : nullptr;
+    auto [beforeScore, beforeLoss] = options.batching ? score_func_batch(dataset, *batch, member, options)
+                                                      : std::make_pair(member.score, member.loss);
+    if (options.batching)
+        num_evals += static_cast<double>(options.batch_size) / dataset.n;
 
     condition_mutation_weights(weights, member, options, curmaxsize);
 
@@ -53,6 +65,7 @@ std::tuple<PopMember<T, L>, bool, double> next_generation(Dataset <T, L> &datase
     bool is_success_always_possible = true;
     int attempts = 0;
     int max_attempts = 10;
+    Expression<T> tree;
 
     while (!successful_mutation && attempts < max_attempts) {
         tree = copy_node(member.tree);
@@ -91,16 +104,15 @@ std::tuple<PopMember<T, L>, bool, double> next_generation(Dataset <T, L> &datase
             tree = combine_operators(tree, options.operators);
             tmp_recorder["type"] = "partial_simplify";
             mutation_accepted = true;
-            return std::make_tuple(
-                    PopMember(
-                            tree,
-                            beforeScore,
-                            beforeLoss,
-                            options,
-                            parent_ref,
-                            options.deterministic),
-                    mutation_accepted,
-                    num_evals);
+            auto simplified = PopMember(
+                    tree,
+                    beforeScore,
+                    beforeLoss,
+                    options,
+                    parent_ref,
+                    options.deterministic);
+            compile_member(simplified, options.operators);
+            return std::make_tuple(simplified, mutation_accepted, num_evals);
             is_success_always_possible = true;
         } else if (mutation_choice == "randomize") {
             tree_size_to_generate = rand(1:curmaxsize);
@@ -163,11 +175,34 @@ std::tuple<PopMember<T, L>, bool, double> next_generation(Dataset <T, L> &datase
                 num_evals);
     }
 
+    L afterScore, afterLoss;
     if (options.batching) {
-        afterScore, afterLoss = score_func_batch(dataset, tree, options);
-        num_evals += (options.batch_size / dataset.n);
+        std::tie(afterScore, afterLoss) = score_func_batch(dataset, *batch, tree, options);
+        num_evals += static_cast<double>(options.batch_size) / dataset.n;
+    } else if (options.racing) {
+        // Children clearly worse than their parent on a prefix of the rows are rejected there
+        RaceResult<L> result = race(dataset, tree, member.tree, options, -1, compute_complexity(member, options));
+        num_evals += result.num_evals;
+        if (!result.competitive) {
+            tmp_recorder["result"] = "reject";
+            tmp_recorder["reason"] = "lost_race";
+            mutation_accepted = false;
+            return std::make_tuple(
+                    PopMember(
+                            copy_node(member.tree),
+                            beforeScore,
+                            beforeLoss,
+                            options,
+                            compute_complexity(member, options),
+                            parent_ref,
+                            options.deterministic),
+                    mutation_accepted,
+                    num_evals);
+        }
+        afterScore = result.score;
+        afterLoss = result.loss;
     } else {
-        afterScore, afterLoss = score_func(dataset, tree, options);
+        std::tie(afterScore, afterLoss) = score_func(dataset, tree, options);
         num_evals += 1;
     }
 
@@ -227,17 +262,16 @@ std::tuple<PopMember<T, L>, bool, double> next_generation(Dataset <T, L> &datase
             tmp_recorder["reason"] = "pass";
         }
         mutation_accepted = true;
-        return (
-                PopMember(
-                        tree,
-                        afterScore,
-                        afterLoss,
-                        options,
-                        newSize,
-                        parent_ref,
-                        options.deterministic),
-                        mutation_accepted,
-                        num_evals);
+        auto baby = PopMember(
+                tree,
+                afterScore,
+                afterLoss,
+                options,
+                newSize,
+                parent_ref,
+                options.deterministic);
+        compile_member(baby, options.operators);
+        return std::make_tuple(baby, mutation_accepted, num_evals);
     }
 }
 
@@ -275,34 +309,32 @@ std::tuple<PopMember<T, L>, PopMember<T, L>, bool, double> crossover_generation(
         std::tie(child_tree1, child_tree2) = crossover_trees(tree1, tree2);
         num_tries += 1;
     }
+    // With batching, both children are scored on the same batch
+    L afterScore1, afterLoss1, afterScore2, afterLoss2;
     if (options.batching) {
-        auto [afterScore1, afterLoss1] = score_func_batch(
-                dataset,
-                child_tree1,
-                options,
-                afterSize1
-        );
-        auto [afterScore2, afterLoss2] = score_func_batch(
-                dataset,
-                child_tree2,
-                options,
-                afterSize2
-        );
-        num_evals += 2 * (options.batch_size / dataset.n);
+        const Batch<T>& batch = thread_batch_sampler<T>(options.batch_size).next(dataset);
+        std::tie(afterScore1, afterLoss1) = score_func_batch(dataset, batch, child_tree1, options, afterSize1);
+        std::tie(afterScore2, afterLoss2) = score_func_batch(dataset, batch, child_tree2, options, afterSize2);
+        num_evals += 2 * static_cast<double>(options.batch_size) / dataset.n;
+    } else if (options.racing) {
+        // Each child races the parent it takes its root from; the crossover
+        // fails if either is clearly worse
+        RaceResult<L> result1 = race(dataset, child_tree1, tree1, options, afterSize1);
+        num_evals += result1.num_evals;
+        if (!result1.competitive)
+            return std::make_tuple(member1, member2, crossover_accepted, num_evals);
+        RaceResult<L> result2 = race(dataset, child_tree2, tree2, options, afterSize2);
+        num_evals += result2.num_evals;
+        if (!result2.competitive)
+            return std::make_tuple(member1, member2, crossover_accepted, num_evals);
+        afterScore1 = result1.score;
+        afterLoss1 = result1.loss;
+        afterScore2 = result2.score;
+        afterLoss2 = result2.loss;
     } else {
-        auto [afterScore1, afterLoss1] = score_func(
-                dataset,
-                child_tree1,
-                options,
-                afterSize1
-        );
-        auto [afterScore2, afterLoss2] = score_func(
-                dataset,
-                child_tree2,
-                options,
-                afterSize2
-        );
-        num_evals += options.batch_size / dataset.n;
+        std::tie(afterScore1, afterLoss1) = score_func(dataset, child_tree1, options, afterSize1);
+        std::tie(afterScore2, afterLoss2) = score_func(dataset, child_tree2, options, afterSize2);
+        num_evals += 2;
     }
 
     auto baby1 = PopMember<T, L>(
@@ -324,6 +356,8 @@ std::tuple<PopMember<T, L>, PopMember<T, L>, bool, double> crossover_generation(
             options.deterministic
     );
 
+    compile_member(baby1, options.operators);
+    compile_member(baby2, options.operators);
     crossover_accepted = true;
     return std::make_tuple(baby1, baby2, crossover_accepted, num_evals);
 }
\ No newline at end of file
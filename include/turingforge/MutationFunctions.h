@@ -3,116 +3,111 @@
 #include <vector>
 #include <random>
 #include <cmath>
-#include <bitset>
+#include <cstdlib>
 #include <optional>
 #include <algorithm>
+#include <utility>
 
-#include "DynamicExpressions.hpp"
-#include "CoreModule.hpp"
+#include "Expression.h"
 
-using namespace DynamicExpressions;
-using namespace CoreModule;
+// Uniform sample in [0, 1]
+inline double rand_unit() {
+    return static_cast<double>(std::rand()) / RAND_MAX;
+}
 
-// Return a random node from the tree
 template<typename T>
-Node <T> *random_node(Node <T> *tree) {
-    if (tree->degree == 0)
-        return tree;
-
-    std::size_t b = 0;
-    std::size_t c = 0;
-
-    if (tree->degree >= 1)
-        b = count_nodes(tree->l);
-
-    if (tree->degree == 2)
-        c = count_nodes(tree->r);
+T randn() {
+    thread_local std::mt19937 gen(std::random_device{}());
+    std::normal_distribution<T> dist;
+    return dist(gen);
+}
 
-    std::size_t i = std::rand() % (1 + b + c);
+// Return the index of a random node from the tree
+template<typename T>
+std::size_t random_node(const Expression<T> &tree) {
+    return static_cast<std::size_t>(std::rand()) % tree.nodes.size();
+}
 
-    if (i <= b)
-        return random_node(tree->l);
-    else if (i == b + 1)
-        return tree;
+// Return the index of a random node of the given degree; the tree must contain one
+template<typename T>
+std::size_t random_node_of_degree(const Expression<T> &tree, bool branch) {
+    std::size_t i = random_node(tree);
+    while ((tree.nodes[i].degree != 0) != branch)
+        i = random_node(tree);
+    return i;
+}
 
-    return random_node(tree->r);
+template<typename T>
+Expression<T> make_random_leaf(int nfeatures) {
+    if (std::rand() > RAND_MAX / 2)
+        return make_constant<T>(randn<T>());
+    else
+        return make_feature<T>(std::rand() % nfeatures);
 }
 
 // Randomly convert an operator into another one (binary->binary; unary->unary)
 template<typename T>
-Node <T> *mutate_operator(Node <T> *tree, const Options &options) {
+Expression<T> &mutate_operator(Expression<T> &tree, const Options &options) {
     if (!has_operators(tree))
         return tree;
 
-    Node <T> *node = random_node(tree);
+    ExprNode &node = tree.nodes[random_node_of_degree(tree, true)];
 
-    while (node->degree == 0)
-        node = random_node(tree);
-
-    if (node->degree == 1)
-        node->op = std::rand() % options.nuna + 1;
+    if (node.degree == 1)
+        node.index = static_cast<std::uint16_t>(std::rand() % options.nuna);
     else
-        node->op = std::rand() % options.nbin + 1;
+        node.index = static_cast<std::uint16_t>(std::rand() % options.nbin);
 
     return tree;
 }
 
 // Randomly perturb a constant
 template<typename T>
-Node <T> *mutate_constant(Node <T> *tree, T temperature, const Options &options) {
+Expression<T> &mutate_constant(Expression<T> &tree, T temperature, const Options &options) {
     if (!has_constants(tree))
         return tree;
 
-    Node <T> *node = random_node(tree);
-
-    while (node->degree != 0 || !node->constant)
-        node = random_node(tree);
+    // Constant slots are ordered, so a random constant is a random slot.
+    T &val = tree.constants[static_cast<std::size_t>(std::rand()) % tree.constants.size()];
 
     T bottom = static_cast<T>(1) / static_cast<T>(10);
     T maxChange = options.perturbation_factor * temperature + 1 + bottom;
-    T factor = std::pow(maxChange, static_cast<T>(std::rand()) / RAND_MAX);
+    T factor = std::pow(maxChange, static_cast<T>(rand_unit()));
     bool makeConstBigger = std::rand() > RAND_MAX / 2;
 
     if (makeConstBigger)
-        node->val *= factor;
+        val *= factor;
     else
-        node->val /= factor;
+        val /= factor;
 
-    if (std::rand() > options.probability_negate_constant)
-        node->val *= -1;
+    if (rand_unit() > options.probability_negate_constant)
+        val *= -1;
 
     return tree;
 }
 
 // Add a random unary/binary operation to the end of a tree
 template<typename T>
-Node <T> *append_random_op(Node <T> *tree, const Options &options, int nfeatures,
-                           std::optional<bool> makeNewBinOp = std::nullopt) {
-    Node <T> *node = random_node(tree);
-
-    while (node->degree != 0)
-        node = random_node(tree);
+Expression<T> &append_random_op(Expression<T> &tree, const Options &options, int nfeatures,
+                                std::optional<bool> makeNewBinOp = std::nullopt) {
+    std::size_t node = random_node_of_degree(tree, false);
 
     if (!makeNewBinOp.has_value()) {
-        float choice = static_cast<float>(std::rand()) / RAND_MAX;
-        makeNewBinOp = choice < static_cast<float>(options.nbin) / (options.nuna + options.nbin);
+        double choice = rand_unit();
+        makeNewBinOp = choice < static_cast<double>(options.nbin) / (options.nuna + options.nbin);
     }
 
     if (makeNewBinOp.value()) {
-        Node <T> *newnode = new Node<T>(
-                std::rand() % options.nbin + 1,
+        replace_subtree(tree, node, make_binary(
+                std::rand() % options.nbin,
                 make_random_leaf<T>(nfeatures),
                 make_random_leaf<T>(nfeatures)
-        );
-
-        set_node(node, newnode);
+        ));
     } else {
-        Node <T> *newnode = new Node<T>(
-                std::rand() % options.nuna + 1,
+        replace_subtree(tree, node, make_unary(
+                std::rand() % options.nuna,
                 make_random_leaf<T>(nfeatures)
-        );
-
-        set_node(node, newnode);
+        ));
     }
 
     return tree;
@@ -120,28 +115,23 @@ Node <T> *append_random_op(Node <T> *tree, const Options &options, int nfeatures
 
 // Insert random node
 template<typename T>
-Node <T> *insert_random_op(Node <T> *tree, const Options &options, int nfeatures) {
-    Node <T> *node = random_node(tree);
-    float choice = static_cast<float>(std::rand()) / RAND_MAX;
-    bool makeNewBinOp = choice < static_cast<float>(options.nbin) / (options.nuna + options.nbin);
-    Node <T> *left = copy_node(node);
+Expression<T> &insert_random_op(Expression<T> &tree, const Options &options, int nfeatures) {
+    std::size_t node = random_node(tree);
+    double choice = rand_unit();
+    bool makeNewBinOp = choice < static_cast<double>(options.nbin) / (options.nuna + options.nbin);
+    Expression<T> left = extract_subtree(tree, node);
 
     if (makeNewBinOp) {
-        Node <T> *right = make_random_leaf<T>(nfeatures);
-        Node <T> *newnode = new Node<T>(
-                std::rand() % options.nbin + 1,
-                left,
-                right
-        );
-
-        set_node(node, newnode);
+        replace_subtree(tree, node, make_binary(
+                std::rand() % options.nbin,
+                std::move(left),
+                make_random_leaf<T>(nfeatures)
+        ));
     } else {
-        Node <T> *newnode = new Node<T>(
-                std::rand() % options.nuna + 1,
-                left
-        );
-
-        set_node(node, newnode);
+        replace_subtree(tree, node, make_unary(
+                std::rand() % options.nuna,
+                std::move(left)
+        ));
     }
 
     return tree;
@@ -149,263 +139,109 @@ Node <T> *insert_random_op(Node <T> *tree, const Options &options, int nfeatures
 
 // Add random node to the top of a tree
 template<typename T>
-Node <T> *prepend_random_op(Node <T> *tree, const Options &options, int nfeatures) {
-    Node <T> *node = tree;
-    float choice = static_cast<float>(std::rand()) / RAND_MAX;
-    bool makeNewBinOp = choice < static_cast<float>(options.nbin) / (options.nuna + options.nbin);
-    Node <T> *left = copy_node(tree);
+Expression<T> &prepend_random_op(Expression<T> &tree, const Options &options, int nfeatures) {
+    double choice = rand_unit();
+    bool makeNewBinOp = choice < static_cast<double>(options.nbin) / (options.nuna + options.nbin);
 
     if (makeNewBinOp) {
-        Node <T> *right = make_random_leaf<T>(nfeatures);
-        Node <T> *newnode = new Node<T>(
-                std::rand() % options.nbin + 1,
-                left,
-                right
+        tree = make_binary(
+                std::rand() % options.nbin,
+                std::move(tree),
+                make_random_leaf<T>(nfeatures)
         );
-
-        set_node(node, newnode);
     } else {
-        Node <T> *newnode = new Node<T>(
-                std::rand() % options.nuna + 1,
-                left
+        tree = make_unary(
+                std::rand() % options.nuna,
+                std::move(tree)
         );
-
-        set_node(node, newnode);
     }
 
-    return node;
-}
-
-template<typename T>
-Node <T> *make_random_leaf(int nfeatures) {
-    if (std::rand() > RAND_MAX / 2)
-        return new Node<T>(randn<T>());
-    else
-        return new Node<T>(rand() % nfeatures + 1);
-}
-
-// Return a random node from the tree with parent, and side ('n' for no parent)
-template<typename T>
-std::tuple<Node < T>*, Node <T>*, char>
-random_node_and_parent(Node<T>
-* tree,
-Node <T> *parent = nullptr,
-char side = 'n'
-)
-{
-if (tree->degree == 0)
-return
-std::make_tuple(tree, parent, side
-);
-
-std::size_t b = 0;
-std::size_t c = 0;
-
-if (tree->degree >= 1)
-b = count_nodes(tree->l);
-
-if (tree->degree == 2)
-c = count_nodes(tree->r);
-
-std::size_t i = std::rand() % (1 + b + c);
-
-if (i <= b)
-return
-random_node_and_parent(tree
-->l, tree, 'l');
-else if (i == b + 1)
-return
-std::make_tuple(tree, parent, side
-);
-
-return
-random_node_and_parent(tree
-->r, tree, 'r');
-}
-
-template<typename T>
-std::tuple<Node < T>*, Node <T>*, char>
-random_node_and_parent(Node<T>
-* tree)
-{
-return
-random_node_and_parent(tree, nullptr,
-'n');
+    return tree;
 }
 
 // Select a random node, and replace it and the subtree
 // with a variable or constant
 template<typename T>
-Node <T> *delete_random_op(Node < T > *tree,
-const Options &options,
-int nfeatures
-)
-{
-Node <T> *node;
-Node <T> *parent;
-char side;
-std::tie(node, parent, side
-) =
-random_node_and_parent(tree);
-bool isroot = (parent == nullptr);
-
-if (node->degree == 0)
-{
-// Replace with new constant
-Node <T> *newnode = make_random_leaf<T>(nfeatures);
-set_node(node, newnode
-);
-}
-else if (node->degree == 1)
-{
-// Join one of the children with the parent
-if (isroot)
-return node->
-l;
-else if (parent->l == node)
-parent->
-l = node->l;
-else
-parent->
-r = node->l;
-}
-else
-{
-// Join one of the children with the parent
-if (
-
-std::rand()
-
-< RAND_MAX / 2)
-{
-if (isroot)
-return node->
-l;
-else if (parent->l == node)
-parent->
-l = node->l;
-else
-parent->
-r = node->l;
-}
-else
-{
-if (isroot)
-return node->
-r;
-else if (parent->l == node)
-parent->
-l = node->r;
-else
-parent->
-r = node->r;
-}
-}
+Expression<T> &delete_random_op(Expression<T> &tree, const Options &options, int nfeatures) {
+    std::size_t node = random_node(tree);
+    const ExprNode &selected = tree.nodes[node];
+
+    if (selected.degree == 0) {
+        // Replace with new constant
+        replace_subtree(tree, node, make_random_leaf<T>(nfeatures));
+    } else if (selected.degree == 1) {
+        // Join the child with the parent
+        replace_subtree(tree, node, extract_subtree(tree, left_child(tree, node)));
+    } else {
+        // Join one of the children with the parent
+        std::size_t child = std::rand() < RAND_MAX / 2 ? left_child(tree, node) : right_child(tree, node);
+        replace_subtree(tree, node, extract_subtree(tree, child));
+    }
 
-return
-tree;
+    return tree;
 }
 
 // Create a random equation by appending random operators
 template<typename T>
-Node <T> *gen_random_tree(int length, const Options &options, int nfeatures) {
+Expression<T> gen_random_tree(int length, const Options &options, int nfeatures) {
     // Note that this base tree is just a placeholder; it will be replaced.
-    Node<T> * tree = new Node<T>(T(1));
+    Expression<T> tree = make_constant<T>(T(1));
 
     for (int i = 0; i < length; ++i) {
         // TODO: This can be larger number of nodes than length.
-        tree = append_random_op(tree, options, nfeatures);
+        append_random_op(tree, options, nfeatures);
     }
 
     return tree;
 }
 
 template<typename T>
-Node <T> *gen_random_tree_fixed_size(int node_count, const Options &options, int nfeatures) {
-    Node<T> * tree = make_random_leaf<T>(nfeatures);
-    int cur_size = count_nodes(tree);
+Expression<T> gen_random_tree_fixed_size(int node_count, const Options &options, int nfeatures) {
+    Expression<T> tree = make_random_leaf<T>(nfeatures);
+    auto cur_size = static_cast<int>(count_nodes(tree));
 
     while (cur_size < node_count) {
         if (cur_size == node_count - 1)  // only unary operator allowed.
         {
             if (options.nuna == 0)
                 break; // We will go over the requested amount, so we must break.
-            tree = append_random_op(tree, options, nfeatures, false);
+            append_random_op(tree, options, nfeatures, false);
         } else {
-            tree = append_random_op(tree, options, nfeatures);
+            append_random_op(tree, options, nfeatures);
         }
 
-        cur_size = count_nodes(tree);
+        cur_size = static_cast<int>(count_nodes(tree));
     }
 
     return tree;
 }
 
+// Swap a random subtree of `tree1` with a random subtree of `tree2`
 template<typename T>
-std::pair<Node < T>*, Node <T>*>
-crossover_trees(Node<T>
-* tree1,
-Node <T> *tree2
-)
-{
-tree1 = copy_node(tree1);
-tree2 = copy_node(tree2);
-
-Node <T> *node1;
-Node <T> *parent1;
-char side1;
-std::tie(node1, parent1, side1
-) =
-random_node_and_parent(tree1);
-
-Node <T> *node2;
-Node <T> *parent2;
-char side2;
-std::tie(node2, parent2, side2
-) =
-random_node_and_parent(tree2);
-
-bool isroot1 = (parent1 == nullptr);
-bool isroot2 = (parent2 == nullptr);
-
-if (isroot1)
-tree1 = node2;
-else if (parent1->l == node1)
-parent1->
-l = node2;
-else
-parent1->
-r = node2;
-
-if (isroot2)
-tree2 = node1;
-else if (parent2->l == node2)
-parent2->
-l = node1;
-else
-parent2->
-r = node1;
-
-    return std::make_pair(tree1, tree2);
+std::pair<Expression<T>, Expression<T>> crossover_trees(const Expression<T> &tree1, const Expression<T> &tree2) {
+    Expression<T> child1 = copy_node(tree1);
+    Expression<T> child2 = copy_node(tree2);
+
+    std::size_t node1 = random_node(child1);
+    std::size_t node2 = random_node(child2);
+
+    Expression<T> sub1 = extract_subtree(child1, node1);
+    Expression<T> sub2 = extract_subtree(child2, node2);
+
+    replace_subtree(child1, node1, sub2);
+    replace_subtree(child2, node2, sub1);
+
+    return std::make_pair(std::move(child1), std::move(child2));
 }
 
 template<typename T>
-Node <T> *mutate_tree(Node < T > *tree,
-const Options &options,
-int nfeatures, T
-temperature)
-{
-float choice = static_cast<float>(std::rand()) / RAND_MAX;
-
-if (choice<options.probability_mutate_operator)
-return
-mutate_operator(tree, options
-);
-else if (choice<options.probability_mutate_operator + options.probability_mutate_constant)
-return
-mutate_constant(tree, temperature, options
-);
-else
-return
-tree;
+Expression<T> &mutate_tree(Expression<T> &tree, const Options &options, int nfeatures, T temperature) {
+    double choice = rand_unit();
+
+    if (choice < options.probability_mutate_operator)
+        return mutate_operator(tree, options);
+    else if (choice < options.probability_mutate_operator + options.probability_mutate_constant)
+        return mutate_constant(tree, temperature, options);
+    else
+        return tree;
 }
@@ -1,10 +1,90 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+#include <string>
 #include <vector>
 #include <functional>
 #include <ostream>
 #include <stdexcept>
 
+#include "Operators.h"
+
+// Operators the evaluator has vectorized kernels for. Anything else is stored as
+// CUSTOM and evaluated element by element through the `std::function` table.
+enum class BinaryOperator : std::uint8_t {
+    PLUS,
+    SUB,
+    MULT,
+    DIV,
+    POW,
+    GREATER,
+    LOGICAL_OR,
+    LOGICAL_AND,
+    CUSTOM
+};
+
+enum class UnaryOperator : std::uint8_t {
+    NEG,
+    SQUARE,
+    CUBE,
+    ABS,
+    SQRT,
+    RELU,
+    EXP,
+    LOG,
+    LOG2,
+    LOG10,
+    LOG1P,
+    SIN,
+    COS,
+    TANH,
+    ACOSH,
+    ATANH_CLIP,
+    GAMMA,
+    CUSTOM
+};
+
+inline std::string to_string(BinaryOperator op) {
+    switch (op) {
+        case BinaryOperator::PLUS: return "+";
+        case BinaryOperator::SUB: return "-";
+        case BinaryOperator::MULT: return "*";
+        case BinaryOperator::DIV: return "/";
+        case BinaryOperator::POW: return "pow";
+        case BinaryOperator::GREATER: return "greater";
+        case BinaryOperator::LOGICAL_OR: return "logical_or";
+        case BinaryOperator::LOGICAL_AND: return "logical_and";
+        case BinaryOperator::CUSTOM: return "custom";
+    }
+    return "unknown";
+}
+
+inline std::string to_string(UnaryOperator op) {
+    switch (op) {
+        case UnaryOperator::NEG: return "neg";
+        case UnaryOperator::SQUARE: return "square";
+        case UnaryOperator::CUBE: return "cube";
+        case UnaryOperator::ABS: return "abs";
+        case UnaryOperator::SQRT: return "sqrt";
+        case UnaryOperator::RELU: return "relu";
+        case UnaryOperator::EXP: return "exp";
+        case UnaryOperator::LOG: return "log";
+        case UnaryOperator::LOG2: return "log2";
+        case UnaryOperator::LOG10: return "log10";
+        case UnaryOperator::LOG1P: return "log1p";
+        case UnaryOperator::SIN: return "sin";
+        case UnaryOperator::COS: return "cos";
+        case UnaryOperator::TANH: return "tanh";
+        case UnaryOperator::ACOSH: return "acosh";
+        case UnaryOperator::ATANH_CLIP: return "atanh_clip";
+        case UnaryOperator::GAMMA: return "gamma";
+        case UnaryOperator::CUSTOM: return "custom";
+    }
+    return "unknown";
+}
+
 struct AbstractOperatorEnum {
     std::string print(std::ostream& os, const std::string ops = ""){
         throw std::logic_error("Not implemented");
@@ -17,14 +97,135 @@ struct AbstractOperatorEnum {
     }
 };
 
+inline std::uint64_t _next_operator_generation() {
+    static std::atomic<std::uint64_t> generation{1};
+    return generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+// What the outputs of an operator table depend on: the builtin id of each
+// entry and, if any entry is custom, the generation of the table its
+// functions came from (zero otherwise). See `OperatorEnum::signature`.
+struct OperatorSignature {
+    std::vector<BinaryOperator> binops;
+    std::vector<UnaryOperator> unaops;
+    std::uint64_t generation = 0;
+
+    bool operator==(const OperatorSignature&) const = default;
+};
+
 struct OperatorEnum : public AbstractOperatorEnum {
     std::vector<std::function<double(double, double)>> binops;
     std::vector<std::function<double(double)>> unaops;
     std::vector<std::function<double(double, double)>> diff_binops;
     std::vector<std::function<double(double)>> diff_unaops;
+    // Builtin id of each entry of `binops`/`unaops`; missing entries are CUSTOM
+    std::vector<BinaryOperator> binop_ids;
+    std::vector<UnaryOperator> unaop_ids;
+    // Every new table gets its own generation and copies keep it, so caches
+    // bound to a table stay valid for its copies. `std::function`s cannot be
+    // compared, so replacing a custom function in place is not detected:
+    // build a new table instead.
+    std::uint64_t generation = _next_operator_generation();
+
+    [[nodiscard]] BinaryOperator binop_id(std::size_t i) const {
+        return i < binop_ids.size() ? binop_ids[i] : BinaryOperator::CUSTOM;
+    }
+
+    [[nodiscard]] UnaryOperator unaop_id(std::size_t i) const {
+        return i < unaop_ids.size() ? unaop_ids[i] : UnaryOperator::CUSTOM;
+    }
+
+    [[nodiscard]] bool has_custom() const {
+        for (std::size_t i = 0; i < binops.size(); ++i)
+            if (binop_id(i) == BinaryOperator::CUSTOM)
+                return true;
+        for (std::size_t i = 0; i < unaops.size(); ++i)
+            if (unaop_id(i) == UnaryOperator::CUSTOM)
+                return true;
+        return false;
+    }
+
+    // Two tables with equal signatures evaluate every tree the same way
+    [[nodiscard]] OperatorSignature signature() const {
+        OperatorSignature result;
+        for (std::size_t i = 0; i < binops.size(); ++i)
+            result.binops.push_back(binop_id(i));
+        for (std::size_t i = 0; i < unaops.size(); ++i)
+            result.unaops.push_back(unaop_id(i));
+        result.generation = has_custom() ? generation : 0;
+        return result;
+    }
+
+    // Whether `signature() == other`, without building the signature
+    [[nodiscard]] bool matches(const OperatorSignature& other) const {
+        if (other.binops.size() != binops.size() || other.unaops.size() != unaops.size())
+            return false;
+        for (std::size_t i = 0; i < binops.size(); ++i)
+            if (binop_id(i) != other.binops[i])
+                return false;
+        for (std::size_t i = 0; i < unaops.size(); ++i)
+            if (unaop_id(i) != other.unaops[i])
+                return false;
+        return other.generation == (has_custom() ? generation : 0);
+    }
 };
 
 struct GenericOperatorEnum : public AbstractOperatorEnum {
     std::vector<std::function<double(double, double)>> binops;
     std::vector<std::function<double(double)>> unaops;
-};
\ No newline at end of file
+};
+
+inline std::function<double(double, double)> builtin_function(BinaryOperator op) {
+    switch (op) {
+        case BinaryOperator::PLUS: return [](double x, double y) { return x + y; };
+        case BinaryOperator::SUB: return [](double x, double y) { return x - y; };
+        case BinaryOperator::MULT: return [](double x, double y) { return x * y; };
+        case BinaryOperator::DIV: return div<double>;
+        case BinaryOperator::POW: return safe_pow<double>;
+        case BinaryOperator::GREATER: return greater<double>;
+        case BinaryOperator::LOGICAL_OR: return logical_or<double>;
+        case BinaryOperator::LOGICAL_AND: return logical_and<double>;
+        case BinaryOperator::CUSTOM: break;
+    }
+    throw std::invalid_argument("CUSTOM has no builtin implementation");
+}
+
+inline std::function<double(double)> builtin_function(UnaryOperator op) {
+    switch (op) {
+        case UnaryOperator::NEG: return neg<double>;
+        case UnaryOperator::SQUARE: return square<double>;
+        case UnaryOperator::CUBE: return cube<double>;
+        case UnaryOperator::ABS: return [](double x) { return std::abs(x); };
+        case UnaryOperator::SQRT: return safe_sqrt<double>;
+        case UnaryOperator::RELU: return relu<double>;
+        case UnaryOperator::EXP: return [](double x) { return std::exp(x); };
+        case UnaryOperator::LOG: return safe_log<double>;
+        case UnaryOperator::LOG2: return safe_log2<double>;
+        case UnaryOperator::LOG10: return safe_log10<double>;
+        case UnaryOperator::LOG1P: return safe_log1p<double>;
+        case UnaryOperator::SIN: return [](double x) { return std::sin(x); };
+        case UnaryOperator::COS: return [](double x) { return std::cos(x); };
+        case UnaryOperator::TANH: return [](double x) { return std::tanh(x); };
+        case UnaryOperator::ACOSH: return safe_acosh<double>;
+        case UnaryOperator::ATANH_CLIP: return atanh_clip<double>;
+        case UnaryOperator::GAMMA: return gamma<double>;
+        case UnaryOperator::CUSTOM: break;
+    }
+    throw std::invalid_argument("CUSTOM has no builtin implementation");
+}
+
+// Build an operator table from builtin operators, so that the evaluator can
+// dispatch each node to a vectorized kernel instead of a `std::function`
+inline OperatorEnum make_operator_enum(const std::vector<BinaryOperator>& binary_operators,
+                                       const std::vector<UnaryOperator>& unary_operators) {
+    OperatorEnum operators;
+    for (BinaryOperator op : binary_operators) {
+        operators.binops.push_back(builtin_function(op));
+        operators.binop_ids.push_back(op);
+    }
+    for (UnaryOperator op : unary_operators) {
+        operators.unaops.push_back(builtin_function(op));
+        operators.unaop_ids.push_back(op);
+    }
+    return operators;
+}
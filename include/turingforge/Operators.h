@@ -5,7 +5,7 @@
 #include <type_traits>
 
 template <typename T>
-concept DataType = std::is_arithmetic_v<T>;
+concept Arithmetic = std::is_arithmetic_v<T>;
 
 template <typename T>
 T gamma(T x) {
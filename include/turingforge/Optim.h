@@ -1,7 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <optional>
 #include <limits>
+#include <vector>
 
 namespace Optim {
     template<typename T = double, typename TCallback = std::nullptr_t>
@@ -43,8 +47,8 @@ namespace Optim {
                 const T &f_reltol = 0.0,
                 const T &g_abstol = 1e-8,
                 const T &g_reltol = 1e-8,
-                const T &outer_x_tol = 0.0,
-                const T &outer_f_tol = 0.0,
+                const std::optional<T> &outer_x_tol = std::nullopt,
+                const std::optional<T> &outer_f_tol = std::nullopt,
                 const std::optional<T> &outer_g_tol = std::nullopt,
                 const T &outer_x_abstol = 0.0,
                 const T &outer_x_reltol = 0.0,
@@ -95,23 +99,159 @@ namespace Optim {
                 , callback(callback.value_or(nullptr))
                 , time_limit(time_limit) {
             if (x_tol.has_value()) {
-                x_abstol = x_tol.value();
+                this->x_abstol = x_tol.value();
             }
             if (g_tol.has_value()) {
-                g_abstol = g_tol.value();
+                this->g_abstol = g_tol.value();
             }
             if (f_tol.has_value()) {
-                f_reltol = f_tol.value();
+                this->f_reltol = f_tol.value();
             }
             if (outer_x_tol.has_value()) {
-                outer_x_abstol = outer_x_tol.value();
+                this->outer_x_abstol = outer_x_tol.value();
             }
             if (outer_g_tol.has_value()) {
-                outer_g_abstol = outer_g_tol.value();
+                this->outer_g_abstol = outer_g_tol.value();
             }
             if (outer_f_tol.has_value()) {
-                outer_f_reltol = outer_f_tol.value();
+                this->outer_f_reltol = outer_f_tol.value();
             }
         }
     };
+    // Outcome of a minimization. For methods given both `f` and `fg`, `f_calls`
+    // counts the calls of `f` and `g_calls` those of `fg`.
+    template<typename T>
+    struct Result {
+        std::vector<T> minimizer;
+        T minimum;
+        int iterations = 0;
+        int f_calls = 0;
+        int g_calls = 0;
+        bool converged = false;
+    };
+
+    template<typename T>
+    bool converged(const Result<T> &result) {
+        return result.converged;
+    }
+
+    // Quasi-Newton method with an inverse Hessian approximation
+    struct BFGS {};
+
+    template<typename T>
+    T _dot(const std::vector<T> &a, const std::vector<T> &b) {
+        T s = 0;
+        for (std::size_t i = 0; i < a.size(); ++i)
+            s += a[i] * b[i];
+        return s;
+    }
+
+    // Minimize `f` with BFGS and a backtracking (Armijo) line search, starting
+    // from `x`. `fg(x, g)` returns `f(x)` and writes its gradient into `g`. Once
+    // a line search accepts the unit step, the next ones likely will too, so
+    // their unit step calls `fg` and needs no second call if accepted; other
+    // trial steps cost one call of `f`, and `fg` is then called at the accepted one.
+    // Converges when the gradient, the change of `f` or the step are within the
+    // tolerances of `options`, which may be given in another precision than `x`.
+    template<typename T, typename F, typename FG, typename U, typename TCallback>
+    Result<T> optimize(F f, FG fg, std::vector<T> x, BFGS, const Options<U, TCallback> &options) {
+        const std::size_t n = x.size();
+        Result<T> result;
+        std::vector<T> g(n), g_new(n), x_new(n), p(n), s(n), y(n), Hy(n);
+        std::vector<T> H(n * n, T(0));
+        auto reset = [&]() {
+            std::fill(H.begin(), H.end(), T(0));
+            for (std::size_t i = 0; i < n; ++i)
+                H[i * n + i] = T(1);
+        };
+        reset();
+        bool expect_unit_step = false;
+
+        T fx = fg(x, g);
+        ++result.g_calls;
+        while (std::isfinite(fx) && result.iterations < options.iterations) {
+            T gnorm = 0;
+            for (T gi : g)
+                gnorm = std::max(gnorm, std::abs(gi));
+            if (gnorm <= static_cast<T>(options.g_abstol)) {
+                result.converged = true;
+                break;
+            }
+            ++result.iterations;
+
+            for (std::size_t i = 0; i < n; ++i) {
+                p[i] = 0;
+                for (std::size_t j = 0; j < n; ++j)
+                    p[i] -= H[i * n + j] * g[j];
+            }
+            T slope = _dot(g, p);
+            if (!(slope < 0)) {
+                reset();
+                for (std::size_t i = 0; i < n; ++i)
+                    p[i] = -g[i];
+                slope = -_dot(g, g);
+            }
+
+            T alpha = 1;
+            T f_new = std::numeric_limits<T>::infinity();
+            bool has_gradient = false;
+            for (int step = 0; step < 40; ++step, alpha /= 2) {
+                for (std::size_t i = 0; i < n; ++i)
+                    x_new[i] = x[i] + alpha * p[i];
+                has_gradient = step == 0 && expect_unit_step;
+                if (has_gradient) {
+                    f_new = fg(x_new, g_new);
+                    ++result.g_calls;
+                } else {
+                    f_new = f(x_new);
+                    ++result.f_calls;
+                }
+                if (f_new <= fx + T(1e-4) * alpha * slope)
+                    break;
+            }
+            expect_unit_step = alpha == 1;
+            if (!(f_new <= fx))
+                break;
+
+            if (!has_gradient) {
+                f_new = fg(x_new, g_new);
+                ++result.g_calls;
+            }
+            T dx = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                s[i] = x_new[i] - x[i];
+                y[i] = g_new[i] - g[i];
+                dx = std::max(dx, std::abs(s[i]));
+            }
+            T df = std::abs(fx - f_new);
+            x.swap(x_new);
+            g.swap(g_new);
+            fx = f_new;
+            if (dx <= static_cast<T>(options.x_abstol) ||
+                df <= static_cast<T>(options.f_abstol) + static_cast<T>(options.f_reltol) * std::abs(fx)) {
+                result.converged = true;
+                break;
+            }
+
+            // H <- (I - rho s y') H (I - rho y s') + rho s s'
+            T sy = _dot(s, y);
+            if (sy <= std::numeric_limits<T>::epsilon() * _dot(y, y))
+                continue;
+            T rho = 1 / sy;
+            for (std::size_t i = 0; i < n; ++i) {
+                Hy[i] = 0;
+                for (std::size_t j = 0; j < n; ++j)
+                    Hy[i] += H[i * n + j] * y[j];
+            }
+            T yHy = _dot(y, Hy);
+            for (std::size_t i = 0; i < n; ++i) {
+                for (std::size_t j = 0; j < n; ++j)
+                    H[i * n + j] += rho * ((1 + rho * yHy) * s[i] * s[j] - Hy[i] * s[j] - s[i] * Hy[j]);
+            }
+        }
+
+        result.minimizer = x;
+        result.minimum = fx;
+        return result;
+    }
 }  // namespace Optim
\ No newline at end of file
@@ -89,11 +89,11 @@ namespace OptionsStructModule {
     struct Options {
         using CT = T;
         using OPT = Optim::Options<>;
-        using EL = typename std::conditional<std::is_same<T, SupervisedLoss>::value, SupervisedLoss, std::function<T>>::type;
+        using EL = typename std::conditional<std::is_same<T, SupervisedLoss>::value, AnyLoss, std::function<T>>::type;
         using FL = typename std::conditional<std::is_same<T, std::nullptr_t>::value, std::nullptr_t, std::function<T>>::type;
         using W = std::tuple<int, float>; // Placeholder for W
 
-        GenericOperatorEnum operators;
+        OperatorEnum operators;
         std::vector<std::tuple<int, int>> bin_constraints;
         std::vector<int> una_constraints;
         ComplexityMapping<T> complexity_mapping;
@@ -116,6 +116,15 @@ namespace OptionsStructModule {
         bool annealing{};
         bool batching{};
         int batch_size{};
+        bool racing{};
+        int racing_rows{4096};
+        double racing_confidence{3.0};
+        bool fused_scoring{true};
+        std::size_t subtree_cache_bytes{0};
+        std::size_t fitness_memo_size{0};
+        double fitness_memo_tolerance{1e-10};
+        int precision{64};
+        std::size_t reduction_threads{0};
         MutationWeights mutation_weights;
         float crossover_probability{};
         float warmup_maxsize_by{};
@@ -182,7 +191,7 @@ namespace OptionsStructModule {
                << "    # Annealing:\n"
                << "        annealing=" << annealing << ", alpha=" << alpha << ",\n"
                << "    # Speed Tweaks:\n"
-               << "        batching=" << batching << ", batch_size=" << batch_size << ", fast_cycle=" << fast_cycle << ",\n"
+               << "        batching=" << batching << ", batch_size=" << batch_size << ", racing=" << racing << ", racing_rows=" << racing_rows << ", racing_confidence=" << racing_confidence << ", fused_scoring=" << fused_scoring << ", subtree_cache_bytes=" << subtree_cache_bytes << ", fitness_memo_size=" << fitness_memo_size << ", precision=" << precision << ", reduction_threads=" << reduction_threads << ", fast_cycle=" << fast_cycle << ",\n"
                << "    # Logistics:\n"
                << "        output_file=" << output_file << ", verbosity=" << verbosity << ", seed=" << seed << ", progress=" << progress << ",\n"
                << "    # Early Exit:\n"
@@ -2,24 +2,38 @@
 #include <memory>
 #include <cassert>
 
+#include "Bytecode.h"
+#include "Expression.h"
+#include "Scoring.h"
+
 // Define a member of population by equation, score, and age
 template <typename T, typename L>
 struct PopMember {
-    Node<T> tree;
+    Expression<T> tree;
     L score;
     L loss;
     int birth;
     int complexity;
     int ref;
     int parent;
+    // Bytecode of `tree`, compiled where the tree is set or changed (see
+    // `compile_member`) and shared by copies of the member. Members are shared
+    // between threads, so scoring only reads it.
+    std::shared_ptr<const Program<T>> program;
 };
 
+// Compile the member's program from its tree, after the tree was set or changed
+template <typename T, typename L>
+void compile_member(PopMember<T, L>& member, const OperatorEnum& operators) {
+    member.program = std::make_shared<const Program<T>>(compile(member.tree, operators));
+}
+
 template <typename T, typename L>
 PopMember<T, L> make_PopMember(
-        Node<T> t,
+        Expression<T> t,
         L score,
         L loss,
-        Options options,
+        const Options& options,
         std::optional<int> complexity = std::nullopt,
         int ref = -1,
         int parent = -1,
@@ -32,7 +46,7 @@ PopMember<T, L> make_PopMember(
         ref = abs(dis(gen));
     }
     complexity = complexity.has_value() ? complexity.value() : -1;
-    return PopMember<T, L>{
+    PopMember<T, L> member{
             std::move(t),
             std::move(score),
             std::move(loss),
@@ -41,13 +55,15 @@ PopMember<T, L> make_PopMember(
             ref,
             parent
     };
+    compile_member(member, options.operators);
+    return member;
 }
 
 template <typename T, typename L>
 PopMember<T, L> make_PopMember(
         const Dataset<T, L>& dataset,
-        Node<T> t,
-        Options options,
+        Expression<T> t,
+        const Options& options,
         std::optional<int> complexity = std::nullopt,
         int ref = -1,
         int parent = -1,
@@ -60,7 +76,7 @@ PopMember<T, L> make_PopMember(
             std::move(t),
             std::move(score),
             std::move(loss),
-            std::move(options),
+            options,
             set_complexity,
             ref,
             parent,
@@ -70,7 +86,7 @@ PopMember<T, L> make_PopMember(
 
 template <typename T, typename L>
 PopMember<T, L> copy_pop_member(const PopMember<T, L>& p) {
-    Node<T> tree = copy_node(p.tree);
+    Expression<T> tree = copy_node(p.tree);
     L score = p.score;
     L loss = p.loss;
     int birth = p.birth;
@@ -84,7 +100,8 @@ PopMember<T, L> copy_pop_member(const PopMember<T, L>& p) {
             birth,
             complexity,
             ref,
-            parent
+            parent,
+            p.program
     };
 }
 
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "Aligned.h"
+#include "Complexity.h"
+#include "Dataset.h"
+#include "Evaluate.h"
+#include "Expression.h"
+#include "FitnessMemo.h"
+#include "Loss/LossFunctions.h"
+#include "Scoring.h"
+
+// Each racing stage evaluates this many times the rows of the one before
+constexpr std::size_t RACING_GROWTH = 4;
+
+// The rows of a dataset in one fixed random order, so that every prefix is a
+// uniform sample of the rows and still streams contiguous columns
+template <typename T>
+struct ShuffledRows {
+    Matrix<T> X;
+    AlignedVector<T> y;
+    AlignedVector<T> weights;  // empty if the dataset is unweighted
+
+    [[nodiscard]] ColumnView<T> columns() const {
+        return ColumnView<T>{X.data(), X.stride, static_cast<std::size_t>(X.shape()[BATCH_DIM]), X.shape()[FEATURE_DIM]};
+    }
+};
+
+// Give the dataset the shuffled copy of its rows that racing scores on, or
+// remove it if `options.racing` is off. The copy doubles the dataset's memory.
+template <typename T, typename L, typename... D>
+void init_racing(Dataset<T, L, D...>& dataset, const Options& options, std::uint64_t seed = std::random_device{}()) {
+    if (!options.racing) {
+        dataset.shuffled_rows = nullptr;
+        return;
+    }
+    std::vector<int> order(dataset.n);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937_64 gen(seed);
+    std::shuffle(order.begin(), order.end(), gen);
+
+    auto shuffled = std::make_shared<ShuffledRows<T>>(ShuffledRows<T>{Matrix<T>(dataset.nfeatures, dataset.n), {}, {}});
+    const ColumnView<T> X = dataset.columns();
+    for (int feature = 0; feature < dataset.nfeatures; ++feature) {
+        const T* column = X.column(feature);
+        for (int row = 0; row < dataset.n; ++row)
+            shuffled->X(feature, row) = column[order[row]];
+    }
+    shuffled->y.resize(dataset.n);
+    for (int row = 0; row < dataset.n; ++row)
+        shuffled->y[row] = dataset.y.value()[order[row]];
+    if (dataset.weighted) {
+        shuffled->weights.resize(dataset.n);
+        for (int row = 0; row < dataset.n; ++row)
+            shuffled->weights[row] = dataset.weights.value()[order[row]];
+    }
+    dataset.shuffled_rows = std::move(shuffled);
+}
+
+// Outcome of racing a child against its parent
+template <typename L>
+struct RaceResult {
+    bool competitive;  // the child was scored on every row; `score` and `loss` are then its full score and loss
+    L score;
+    L loss;
+    double num_evals;  // rows evaluated for both trees, in units of the dataset's rows
+};
+
+// Running sums of one race over the rows seen so far
+struct _RaceSums {
+    double child = 0;       // weighted losses of the child
+    double difference = 0;  // weighted child minus parent losses, over the paired rows
+    double difference2 = 0;
+    double weight = 0;
+    std::size_t rows = 0;
+    std::size_t child_evaluated = 0;  // rows each tree was evaluated on, for num_evals
+    std::size_t parent_evaluated = 0;
+
+    [[nodiscard]] double num_evals(std::size_t n) const {
+        return static_cast<double>(child_evaluated + parent_evaluated) / static_cast<double>(n);
+    }
+};
+
+// Add the rows [begin, end) of `rows` to `sums`, with the parent only if
+// `parent` is not null. Returns false once a child prediction is not finite.
+template <typename T>
+bool _race_rows(const ShuffledRows<T>& rows, std::size_t begin, std::size_t end, const Expression<T>& child,
+                const Expression<T>* parent, const Options& options, _RaceSums& sums, bool& parent_finite) {
+    thread_local TileWorkspace<T> child_workspace;
+    thread_local TileWorkspace<T> parent_workspace;
+    thread_local std::vector<T> child_prediction(EVAL_TILE_SIZE);
+    thread_local std::vector<T> parent_prediction(EVAL_TILE_SIZE);
+    const ColumnView<T> X = rows.columns();
+    const bool weighted = !rows.weights.empty();
+    for (std::size_t row = begin; row < end; row += EVAL_TILE_SIZE) {
+        std::size_t m = std::min<std::size_t>(EVAL_TILE_SIZE, end - row);
+        ColumnView<T> tile{X.data + row, X.stride, m, X.nfeatures};
+        sums.child_evaluated += m;
+        if (!eval_tree_array(child, tile, options.operators, child_prediction.data(), child_workspace))
+            return false;
+        bool paired = parent != nullptr && parent_finite;
+        if (paired) {
+            sums.parent_evaluated += m;
+            if (!eval_tree_array(*parent, tile, options.operators, parent_prediction.data(), parent_workspace))
+                paired = parent_finite = false;
+        }
+        visit_loss(options.elementwise_loss, [&](const auto& loss) {
+            for (std::size_t i = 0; i < m; ++i) {
+                double target = static_cast<double>(rows.y[row + i]);
+                double w = weighted ? static_cast<double>(rows.weights[row + i]) : 1.0;
+                double child_loss = w * _value(loss, static_cast<double>(child_prediction[i]), target);
+                sums.child += child_loss;
+                sums.weight += w;
+                if (paired) {
+                    double d = child_loss - w * _value(loss, static_cast<double>(parent_prediction[i]), target);
+                    sums.difference += d;
+                    sums.difference2 += d * d;
+                }
+            }
+        });
+        sums.rows += m;
+    }
+    return true;
+}
+
+/*
+ * Score `child` by racing it against `parent` over growing prefixes of the
+ * dataset's shuffled rows: `options.racing_rows` rows first, then
+ * RACING_GROWTH times as many at each stage. Both trees are evaluated on the
+ * same rows, and after each stage the child is dropped if, with
+ * `options.racing_confidence` standard errors of the paired loss differences
+ * to spare, its score is still worse than the parent's on those rows.
+ * A child that stays competitive is evaluated on the remaining rows alone and
+ * gets its loss over all of them, equal to `score_func` up to rounding.
+ * A dropped child never reaches the annealing acceptance test, so while
+ * racing, `temperature` cannot accept a clearly worse child.
+ *
+ * A child found in the dataset's fitness memo takes its score from there and
+ * costs no evaluations, and the full score of a child that survives is added
+ * to it. Without shuffled rows, see `init_racing`, or on a dataset no larger
+ * than the first stage, the child is scored with `score_func` instead.
+ */
+template <typename T, typename L, typename... D>
+RaceResult<L> race(const Dataset<T, L, D...>& dataset, const Expression<T>& child, const Expression<T>& parent,
+                   const Options& options, int child_complexity = -1, int parent_complexity = -1) {
+    const auto n = static_cast<std::size_t>(dataset.n);
+    const auto first_stage = static_cast<std::size_t>(std::max(options.racing_rows, 1));
+    int child_size = child_complexity == -1 ? compute_complexity(child, options) : child_complexity;
+    if (!dataset.shuffled_rows || n <= first_stage) {
+        auto [score, loss] = score_func(dataset, child, options, child_size);
+        return {true, score, loss, 1.0};
+    }
+    FitnessMemo<L>* memo = _fitness_memo(dataset, options);
+    MemoKey key;
+    if (memo != nullptr) {
+        key = memo_key(child, options.operators, static_cast<T>(memo->tolerance()));
+        if (auto entry = memo->find(key))
+            return {true, entry->score, entry->loss, 0.0};
+    }
+    int parent_size = parent_complexity == -1 ? compute_complexity(parent, options) : parent_complexity;
+    const ShuffledRows<T>& rows = *dataset.shuffled_rows;
+    const L infinity = std::numeric_limits<L>::infinity();
+    L normalization = dataset.baseline_loss < L(0.01) ? L(0.01) : dataset.baseline_loss;
+    double scale = dataset.use_baseline ? 1.0 / static_cast<double>(normalization) : 1.0;
+    double parsimony_difference = static_cast<double>(child_size - parent_size) * static_cast<double>(options.parsimony);
+
+    _RaceSums sums;
+    bool parent_finite = true;
+    for (std::size_t stage = first_stage; sums.rows < n; stage *= RACING_GROWTH) {
+        std::size_t end = std::min(stage, n);
+        bool racing = end < n && parent_finite;
+        if (!_race_rows(rows, sums.rows, end, child, racing ? &parent : nullptr, options, sums, parent_finite))
+            return {false, infinity, infinity, sums.num_evals(n)};
+        if (!racing || !parent_finite)
+            continue;
+        // Lower confidence bound of the child's score minus the parent's
+        double m = static_cast<double>(sums.rows);
+        double mean = sums.difference / m;
+        double variance = std::max(0.0, sums.difference2 / m - mean * mean) * m / (m - 1);
+        double lower = (sums.difference - options.racing_confidence * std::sqrt(variance * m)) / sums.weight;
+        if (lower * scale + parsimony_difference > 0)
+            return {false, infinity, infinity, sums.num_evals(n)};
+    }
+
+    L loss = static_cast<L>(sums.child / sums.weight);
+    if (!std::isfinite(loss))
+        loss = infinity;
+    L score = loss_to_score(loss, dataset.use_baseline, dataset.baseline_loss, child_size, options);
+    if (memo != nullptr)
+        memo->insert(std::move(key), MemoEntry<L>{score, loss, child_size});
+    return {true, score, loss, sums.num_evals(n)};
+}
@@ -0,0 +1,517 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "BatchSampler.h"
+#include "Bytecode.h"
+#include "Complexity.h"
+#include "Dataset.h"
+#include "Evaluate.h"
+#include "Expression.h"
+#include "ExpressionHash.h"
+#include "FitnessMemo.h"
+#include "Loss/Accumulator.h"
+#include "Loss/LossFunctions.h"
+#include "Loss/Parallel.h"
+#include "SubtreeCache.h"
+
+template <typename T, typename L>
+struct PopMember;
+
+// Mean of the elementwise loss over all rows. With `reduction_threads` set,
+// the rows are reduced in fixed blocks on that many threads, see
+// Loss/Parallel.h, and the result does not depend on the thread count.
+template <typename T>
+accumulator_t<T> _loss(const std::vector<T>& x, const T* y, const Options& options) {
+    std::span<const T> outputs(x), targets(y, x.size());
+    if (options.reduction_threads == 0)
+        return static_cast<accumulator_t<T>>(mean(options.elementwise_loss, outputs, targets));
+    ThreadPool& pool = shared_thread_pool(options.reduction_threads);
+    return static_cast<accumulator_t<T>>(parallel_mean(options.elementwise_loss, outputs, targets, &pool));
+}
+
+// Weighted mean of the elementwise loss over all rows
+template <typename T>
+accumulator_t<T> _weighted_loss(const std::vector<T>& x, const T* y, const T* w, const Options& options) {
+    std::span<const T> outputs(x), targets(y, x.size()), weights(w, x.size());
+    if (options.reduction_threads == 0)
+        return static_cast<accumulator_t<T>>(sum(options.elementwise_loss, outputs, targets, weights, true));
+    ThreadPool& pool = shared_thread_pool(options.reduction_threads);
+    return static_cast<accumulator_t<T>>(parallel_mean(options.elementwise_loss, outputs, targets, weights, &pool));
+}
+
+// Sum of the (weighted) elementwise losses over the first `rows` rows, and
+// whether every prediction was finite
+template <typename T>
+struct TiledLoss {
+    accumulator_t<T> sum;
+    bool complete;
+    std::size_t rows;
+};
+
+// Reduce the elementwise loss tile by tile while each tile of predictions is
+// still in L1, so no n-length prediction vector is written and read back.
+// `tile(row, m)` evaluates one tile; `buffer` holds a tile when the result is
+// a scalar. Stops at the first tile with a non-finite prediction, and once the
+// sum exceeds `bound`: every loss is non-negative, so the sum can only grow.
+template <typename T, typename TileFunction, typename LossFunction>
+TiledLoss<T> reduce_loss_tiled(TileFunction tile, std::size_t n, const T* y, const T* w, const LossFunction& loss,
+                               T* buffer, accumulator_t<T> bound = std::numeric_limits<T>::infinity()) {
+    using A = accumulator_t<T>;
+    A total = A(0);
+    A compensation = A(0);  // low-order bits lost from `total`, Kahan style
+    for (std::size_t row = 0; row < n; row += EVAL_TILE_SIZE) {
+        int m = static_cast<int>(std::min<std::size_t>(EVAL_TILE_SIZE, n - row));
+        Operand<T> result = tile(row, m);
+        const T* prediction = result.ptr;
+        if (result.scalar) {
+            std::fill(buffer, buffer + m, result.value);
+            prediction = buffer;
+        }
+        if (!all_finite(prediction, static_cast<std::size_t>(m))) {
+            _record_nonfinite_abort(row, n);
+            return {total, false, row};
+        }
+        A tile_sum = w == nullptr
+                ? static_cast<A>(sum(loss, prediction, y + row, static_cast<std::size_t>(m)))
+                : static_cast<A>(sum(loss, prediction, y + row, w + row, static_cast<std::size_t>(m)));
+        A corrected = tile_sum - compensation;
+        A next = total + corrected;
+        // An overflowed total stays infinite instead of turning into NaN
+        compensation = std::isfinite(next) ? (next - total) - corrected : A(0);
+        total = next;
+        if (total > bound && row + m < n) {
+            EarlyAbortStats& stats = early_abort_stats();
+            stats.bound_aborts.fetch_add(1, std::memory_order_relaxed);
+            stats.rows_skipped.fetch_add(n - row - m, std::memory_order_relaxed);
+            return {total, true, row + m};
+        }
+    }
+    return {total, true, n};
+}
+
+template <typename T, typename LossFunction>
+TiledLoss<T> eval_loss_tiled(const Expression<T>& tree, const ColumnView<T>& X, const OperatorEnum& operators,
+                             const T* y, const T* w, const LossFunction& loss, TileWorkspace<T>& workspace,
+                             accumulator_t<T> bound = std::numeric_limits<T>::infinity()) {
+    thread_local std::vector<T> buffer(EVAL_TILE_SIZE);
+    workspace.reserve(tree);
+    return reduce_loss_tiled([&](std::size_t row, int m) {
+        return eval_tile(tree, X, operators, row, m, workspace);
+    }, X.n, y, w, loss, buffer.data(), bound);
+}
+
+template <typename T, typename LossFunction>
+TiledLoss<T> eval_loss_tiled(const Program<T>& program, const std::vector<T>& constants, const ColumnView<T>& X,
+                             const OperatorEnum& operators, const T* y, const T* w, const LossFunction& loss,
+                             ProgramWorkspace<T>& workspace,
+                             accumulator_t<T> bound = std::numeric_limits<T>::infinity()) {
+    thread_local std::vector<T> buffer(EVAL_TILE_SIZE);
+    prepare(program, constants, operators, workspace);
+    return reduce_loss_tiled([&](std::size_t row, int m) {
+        return run_tile(program, constants, X, operators, row, m, workspace);
+    }, X.n, y, w, loss, buffer.data(), bound);
+}
+
+// Fused loss over the fixed blocks of the deterministic reduction, evaluated
+// on the reduction pool; see `reduce_blocks`. The result does not depend on
+// the number of threads. Blocks are independent, so there is no early abort.
+template <typename T, typename L>
+L _eval_loss_blocks(const Expression<T>& tree, const Program<T>* program, const ColumnView<T>& X,
+                    const T* y, const T* w, const Options& options) {
+    using A = accumulator_t<T>;
+    std::atomic<bool> complete{true};
+    A total = reduce_blocks<A>(X.n, [&](std::size_t, std::size_t begin, std::size_t end) {
+        thread_local TileWorkspace<T> tree_workspace;
+        thread_local ProgramWorkspace<T> program_workspace;
+        ColumnView<T> block{X.data + begin, X.stride, end - begin, X.nfeatures};
+        const T* block_w = w == nullptr ? nullptr : w + begin;
+        TiledLoss<T> result = program == nullptr
+                ? eval_loss_tiled(tree, block, options.operators, y + begin, block_w,
+                                  options.elementwise_loss, tree_workspace)
+                : eval_loss_tiled(*program, tree.constants, block, options.operators, y + begin, block_w,
+                                  options.elementwise_loss, program_workspace);
+        if (!result.complete)
+            complete.store(false, std::memory_order_relaxed);
+        return result.sum;
+    }, &shared_thread_pool(options.reduction_threads));
+    if (!complete.load(std::memory_order_relaxed))
+        return std::numeric_limits<L>::infinity();
+    A normalization = w == nullptr ? static_cast<A>(X.n) : std::accumulate(w, w + X.n, A(0));
+    return static_cast<L>(total / normalization);
+}
+
+// Loss of the tree over the rows of `X`, either fused with the evaluation or
+// in two passes over a materialized prediction vector. When `program` is given
+// it must be compiled from `tree`; it is run instead of walking the nodes.
+// The fused path stops once the loss is known to exceed `bound`, and then
+// returns the loss of the rows seen so far: a lower bound that exceeds `bound`.
+template <typename T, typename L>
+L _eval_loss(const Expression<T>& tree, const Program<T>* program, const ColumnView<T>& X, const T* y,
+             const T* w, const Options& options, L bound = std::numeric_limits<L>::infinity()) {
+    if (options.fused_scoring && options.reduction_threads > 0)
+        return _eval_loss_blocks<T, L>(tree, program, X, y, w, options);
+    if (options.fused_scoring) {
+        thread_local TileWorkspace<T> tree_workspace;
+        thread_local ProgramWorkspace<T> program_workspace;
+        using A = accumulator_t<T>;
+        A normalization = w == nullptr ? static_cast<A>(X.n) : std::accumulate(w, w + X.n, A(0));
+        A sum_bound = static_cast<A>(bound) * normalization;
+        TiledLoss<T> result = program == nullptr
+                ? eval_loss_tiled(tree, X, options.operators, y, w, options.elementwise_loss,
+                                  tree_workspace, sum_bound)
+                : eval_loss_tiled(*program, tree.constants, X, options.operators, y, w,
+                                  options.elementwise_loss, program_workspace, sum_bound);
+        if (!result.complete)
+            return std::numeric_limits<L>::infinity();
+        return static_cast<L>(result.sum / normalization);
+    }
+
+    auto [prediction, completion] = program == nullptr
+            ? eval_tree_array(tree, X, options.operators)
+            : eval_program_array(*program, tree.constants, X, options.operators);
+    if (!completion)
+        return std::numeric_limits<L>::infinity();
+
+    if (w != nullptr)
+        return static_cast<L>(_weighted_loss(prediction, y, w, options));
+    return static_cast<L>(_loss(prediction, y, options));
+}
+
+// Whether the dataset has a subtree cache that can be used with these options
+// and that holds at least one of its columns. A zero `subtree_cache_bytes`
+// turns the cache off without removing it from the dataset.
+template <typename T, typename L, typename... D>
+bool _use_subtree_cache(const Dataset<T, L, D...>& dataset, const Options& options) {
+    return options.subtree_cache_bytes > 0 && dataset.subtree_cache &&
+           dataset.subtree_cache->bound_to(dataset.columns(), options.operators) &&
+           dataset.subtree_cache->capacity() > 0;
+}
+
+// The dataset's fitness memo if it can be used with these options, or nullptr.
+// A zero `fitness_memo_size` turns the memo off without removing it from the dataset.
+template <typename T, typename L, typename... D>
+FitnessMemo<L>* _fitness_memo(const Dataset<T, L, D...>& dataset, const Options& options) {
+    if (options.fitness_memo_size == 0 || !dataset.fitness_memo || !dataset.fitness_memo->bound_to(options.operators))
+        return nullptr;
+    return dataset.fitness_memo.get();
+}
+
+// Loss of the tree over the whole dataset, reusing subtree outputs from the
+// dataset's cache. The tree is evaluated and reduced tile by tile like the
+// fused path of `_eval_loss`, on the blocks of the reduction pool if
+// `reduction_threads` is set, and stops at the first non-finite tile or once
+// the loss exceeds `bound`. The columns it computed are only added to the
+// cache if every row was evaluated.
+template <typename T, typename L, typename... D>
+L _eval_loss_cached(const Expression<T>& tree, const Dataset<T, L, D...>& dataset, const Options& options,
+                    L bound = std::numeric_limits<L>::infinity()) {
+    using A = accumulator_t<T>;
+    SubtreeCache<T>& cache = *dataset.subtree_cache;
+    const SubtreePlan<T> plan = plan_subtrees(tree, options.operators, cache);
+    const ColumnView<T> X = dataset.columns();
+    const T* y = dataset.y.value().data();
+    const T* w = dataset.weighted ? dataset.weights.value().data() : nullptr;
+    A normalization = w == nullptr ? static_cast<A>(X.n) : std::accumulate(w, w + X.n, A(0));
+
+    // Reduce the rows [begin, end)
+    auto reduce_rows = [&](std::size_t begin, std::size_t end, TileWorkspace<T>& workspace, A sum_bound) {
+        thread_local std::vector<T> buffer(EVAL_TILE_SIZE);
+        workspace.reserve(tree);
+        return reduce_loss_tiled([&](std::size_t row, int m) {
+            return eval_tile(tree, plan, X, options.operators, begin + row, m, workspace);
+        }, end - begin, y + begin, w == nullptr ? nullptr : w + begin, options.elementwise_loss, buffer.data(),
+           sum_bound);
+    };
+
+    A total;
+    bool complete;
+    bool every_row;
+    if (options.reduction_threads > 0) {
+        std::atomic<bool> blocks_complete{true};
+        total = reduce_blocks<A>(X.n, [&](std::size_t, std::size_t begin, std::size_t end) {
+            thread_local TileWorkspace<T> workspace;
+            TiledLoss<T> result = reduce_rows(begin, end, workspace, std::numeric_limits<A>::infinity());
+            if (!result.complete)
+                blocks_complete.store(false, std::memory_order_relaxed);
+            return result.sum;
+        }, &shared_thread_pool(options.reduction_threads));
+        complete = blocks_complete.load(std::memory_order_relaxed);
+        every_row = complete;
+    } else {
+        thread_local TileWorkspace<T> workspace;
+        TiledLoss<T> result = reduce_rows(0, X.n, workspace, static_cast<A>(bound) * normalization);
+        total = result.sum;
+        complete = result.complete;
+        every_row = result.complete && result.rows == X.n;
+    }
+    if (every_row)
+        insert_subtrees(plan, cache);
+    if (!complete)
+        return std::numeric_limits<L>::infinity();
+    return static_cast<L>(total / normalization);
+}
+
+// Evaluate the loss of the tree over the whole dataset. With a finite `bound`,
+// the evaluation may stop early once the loss exceeds it; see `_eval_loss`.
+template <typename T, typename L, typename... D>
+L eval_loss(const Expression<T>& tree, const Dataset<T, L, D...>& dataset, const Options& options,
+            L bound = std::numeric_limits<L>::infinity()) {
+    if (_use_subtree_cache(dataset, options))
+        return _eval_loss_cached(tree, dataset, options, bound);
+    return _eval_loss<T, L>(tree, nullptr, dataset.columns(), dataset.y.value().data(),
+                            dataset.weighted ? dataset.weights.value().data() : nullptr, options, bound);
+}
+
+// Evaluate the loss of the tree over the whole dataset with its compiled program
+template <typename T, typename L, typename... D>
+L eval_loss(const Program<T>& program, const Expression<T>& tree, const Dataset<T, L, D...>& dataset,
+            const Options& options, L bound = std::numeric_limits<L>::infinity()) {
+    return _eval_loss<T, L>(tree, &program, dataset.columns(), dataset.y.value().data(),
+                            dataset.weighted ? dataset.weights.value().data() : nullptr, options, bound);
+}
+
+// Evaluate the tree over one chunk of rows and add its losses to
+// `accumulator`, a tile at a time, so scoring a dataset streamed in chunks
+// needs no memory beyond the chunk. `w` may be null. Returns false if a
+// prediction is not finite; the loss of the tree is then infinite and the
+// accumulator holds only part of the chunk.
+template <typename T, typename L>
+bool accumulate_loss(const Expression<T>& tree, const ColumnView<T>& X, const T* y, const T* w,
+                     const Options& options, LossAccumulator<L, T>& accumulator) {
+    thread_local TileWorkspace<T> workspace;
+    thread_local std::vector<T> prediction(EVAL_TILE_SIZE);
+    for (std::size_t row = 0; row < X.n; row += EVAL_TILE_SIZE) {
+        std::size_t m = std::min<std::size_t>(EVAL_TILE_SIZE, X.n - row);
+        ColumnView<T> tile{X.data + row, X.stride, m, X.nfeatures};
+        if (!eval_tree_array(tree, tile, options.operators, prediction.data(), workspace))
+            return false;
+        std::span<const T> outputs(prediction.data(), m);
+        if (w == nullptr)
+            accumulator.add(outputs, std::span<const T>(y + row, m));
+        else
+            accumulator.add(outputs, std::span<const T>(y + row, m), std::span<const T>(w + row, m));
+    }
+    return true;
+}
+
+// Mean pinball loss of the tree at every quantile of `loss`, in the order of
+// `loss.taus`, from one evaluation of the tree and one pass over the
+// residuals. All losses are infinite if a prediction is not finite.
+template <typename T, typename L, typename... D>
+std::vector<L> eval_quantile_losses(const Expression<T>& tree, const Dataset<T, L, D...>& dataset,
+                                    const Options& options, const MultiQuantileLoss& loss) {
+    thread_local TileWorkspace<T> workspace;
+    thread_local std::vector<T> prediction(EVAL_TILE_SIZE);
+    const ColumnView<T> X = dataset.columns();
+    const T* y = dataset.y.value().data();
+    const T* w = dataset.weighted ? dataset.weights.value().data() : nullptr;
+    ResidualParts parts;
+    for (std::size_t row = 0; row < X.n; row += EVAL_TILE_SIZE) {
+        std::size_t m = std::min<std::size_t>(EVAL_TILE_SIZE, X.n - row);
+        ColumnView<T> tile{X.data + row, X.stride, m, X.nfeatures};
+        if (!eval_tree_array(tree, tile, options.operators, prediction.data(), workspace))
+            return std::vector<L>(loss.size(), std::numeric_limits<L>::infinity());
+        std::span<const T> outputs(prediction.data(), m);
+        parts += w == nullptr ? residual_parts(outputs, std::span<const T>(y + row, m))
+                              : residual_parts(outputs, std::span<const T>(y + row, m), std::span<const T>(w + row, m));
+    }
+    using A = accumulator_t<T>;
+    A normalization = w == nullptr ? static_cast<A>(X.n) : std::accumulate(w, w + X.n, A(0));
+    std::vector<L> losses;
+    for (double l : quantile_losses(loss, parts))
+        losses.push_back(static_cast<L>(l / normalization));
+    return losses;
+}
+
+// Evaluate the loss of the tree over the rows of `batch`, which must be drawn
+// from the dataset being scored
+template <typename T, typename L>
+L batch_loss(const Expression<T>& tree, const Batch<T>& batch, const Options& options,
+             const Program<T>* program = nullptr) {
+    return _eval_loss<T, L>(tree, program, batch.columns(), batch.y.data(),
+                            batch.weighted ? batch.weights.data() : nullptr, options);
+}
+
+// Evaluate the loss of the tree over the next `batch_size` rows of the calling
+// thread's batch sampler
+template <typename T, typename L, typename... D>
+L batch_sample_loss(const Expression<T>& tree, const Dataset<T, L, D...>& dataset, const Options& options,
+                    const Program<T>* program = nullptr) {
+    auto& sampler = thread_batch_sampler<T>(static_cast<std::size_t>(options.batch_size));
+    return batch_loss<T, L>(tree, sampler.next(dataset), options, program);
+}
+
+// Convert a loss into a score: normalize by the baseline and add the parsimony term
+template <typename L>
+L loss_to_score(L loss, bool use_baseline, L baseline, int complexity, const Options& options) {
+    L normalization = baseline < L(0.01) ? L(0.01) : baseline;
+    L loss_val = use_baseline ? loss / normalization : loss;
+    L parsimony_term = static_cast<L>(complexity) * static_cast<L>(options.parsimony);
+    return loss_val + parsimony_term;
+}
+
+// Largest loss whose score stays within `score_bound`; the inverse of `loss_to_score`
+template <typename L>
+L score_to_loss_bound(L score_bound, bool use_baseline, L baseline, int complexity, const Options& options) {
+    L normalization = baseline < L(0.01) ? L(0.01) : baseline;
+    L loss_val = score_bound - static_cast<L>(complexity) * static_cast<L>(options.parsimony);
+    return use_baseline ? loss_val * normalization : loss_val;
+}
+
+// Score an equation; returns (score, loss). A tree that hashes like one
+// already scored on the dataset is looked up in its fitness memo instead.
+// With a finite `score_bound`, such as the worst score of a tournament, the
+// evaluation stops once the score is known to exceed it, and the returned
+// score is only a lower bound above `score_bound`.
+template <typename T, typename L, typename... D>
+std::pair<L, L> score_func(const Dataset<T, L, D...>& dataset, const Expression<T>& tree, const Options& options,
+                           int complexity = -1, L score_bound = std::numeric_limits<L>::infinity()) {
+    FitnessMemo<L>* memo = _fitness_memo(dataset, options);
+    MemoKey key;
+    if (memo != nullptr) {
+        key = memo_key(tree, options.operators, static_cast<T>(memo->tolerance()));
+        if (auto entry = memo->find(key))
+            return {entry->score, entry->loss};
+    }
+
+    int size = complexity == -1 ? compute_complexity(tree, options) : complexity;
+    L loss_bound = std::isinf(score_bound)
+            ? score_bound
+            : score_to_loss_bound(score_bound, dataset.use_baseline, dataset.baseline_loss, size, options);
+    L result_loss = eval_loss(tree, dataset, options, loss_bound);
+    L score = loss_to_score(result_loss, dataset.use_baseline, dataset.baseline_loss, size, options);
+    // A loss above the bound may come from a partial evaluation
+    if (memo != nullptr && !(result_loss > loss_bound))
+        memo->insert(std::move(key), MemoEntry<L>{score, result_loss, size});
+    return {score, result_loss};
+}
+
+// The member's compiled program, or nullptr if it is missing or was compiled
+// from another tree or operator table, in which case the tree is walked
+// instead. Scoring never compiles, as the member may be scored on other
+// threads at the same time; see `compile_member`.
+template <typename T, typename L>
+const Program<T>* _member_program(const PopMember<T, L>& member, const Options& options) {
+    const Program<T>* program = member.program.get();
+    return program != nullptr && program->compiled_from(member.tree, options.operators) ? program : nullptr;
+}
+
+// Score a member with its compiled program, or reusing the outputs of its
+// subtrees when the dataset has a subtree cache
+template <typename T, typename L, typename... D>
+std::pair<L, L> score_func(const Dataset<T, L, D...>& dataset, const PopMember<T, L>& member, const Options& options,
+                           int complexity = -1) {
+    L result_loss = _use_subtree_cache(dataset, options)
+            ? _eval_loss_cached(member.tree, dataset, options)
+            : _eval_loss<T, L>(member.tree, _member_program(member, options), dataset.columns(),
+                               dataset.y.value().data(), dataset.weighted ? dataset.weights.value().data() : nullptr,
+                               options);
+    int size = complexity == -1 ? compute_complexity(member, options) : complexity;
+    L score = loss_to_score(result_loss, dataset.use_baseline, dataset.baseline_loss, size, options);
+    return {score, result_loss};
+}
+
+// Score an equation with a small batch; returns (score, loss)
+template <typename T, typename L, typename... D>
+std::pair<L, L> score_func_batch(const Dataset<T, L, D...>& dataset, const Expression<T>& tree, const Options& options,
+                                 int complexity = -1) {
+    L result_loss = batch_sample_loss(tree, dataset, options);
+    int size = complexity == -1 ? compute_complexity(tree, options) : complexity;
+    L score = loss_to_score(result_loss, dataset.use_baseline, dataset.baseline_loss, size, options);
+    return {score, result_loss};
+}
+
+template <typename T, typename L, typename... D>
+std::pair<L, L> score_func_batch(const Dataset<T, L, D...>& dataset, const PopMember<T, L>& member,
+                                 const Options& options, int complexity = -1) {
+    L result_loss = batch_sample_loss(member.tree, dataset, options, _member_program(member, options));
+    int size = complexity == -1 ? compute_complexity(member, options) : complexity;
+    L score = loss_to_score(result_loss, dataset.use_baseline, dataset.baseline_loss, size, options);
+    return {score, result_loss};
+}
+
+// Score an equation on a given batch of the dataset, e.g. the one its parent
+// was just scored on, so the two scores compare the same rows
+template <typename T, typename L, typename... D>
+std::pair<L, L> score_func_batch(const Dataset<T, L, D...>& dataset, const Batch<T>& batch,
+                                 const Expression<T>& tree, const Options& options, int complexity = -1) {
+    L result_loss = batch_loss<T, L>(tree, batch, options);
+    int size = complexity == -1 ? compute_complexity(tree, options) : complexity;
+    L score = loss_to_score(result_loss, dataset.use_baseline, dataset.baseline_loss, size, options);
+    return {score, result_loss};
+}
+
+template <typename T, typename L, typename... D>
+std::pair<L, L> score_func_batch(const Dataset<T, L, D...>& dataset, const Batch<T>& batch,
+                                 const PopMember<T, L>& member, const Options& options, int complexity = -1) {
+    L result_loss = batch_loss<T, L>(member.tree, batch, options, _member_program(member, options));
+    int size = complexity == -1 ? compute_complexity(member, options) : complexity;
+    L score = loss_to_score(result_loss, dataset.use_baseline, dataset.baseline_loss, size, options);
+    return {score, result_loss};
+}
+
+// Update the baseline loss of the dataset using the loss of predicting the mean
+template <typename T, typename L, typename... D>
+void update_baseline_loss(Dataset<T, L, D...>& dataset, const Options& options) {
+    std::vector<T> prediction(dataset.n, dataset.avg_y.value());
+    L loss;
+    if (dataset.weighted)
+        loss = static_cast<L>(_weighted_loss(prediction, dataset.y.value().data(), dataset.weights.value().data(),
+                                             options));
+    else
+        loss = static_cast<L>(_loss(prediction, dataset.y.value().data(), options));
+    dataset.baseline_loss = loss;
+    dataset.use_baseline = std::isfinite(loss);
+    if (dataset.fitness_memo)
+        dataset.fitness_memo->clear();
+}
+
+// Give the dataset a subtree cache of `options.subtree_cache_bytes`, or remove
+// it if the budget is zero. Constant optimization keeps evaluating through the
+// compiled program, so its many short-lived constant variants do not flush the cache.
+template <typename T, typename L, typename... D>
+void init_subtree_cache(Dataset<T, L, D...>& dataset, const Options& options) {
+    if (options.subtree_cache_bytes == 0)
+        dataset.subtree_cache = nullptr;
+    else
+        dataset.subtree_cache = std::make_shared<SubtreeCache<T>>(dataset.columns(), options.operators,
+                                                                  options.subtree_cache_bytes);
+}
+
+// Give the dataset a fitness memo of at most `options.fitness_memo_size`
+// entries, or remove it if the size is zero. Constants closer than about
+// `options.fitness_memo_tolerance` (relative) count as equal.
+template <typename T, typename L, typename... D>
+void init_fitness_memo(Dataset<T, L, D...>& dataset, const Options& options) {
+    if (options.fitness_memo_size == 0)
+        dataset.fitness_memo = nullptr;
+    else
+        dataset.fitness_memo = std::make_shared<FitnessMemo<L>>(options.operators, options.fitness_memo_size,
+                                                                options.fitness_memo_tolerance);
+}
+
+// Run `search` on the dataset in the precision selected by `options.precision`.
+// With 32 the features, targets and weights are converted to float, so the
+// evaluator streams half the bytes on twice the lanes, while every loss is
+// still summed in double. Both calls of `search` must return the same type.
+template <typename L, typename Search>
+auto with_precision(const Dataset<double, L, Matrix<double>>& dataset, const Options& options, Search search) {
+    if (options.precision == 32)
+        return search(to_precision<float>(dataset));
+    if (options.precision != 64)
+        throw std::invalid_argument("precision must be 32 or 64");
+    return search(dataset);
+}
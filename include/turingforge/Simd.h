@@ -0,0 +1,387 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Minimal portable vector packs used by the evaluator and the batched losses.
+// `simd::Pack<T>` maps onto the widest registers enabled at compile time
+// (AVX-512, AVX/AVX2, SSE2 or NEON); `simd::Scalar<T>` is the width-1 fallback
+// with the same interface and is also used for loop remainders.
+namespace simd {
+
+    template <typename T>
+    struct Scalar {
+        static constexpr std::size_t width = 1;
+        T v;
+
+        static Scalar load(const T* p) { return {*p}; }
+        static Scalar broadcast(T x) { return {x}; }
+        void store(T* p) const { *p = v; }
+
+        friend Scalar operator+(Scalar a, Scalar b) { return {a.v + b.v}; }
+        friend Scalar operator-(Scalar a, Scalar b) { return {a.v - b.v}; }
+        friend Scalar operator*(Scalar a, Scalar b) { return {a.v * b.v}; }
+        friend Scalar operator/(Scalar a, Scalar b) { return {a.v / b.v}; }
+        friend Scalar operator-(Scalar a) { return {-a.v}; }
+        friend Scalar abs(Scalar a) { return {std::abs(a.v)}; }
+        friend Scalar sqrt(Scalar a) { return {std::sqrt(a.v)}; }
+        friend Scalar min(Scalar a, Scalar b) { return {b.v < a.v ? b.v : a.v}; }
+        friend Scalar max(Scalar a, Scalar b) { return {a.v < b.v ? b.v : a.v}; }
+        // Comparisons return 1 or 0, matching `greater` and friends in Operators.h
+        friend Scalar greater(Scalar a, Scalar b) { return {static_cast<T>(a.v > b.v)}; }
+        friend Scalar logical_or(Scalar a, Scalar b) { return {static_cast<T>(a.v > T(0) || b.v > T(0))}; }
+        friend Scalar logical_and(Scalar a, Scalar b) { return {static_cast<T>(a.v > T(0) && b.v > T(0))}; }
+        // Lane-wise `c > 0 ? a : b`
+        friend Scalar select_positive(Scalar c, Scalar a, Scalar b) { return {c.v > T(0) ? a.v : b.v}; }
+        friend T reduce_add(Scalar a) { return a.v; }
+    };
+
+    template <typename T>
+    struct native {
+        using type = Scalar<T>;
+    };
+
+#if defined(__AVX512F__)
+    struct F64x8 {
+        static constexpr std::size_t width = 8;
+        __m512d v;
+
+        static F64x8 load(const double* p) { return {_mm512_loadu_pd(p)}; }
+        static F64x8 broadcast(double x) { return {_mm512_set1_pd(x)}; }
+        void store(double* p) const { _mm512_storeu_pd(p, v); }
+
+        friend F64x8 operator+(F64x8 a, F64x8 b) { return {_mm512_add_pd(a.v, b.v)}; }
+        friend F64x8 operator-(F64x8 a, F64x8 b) { return {_mm512_sub_pd(a.v, b.v)}; }
+        friend F64x8 operator*(F64x8 a, F64x8 b) { return {_mm512_mul_pd(a.v, b.v)}; }
+        friend F64x8 operator/(F64x8 a, F64x8 b) { return {_mm512_div_pd(a.v, b.v)}; }
+        friend F64x8 operator-(F64x8 a) { return {_mm512_sub_pd(_mm512_setzero_pd(), a.v)}; }
+        friend F64x8 abs(F64x8 a) { return {_mm512_abs_pd(a.v)}; }
+        friend F64x8 sqrt(F64x8 a) { return {_mm512_sqrt_pd(a.v)}; }
+        friend F64x8 min(F64x8 a, F64x8 b) { return {_mm512_min_pd(a.v, b.v)}; }
+        friend F64x8 max(F64x8 a, F64x8 b) { return {_mm512_max_pd(a.v, b.v)}; }
+        friend F64x8 greater(F64x8 a, F64x8 b) {
+            return {_mm512_maskz_mov_pd(_mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ), _mm512_set1_pd(1.0))};
+        }
+        friend F64x8 logical_or(F64x8 a, F64x8 b) {
+            __m512d zero = _mm512_setzero_pd();
+            __mmask8 m = _mm512_cmp_pd_mask(a.v, zero, _CMP_GT_OQ) | _mm512_cmp_pd_mask(b.v, zero, _CMP_GT_OQ);
+            return {_mm512_maskz_mov_pd(m, _mm512_set1_pd(1.0))};
+        }
+        friend F64x8 logical_and(F64x8 a, F64x8 b) {
+            __m512d zero = _mm512_setzero_pd();
+            __mmask8 m = _mm512_cmp_pd_mask(a.v, zero, _CMP_GT_OQ) & _mm512_cmp_pd_mask(b.v, zero, _CMP_GT_OQ);
+            return {_mm512_maskz_mov_pd(m, _mm512_set1_pd(1.0))};
+        }
+        friend F64x8 select_positive(F64x8 c, F64x8 a, F64x8 b) {
+            return {_mm512_mask_blend_pd(_mm512_cmp_pd_mask(c.v, _mm512_setzero_pd(), _CMP_GT_OQ), b.v, a.v)};
+        }
+        friend double reduce_add(F64x8 a) { return _mm512_reduce_add_pd(a.v); }
+    };
+
+    struct F32x16 {
+        static constexpr std::size_t width = 16;
+        __m512 v;
+
+        static F32x16 load(const float* p) { return {_mm512_loadu_ps(p)}; }
+        static F32x16 broadcast(float x) { return {_mm512_set1_ps(x)}; }
+        void store(float* p) const { _mm512_storeu_ps(p, v); }
+
+        friend F32x16 operator+(F32x16 a, F32x16 b) { return {_mm512_add_ps(a.v, b.v)}; }
+        friend F32x16 operator-(F32x16 a, F32x16 b) { return {_mm512_sub_ps(a.v, b.v)}; }
+        friend F32x16 operator*(F32x16 a, F32x16 b) { return {_mm512_mul_ps(a.v, b.v)}; }
+        friend F32x16 operator/(F32x16 a, F32x16 b) { return {_mm512_div_ps(a.v, b.v)}; }
+        friend F32x16 operator-(F32x16 a) { return {_mm512_sub_ps(_mm512_setzero_ps(), a.v)}; }
+        friend F32x16 abs(F32x16 a) { return {_mm512_abs_ps(a.v)}; }
+        friend F32x16 sqrt(F32x16 a) { return {_mm512_sqrt_ps(a.v)}; }
+        friend F32x16 min(F32x16 a, F32x16 b) { return {_mm512_min_ps(a.v, b.v)}; }
+        friend F32x16 max(F32x16 a, F32x16 b) { return {_mm512_max_ps(a.v, b.v)}; }
+        friend F32x16 greater(F32x16 a, F32x16 b) {
+            return {_mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ), _mm512_set1_ps(1.0f))};
+        }
+        friend F32x16 logical_or(F32x16 a, F32x16 b) {
+            __m512 zero = _mm512_setzero_ps();
+            __mmask16 m = _mm512_cmp_ps_mask(a.v, zero, _CMP_GT_OQ) | _mm512_cmp_ps_mask(b.v, zero, _CMP_GT_OQ);
+            return {_mm512_maskz_mov_ps(m, _mm512_set1_ps(1.0f))};
+        }
+        friend F32x16 logical_and(F32x16 a, F32x16 b) {
+            __m512 zero = _mm512_setzero_ps();
+            __mmask16 m = _mm512_cmp_ps_mask(a.v, zero, _CMP_GT_OQ) & _mm512_cmp_ps_mask(b.v, zero, _CMP_GT_OQ);
+            return {_mm512_maskz_mov_ps(m, _mm512_set1_ps(1.0f))};
+        }
+        friend F32x16 select_positive(F32x16 c, F32x16 a, F32x16 b) {
+            return {_mm512_mask_blend_ps(_mm512_cmp_ps_mask(c.v, _mm512_setzero_ps(), _CMP_GT_OQ), b.v, a.v)};
+        }
+        friend float reduce_add(F32x16 a) { return _mm512_reduce_add_ps(a.v); }
+    };
+
+    template <> struct native<double> { using type = F64x8; };
+    template <> struct native<float> { using type = F32x16; };
+
+#elif defined(__AVX__)
+    struct F64x4 {
+        static constexpr std::size_t width = 4;
+        __m256d v;
+
+        static F64x4 load(const double* p) { return {_mm256_loadu_pd(p)}; }
+        static F64x4 broadcast(double x) { return {_mm256_set1_pd(x)}; }
+        void store(double* p) const { _mm256_storeu_pd(p, v); }
+
+        friend F64x4 operator+(F64x4 a, F64x4 b) { return {_mm256_add_pd(a.v, b.v)}; }
+        friend F64x4 operator-(F64x4 a, F64x4 b) { return {_mm256_sub_pd(a.v, b.v)}; }
+        friend F64x4 operator*(F64x4 a, F64x4 b) { return {_mm256_mul_pd(a.v, b.v)}; }
+        friend F64x4 operator/(F64x4 a, F64x4 b) { return {_mm256_div_pd(a.v, b.v)}; }
+        friend F64x4 operator-(F64x4 a) { return {_mm256_xor_pd(a.v, _mm256_set1_pd(-0.0))}; }
+        friend F64x4 abs(F64x4 a) { return {_mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v)}; }
+        friend F64x4 sqrt(F64x4 a) { return {_mm256_sqrt_pd(a.v)}; }
+        friend F64x4 min(F64x4 a, F64x4 b) { return {_mm256_min_pd(a.v, b.v)}; }
+        friend F64x4 max(F64x4 a, F64x4 b) { return {_mm256_max_pd(a.v, b.v)}; }
+        friend F64x4 greater(F64x4 a, F64x4 b) {
+            return {_mm256_and_pd(_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ), _mm256_set1_pd(1.0))};
+        }
+        friend F64x4 logical_or(F64x4 a, F64x4 b) {
+            __m256d zero = _mm256_setzero_pd();
+            __m256d m = _mm256_or_pd(_mm256_cmp_pd(a.v, zero, _CMP_GT_OQ), _mm256_cmp_pd(b.v, zero, _CMP_GT_OQ));
+            return {_mm256_and_pd(m, _mm256_set1_pd(1.0))};
+        }
+        friend F64x4 logical_and(F64x4 a, F64x4 b) {
+            __m256d zero = _mm256_setzero_pd();
+            __m256d m = _mm256_and_pd(_mm256_cmp_pd(a.v, zero, _CMP_GT_OQ), _mm256_cmp_pd(b.v, zero, _CMP_GT_OQ));
+            return {_mm256_and_pd(m, _mm256_set1_pd(1.0))};
+        }
+        friend F64x4 select_positive(F64x4 c, F64x4 a, F64x4 b) {
+            return {_mm256_blendv_pd(b.v, a.v, _mm256_cmp_pd(c.v, _mm256_setzero_pd(), _CMP_GT_OQ))};
+        }
+        friend double reduce_add(F64x4 a) {
+            __m128d s = _mm_add_pd(_mm256_castpd256_pd128(a.v), _mm256_extractf128_pd(a.v, 1));
+            return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+        }
+    };
+
+    struct F32x8 {
+        static constexpr std::size_t width = 8;
+        __m256 v;
+
+        static F32x8 load(const float* p) { return {_mm256_loadu_ps(p)}; }
+        static F32x8 broadcast(float x) { return {_mm256_set1_ps(x)}; }
+        void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+        friend F32x8 operator+(F32x8 a, F32x8 b) { return {_mm256_add_ps(a.v, b.v)}; }
+        friend F32x8 operator-(F32x8 a, F32x8 b) { return {_mm256_sub_ps(a.v, b.v)}; }
+        friend F32x8 operator*(F32x8 a, F32x8 b) { return {_mm256_mul_ps(a.v, b.v)}; }
+        friend F32x8 operator/(F32x8 a, F32x8 b) { return {_mm256_div_ps(a.v, b.v)}; }
+        friend F32x8 operator-(F32x8 a) { return {_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))}; }
+        friend F32x8 abs(F32x8 a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+        friend F32x8 sqrt(F32x8 a) { return {_mm256_sqrt_ps(a.v)}; }
+        friend F32x8 min(F32x8 a, F32x8 b) { return {_mm256_min_ps(a.v, b.v)}; }
+        friend F32x8 max(F32x8 a, F32x8 b) { return {_mm256_max_ps(a.v, b.v)}; }
+        friend F32x8 greater(F32x8 a, F32x8 b) {
+            return {_mm256_and_ps(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ), _mm256_set1_ps(1.0f))};
+        }
+        friend F32x8 logical_or(F32x8 a, F32x8 b) {
+            __m256 zero = _mm256_setzero_ps();
+            __m256 m = _mm256_or_ps(_mm256_cmp_ps(a.v, zero, _CMP_GT_OQ), _mm256_cmp_ps(b.v, zero, _CMP_GT_OQ));
+            return {_mm256_and_ps(m, _mm256_set1_ps(1.0f))};
+        }
+        friend F32x8 logical_and(F32x8 a, F32x8 b) {
+            __m256 zero = _mm256_setzero_ps();
+            __m256 m = _mm256_and_ps(_mm256_cmp_ps(a.v, zero, _CMP_GT_OQ), _mm256_cmp_ps(b.v, zero, _CMP_GT_OQ));
+            return {_mm256_and_ps(m, _mm256_set1_ps(1.0f))};
+        }
+        friend F32x8 select_positive(F32x8 c, F32x8 a, F32x8 b) {
+            return {_mm256_blendv_ps(b.v, a.v, _mm256_cmp_ps(c.v, _mm256_setzero_ps(), _CMP_GT_OQ))};
+        }
+        friend float reduce_add(F32x8 a) {
+            __m128 s = _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+            s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+            return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+        }
+    };
+
+    template <> struct native<double> { using type = F64x4; };
+    template <> struct native<float> { using type = F32x8; };
+
+#elif defined(__SSE2__) || defined(_M_X64)
+    struct F64x2 {
+        static constexpr std::size_t width = 2;
+        __m128d v;
+
+        static F64x2 load(const double* p) { return {_mm_loadu_pd(p)}; }
+        static F64x2 broadcast(double x) { return {_mm_set1_pd(x)}; }
+        void store(double* p) const { _mm_storeu_pd(p, v); }
+
+        friend F64x2 operator+(F64x2 a, F64x2 b) { return {_mm_add_pd(a.v, b.v)}; }
+        friend F64x2 operator-(F64x2 a, F64x2 b) { return {_mm_sub_pd(a.v, b.v)}; }
+        friend F64x2 operator*(F64x2 a, F64x2 b) { return {_mm_mul_pd(a.v, b.v)}; }
+        friend F64x2 operator/(F64x2 a, F64x2 b) { return {_mm_div_pd(a.v, b.v)}; }
+        friend F64x2 operator-(F64x2 a) { return {_mm_xor_pd(a.v, _mm_set1_pd(-0.0))}; }
+        friend F64x2 abs(F64x2 a) { return {_mm_andnot_pd(_mm_set1_pd(-0.0), a.v)}; }
+        friend F64x2 sqrt(F64x2 a) { return {_mm_sqrt_pd(a.v)}; }
+        friend F64x2 min(F64x2 a, F64x2 b) { return {_mm_min_pd(a.v, b.v)}; }
+        friend F64x2 max(F64x2 a, F64x2 b) { return {_mm_max_pd(a.v, b.v)}; }
+        friend F64x2 greater(F64x2 a, F64x2 b) {
+            return {_mm_and_pd(_mm_cmpgt_pd(a.v, b.v), _mm_set1_pd(1.0))};
+        }
+        friend F64x2 logical_or(F64x2 a, F64x2 b) {
+            __m128d zero = _mm_setzero_pd();
+            return {_mm_and_pd(_mm_or_pd(_mm_cmpgt_pd(a.v, zero), _mm_cmpgt_pd(b.v, zero)), _mm_set1_pd(1.0))};
+        }
+        friend F64x2 logical_and(F64x2 a, F64x2 b) {
+            __m128d zero = _mm_setzero_pd();
+            return {_mm_and_pd(_mm_and_pd(_mm_cmpgt_pd(a.v, zero), _mm_cmpgt_pd(b.v, zero)), _mm_set1_pd(1.0))};
+        }
+        friend F64x2 select_positive(F64x2 c, F64x2 a, F64x2 b) {
+            __m128d m = _mm_cmpgt_pd(c.v, _mm_setzero_pd());
+            return {_mm_or_pd(_mm_and_pd(m, a.v), _mm_andnot_pd(m, b.v))};
+        }
+        friend double reduce_add(F64x2 a) { return _mm_cvtsd_f64(_mm_add_sd(a.v, _mm_unpackhi_pd(a.v, a.v))); }
+    };
+
+    struct F32x4 {
+        static constexpr std::size_t width = 4;
+        __m128 v;
+
+        static F32x4 load(const float* p) { return {_mm_loadu_ps(p)}; }
+        static F32x4 broadcast(float x) { return {_mm_set1_ps(x)}; }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+
+        friend F32x4 operator+(F32x4 a, F32x4 b) { return {_mm_add_ps(a.v, b.v)}; }
+        friend F32x4 operator-(F32x4 a, F32x4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+        friend F32x4 operator*(F32x4 a, F32x4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+        friend F32x4 operator/(F32x4 a, F32x4 b) { return {_mm_div_ps(a.v, b.v)}; }
+        friend F32x4 operator-(F32x4 a) { return {_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))}; }
+        friend F32x4 abs(F32x4 a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+        friend F32x4 sqrt(F32x4 a) { return {_mm_sqrt_ps(a.v)}; }
+        friend F32x4 min(F32x4 a, F32x4 b) { return {_mm_min_ps(a.v, b.v)}; }
+        friend F32x4 max(F32x4 a, F32x4 b) { return {_mm_max_ps(a.v, b.v)}; }
+        friend F32x4 greater(F32x4 a, F32x4 b) {
+            return {_mm_and_ps(_mm_cmpgt_ps(a.v, b.v), _mm_set1_ps(1.0f))};
+        }
+        friend F32x4 logical_or(F32x4 a, F32x4 b) {
+            __m128 zero = _mm_setzero_ps();
+            return {_mm_and_ps(_mm_or_ps(_mm_cmpgt_ps(a.v, zero), _mm_cmpgt_ps(b.v, zero)), _mm_set1_ps(1.0f))};
+        }
+        friend F32x4 logical_and(F32x4 a, F32x4 b) {
+            __m128 zero = _mm_setzero_ps();
+            return {_mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(a.v, zero), _mm_cmpgt_ps(b.v, zero)), _mm_set1_ps(1.0f))};
+        }
+        friend F32x4 select_positive(F32x4 c, F32x4 a, F32x4 b) {
+            __m128 m = _mm_cmpgt_ps(c.v, _mm_setzero_ps());
+            return {_mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v))};
+        }
+        friend float reduce_add(F32x4 a) {
+            __m128 s = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+            return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+        }
+    };
+
+    template <> struct native<double> { using type = F64x2; };
+    template <> struct native<float> { using type = F32x4; };
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    struct F64x2 {
+        static constexpr std::size_t width = 2;
+        float64x2_t v;
+
+        static F64x2 load(const double* p) { return {vld1q_f64(p)}; }
+        static F64x2 broadcast(double x) { return {vdupq_n_f64(x)}; }
+        void store(double* p) const { vst1q_f64(p, v); }
+
+        friend F64x2 operator+(F64x2 a, F64x2 b) { return {vaddq_f64(a.v, b.v)}; }
+        friend F64x2 operator-(F64x2 a, F64x2 b) { return {vsubq_f64(a.v, b.v)}; }
+        friend F64x2 operator*(F64x2 a, F64x2 b) { return {vmulq_f64(a.v, b.v)}; }
+        friend F64x2 operator/(F64x2 a, F64x2 b) { return {vdivq_f64(a.v, b.v)}; }
+        friend F64x2 operator-(F64x2 a) { return {vnegq_f64(a.v)}; }
+        friend F64x2 abs(F64x2 a) { return {vabsq_f64(a.v)}; }
+        friend F64x2 sqrt(F64x2 a) { return {vsqrtq_f64(a.v)}; }
+        friend F64x2 min(F64x2 a, F64x2 b) { return {vminq_f64(a.v, b.v)}; }
+        friend F64x2 max(F64x2 a, F64x2 b) { return {vmaxq_f64(a.v, b.v)}; }
+        friend F64x2 greater(F64x2 a, F64x2 b) {
+            return {vreinterpretq_f64_u64(vandq_u64(vcgtq_f64(a.v, b.v), vreinterpretq_u64_f64(vdupq_n_f64(1.0))))};
+        }
+        friend F64x2 logical_or(F64x2 a, F64x2 b) {
+            uint64x2_t m = vorrq_u64(vcgtzq_f64(a.v), vcgtzq_f64(b.v));
+            return {vreinterpretq_f64_u64(vandq_u64(m, vreinterpretq_u64_f64(vdupq_n_f64(1.0))))};
+        }
+        friend F64x2 logical_and(F64x2 a, F64x2 b) {
+            uint64x2_t m = vandq_u64(vcgtzq_f64(a.v), vcgtzq_f64(b.v));
+            return {vreinterpretq_f64_u64(vandq_u64(m, vreinterpretq_u64_f64(vdupq_n_f64(1.0))))};
+        }
+        friend F64x2 select_positive(F64x2 c, F64x2 a, F64x2 b) { return {vbslq_f64(vcgtzq_f64(c.v), a.v, b.v)}; }
+        friend double reduce_add(F64x2 a) { return vaddvq_f64(a.v); }
+    };
+
+    struct F32x4 {
+        static constexpr std::size_t width = 4;
+        float32x4_t v;
+
+        static F32x4 load(const float* p) { return {vld1q_f32(p)}; }
+        static F32x4 broadcast(float x) { return {vdupq_n_f32(x)}; }
+        void store(float* p) const { vst1q_f32(p, v); }
+
+        friend F32x4 operator+(F32x4 a, F32x4 b) { return {vaddq_f32(a.v, b.v)}; }
+        friend F32x4 operator-(F32x4 a, F32x4 b) { return {vsubq_f32(a.v, b.v)}; }
+        friend F32x4 operator*(F32x4 a, F32x4 b) { return {vmulq_f32(a.v, b.v)}; }
+        friend F32x4 operator/(F32x4 a, F32x4 b) { return {vdivq_f32(a.v, b.v)}; }
+        friend F32x4 operator-(F32x4 a) { return {vnegq_f32(a.v)}; }
+        friend F32x4 abs(F32x4 a) { return {vabsq_f32(a.v)}; }
+        friend F32x4 sqrt(F32x4 a) { return {vsqrtq_f32(a.v)}; }
+        friend F32x4 min(F32x4 a, F32x4 b) { return {vminq_f32(a.v, b.v)}; }
+        friend F32x4 max(F32x4 a, F32x4 b) { return {vmaxq_f32(a.v, b.v)}; }
+        friend F32x4 greater(F32x4 a, F32x4 b) {
+            return {vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(a.v, b.v), vreinterpretq_u32_f32(vdupq_n_f32(1.0f))))};
+        }
+        friend F32x4 logical_or(F32x4 a, F32x4 b) {
+            uint32x4_t m = vorrq_u32(vcgtzq_f32(a.v), vcgtzq_f32(b.v));
+            return {vreinterpretq_f32_u32(vandq_u32(m, vreinterpretq_u32_f32(vdupq_n_f32(1.0f))))};
+        }
+        friend F32x4 logical_and(F32x4 a, F32x4 b) {
+            uint32x4_t m = vandq_u32(vcgtzq_f32(a.v), vcgtzq_f32(b.v));
+            return {vreinterpretq_f32_u32(vandq_u32(m, vreinterpretq_u32_f32(vdupq_n_f32(1.0f))))};
+        }
+        friend F32x4 select_positive(F32x4 c, F32x4 a, F32x4 b) { return {vbslq_f32(vcgtzq_f32(c.v), a.v, b.v)}; }
+        friend float reduce_add(F32x4 a) { return vaddvq_f32(a.v); }
+    };
+
+    template <> struct native<double> { using type = F64x2; };
+    template <> struct native<float> { using type = F32x4; };
+#endif
+
+    template <typename T>
+    using Pack = typename native<T>::type;
+
+    // Name of the instruction set the packs were compiled for
+    constexpr const char* isa() {
+#if defined(__AVX512F__)
+        return "AVX-512";
+#elif defined(__AVX2__)
+        return "AVX2";
+#elif defined(__AVX__)
+        return "AVX";
+#elif defined(__SSE2__) || defined(_M_X64)
+        return "SSE2";
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        return "NEON";
+#else
+        return "scalar";
+#endif
+    }
+
+    // Apply `f` lane-wise over `[0, n)`: full packs first, then the scalar tail
+    template <typename T, typename F>
+    void map(F f, const T* a, T* out, std::size_t n) {
+        using P = Pack<T>;
+        std::size_t i = 0;
+        for (; i + P::width <= n; i += P::width)
+            f(P::load(a + i)).store(out + i);
+        for (; i < n; ++i)
+            f(Scalar<T>::load(a + i)).store(out + i);
+    }
+}
@@ -94,6 +94,7 @@ tuple<Population<T, L>, double> optimize_and_simplify_population(
             tree = simplify_tree(tree, options.operators);
             tree = combine_operators(tree, options.operators);
             pop.members[j].tree = tree;
+            compile_member(pop.members[j], options.operators);
         }
 
         if (options.should_optimize_constants && do_optimization[j]) {
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Aligned.h"
+#include "Dataset.h"
+#include "Evaluate.h"
+#include "Expression.h"
+#include "ExpressionHash.h"
+#include "OperatorEnum.h"
+
+// Counters of a subtree cache, for sizing its memory budget
+struct SubtreeCacheStats {
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t insertions = 0;
+    std::size_t evictions = 0;
+    std::size_t collisions = 0;  // lookups whose hash matched another subtree
+    std::size_t bytes_used = 0;
+    std::size_t bytes_saved = 0;  // bytes of subtree outputs read from the cache by complete evaluations
+
+    [[nodiscard]] double hit_rate() const {
+        std::size_t lookups = hits + misses;
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+    }
+};
+
+// Bounded cache from the structural hash of a subtree to its output column over
+// one dataset. Each entry keeps the canonical form of its subtree, see
+// `canonical_form`, and a lookup whose form differs is a miss, so a hash
+// collision cannot serve another subtree's column. Offspring differ from their
+// parent in one or two nodes, so most of their subtrees were already
+// evaluated; the cache is shared by every population scoring against the
+// dataset and evicts the least recently used column once `budget_bytes` is
+// exceeded. Most subtrees are never seen again, so a subtree is only admitted
+// the second time it is seen (see `admit`). All member functions are
+// thread-safe, and a column that was found stays valid after it is evicted.
+template <typename T>
+class SubtreeCache {
+public:
+    using Column = std::shared_ptr<const UninitializedVector<T>>;
+
+    // Number of hashes remembered by `admit`
+    static constexpr std::size_t SUBTREE_SIGHTINGS = 1 << 14;
+
+    SubtreeCache(const ColumnView<T>& X, const OperatorEnum& operators, std::size_t budget_bytes)
+            : data(X.data), n(X.n), operators(operators.signature()), budget_bytes(budget_bytes),
+              sightings(SUBTREE_SIGHTINGS) {}
+
+    // Whether outputs cached here are valid for these features and operators
+    [[nodiscard]] bool bound_to(const ColumnView<T>& X, const OperatorEnum& operators_) const {
+        return X.data == data && X.n == n && operators_.matches(operators);
+    }
+
+    // The cached column of the subtree with hash `key` and canonical `form`, or nullptr
+    Column find(std::uint64_t key, const std::vector<std::uint64_t>& form) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end() || it->second->form != form) {
+            counters.collisions += it != index.end();
+            ++counters.misses;
+            return nullptr;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        ++counters.hits;
+        return it->second->column;
+    }
+
+    // Whether the subtree with hash `key` should get a column: true if it was
+    // seen since its slot in the sightings table was last overwritten, and
+    // otherwise remember it for the next time
+    bool admit(std::uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::uint64_t& sighting = sightings[key % SUBTREE_SIGHTINGS];
+        if (sighting == key)
+            return true;
+        sighting = key;
+        return false;
+    }
+
+    // Count `columns` cached columns as read by a complete evaluation
+    void record_saved(std::size_t columns) {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.bytes_saved += columns * column_bytes();
+    }
+
+    // Rows of the columns cached here
+    [[nodiscard]] std::size_t rows() const {
+        return n;
+    }
+
+    // Number of columns the budget holds; zero if a single column exceeds it
+    [[nodiscard]] std::size_t capacity() const {
+        return column_bytes() == 0 ? 0 : budget_bytes / column_bytes();
+    }
+
+    void insert(std::uint64_t key, std::vector<std::uint64_t> form, Column column) {
+        if (column_bytes() > budget_bytes)
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index.count(key) != 0)
+            return;
+        while (counters.bytes_used + column_bytes() > budget_bytes) {
+            index.erase(entries.back().key);
+            entries.pop_back();
+            counters.bytes_used -= column_bytes();
+            ++counters.evictions;
+        }
+        entries.push_front(Entry{key, std::move(form), std::move(column)});
+        index.emplace(key, entries.begin());
+        counters.bytes_used += column_bytes();
+        ++counters.insertions;
+    }
+
+    [[nodiscard]] SubtreeCacheStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+        std::fill(sightings.begin(), sightings.end(), 0);
+        counters = SubtreeCacheStats{};
+    }
+
+private:
+    struct Entry {
+        std::uint64_t key;
+        std::vector<std::uint64_t> form;
+        Column column;
+    };
+
+    [[nodiscard]] std::size_t column_bytes() const {
+        return n * sizeof(T);
+    }
+
+    const T* data;
+    std::size_t n;
+    OperatorSignature operators;
+    std::size_t budget_bytes;
+
+    mutable std::mutex mutex;
+    std::list<Entry> entries;  // most recently used first
+    std::unordered_map<std::uint64_t, typename std::list<Entry>::iterator> index;
+    std::vector<std::uint64_t> sightings;  // direct-mapped by hash, latest hash per slot
+    SubtreeCacheStats counters;
+};
+
+// Which nodes of a tree are read from cached columns and which fill new
+// columns for the cache while the tree is evaluated; see `plan_subtrees`
+template <typename T>
+struct SubtreePlan {
+    std::vector<std::uint64_t> hashes;
+    std::vector<std::vector<std::uint64_t>> forms;  // canonical forms of the subtrees looked up
+    std::vector<bool> needed;  // nodes that are evaluated or read from `found`
+    std::vector<typename SubtreeCache<T>::Column> found;
+    std::vector<std::shared_ptr<UninitializedVector<T>>> computed;  // filled row by row, inserted once complete
+};
+
+// Look up the subtrees of the tree in `cache`. Parents precede their children
+// in reverse postfix order, so a subtree found in the cache is marked before
+// any of its nodes is visited, and its nodes are skipped. A column is only
+// allocated for the first copy of each remaining subtree with features that
+// the cache admits, and for no more of them than the cache can hold. Subtrees
+// without features are cheap scalars and are never cached.
+template <typename T>
+SubtreePlan<T> plan_subtrees(const Expression<T>& tree, const OperatorEnum& operators, SubtreeCache<T>& cache) {
+    const std::size_t root = tree.root();
+    SubtreePlan<T> plan;
+    plan.hashes = subtree_hashes(tree, operators);
+    plan.forms.resize(tree.nodes.size());
+    plan.needed.resize(tree.nodes.size());
+    plan.found.resize(tree.nodes.size());
+    plan.computed.resize(tree.nodes.size());
+
+    std::vector<bool> variable(tree.nodes.size());
+    for (std::size_t i = 0; i <= root; ++i) {
+        const ExprNode& node = tree.nodes[i];
+        variable[i] = node.kind == NodeKind::FEATURE ||
+                      (node.degree >= 1 && variable[i - 1]) ||
+                      (node.degree == 2 && variable[left_child(tree, i)]);
+    }
+
+    plan.needed[root] = true;
+    for (std::size_t i = root + 1; i-- > 0;) {
+        const ExprNode& node = tree.nodes[i];
+        if (!plan.needed[i] || node.degree == 0)
+            continue;
+        if (variable[i]) {
+            plan.forms[i] = canonical_form(tree, i, plan.hashes, operators);
+            if ((plan.found[i] = cache.find(plan.hashes[i], plan.forms[i])))
+                continue;
+        }
+        plan.needed[i - 1] = true;
+        if (node.degree == 2)
+            plan.needed[left_child(tree, i)] = true;
+    }
+
+    std::vector<std::uint64_t> considered;
+    std::size_t planned = 0;
+    for (std::size_t i = 0; i <= root && planned < cache.capacity(); ++i) {
+        if (!plan.needed[i] || plan.found[i] || tree.nodes[i].degree == 0 || !variable[i] ||
+            std::find(considered.begin(), considered.end(), plan.hashes[i]) != considered.end())
+            continue;
+        considered.push_back(plan.hashes[i]);
+        if (!cache.admit(plan.hashes[i]))
+            continue;
+        plan.computed[i] = std::make_shared<UninitializedVector<T>>(cache.rows());
+        ++planned;
+    }
+    return plan;
+}
+
+// Evaluate rows `[row, row + m)` of the tree like `eval_tile`, reading the
+// subtrees found in the cache from their columns and writing the ones the
+// plan computes into their new columns. Tiles of one plan may be evaluated
+// on several threads at once, as they write disjoint rows.
+template <typename T>
+Operand<T> eval_tile(const Expression<T>& tree, const SubtreePlan<T>& plan, const ColumnView<T>& X,
+                     const OperatorEnum& operators, std::size_t row, int m, TileWorkspace<T>& workspace) {
+    Operand<T>* stack = workspace.stack.data();
+    T* scratch = workspace.scratch.data();
+    const std::size_t root = tree.root();
+    int top = -1;
+    for (std::size_t i = 0; i <= root; ++i) {
+        if (!plan.needed[i])
+            continue;
+        const ExprNode& node = tree.nodes[i];
+        if (plan.found[i]) {
+            stack[++top] = Operand<T>{plan.found[i]->data() + row, T(0), false};
+            continue;
+        }
+        T* dst = plan.computed[i] ? plan.computed[i]->data() + row : nullptr;
+        switch (node.kind) {
+            case NodeKind::CONSTANT:
+                stack[++top] = Operand<T>{nullptr, tree.constants[node.index], true};
+                break;
+            case NodeKind::FEATURE:
+                stack[++top] = Operand<T>{X.column(node.index) + row, T(0), false};
+                break;
+            case NodeKind::UNARY:
+                _eval_unary(operators, node.index, stack[top], dst ? dst : scratch + top * EVAL_TILE_SIZE, m);
+                break;
+            case NodeKind::BINARY:
+                --top;
+                _eval_binary(operators, node.index, stack[top], stack[top + 1],
+                             dst ? dst : scratch + top * EVAL_TILE_SIZE, m);
+                break;
+        }
+    }
+    return stack[0];
+}
+
+// Add the columns computed under `plan` to the cache, and count the ones it
+// read as saved. Only call this once every row was evaluated, or the cache
+// would serve partial columns.
+template <typename T>
+void insert_subtrees(const SubtreePlan<T>& plan, SubtreeCache<T>& cache) {
+    std::size_t reused = 0;
+    for (std::size_t i = 0; i < plan.computed.size(); ++i) {
+        if (plan.computed[i])
+            cache.insert(plan.hashes[i], plan.forms[i], plan.computed[i]);
+        reused += plan.found[i] != nullptr;
+    }
+    cache.record_saved(reused);
+}
+
+// Evaluate the tree on every row of `X` into `out`, tile by tile, reusing the
+// outputs of subtrees found in `cache` and adding the ones it computes. Stops
+// at the first tile with a NaN or infinite output, like the tree evaluator,
+// and then returns false and adds nothing to the cache.
+template <typename T>
+bool eval_tree_array(const Expression<T>& tree, const ColumnView<T>& X, const OperatorEnum& operators,
+                     T* out, SubtreeCache<T>& cache) {
+    thread_local TileWorkspace<T> workspace;
+    workspace.reserve(tree);
+    const SubtreePlan<T> plan = plan_subtrees(tree, operators, cache);
+    for (std::size_t row = 0; row < X.n; row += EVAL_TILE_SIZE) {
+        int m = static_cast<int>(std::min<std::size_t>(EVAL_TILE_SIZE, X.n - row));
+        store_operand(eval_tile(tree, plan, X, operators, row, m, workspace), out + row, m);
+        if (!all_finite(out + row, static_cast<std::size_t>(m))) {
+            _record_nonfinite_abort(row, X.n);
+            return false;
+        }
+    }
+    insert_subtrees(plan, cache);
+    return true;
+}
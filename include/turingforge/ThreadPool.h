@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run the iterations of one loop at a time.
+// The calling thread works on the loop too, so a pool of size 1 has no
+// workers and runs everything inline. Which thread runs an iteration is
+// unspecified; callers that need reproducible results write each iteration's
+// result to its own slot and combine the slots in a fixed order.
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency()) {
+        threads = std::max<std::size_t>(threads, 1);
+        for (std::size_t i = 1; i < threads; ++i)
+            workers.emplace_back([this] { work(); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    // Number of threads working on a loop, including the caller
+    [[nodiscard]] std::size_t size() const {
+        return workers.size() + 1;
+    }
+
+    // Run `f(i)` for every `i` in `[0, n)` and return once all have finished.
+    // If the pool is already running a loop, e.g. when called from one of its
+    // own iterations or from another thread, the loop runs on the calling
+    // thread alone. The first exception thrown by an iteration is rethrown
+    // here after the others have finished.
+    template <typename F>
+    void parallel_for(std::size_t n, F&& f) {
+        std::unique_lock<std::mutex> submit(submitting, std::try_to_lock);
+        if (!submit.owns_lock() || workers.empty() || n <= 1) {
+            for (std::size_t i = 0; i < n; ++i)
+                f(i);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = std::ref(f);
+            job_size = n;
+            next.store(0, std::memory_order_relaxed);
+            active = workers.size();
+            error = nullptr;
+            ++generation;
+        }
+        wake.notify_all();
+        run_job();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return active == 0; });
+        job = nullptr;
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+private:
+    void run_job() {
+        for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < job_size;) {
+            try {
+                job(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+    }
+
+    void work() {
+        std::uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            run_job();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --active;
+            }
+            done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex submitting;  // held by the thread whose loop the pool is running
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void(std::size_t)> job;
+    std::size_t job_size = 0;
+    std::atomic<std::size_t> next{0};
+    std::size_t active = 0;
+    std::exception_ptr error;
+    std::uint64_t generation = 0;
+    bool stopping = false;
+};
+
+// Process-wide pool with `threads` threads, created on first use and shared
+// by every caller asking for the same size
+inline ThreadPool& shared_thread_pool(std::size_t threads) {
+    static std::mutex mutex;
+    static std::map<std::size_t, std::unique_ptr<ThreadPool>> pools;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<ThreadPool>& pool = pools[threads];
+    if (!pool)
+        pool = std::make_unique<ThreadPool>(threads);
+    return *pool;
+}
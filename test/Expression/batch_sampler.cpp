@@ -0,0 +1,89 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "turingforge/Expression.h"
+#include "options.h"
+#include "fixtures.h"
+#include "turingforge/BatchSampler.h"
+#include "turingforge/MutationFunctions.h"
+#include "turingforge/Scoring.h"
+
+TEST_CASE("Batches cover every row once per epoch", "[Batch]") {
+    const int n = 1000;
+    auto X = random_features(n, 5);
+    std::vector<double> y(n), w(n);
+    for (int row = 0; row < n; ++row) {
+        y[row] = row;
+        w[row] = 1 + row % 4;
+    }
+    Dataset<double, double, Matrix<double>> dataset(X, y, w);
+
+    BatchSampler<double> sampler(100, 7);
+    std::vector<int> seen(n, 0);
+    for (int i = 0; i < 10; ++i) {
+        const Batch<double>& batch = sampler.next(dataset);
+        REQUIRE(batch.size() == 100);
+        auto columns = batch.columns();
+        for (std::size_t k = 0; k < batch.size(); ++k) {
+            int row = batch.rows[k];
+            ++seen[row];
+            REQUIRE(columns.column(0)[k] == X(0, row));
+            REQUIRE(columns.column(1)[k] == X(1, row));
+            REQUIRE(batch.y[k] == y[row]);
+            REQUIRE(batch.weights[k] == w[row]);
+        }
+    }
+    REQUIRE(std::all_of(seen.begin(), seen.end(), [](int count) { return count == 1; }));
+
+    // A batch that straddles two epochs, and one larger than the dataset
+    BatchSampler<double> straddling(300, 7);
+    for (int i = 0; i < 4; ++i)
+        REQUIRE(straddling.next(dataset).size() == 300);
+    BatchSampler<double> large(2500, 7);
+    std::fill(seen.begin(), seen.end(), 0);
+    for (int row : large.next(dataset).rows)
+        ++seen[row];
+    REQUIRE(std::all_of(seen.begin(), seen.end(), [](int count) { return count >= 2 && count <= 3; }));
+}
+
+TEST_CASE("Scores on a shared batch compare the same rows", "[Batch][Scoring]") {
+    std::srand(8);
+    Options options;
+    const int n = 2000;
+    auto X = random_features(n, 9);
+    std::vector<double> y(n), w(n);
+    for (int row = 0; row < n; ++row) {
+        y[row] = X(0, row) * X(1, row);
+        w[row] = 0.5 + (row % 3) / 3.0;
+    }
+    Dataset<double, double, Matrix<double>> dataset(X, y, w);
+    BatchSampler<double> sampler(options.batch_size, 3);
+    const Batch<double>& batch = sampler.next(dataset);
+
+    // The batch loss is the loss over the dataset restricted to the batch rows
+    Matrix<double> rows(2, options.batch_size);
+    std::vector<double> batch_y, batch_w;
+    for (int k = 0; k < options.batch_size; ++k) {
+        rows(0, k) = X(0, batch.rows[k]);
+        rows(1, k) = X(1, batch.rows[k]);
+        batch_y.push_back(y[batch.rows[k]]);
+        batch_w.push_back(w[batch.rows[k]]);
+    }
+    Dataset<double, double, Matrix<double>> subset(rows, batch_y, batch_w);
+    for (int i = 0; i < 50; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(1 + i % 12, options, 2);
+        auto [score, loss] = score_func_batch(dataset, batch, tree, options);
+        double expected = eval_loss(tree, subset, options);
+        if (std::isinf(expected)) {
+            REQUIRE(std::isinf(loss));
+            continue;
+        }
+        REQUIRE(loss == expected);
+        // The same batch scores the same tree the same way every time
+        REQUIRE(score_func_batch(dataset, batch, tree, options).first == score);
+    }
+}
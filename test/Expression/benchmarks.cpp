@@ -0,0 +1,332 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "turingforge/Bytecode.h"
+#include "turingforge/CsvLoader.h"
+#include "turingforge/DatasetFile.h"
+#include "turingforge/Evaluate.h"
+#include "turingforge/Expression.h"
+#include "turingforge/OperatorEnum.h"
+#include "options.h"
+#include "fixtures.h"
+#include "turingforge/Gradient.h"
+#include "turingforge/MutationFunctions.h"
+#include "turingforge/Scoring.h"
+#include "turingforge/SubtreeCache.h"
+
+// Rows per evaluation; divide by the reported mean time for the row throughput
+constexpr int BENCHMARK_ROWS = 1 << 20;
+
+Matrix<double> benchmark_features() {
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<double> dist(0.1, 3.0);
+    Matrix<double> X(2, BENCHMARK_ROWS);
+    for (double& v : X.values)
+        v = dist(gen);
+    return X;
+}
+
+TEST_CASE("Per-operator evaluation throughput", "[!benchmark][Evaluate]") {
+    const std::vector<BinaryOperator> binary_operators = {
+            BinaryOperator::PLUS, BinaryOperator::SUB, BinaryOperator::MULT, BinaryOperator::DIV,
+            BinaryOperator::POW, BinaryOperator::GREATER, BinaryOperator::LOGICAL_OR, BinaryOperator::LOGICAL_AND
+    };
+    const std::vector<UnaryOperator> unary_operators = {
+            UnaryOperator::NEG, UnaryOperator::SQUARE, UnaryOperator::CUBE, UnaryOperator::ABS,
+            UnaryOperator::SQRT, UnaryOperator::RELU, UnaryOperator::EXP, UnaryOperator::LOG,
+            UnaryOperator::LOG2, UnaryOperator::LOG10, UnaryOperator::LOG1P, UnaryOperator::SIN,
+            UnaryOperator::COS, UnaryOperator::TANH, UnaryOperator::ACOSH, UnaryOperator::ATANH_CLIP,
+            UnaryOperator::GAMMA
+    };
+    auto operators = make_operator_enum(binary_operators, unary_operators);
+    auto X = benchmark_features();
+    ColumnView<double> columns{X.data(), X.stride, BENCHMARK_ROWS, 2};
+    std::vector<double> out(BENCHMARK_ROWS);
+    TileWorkspace<double> workspace;
+    const std::string rows = " x " + std::to_string(BENCHMARK_ROWS) + " rows";
+
+    for (std::size_t op = 0; op < binary_operators.size(); ++op) {
+        auto tree = make_binary(op, make_feature<double>(0), make_feature<double>(1));
+        BENCHMARK(to_string(binary_operators[op]) + rows) {
+            return eval_tree_array(tree, columns, operators, out.data(), workspace);
+        };
+    }
+
+    for (std::size_t op = 0; op < unary_operators.size(); ++op) {
+        auto tree = make_unary(op, make_feature<double>(0));
+        BENCHMARK(to_string(unary_operators[op]) + rows) {
+            return eval_tree_array(tree, columns, operators, out.data(), workspace);
+        };
+    }
+
+    // The same tree dispatched through the std::function table instead of the kernels
+    OperatorEnum generic;
+    generic.binops = operators.binops;
+    generic.unaops = operators.unaops;
+    auto tree = make_binary(2, make_feature<double>(0), make_binary(0, make_unary(12, make_feature<double>(1)), make_constant(2.0)));
+    BENCHMARK("x1 * (cos(x2) + 2.0) vectorized" + rows) {
+        return eval_tree_array(tree, columns, operators, out.data(), workspace);
+    };
+    BENCHMARK("x1 * (cos(x2) + 2.0) through std::function" + rows) {
+        return eval_tree_array(tree, columns, generic, out.data(), workspace);
+    };
+}
+
+TEST_CASE("Fused and two-pass loss", "[!benchmark][Scoring]") {
+    Options fused;
+    fused.operators = make_operator_enum({BinaryOperator::PLUS, BinaryOperator::MULT}, {UnaryOperator::COS});
+    Options two_pass = fused;
+    two_pass.fused_scoring = false;
+
+    auto X = benchmark_features();
+    std::vector<double> y(X.values.begin(), X.values.begin() + BENCHMARK_ROWS);
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    auto tree = make_binary(1, make_feature<double>(0), make_binary(0, make_unary(0, make_feature<double>(1)), make_constant(2.0)));
+    const std::string rows = " x " + std::to_string(BENCHMARK_ROWS) + " rows";
+
+    BENCHMARK("two-pass eval_loss" + rows) {
+        return eval_loss(tree, dataset, two_pass);
+    };
+    BENCHMARK("fused eval_loss" + rows) {
+        return eval_loss(tree, dataset, fused);
+    };
+}
+
+TEST_CASE("Bytecode against tree walking by tree size", "[!benchmark][Bytecode]") {
+    // Small row counts, as in constant optimization, where dispatch costs show
+    constexpr std::size_t rows = 1024;
+    std::srand(0);
+    Options options;
+    options.operators = make_operator_enum({BinaryOperator::PLUS, BinaryOperator::SUB, BinaryOperator::MULT},
+                                           {UnaryOperator::COS, UnaryOperator::SQUARE});
+    auto X = benchmark_features();
+    ColumnView<double> columns{X.data(), X.stride, rows, 2};
+    std::vector<double> out(rows);
+    TileWorkspace<double> tree_workspace;
+    ProgramWorkspace<double> program_workspace;
+
+    for (int size = 5; size <= 50; size += 5) {
+        auto tree = gen_random_tree_fixed_size<double>(size, options, 2);
+        auto program = compile(tree, options.operators);
+        const std::string name = "size " + std::to_string(count_nodes(tree)) + " x " + std::to_string(rows) + " rows";
+        BENCHMARK("tree walk, " + name) {
+            return eval_tree_array(tree, columns, options.operators, out.data(), tree_workspace);
+        };
+        BENCHMARK("bytecode, " + name) {
+            return eval_program_array(program, tree.constants, columns, options.operators, out.data(), program_workspace);
+        };
+    }
+}
+
+TEST_CASE("Subtree cache on offspring of one parent", "[!benchmark][SubtreeCache]") {
+    constexpr std::size_t rows = 1 << 16;
+    std::srand(1);
+    Options options;
+    auto X = benchmark_features();
+    ColumnView<double> columns{X.data(), X.stride, rows, 2};
+    std::vector<double> out(rows);
+    TileWorkspace<double> workspace;
+
+    // Offspring that differ from the parent by one constant or one operator
+    auto parent = gen_random_tree_fixed_size<double>(30, options, 2);
+    std::vector<Expression<double>> offspring;
+    for (int i = 0; i < 64; ++i) {
+        auto child = parent;
+        if (i % 2 == 0 && has_constants(child))
+            mutate_constant(child, 1.0, options);
+        else
+            mutate_operator(child, options);
+        offspring.push_back(child);
+    }
+
+    BENCHMARK("parent and 64 offspring, uncached, 65536 rows") {
+        bool complete = eval_tree_array(parent, columns, options.operators, out.data(), workspace);
+        for (const auto& child : offspring)
+            complete &= eval_tree_array(child, columns, options.operators, out.data(), workspace);
+        return complete;
+    };
+    SubtreeCache<double> cache(columns, options.operators, std::size_t(256) << 20);
+    // Start each run from an empty cache, so only the parent's subtrees are reused
+    BENCHMARK("parent and 64 offspring, cached, 65536 rows") {
+        cache.clear();
+        bool complete = eval_tree_array(parent, columns, options.operators, out.data(), cache);
+        for (const auto& child : offspring)
+            complete &= eval_tree_array(child, columns, options.operators, out.data(), cache);
+        return complete;
+    };
+    auto stats = cache.stats();
+    WARN("hit rate " << stats.hit_rate() << ", " << stats.bytes_saved / (1 << 20) << " MiB saved, "
+                     << stats.bytes_used / (1 << 20) << " MiB used");
+}
+
+TEST_CASE("Forward and reverse mode loss gradient by constant count", "[!benchmark][Gradient]") {
+    constexpr int rows = 1 << 14;
+    Options options;
+    auto features = benchmark_features();
+    Matrix<double> X(2, rows);
+    for (int row = 0; row < rows; ++row) {
+        X(0, row) = features(0, row);
+        X(1, row) = features(1, row);
+    }
+    std::vector<double> y(&features(1, BENCHMARK_ROWS - rows), &features(1, BENCHMARK_ROWS - 1) + 1);
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    const double* unweighted = nullptr;
+    DualWorkspace<double> forward;
+    ReverseWorkspace<double> reverse;
+
+    // c1 * x1 + c2 * cos(c3 * x2) + c4 * cos(c5 * x2) + ...
+    for (int nconstants : {1, 3, 5, 9, 17, 33}) {
+        auto tree = make_binary(0, make_constant(0.5), make_feature<double>(0));
+        for (int i = 1; i < nconstants; i += 2) {
+            auto term = make_binary(0, make_constant(0.1 * i),
+                                    make_unary(0, make_binary(0, make_constant(0.2 * i), make_feature<double>(1))));
+            tree = make_binary(1, tree, term);
+        }
+        std::vector<double> gradient(tree.constants.size());
+        const std::string name = std::to_string(tree.constants.size()) + " constants x " + std::to_string(rows) + " rows";
+        BENCHMARK("loss only, " + name) {
+            return eval_loss(tree, dataset, options);
+        };
+        BENCHMARK("forward mode, " + name) {
+            return eval_loss_gradient_tiled(tree, dataset.columns(), options.operators, y.data(), unweighted,
+                                            options.elementwise_loss, gradient.data(), forward);
+        };
+        BENCHMARK("reverse mode, " + name) {
+            return eval_loss_gradient_tiled(tree, dataset.columns(), options.operators, y.data(), unweighted,
+                                            options.elementwise_loss, gradient.data(), reverse);
+        };
+    }
+}
+
+TEST_CASE("Single and double precision loss", "[!benchmark][Precision]") {
+    Options options;
+    auto features = benchmark_features();
+    Dataset<double, double, Matrix<double>> dataset(features, std::vector<double>(BENCHMARK_ROWS));
+    const std::string rows = " x " + std::to_string(BENCHMARK_ROWS) + " rows";
+
+    // Accuracy of single precision losses on the reference problems, over random trees
+    std::srand(2);
+    auto X = random_features(1 << 14, 3);
+    for (const ReferenceProblem& problem : reference_problems()) {
+        Dataset<double, double, Matrix<double>> reference(X, reference_targets(problem, X));
+        auto single = to_precision<float>(reference);
+        std::vector<double> errors;
+        for (int i = 0; i < 500; ++i) {
+            auto tree = gen_random_tree_fixed_size<double>(5 + i % 20, options, 2);
+            double expected = eval_loss(tree, reference, options);
+            double actual = eval_loss(to_precision<float>(tree), single, options);
+            if (std::isfinite(expected) && std::isfinite(actual))
+                errors.push_back(std::abs(actual - expected) / std::max(1e-12, expected));
+        }
+        std::sort(errors.begin(), errors.end());
+        WARN(problem.name << ": relative error of float32 losses over " << errors.size() << " trees, median "
+                          << errors[errors.size() / 2] << ", 99th percentile " << errors[errors.size() * 99 / 100]
+                          << ", max " << errors.back());
+    }
+
+    for (auto& v : dataset.y.value())
+        v = 1.0;
+    auto single = to_precision<float>(dataset);
+    auto polynomial = make_binary(1, make_binary(0, make_binary(0, make_feature<double>(0), make_feature<double>(0)),
+                                                 make_feature<double>(1)), make_constant(0.5));
+    auto trigonometric = make_binary(0, make_feature<double>(0),
+                                     make_binary(1, make_unary(0, make_feature<double>(1)), make_constant(2.0)));
+    BENCHMARK("x1 * x1 * x2 + 0.5, float64" + rows) {
+        return eval_loss(polynomial, dataset, options);
+    };
+    BENCHMARK("x1 * x1 * x2 + 0.5, float32" + rows) {
+        return eval_loss(to_precision<float>(polynomial), single, options);
+    };
+    BENCHMARK("x1 * (cos(x2) + 2.0), float64" + rows) {
+        return eval_loss(trigonometric, dataset, options);
+    };
+    BENCHMARK("x1 * (cos(x2) + 2.0), float32" + rows) {
+        return eval_loss(to_precision<float>(trigonometric), single, options);
+    };
+}
+
+TEST_CASE("Dataset startup from a file", "[!benchmark][Dataset]") {
+    // Each iteration maps the file anew, as a search process starting up does;
+    // its pages come from the page cache
+    Options options;
+    constexpr int nfeatures = 8;
+    auto features = benchmark_features();
+    Matrix<double> X(nfeatures, BENCHMARK_ROWS);
+    for (int feature = 0; feature < nfeatures; ++feature)
+        for (int row = 0; row < BENCHMARK_ROWS; ++row)
+            X(feature, row) = features(feature % 2, row) + feature;
+    Dataset<double, double, Matrix<double>> dataset(X, std::vector<double>(BENCHMARK_ROWS, 1.0));
+    const std::string path = (std::filesystem::temp_directory_path() / "turingforge_benchmark.tfd").string();
+    write_dataset_file(dataset, path);
+    const std::string rows = ", " + std::to_string(nfeatures) + " features x " + std::to_string(BENCHMARK_ROWS) + " rows";
+
+    auto tree = make_binary(1, make_binary(0, make_feature<double>(0), make_feature<double>(7)), make_feature<double>(3));
+    BENCHMARK("map" + rows) {
+        return map_dataset<double, double>(path).n;
+    };
+    BENCHMARK("map and score" + rows) {
+        auto mapped = map_dataset<double, double>(path);
+        return eval_loss(tree, mapped, options);
+    };
+    BENCHMARK("copy into memory and score" + rows) {
+        auto copied = to_precision<double>(map_dataset<double, double>(path));
+        return eval_loss(tree, copied, options);
+    };
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("CSV loading", "[!benchmark][Dataset]") {
+    constexpr int nfeatures = 8;
+    constexpr int rows = 1 << 18;
+    auto features = benchmark_features();
+    TemporaryFile file("turingforge_benchmark.csv");
+    {
+        std::ofstream out(file.path);
+        out.precision(17);
+        for (int feature = 0; feature < nfeatures; ++feature)
+            out << "x" << feature + 1 << ",";
+        out << "y\n";
+        for (int row = 0; row < rows; ++row) {
+            for (int feature = 0; feature <= nfeatures; ++feature)
+                out << features(feature % 2, row) + feature << (feature < nfeatures ? "," : "\n");
+        }
+    }
+    const std::string name = ", " + std::to_string(std::filesystem::file_size(file.path) >> 20) + " MiB, "
+                             + std::to_string(nfeatures) + " features x " + std::to_string(rows) + " rows";
+
+    // Row by row through a stream, then transposed
+    BENCHMARK("istream" + name) {
+        std::ifstream in(file.path);
+        std::string header;
+        std::getline(in, header);
+        std::vector<double> values;
+        std::vector<double> y;
+        double value;
+        char comma;
+        while (in >> value) {
+            for (int feature = 0; feature < nfeatures; ++feature) {
+                values.push_back(value);
+                in >> comma >> value;
+            }
+            y.push_back(value);
+        }
+        Dataset<double, double, Matrix<double>> dataset(Matrix<double>(std::span<const double>(values), nfeatures), y);
+        return dataset.n;
+    };
+    BENCHMARK("load_csv, serial" + name) {
+        return load_csv<double, double>(file.path.string()).n;
+    };
+    ThreadPool pool;
+    BENCHMARK("load_csv, " + std::to_string(pool.size()) + " threads" + name) {
+        return load_csv<double, double>(file.path.string(), CsvOptions(), &pool).n;
+    };
+}
@@ -0,0 +1,124 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "turingforge/Expression.h"
+#include "options.h"
+#include "fixtures.h"
+#include "turingforge/Bytecode.h"
+#include "turingforge/MutationFunctions.h"
+#include "turingforge/Scoring.h"
+
+bool matches_tree(const Program<double>& program, const Expression<double>& tree, const Matrix<double>& X,
+                  const OperatorEnum& operators) {
+    auto [expected, expected_completion] = eval_tree_array(tree, view(X), operators);
+    auto [actual, actual_completion] = eval_program_array(program, tree.constants, view(X), operators);
+    for (std::size_t row = 0; row < expected.size(); ++row) {
+        if (!same(actual[row], expected[row]))
+            return false;
+    }
+    return actual_completion == expected_completion;
+}
+
+TEST_CASE("Compiled programs match the tree evaluator", "[Bytecode]") {
+    std::srand(4);
+    Options options;
+    for (int n : {1, 256, 700}) {
+        auto X = random_features(n, n);
+        for (int i = 0; i < 300; ++i) {
+            auto tree = gen_random_tree_fixed_size<double>(1 + i % 40, options, 2);
+            auto program = compile(tree, options.operators);
+            REQUIRE(program.nregisters <= count_max_stack(tree));
+            REQUIRE(matches_tree(program, tree, X, options.operators));
+        }
+    }
+}
+
+TEST_CASE("Constant-only subtrees are hoisted out of the tile loop", "[Bytecode]") {
+    Options options;
+    // x1 * (2.0 + cos(3.0))
+    auto tree = make_binary(0, make_feature<double>(0),
+                            make_binary(1, make_constant(2.0), make_unary(0, make_constant(3.0))));
+    auto program = compile(tree, options.operators);
+    REQUIRE(program.scalar_code.size() == 2);
+    REQUIRE(program.tile_code.size() == 1);
+    REQUIRE(program.nregisters == 1);
+
+    auto X = random_features(300);
+    REQUIRE(matches_tree(program, tree, X, options.operators));
+    tree.constants = {-1.0, 0.5};
+    REQUIRE(program.compiled_from(tree, options.operators));
+    REQUIRE(matches_tree(program, tree, X, options.operators));
+}
+
+TEST_CASE("Cached programs survive constant changes only", "[Bytecode]") {
+    std::srand(5);
+    Options options;
+    auto tree = gen_random_tree_fixed_size<double>(15, options, 2);
+    std::shared_ptr<const Program<double>> cache;
+    const Program<double>* first = &cached_program(cache, tree, options.operators);
+    REQUIRE(&cached_program(cache, tree, options.operators) == first);
+
+    for (double& c : tree.constants)
+        c *= 2.0;
+    REQUIRE(&cached_program(cache, tree, options.operators) == first);
+
+    prepend_random_op(tree, options, 2);
+    const Program<double>& recompiled = cached_program(cache, tree, options.operators);
+    REQUIRE(&recompiled != first);
+    REQUIRE(recompiled.compiled_from(tree, options.operators));
+}
+
+TEST_CASE("Programs are bound to the contents of the operator table", "[Bytecode]") {
+    std::srand(7);
+    Options options;
+    auto tree = gen_random_tree_fixed_size<double>(9, options, 2);
+    auto program = compile(tree, options.operators);
+
+    // Copies of the options, and tables of the same builtin operators, share the program
+    Options copy = options;
+    REQUIRE(program.compiled_from(tree, copy.operators));
+    REQUIRE(program.compiled_from(tree, make_operator_enum({BinaryOperator::MULT, BinaryOperator::PLUS,
+                                                            BinaryOperator::SUB},
+                                                           {UnaryOperator::COS, UnaryOperator::EXP})));
+    REQUIRE_FALSE(program.compiled_from(tree, make_operator_enum({BinaryOperator::PLUS, BinaryOperator::MULT,
+                                                                  BinaryOperator::SUB},
+                                                                 {UnaryOperator::COS, UnaryOperator::EXP})));
+
+    // A custom function only matches the table it was added to and its copies
+    OperatorEnum custom = options.operators;
+    custom.generation = _next_operator_generation();
+    custom.binops.push_back([](double x, double y) { return x - 2 * y; });
+    auto custom_program = compile(tree, custom);
+    OperatorEnum custom_copy = custom;
+    REQUIRE(custom_program.compiled_from(tree, custom_copy));
+    OperatorEnum other = options.operators;
+    other.generation = _next_operator_generation();
+    other.binops.push_back([](double x, double y) { return x + 2 * y; });
+    REQUIRE_FALSE(custom_program.compiled_from(tree, other));
+}
+
+TEST_CASE("Scoring with a program matches scoring the tree", "[Bytecode][Scoring]") {
+    std::srand(6);
+    Options fused;
+    Options two_pass;
+    two_pass.fused_scoring = false;
+    auto X = random_features(900, 1);
+    std::vector<double> y(900);
+    for (int row = 0; row < 900; ++row)
+        y[row] = X(0, row) - std::exp(X(1, row));
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+
+    for (int i = 0; i < 100; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(1 + i % 30, fused, 2);
+        auto program = compile(tree, fused.operators);
+        for (const Options* options : {&fused, &two_pass}) {
+            double expected = eval_loss(tree, dataset, *options);
+            double actual = eval_loss(program, tree, dataset, *options);
+            REQUIRE((actual == expected || (std::isinf(actual) && std::isinf(expected))));
+        }
+    }
+}
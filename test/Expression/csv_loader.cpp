@@ -0,0 +1,96 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "fixtures.h"
+#include "turingforge/CsvLoader.h"
+#include "turingforge/ThreadPool.h"
+
+void write_text(const TemporaryFile& file, const std::string& text) {
+    std::ofstream(file.path, std::ios::binary | std::ios::trunc) << text;
+}
+
+TEST_CASE("CSV files load into dataset columns", "[Dataset]") {
+    TemporaryFile file("turingforge_loader.csv");
+    // CRLF line ends, padded fields, blank lines and no final newline
+    write_text(file, "a, \"w\" ,b,y\r\n1,2,3,4\r\n\r\n-1.5 ,0.25,1e3, -2\r\n\n5,1,nan,6");
+    CsvOptions options;
+    options.weights = "w";
+    auto dataset = load_csv<double, double>(file.path.string(), options);
+    REQUIRE(dataset.n == 3);
+    REQUIRE(dataset.nfeatures == 2);
+    REQUIRE(dataset.varMap == std::vector<std::string>{"a", "b"});
+    REQUIRE(dataset.weighted);
+    REQUIRE(dataset.X(0, 1) == -1.5);
+    REQUIRE(dataset.X(1, 1) == 1000);
+    REQUIRE(std::isnan(dataset.X(1, 2)));
+    REQUIRE(dataset.y.value()[1] == -2);
+    REQUIRE(dataset.weights.value()[2] == 1);
+    REQUIRE(dataset.avg_y.value() == (4 * 2 - 2 * 0.25 + 6 * 1) / 3.25);
+
+    options.target = "a";
+    options.weights.reset();
+    auto by_name = load_csv<float, float>(file.path.string(), options);
+    REQUIRE(by_name.varMap == std::vector<std::string>{"w", "b", "y"});
+    REQUIRE_FALSE(by_name.weighted);
+    REQUIRE(by_name.y.value()[1] == -1.5f);
+    REQUIRE(by_name.X(2, 2) == 6.0f);
+}
+
+TEST_CASE("CSV loading does not depend on the chunks or threads", "[Dataset]") {
+    std::mt19937 gen(4);
+    std::uniform_real_distribution<double> dist(-100, 100);
+    std::ostringstream text;
+    text.precision(17);
+    text << "x1,x2,x3,y\n";
+    const int n = 5000;
+    for (int row = 0; row < n; ++row) {
+        text << dist(gen) << "," << dist(gen) << "," << dist(gen) << "," << dist(gen) << "\n";
+        if (row % 97 == 0)
+            text << "\n";
+    }
+    TemporaryFile file("turingforge_chunks.csv");
+    write_text(file, text.str());
+
+    auto expected = load_csv<double, double>(file.path.string());
+    REQUIRE(expected.n == n);
+    ThreadPool pool(4);
+    for (std::size_t chunk_bytes : {1, 7, 64, 1000, 1 << 20}) {
+        CsvOptions options;
+        options.chunk_bytes = chunk_bytes;
+        for (ThreadPool* threads : {static_cast<ThreadPool*>(nullptr), &pool}) {
+            auto dataset = load_csv<double, double>(file.path.string(), options, threads);
+            REQUIRE(dataset.n == n);
+            for (int feature = 0; feature < 3; ++feature)
+                for (int row = 0; row < n; ++row)
+                    REQUIRE(dataset.X(feature, row) == expected.X(feature, row));
+            REQUIRE(dataset.y.value() == expected.y.value());
+        }
+    }
+}
+
+TEST_CASE("Malformed CSV files are rejected", "[Dataset]") {
+    TemporaryFile file("turingforge_malformed.csv");
+    ThreadPool pool(2);
+    CsvOptions options;
+    options.chunk_bytes = 8;
+    auto rejects = [&](const std::string& text) {
+        write_text(file, text);
+        REQUIRE_THROWS_AS((load_csv<double, double>(file.path.string(), options)), std::invalid_argument);
+        REQUIRE_THROWS_AS((load_csv<double, double>(file.path.string(), options, &pool)), std::invalid_argument);
+    };
+    rejects("");
+    rejects("y\n1\n");
+    rejects("a,y\n1,2\n3\n");
+    rejects("a,y\n1,2\n3,4,5\n");
+    rejects("a,y\n1,2\n3,x\n");
+    rejects("a,y\n1,,2\n");
+    options.weights = "w";
+    rejects("a,y\n1,2\n");
+}
@@ -0,0 +1,105 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "turingforge/Expression.h"
+#include "options.h"
+#include "fixtures.h"
+#include "turingforge/DatasetFile.h"
+#include "turingforge/MutationFunctions.h"
+#include "turingforge/Scoring.h"
+
+TEST_CASE("Mapped dataset files match the written dataset", "[Dataset]") {
+    auto aligned = [](const void* p) { return reinterpret_cast<std::uintptr_t>(p) % SIMD_ALIGNMENT == 0; };
+    std::srand(11);
+    Options options;
+    const int n = 1001;
+    auto X = random_features(n, 3);
+    std::vector<double> y(n), w(n);
+    for (int row = 0; row < n; ++row) {
+        y[row] = X(0, row) - 2 * X(1, row);
+        w[row] = 0.5 + (row % 3) / 3.0;
+    }
+    Dataset<double, double, Matrix<double>> weighted(X, y, w);
+    weighted.varMap = {"speed", "angle"};
+    update_baseline_loss(weighted, options);
+    weighted.use_baseline = false;
+    Dataset<double, double, Matrix<double>> unweighted(X, y);
+
+    TemporaryFile weighted_file("turingforge_weighted.tfd");
+    TemporaryFile unweighted_file("turingforge_unweighted.tfd");
+    write_dataset_file(weighted, weighted_file.path.string());
+    write_dataset_file(unweighted, unweighted_file.path.string());
+
+    auto mapped = map_dataset<double, double>(weighted_file.path.string());
+    REQUIRE(mapped.n == n);
+    REQUIRE(mapped.nfeatures == 2);
+    REQUIRE(mapped.weighted);
+    REQUIRE(mapped.varMap == weighted.varMap);
+    REQUIRE(mapped.avg_y == weighted.avg_y);
+    REQUIRE_FALSE(mapped.use_baseline);
+    REQUIRE(mapped.baseline_loss == weighted.baseline_loss);
+    REQUIRE(mapped.X.stride == X.stride);
+    for (int feature = 0; feature < 2; ++feature) {
+        REQUIRE(aligned(mapped.columns().column(feature)));
+        for (int row = 0; row < n; ++row)
+            REQUIRE(mapped.X(feature, row) == X(feature, row));
+    }
+    REQUIRE(aligned(mapped.y.value().data()));
+    REQUIRE(aligned(mapped.weights.value().data()));
+    REQUIRE(std::equal(y.begin(), y.end(), mapped.y.value().begin()));
+    REQUIRE(std::equal(w.begin(), w.end(), mapped.weights.value().begin()));
+
+    auto plain = map_dataset<double, double>(unweighted_file.path.string());
+    REQUIRE_FALSE(plain.weighted);
+    REQUIRE(plain.use_baseline);
+    REQUIRE(plain.varMap == std::vector<std::string>{"x1", "x2"});
+
+    // Scoring reads the mapping in place, and copies keep it alive
+    auto copy = mapped;
+    for (int i = 0; i < 50; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(1 + i % 15, options, 2);
+        double expected = eval_loss(tree, weighted, options);
+        if (std::isinf(expected)) {
+            REQUIRE(std::isinf(eval_loss(tree, copy, options)));
+            continue;
+        }
+        REQUIRE(eval_loss(tree, copy, options) == expected);
+        REQUIRE(eval_loss(tree, plain, options) == eval_loss(tree, unweighted, options));
+    }
+
+    auto single = to_precision<float>(mapped);
+    REQUIRE(single.X(1, n - 1) == static_cast<float>(X(1, n - 1)));
+    REQUIRE(single.varMap == weighted.varMap);
+}
+
+TEST_CASE("Invalid dataset files are rejected", "[Dataset]") {
+    auto X = random_features(100);
+    Dataset<double, double, Matrix<double>> dataset(X, std::vector<double>(100, 1.0));
+    TemporaryFile file("turingforge_invalid.tfd");
+    write_dataset_file(dataset, file.path.string());
+
+    // Mapped with the wrong precision
+    REQUIRE_THROWS_AS((map_dataset<float, double>(file.path.string())), std::invalid_argument);
+
+    // Truncated
+    auto size = std::filesystem::file_size(file.path);
+    std::filesystem::resize_file(file.path, size - 8);
+    REQUIRE_THROWS_AS((map_dataset<double, double>(file.path.string())), std::invalid_argument);
+
+    // Not a dataset file
+    std::ofstream(file.path, std::ios::trunc) << "x1,x2,y\n1,2,3\n";
+    REQUIRE_THROWS_AS((map_dataset<double, double>(file.path.string())), std::invalid_argument);
+
+    TemporaryFile missing("turingforge_missing.tfd");
+    REQUIRE_THROWS_AS((map_dataset<double, double>(missing.path.string())), std::system_error);
+}
@@ -0,0 +1,367 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "turingforge/Expression.h"
+#include "options.h"
+#include "fixtures.h"
+#include "turingforge/Evaluate.h"
+#include "turingforge/MutationFunctions.h"
+#include "turingforge/Scoring.h"
+
+const std::vector<BinaryOperator> all_binary_operators = {
+        BinaryOperator::PLUS, BinaryOperator::SUB, BinaryOperator::MULT, BinaryOperator::DIV,
+        BinaryOperator::POW, BinaryOperator::GREATER, BinaryOperator::LOGICAL_OR, BinaryOperator::LOGICAL_AND
+};
+
+const std::vector<UnaryOperator> all_unary_operators = {
+        UnaryOperator::NEG, UnaryOperator::SQUARE, UnaryOperator::CUBE, UnaryOperator::ABS,
+        UnaryOperator::SQRT, UnaryOperator::RELU, UnaryOperator::EXP, UnaryOperator::LOG,
+        UnaryOperator::LOG2, UnaryOperator::LOG10, UnaryOperator::LOG1P, UnaryOperator::SIN,
+        UnaryOperator::COS, UnaryOperator::TANH, UnaryOperator::ACOSH, UnaryOperator::ATANH_CLIP,
+        UnaryOperator::GAMMA
+};
+
+// Row-by-row evaluation through the `std::function` tables
+double reference_eval(const Expression<double>& tree, const Matrix<double>& X, int row, const OperatorEnum& operators) {
+    std::vector<double> stack;
+    for (const ExprNode& node : tree.nodes) {
+        if (node.kind == NodeKind::CONSTANT) {
+            stack.push_back(tree.constants[node.index]);
+        } else if (node.kind == NodeKind::FEATURE) {
+            stack.push_back(X(node.index, row));
+        } else if (node.kind == NodeKind::UNARY) {
+            stack.back() = operators.unaops[node.index](stack.back());
+        } else {
+            double right = stack.back();
+            stack.pop_back();
+            stack.back() = operators.binops[node.index](stack.back(), right);
+        }
+    }
+    return stack.back();
+}
+
+bool matches_reference(const Expression<double>& tree, const Matrix<double>& X, const OperatorEnum& operators) {
+    auto [prediction, completion] = eval_tree_array(tree, view(X), operators);
+    std::vector<double> expected(prediction.size());
+    for (int row = 0; row < X.shape()[BATCH_DIM]; ++row)
+        expected[row] = reference_eval(tree, X, row, operators);
+    std::size_t rows = evaluated_rows(expected);
+    for (std::size_t row = 0; row < rows; ++row) {
+        if (!same(prediction[row], expected[row]))
+            return false;
+    }
+    return completion == std::all_of(expected.begin(), expected.end(), [](double v) { return std::isfinite(v); });
+}
+
+TEST_CASE("Every builtin operator matches its scalar definition", "[Evaluate]") {
+    auto X = random_features(1000);
+    auto operators = make_operator_enum(all_binary_operators, all_unary_operators);
+
+    for (std::size_t op = 0; op < all_unary_operators.size(); ++op) {
+        INFO(to_string(all_unary_operators[op]));
+        REQUIRE(matches_reference(make_unary(op, make_feature<double>(0)), X, operators));
+        REQUIRE(matches_reference(make_unary(op, make_constant(0.7)), X, operators));
+    }
+
+    for (std::size_t op = 0; op < all_binary_operators.size(); ++op) {
+        INFO(to_string(all_binary_operators[op]));
+        REQUIRE(matches_reference(make_binary(op, make_feature<double>(0), make_feature<double>(1)), X, operators));
+        REQUIRE(matches_reference(make_binary(op, make_constant(1.5), make_feature<double>(1)), X, operators));
+        REQUIRE(matches_reference(make_binary(op, make_feature<double>(0), make_constant(-0.5)), X, operators));
+        REQUIRE(matches_reference(make_binary(op, make_constant(2.0), make_constant(0.5)), X, operators));
+    }
+}
+
+TEST_CASE("Random trees match the reference evaluator", "[Evaluate]") {
+    std::srand(2);
+    Options options;
+    for (int n : {1, 255, 256, 777}) {
+        auto X = random_features(n, n);
+        for (int i = 0; i < 200; ++i) {
+            auto tree = gen_random_tree_fixed_size<double>(1 + i % 25, options, 2);
+            REQUIRE(matches_reference(tree, X, options.operators));
+        }
+    }
+}
+
+TEST_CASE("Custom operators fall back to the function table", "[Evaluate]") {
+    auto X = random_features(300);
+    OperatorEnum operators;
+    operators.binops.push_back([](double x, double y) { return std::hypot(x, y); });
+    operators.unaops.push_back([](double x) { return std::erf(x); });
+    auto tree = make_unary(0, make_binary(0, make_feature<double>(0), make_constant(3.0)));
+    REQUIRE(matches_reference(tree, X, operators));
+}
+
+TEST_CASE("Non-finite outputs mark the evaluation incomplete", "[Evaluate]") {
+    auto X = random_features(600);
+    auto operators = make_operator_enum({BinaryOperator::DIV}, {UnaryOperator::LOG});
+    auto [prediction, completion] = eval_tree_array(make_unary(0, make_feature<double>(0)), view(X), operators);
+    REQUIRE_FALSE(completion);
+    std::tie(prediction, completion) = eval_tree_array(make_binary(0, make_constant(1.0), make_feature<double>(0)), view(X), operators);
+    REQUIRE_FALSE(completion);
+    std::tie(prediction, completion) = eval_tree_array(make_binary(0, make_feature<double>(1), make_constant(2.0)), view(X), operators);
+    REQUIRE(completion);
+}
+
+TEST_CASE("Scoring an exact equation", "[Scoring]") {
+    Options options;
+    auto X = random_features(500);
+    std::vector<double> y(500);
+    for (int row = 0; row < 500; ++row)
+        y[row] = X(0, row) * X(1, row) + 1.0;
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    update_baseline_loss(dataset, options);
+    REQUIRE(dataset.use_baseline);
+
+    auto exact = make_binary(1, make_binary(0, make_feature<double>(0), make_feature<double>(1)), make_constant(1.0));
+    auto [score, loss] = score_func(dataset, exact, options);
+    REQUIRE(loss < 1e-24);
+    REQUIRE(std::abs(score - 5 * options.parsimony) < 1e-12);
+
+    auto [batch_score, batch_loss] = score_func_batch(dataset, exact, options);
+    REQUIRE(batch_loss < 1e-24);
+
+    auto [mean_score, mean_loss] = score_func(dataset, make_constant(dataset.avg_y.value()), options);
+    REQUIRE(std::abs(mean_loss - dataset.baseline_loss) < 1e-12);
+    REQUIRE(std::abs(mean_score - 1.0 - options.parsimony) < 1e-12);
+}
+
+TEST_CASE("Fused scoring matches the two-pass path", "[Scoring]") {
+    std::srand(3);
+    Options fused;
+    Options two_pass;
+    two_pass.fused_scoring = false;
+
+    const int n = 1500;
+    auto X = random_features(n, 7);
+    std::vector<double> y(n);
+    std::vector<double> w(n);
+    for (int row = 0; row < n; ++row) {
+        y[row] = std::cos(X(0, row)) * X(1, row);
+        w[row] = 0.5 + (row % 7) / 7.0;
+    }
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    Dataset<double, double, Matrix<double>> weighted(X, y, w);
+
+    for (int i = 0; i < 300; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(1 + i % 30, fused, 2);
+        for (const auto* data : {&dataset, &weighted}) {
+            double expected = eval_loss(tree, *data, two_pass);
+            double actual = eval_loss(tree, *data, fused);
+            if (std::isinf(expected))
+                REQUIRE(std::isinf(actual));
+            else
+                REQUIRE(std::abs(actual - expected) <= 1e-12 * std::max(1.0, std::abs(expected)));
+        }
+    }
+}
+
+TEST_CASE("Threaded loss reduction does not depend on the thread count", "[Scoring]") {
+    std::srand(5);
+    Options options;
+    // Several reduction blocks, the last one partial
+    const int n = static_cast<int>(3 * REDUCTION_BLOCK_SIZE + 777);
+    auto X = random_features(n, 13);
+    std::vector<double> y(n);
+    std::vector<double> w(n);
+    for (int row = 0; row < n; ++row) {
+        y[row] = X(0, row) * X(1, row) - 1.0;
+        w[row] = 0.25 + (row % 5) / 5.0;
+    }
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    Dataset<double, double, Matrix<double>> weighted(X, y, w);
+
+    for (int i = 0; i < 20; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(3 + i, options, 2);
+        for (const auto* data : {&dataset, &weighted}) {
+            for (bool fused : {true, false}) {
+                Options serial = options;
+                serial.fused_scoring = fused;
+                double expected = eval_loss(tree, *data, serial);
+                Options threaded = serial;
+                threaded.reduction_threads = 1;
+                double reference = eval_loss(tree, *data, threaded);
+                if (std::isinf(expected)) {
+                    REQUIRE(std::isinf(reference));
+                    continue;
+                }
+                REQUIRE(std::abs(reference - expected) <= 1e-12 * std::max(1.0, std::abs(expected)));
+                for (std::size_t threads : {2, 4}) {
+                    threaded.reduction_threads = threads;
+                    REQUIRE(eval_loss(tree, *data, threaded) == reference);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Streaming a dataset in chunks matches the whole-dataset loss", "[Scoring]") {
+    std::srand(6);
+    Options options;
+    const int n = 10000;
+    auto X = random_features(n, 17);
+    std::vector<double> y(n);
+    std::vector<double> w(n);
+    for (int row = 0; row < n; ++row) {
+        y[row] = std::cos(X(1, row)) - X(0, row);
+        w[row] = 0.5 + (row % 3) / 3.0;
+    }
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    Dataset<double, double, Matrix<double>> weighted(X, y, w);
+    auto columns = view(X);
+
+    for (int i = 0; i < 50; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(1 + i % 20, options, 2);
+        for (const auto* data : {&dataset, &weighted}) {
+            const double* weights = data->weighted ? w.data() : nullptr;
+            LossAccumulator<AnyLoss> accumulator(options.elementwise_loss);
+            bool complete = true;
+            for (std::size_t begin = 0; begin < columns.n && complete; begin += 3000) {
+                std::size_t m = std::min<std::size_t>(3000, columns.n - begin);
+                ColumnView<double> chunk{columns.data + begin, columns.stride, m, columns.nfeatures};
+                complete = accumulate_loss(tree, chunk, y.data() + begin, weights == nullptr ? nullptr : weights + begin,
+                                           options, accumulator);
+            }
+            double expected = eval_loss(tree, *data, options);
+            if (!complete) {
+                REQUIRE(std::isinf(expected));
+                continue;
+            }
+            REQUIRE(accumulator.count() == columns.n);
+            if (std::isinf(expected))
+                REQUIRE(std::isinf(accumulator.mean()));
+            else
+                REQUIRE(std::abs(accumulator.mean() - expected) <= 1e-12 * std::max(1.0, std::abs(expected)));
+        }
+    }
+}
+
+TEST_CASE("Quantile losses in one pass match one loss per quantile", "[Scoring]") {
+    std::srand(8);
+    Options options;
+    const int n = 5000;
+    auto X = random_features(n, 19);
+    std::vector<double> y(n);
+    std::vector<double> w(n);
+    for (int row = 0; row < n; ++row) {
+        y[row] = X(0, row) * X(1, row);
+        w[row] = 0.25 + (row % 4) / 4.0;
+    }
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    Dataset<double, double, Matrix<double>> weighted(X, y, w);
+    MultiQuantileLoss loss({0.05, 0.5, 0.95});
+
+    for (int i = 0; i < 50; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(1 + i % 20, options, 2);
+        for (const auto* data : {&dataset, &weighted}) {
+            auto losses = eval_quantile_losses(tree, *data, options, loss);
+            REQUIRE(losses.size() == 3);
+            for (std::size_t k = 0; k < loss.size(); ++k) {
+                Options single = options;
+                single.elementwise_loss = QuantileLoss(loss.taus[k]);
+                double expected = eval_loss(tree, *data, single);
+                if (std::isinf(expected))
+                    REQUIRE(std::isinf(losses[k]));
+                else
+                    REQUIRE(std::abs(losses[k] - expected) <= 1e-10 * std::max(1.0, std::abs(expected)));
+            }
+        }
+    }
+}
+
+TEST_CASE("Datasets store aligned, padded columns", "[Dataset]") {
+    auto aligned = [](const void* p) { return reinterpret_cast<std::uintptr_t>(p) % SIMD_ALIGNMENT == 0; };
+    // Row-major input, as read from a file: row r holds r + 0.25 * f for each feature f
+    const int n = 1001;
+    const int nfeatures = 3;
+    std::vector<double> rows(static_cast<std::size_t>(n) * nfeatures);
+    for (int row = 0; row < n; ++row)
+        for (int feature = 0; feature < nfeatures; ++feature)
+            rows[static_cast<std::size_t>(row) * nfeatures + feature] = row + 0.25 * feature;
+
+    Matrix<double> X(std::span<const double>(rows), nfeatures);
+    ThreadPool pool(4);
+    Matrix<double> pooled(std::span<const double>(rows), nfeatures, &pool);
+    REQUIRE(X.shape()[BATCH_DIM] == n);
+    REQUIRE(X.shape()[FEATURE_DIM] == nfeatures);
+    REQUIRE(X.stride == 1008);
+    REQUIRE(pooled.values == X.values);
+    for (int row = 0; row < n; ++row)
+        for (int feature = 0; feature < nfeatures; ++feature)
+            REQUIRE(X(feature, row) == row + 0.25 * feature);
+    REQUIRE_THROWS_AS(Matrix<double>(std::span<const double>(rows).first(10), nfeatures), std::invalid_argument);
+
+    std::vector<double> y(n, 1.0), w(n, 2.0);
+    Dataset<double, double, Matrix<double>> dataset(X, y, w);
+    auto columns = dataset.columns();
+    REQUIRE(columns.stride == X.stride);
+    for (int feature = 0; feature < nfeatures; ++feature) {
+        REQUIRE(aligned(columns.column(feature)));
+        REQUIRE(columns.column(feature)[n - 1] == n - 1 + 0.25 * feature);
+    }
+    REQUIRE(aligned(dataset.y.value().data()));
+    REQUIRE(aligned(dataset.weights.value().data()));
+    auto single = to_precision<float>(dataset);
+    REQUIRE(single.X.stride == 1008);
+    REQUIRE(single.X(2, n - 1) == static_cast<float>(n - 1 + 0.5));
+    REQUIRE(aligned(single.columns().column(1)));
+
+    // The evaluator reads the padded columns in place
+    Options options;
+    auto tree = make_binary(1, make_feature<double>(0), make_feature<double>(2));
+    std::vector<double> out(n);
+    TileWorkspace<double> workspace;
+    REQUIRE(eval_tree_array(tree, columns, options.operators, out.data(), workspace));
+    for (int row = 0; row < n; ++row)
+        REQUIRE(out[row] == 2.0 * row + 0.5);
+}
+
+TEST_CASE("Evaluation stops at the first non-finite tile", "[Evaluate]") {
+    auto X = random_features(4 * EVAL_TILE_SIZE);
+    auto operators = make_operator_enum({BinaryOperator::SUB}, {UnaryOperator::LOG});
+    // log(x1 - 10) is NaN on every row, so only the first tile is evaluated
+    auto tree = make_unary(0, make_binary(0, make_feature<double>(0), make_constant(10.0)));
+    std::size_t aborts = early_abort_stats().nonfinite_aborts;
+    std::size_t skipped = early_abort_stats().rows_skipped;
+    std::vector<double> out(4 * EVAL_TILE_SIZE, 7.0);
+    TileWorkspace<double> workspace;
+    REQUIRE_FALSE(eval_tree_array(tree, view(X), operators, out.data(), workspace));
+    REQUIRE(early_abort_stats().nonfinite_aborts == aborts + 1);
+    REQUIRE(early_abort_stats().rows_skipped == skipped + 4 * EVAL_TILE_SIZE);
+    REQUIRE(out[EVAL_TILE_SIZE] == 7.0);
+}
+
+TEST_CASE("The fused loss stops once it exceeds a bound", "[Scoring]") {
+    Options options;
+    const int n = 8 * EVAL_TILE_SIZE;
+    auto X = random_features(n, 11);
+    std::vector<double> y(n, 0.0);
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    update_baseline_loss(dataset, options);
+    auto tree = make_binary(0, make_feature<double>(0), make_feature<double>(1));
+    double loss = eval_loss(tree, dataset, options);
+
+    std::size_t aborts = early_abort_stats().bound_aborts;
+    std::size_t skipped = early_abort_stats().rows_skipped;
+    REQUIRE(eval_loss(tree, dataset, options, 2 * loss) == loss);
+    REQUIRE(early_abort_stats().bound_aborts == aborts);
+
+    double partial = eval_loss(tree, dataset, options, loss / 10);
+    REQUIRE(partial > loss / 10);
+    REQUIRE(partial < loss);
+    REQUIRE(early_abort_stats().bound_aborts == aborts + 1);
+    REQUIRE(early_abort_stats().rows_skipped > skipped);
+
+    auto [score, full_loss] = score_func(dataset, tree, options);
+    auto [bounded_score, bounded_loss] = score_func(dataset, tree, options, -1, score / 10);
+    REQUIRE(full_loss == loss);
+    REQUIRE(bounded_score > score / 10);
+    REQUIRE(bounded_score < score);
+}
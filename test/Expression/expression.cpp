@@ -0,0 +1,134 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdlib>
+
+#include "turingforge/Expression.h"
+#include "options.h"
+#include "turingforge/CheckConstraints.h"
+#include "turingforge/MutationFunctions.h"
+
+// Check the postfix invariants: subtree sizes, one root, ordered constant slots
+template<typename T>
+bool is_valid(const Expression<T>& tree) {
+    std::vector<std::size_t> stack;
+    std::size_t slot = 0;
+    for (std::size_t i = 0; i < tree.nodes.size(); ++i) {
+        const ExprNode& node = tree.nodes[i];
+        std::size_t size = 1;
+        for (int k = 0; k < node.degree; ++k) {
+            if (stack.empty())
+                return false;
+            size += stack.back();
+            stack.pop_back();
+        }
+        if (node.size != size)
+            return false;
+        if (node.kind == NodeKind::CONSTANT && node.index != slot++)
+            return false;
+        stack.push_back(size);
+    }
+    return stack.size() == 1 && slot == tree.constants.size();
+}
+
+// x1 * (2.0 + cos(x2)) with binop 0 = "*", binop 1 = "+", unaop 0 = "cos"
+Expression<double> example_tree() {
+    return make_binary(0, make_feature<double>(0),
+                       make_binary(1, make_constant(2.0), make_unary(0, make_feature<double>(1))));
+}
+
+TEST_CASE("Flat expression layout", "[Expression]") {
+    auto tree = example_tree();
+    REQUIRE(is_valid(tree));
+    REQUIRE(count_nodes(tree) == 6);
+    REQUIRE(count_constants(tree) == 1);
+    REQUIRE(count_depth(tree) == 4);
+    REQUIRE(tree.root_node().kind == NodeKind::BINARY);
+    REQUIRE(tree.nodes[left_child(tree, tree.root())].kind == NodeKind::FEATURE);
+    REQUIRE(tree.nodes[right_child(tree, tree.root())].size == 4);
+}
+
+TEST_CASE("Subtree extraction and replacement", "[Expression]") {
+    auto tree = example_tree();
+    auto sub = extract_subtree(tree, right_child(tree, tree.root()));
+    REQUIRE(is_valid(sub));
+    REQUIRE(count_nodes(sub) == 4);
+    REQUIRE(sub.constants == std::vector<double>{2.0});
+
+    // Replace the feature x1 with a constant: slots must be renumbered
+    replace_subtree(tree, 0, make_constant(5.0));
+    REQUIRE(is_valid(tree));
+    REQUIRE(tree.constants == std::vector<double>{5.0, 2.0});
+
+    // Replace the whole tree
+    replace_subtree(tree, tree.root(), sub);
+    REQUIRE(tree == sub);
+
+    // Grow a leaf into a larger subtree
+    replace_subtree(tree, 0, example_tree());
+    REQUIRE(is_valid(tree));
+    REQUIRE(count_nodes(tree) == 9);
+}
+
+TEST_CASE("Complexity and constraints", "[Expression]") {
+    Options options;
+    auto tree = example_tree();
+    REQUIRE(compute_complexity(tree, options) == 6);
+
+    // x1 * (2.0 + cos(x2)) = 2 + 1 + (1 + 1 + (3 + 1))
+    Options mapped = options;
+    mapped.complexity_mapping = ComplexityMapping{true, {2, 1, 1}, {3, 1}, 1, 1};
+    REQUIRE(compute_complexity(tree, mapped) == 9);
+    REQUIRE(subtree_complexities(tree, mapped)[right_child(tree, tree.root())] == 6);
+
+    REQUIRE(check_constraints(tree, options, 6));
+    REQUIRE_FALSE(check_constraints(tree, options, 5));
+    REQUIRE_FALSE(check_constraints(tree, mapped, 8));
+    Options shallow = options;
+    shallow.maxdepth = 3;
+    REQUIRE_FALSE(check_constraints(tree, shallow, 6));
+
+    // The right operand of the product has 4 nodes, the operand of cos one
+    Options constrained = options;
+    constrained.bin_constraints = {{1, -1}, {-1, -1}, {-1, -1}};
+    REQUIRE(check_constraints(tree, constrained, 6));
+    constrained.bin_constraints[0] = {-1, 3};
+    REQUIRE_FALSE(check_constraints(tree, constrained, 6));
+    constrained.bin_constraints.clear();
+    constrained.una_constraints = {0, -1};
+    REQUIRE_FALSE(check_constraints(tree, constrained, 6));
+
+    // No cos anywhere inside a cos
+    Options nested = options;
+    nested.nested_constraints.emplace();
+    nested.nested_constraints->push_back({1, 0, {{1, 0, 0}}});
+    auto cos_x1 = make_unary(0, make_feature<double>(0));
+    REQUIRE(check_constraints(make_binary(1, cos_x1, cos_x1), nested, 10));
+    REQUIRE_FALSE(check_constraints(make_unary(0, make_binary(1, make_constant(1.0), cos_x1)), nested, 10));
+}
+
+TEST_CASE("Mutations keep the flat layout valid", "[MutationFunctions]") {
+    std::srand(1);
+    Options options;
+    const int nfeatures = 3;
+    auto tree = example_tree();
+    for (int i = 0; i < 2000; ++i) {
+        switch (i % 6) {
+            case 0: append_random_op(tree, options, nfeatures); break;
+            case 1: insert_random_op(tree, options, nfeatures); break;
+            case 2: delete_random_op(tree, options, nfeatures); break;
+            case 3: mutate_operator(tree, options); break;
+            case 4: mutate_constant(tree, 1.0, options); break;
+            case 5: {
+                auto [child1, child2] = crossover_trees(tree, gen_random_tree<double>(4, options, nfeatures));
+                REQUIRE(is_valid(child2));
+                tree = child1;
+                break;
+            }
+        }
+        REQUIRE(is_valid(tree));
+        if (count_nodes(tree) > 40)
+            tree = gen_random_tree_fixed_size<double>(7, options, nfeatures);
+    }
+    prepend_random_op(tree, options, nfeatures);
+    REQUIRE(is_valid(tree));
+}
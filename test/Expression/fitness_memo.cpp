@@ -0,0 +1,112 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "turingforge/Expression.h"
+#include "options.h"
+#include "fixtures.h"
+#include "turingforge/ExpressionHash.h"
+#include "turingforge/FitnessMemo.h"
+#include "turingforge/MutationFunctions.h"
+#include "turingforge/Scoring.h"
+
+TEST_CASE("Expression hashes compare constants up to a tolerance", "[FitnessMemo]") {
+    Options options;
+    auto tree = [](double c) { return make_binary(0, make_feature<double>(0), make_constant(c)); };
+    const OperatorEnum& operators = options.operators;
+
+    REQUIRE(expression_hash(tree(1.5), operators) == expression_hash(tree(1.5), operators));
+    REQUIRE(expression_hash(tree(1.5), operators) != expression_hash(tree(1.5 + 1e-15), operators));
+    REQUIRE(expression_hash(tree(0.0), operators) == expression_hash(tree(-0.0), operators));
+
+    REQUIRE(expression_hash(tree(1.5), operators, 1e-6) == expression_hash(tree(1.5 + 1e-13), operators, 1e-6));
+    REQUIRE(expression_hash(tree(1.5), operators, 1e-6) != expression_hash(tree(1.5 + 1e-3), operators, 1e-6));
+    REQUIRE(expression_hash(tree(1.5), operators, 1e-6) != expression_hash(tree(-1.5), operators, 1e-6));
+    REQUIRE(expression_hash(tree(1.5), operators, 1e-6) != expression_hash(tree(3.0), operators, 1e-6));
+    // Tolerances below the machine epsilon round like epsilon
+    const double epsilon = std::numeric_limits<double>::epsilon();
+    REQUIRE(expression_hash(tree(1.5), operators, 1e-300) == expression_hash(tree(1.5), operators, epsilon));
+    REQUIRE(expression_hash(tree(1.5), operators, 1e-300) != expression_hash(tree(1.5 + 1e-13), operators, 1e-300));
+    REQUIRE(memo_key(tree(-1.5), operators, 1e-300).form == memo_key(tree(-1.5), operators, epsilon).form);
+
+    // x1 * 2 and 2 * x1 are the same candidate
+    auto swapped = make_binary(0, make_constant(2.0), make_feature<double>(0));
+    REQUIRE(expression_hash(tree(2.0), operators) == expression_hash(swapped, operators));
+
+    // Trees with equal hashes also have equal memo keys
+    REQUIRE(memo_key(tree(2.0), operators, 0.0).form == memo_key(swapped, operators, 0.0).form);
+    REQUIRE(memo_key(tree(1.5), operators, 1e-6).form == memo_key(tree(1.5 + 1e-13), operators, 1e-6).form);
+    REQUIRE(memo_key(tree(1.5), operators, 1e-6).form != memo_key(tree(3.0), operators, 1e-6).form);
+}
+
+TEST_CASE("The memo table is capped", "[FitnessMemo]") {
+    Options options;
+    FitnessMemo<double> memo(options.operators, 64, 0.0);
+    for (std::uint64_t key = 0; key < 1000; ++key)
+        memo.insert(MemoKey{key * 0x9e3779b97f4a7c15ULL, {key}}, MemoEntry<double>{1.0, 2.0, 3});
+    auto stats = memo.stats();
+    REQUIRE(stats.size <= 64);
+    REQUIRE(stats.insertions == 1000);
+    REQUIRE(stats.evictions == 1000 - stats.size);
+
+    // The latest entry is kept, and re-inserting a key is a no-op
+    MemoKey latest{999 * 0x9e3779b97f4a7c15ULL, {999}};
+    auto last = memo.find(latest);
+    REQUIRE(last);
+    REQUIRE(last->complexity == 3);
+    memo.insert(latest, MemoEntry<double>{5.0, 5.0, 5});
+    REQUIRE(memo.find(latest)->score == 1.0);
+    REQUIRE_FALSE(memo.find(MemoKey{1, {1}}));
+    REQUIRE(memo.stats().hit_rate() > 0.0);
+
+    // A tree whose hash matches another's is not given its score
+    REQUIRE_FALSE(memo.find(MemoKey{latest.hash, {998}}));
+    REQUIRE(memo.stats().collisions == 1);
+}
+
+TEST_CASE("The memo is shared by copies of the options", "[FitnessMemo]") {
+    Options options;
+    FitnessMemo<double> memo(options.operators, 64, 0.0);
+    Options copy = options;
+    REQUIRE(memo.bound_to(copy.operators));
+    REQUIRE_FALSE(memo.bound_to(make_operator_enum({BinaryOperator::MULT, BinaryOperator::PLUS},
+                                                   {UnaryOperator::COS, UnaryOperator::EXP})));
+}
+
+TEST_CASE("Duplicate candidates are scored once", "[FitnessMemo][Scoring]") {
+    std::srand(9);
+    Options options;
+    options.fitness_memo_size = 1000;
+    const int n = 300;
+    auto X = random_features(n, 9);
+    std::vector<double> y(n);
+    for (int row = 0; row < n; ++row)
+        y[row] = X(0, row) - 2.0 * X(1, row);
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    init_fitness_memo(dataset, options);
+    update_baseline_loss(dataset, options);
+
+    std::vector<Expression<double>> trees;
+    for (int i = 0; i < 50; ++i)
+        trees.push_back(gen_random_tree_fixed_size<double>(1 + i % 15, options, 2));
+
+    Options unmemoized = options;
+    unmemoized.fitness_memo_size = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const auto& tree : trees) {
+            auto [score, loss] = score_func(dataset, tree, options);
+            auto [expected_score, expected_loss] = score_func(dataset, tree, unmemoized);
+            REQUIRE(same(score, expected_score));
+            REQUIRE(same(loss, expected_loss));
+        }
+    }
+    auto stats = dataset.fitness_memo->stats();
+    REQUIRE(stats.hits >= 50);
+    REQUIRE(stats.size == stats.insertions);
+
+    // A new baseline changes every score
+    update_baseline_loss(dataset, options);
+    REQUIRE(dataset.fitness_memo->stats().size == 0);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <random>
+
+#include "turingforge/Dataset.h"
+
+// Two uniform features in [-3, 3], with a zero and a -1 in the first row
+inline Matrix<double> random_features(int n, unsigned seed = 0) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(-3.0, 3.0);
+    Matrix<double> X(2, n);
+    for (int feature = 0; feature < 2; ++feature)
+        for (int row = 0; row < n; ++row)
+            X(feature, row) = dist(gen);
+    X(0, 0) = 0.0;
+    X(1, 0) = -1.0;
+    return X;
+}
+
+inline ColumnView<double> view(const Matrix<double>& X) {
+    auto n = static_cast<std::size_t>(X.shape()[BATCH_DIM]);
+    return ColumnView<double>{X.data(), X.stride, n, X.shape()[FEATURE_DIM]};
+}
+
+// Equal, or both NaN
+inline bool same(double a, double b) {
+    return (std::isnan(a) && std::isnan(b)) || a == b;
+}
+
+// Number of leading rows an evaluator writes before it stops at the first tile
+// with a non-finite value
+inline std::size_t evaluated_rows(const std::vector<double>& expected) {
+    for (std::size_t row = 0; row < expected.size(); ++row) {
+        if (!std::isfinite(expected[row]))
+            return std::min(expected.size(), (row / EVAL_TILE_SIZE + 1) * EVAL_TILE_SIZE);
+    }
+    return expected.size();
+}
+
+// Target of a reference regression problem, as a function of the two features
+struct ReferenceProblem {
+    const char* name;
+    double (*target)(double, double);
+};
+
+inline std::vector<ReferenceProblem> reference_problems() {
+    return {
+            {"x1^2 * x2 + x2", [](double a, double b) { return a * a * b + b; }},
+            {"2.5 * x1 + cos(1.3 * x2)", [](double a, double b) { return 2.5 * a + std::cos(1.3 * b); }},
+            {"exp(-x1^2) * x2", [](double a, double b) { return std::exp(-a * a) * b; }},
+            {"x1 / (1 + x2^2)", [](double a, double b) { return a / (1 + b * b); }},
+    };
+}
+
+// Targets of `problem` on the rows of `X`
+inline std::vector<double> reference_targets(const ReferenceProblem& problem, const Matrix<double>& X) {
+    std::vector<double> y(static_cast<std::size_t>(X.shape()[BATCH_DIM]));
+    for (std::size_t row = 0; row < y.size(); ++row)
+        y[row] = problem.target(X(0, static_cast<int>(row)), X(1, static_cast<int>(row)));
+    return y;
+}
+
+// Path in the temporary directory, removed at the end of the test
+struct TemporaryFile {
+    std::filesystem::path path;
+
+    explicit TemporaryFile(const std::string& name) : path(std::filesystem::temp_directory_path() / name) {}
+    ~TemporaryFile() { std::filesystem::remove(path); }
+};
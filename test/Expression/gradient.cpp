@@ -0,0 +1,223 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "turingforge/Expression.h"
+#include "options.h"
+#include "fixtures.h"
+#include "turingforge/Gradient.h"
+#include "turingforge/MutationFunctions.h"
+#include "turingforge/Optim.h"
+
+// Whether `actual` matches the central difference of `f` at `x`, up to the
+// rounding error of the difference. Points where two step sizes disagree, e.g.
+// cos(exp(u)) for large u, are too ill-conditioned and are skipped.
+template <typename F>
+bool matches_central_difference(F f, double x, double actual) {
+    double h = 1e-6 * std::max(1.0, std::abs(x));
+    double expected = (f(x + h) - f(x - h)) / (2 * h);
+    double refined = (f(x + h / 4) - f(x - h / 4)) / (h / 2);
+    if (!std::isfinite(expected) || std::abs(expected - refined) > 1e-5 * std::max(1.0, std::abs(expected)))
+        return true;
+    double rounding = 1e-12 * std::abs(f(x)) / h;
+    return std::abs(actual - expected) <= 1e-4 * std::max(1.0, std::abs(expected)) + rounding;
+}
+
+// Rows on which no subtree of the tree exceeds `limit` in magnitude. Elsewhere
+// finite differences lose their digits in the rounding of large intermediate
+// values, e.g. cos(exp(exp(x)) - c), so only these rows are compared.
+std::vector<bool> moderate_rows(const Expression<double>& tree, const Matrix<double>& X, const OperatorEnum& operators,
+                                double limit = 1e3) {
+    ReverseWorkspace<double> workspace;
+    workspace.reserve(tree);
+    const std::size_t n = view(X).n;
+    std::vector<bool> moderate(n, true);
+    for (std::size_t row = 0; row < n; row += EVAL_TILE_SIZE) {
+        int m = static_cast<int>(std::min<std::size_t>(EVAL_TILE_SIZE, n - row));
+        forward_tile(tree, view(X), operators, row, m, workspace);
+        for (const double* output : workspace.outputs) {
+            for (int i = 0; i < m; ++i)
+                moderate[row + i] = moderate[row + i] && std::abs(output[i]) <= limit;
+        }
+    }
+    return moderate;
+}
+
+// Compare every derivative of every row against finite differences
+bool matches_finite_differences(const Expression<double>& tree, const Matrix<double>& X, const OperatorEnum& operators) {
+    auto [values, gradient, complete] = eval_grad_tree_array(tree, view(X), operators);
+    if (!complete)
+        return true;
+    auto [reference, reference_complete] = eval_tree_array(tree, view(X), operators);
+    if (values != reference)
+        return false;
+    const std::size_t n = values.size();
+    std::vector<bool> moderate = moderate_rows(tree, X, operators);
+    for (std::size_t k = 0; k < tree.constants.size(); ++k) {
+        for (std::size_t row = 0; row < n; row += 37) {
+            if (!moderate[row])
+                continue;
+            auto f = [&, k](double c) {
+                Expression<double> shifted = tree;
+                shifted.constants[k] = c;
+                return eval_tree_array(shifted, view(X), operators).first[row];
+            };
+            if (!matches_central_difference(f, tree.constants[k], gradient[k * n + row]))
+                return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE("Every builtin operator has the right derivative", "[Gradient]") {
+    auto X = random_features(300);
+    for (double& v : X.values)
+        v = 1.2 + std::abs(v);  // inside the domain of every operator
+    auto operators = make_operator_enum(
+            {BinaryOperator::PLUS, BinaryOperator::SUB, BinaryOperator::MULT, BinaryOperator::DIV, BinaryOperator::POW},
+            {UnaryOperator::NEG, UnaryOperator::SQUARE, UnaryOperator::CUBE, UnaryOperator::ABS, UnaryOperator::SQRT,
+             UnaryOperator::RELU, UnaryOperator::EXP, UnaryOperator::LOG, UnaryOperator::LOG2, UnaryOperator::LOG10,
+             UnaryOperator::LOG1P, UnaryOperator::SIN, UnaryOperator::COS, UnaryOperator::TANH, UnaryOperator::ACOSH,
+             UnaryOperator::ATANH_CLIP, UnaryOperator::GAMMA});
+
+    for (std::size_t op = 0; op < operators.unaops.size(); ++op) {
+        INFO(to_string(operators.unaop_id(op)));
+        auto scaled = make_binary(2, make_constant(1.1), make_feature<double>(0));
+        REQUIRE(matches_finite_differences(make_unary(op, scaled), X, operators));
+    }
+    for (std::size_t op = 0; op < operators.binops.size(); ++op) {
+        INFO(to_string(operators.binop_id(op)));
+        REQUIRE(matches_finite_differences(make_binary(op, make_constant(1.3), make_feature<double>(1)), X, operators));
+        REQUIRE(matches_finite_differences(make_binary(op, make_feature<double>(0), make_constant(0.7)), X, operators));
+        REQUIRE(matches_finite_differences(make_binary(op, make_constant(1.3), make_constant(0.7)), X, operators));
+    }
+}
+
+TEST_CASE("Random trees have the right constant derivatives", "[Gradient]") {
+    std::srand(10);
+    Options options;
+    auto X = random_features(700, 3);
+    for (int i = 0; i < 200; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(1 + i % 20, options, 2);
+        REQUIRE(matches_finite_differences(tree, X, options.operators));
+    }
+}
+
+TEST_CASE("The loss gradient matches finite differences of the loss", "[Gradient][Scoring]") {
+    std::srand(11);
+    Options options;
+    const int n = 600;
+    auto X = random_features(n, 12);
+    std::vector<double> y(n);
+    std::vector<double> w(n);
+    for (int row = 0; row < n; ++row) {
+        y[row] = std::cos(1.5 * X(0, row)) + X(1, row) * 0.3;
+        w[row] = 0.5 + (row % 5) / 5.0;
+    }
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    Dataset<double, double, Matrix<double>> weighted(X, y, w);
+
+    for (int i = 0; i < 100; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(3 + i % 15, options, 2);
+        auto moderate = moderate_rows(tree, X, options.operators);
+        if (!has_constant_gradient(tree, options) || std::find(moderate.begin(), moderate.end(), false) != moderate.end())
+            continue;
+        for (const auto* data : {&dataset, &weighted}) {
+            std::vector<double> gradient;
+            double loss = eval_loss_and_gradient(tree, *data, options, gradient);
+            if (!std::isfinite(loss))
+                continue;
+            REQUIRE(std::abs(loss - eval_loss(tree, *data, options)) <= 1e-12 * std::max(1.0, loss));
+            for (std::size_t k = 0; k < tree.constants.size(); ++k) {
+                auto f = [&, k](double c) {
+                    Expression<double> shifted = tree;
+                    shifted.constants[k] = c;
+                    return eval_loss(shifted, *data, options);
+                };
+                REQUIRE(matches_central_difference(f, tree.constants[k], gradient[k]));
+            }
+        }
+    }
+}
+
+TEST_CASE("Reverse mode matches forward mode", "[Gradient]") {
+    std::srand(12);
+    Options options;
+    const int n = 700;
+    auto X = random_features(n, 14);
+    std::vector<double> y(n);
+    for (int row = 0; row < n; ++row)
+        y[row] = std::cos(X(0, row)) * X(1, row);
+    const double* unweighted = nullptr;
+    DualWorkspace<double> forward;
+    ReverseWorkspace<double> reverse;
+    int compared = 0;
+    for (int i = 0; i < 200; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(1 + i % 40, options, 2);
+        std::vector<double> forward_gradient(tree.constants.size());
+        std::vector<double> reverse_gradient(tree.constants.size());
+        auto a = eval_loss_gradient_tiled(tree, view(X), options.operators, y.data(), unweighted, options.elementwise_loss,
+                                          forward_gradient.data(), forward);
+        auto b = eval_loss_gradient_tiled(tree, view(X), options.operators, y.data(), unweighted, options.elementwise_loss,
+                                          reverse_gradient.data(), reverse);
+        REQUIRE(a.complete == b.complete);
+        REQUIRE(a.rows == b.rows);
+        if (!a.complete)
+            continue;
+        REQUIRE(a.sum == b.sum);
+        for (std::size_t k = 0; k < tree.constants.size(); ++k) {
+            // Overflowing derivatives may come out as inf in one mode and NaN in the other
+            if (!std::isfinite(forward_gradient[k]) || !std::isfinite(reverse_gradient[k]))
+                continue;
+            REQUIRE(std::abs(forward_gradient[k] - reverse_gradient[k]) <=
+                    1e-9 * std::max(1.0, std::abs(forward_gradient[k])));
+        }
+        compared += tree.constants.size() >= REVERSE_MODE_MIN_CONSTANTS;
+    }
+    REQUIRE(compared > 20);
+}
+
+TEST_CASE("BFGS with the constant gradient fits the constants", "[Gradient][Optim]") {
+    Options options;
+    const int n = 500;
+    auto X = random_features(n, 13);
+    std::vector<double> y(n);
+    for (int row = 0; row < n; ++row)
+        y[row] = 2.5 * X(0, row) + std::cos(1.3 * X(1, row));
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+
+    // c1 * x1 + cos(c2 * x2), starting away from (2.5, 1.3)
+    auto tree = make_binary(1, make_binary(0, make_constant(1.0), make_feature<double>(0)),
+                            make_unary(0, make_binary(0, make_constant(1.1), make_feature<double>(1))));
+    REQUIRE(has_constant_gradient(tree, options));
+    int f_calls = 0;
+    int fg_calls = 0;
+    auto f = [&](const std::vector<double>& x) {
+        ++f_calls;
+        tree.constants = x;
+        return eval_loss(tree, dataset, options);
+    };
+    auto fg = [&](const std::vector<double>& x, std::vector<double>& g) {
+        ++fg_calls;
+        tree.constants = x;
+        return eval_loss_and_gradient(tree, dataset, options, g);
+    };
+    Optim::Options<> optimizer_options;
+    optimizer_options.iterations = 100;
+    optimizer_options.g_abstol = 1e-10;
+    auto result = Optim::optimize(f, fg, tree.constants, Optim::BFGS{}, optimizer_options);
+    REQUIRE(Optim::converged(result));
+    REQUIRE(result.minimum < 1e-16);
+    REQUIRE(std::abs(result.minimizer[0] - 2.5) < 1e-8);
+    REQUIRE(std::abs(result.minimizer[1] - 1.3) < 1e-8);
+    REQUIRE(result.f_calls < 100);
+
+    // Accepted unit steps compute the loss once, along with the gradient, so
+    // some iterations cost a single call
+    REQUIRE(result.f_calls == f_calls);
+    REQUIRE(result.g_calls == fg_calls);
+    REQUIRE(result.f_calls + result.g_calls < 2 * result.iterations + 1);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include "turingforge/Expression.h"
+#include "turingforge/OperatorEnum.h"
+#include "turingforge/Loss/LossFunctions.h"
+
+// Custom complexities of the node kinds, as in OptionsStructure.h
+struct ComplexityMapping {
+    bool use = false;
+    std::vector<double> binop_complexities;
+    std::vector<double> unaop_complexities;
+    double variable_complexity = 1;
+    double constant_complexity = 1;
+};
+
+// The subset of the search options used by the expression and scoring code
+struct Options {
+    int nuna = 2;
+    int nbin = 3;
+    double perturbation_factor = 0.076;
+    double probability_negate_constant = 0.01;
+    double probability_mutate_operator = 0.5;
+    double probability_mutate_constant = 0.5;
+    double parsimony = 0.0032;
+    int maxsize = 20;
+    int maxdepth = 20;
+    ComplexityMapping complexity_mapping;
+    std::vector<std::tuple<int, int>> bin_constraints;
+    std::vector<int> una_constraints;
+    std::optional<std::vector<std::tuple<int, int, std::vector<std::tuple<int, int, int>>>>> nested_constraints;
+    int batch_size = 50;
+    bool racing = false;
+    int racing_rows = 4096;
+    double racing_confidence = 3.0;
+    bool fused_scoring = true;
+    std::size_t subtree_cache_bytes = 0;
+    std::size_t fitness_memo_size = 0;
+    double fitness_memo_tolerance = 1e-10;
+    int precision = 64;
+    std::size_t reduction_threads = 0;
+    OperatorEnum operators = make_operator_enum(
+            {BinaryOperator::MULT, BinaryOperator::PLUS, BinaryOperator::SUB},
+            {UnaryOperator::COS, UnaryOperator::EXP});
+    AnyLoss elementwise_loss = L2DistLoss();
+};
@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+#include "turingforge/Expression.h"
+#include "options.h"
+#include "fixtures.h"
+#include "turingforge/Gradient.h"
+#include "turingforge/MutationFunctions.h"
+#include "turingforge/Scoring.h"
+
+// Candidates a search typically visits near the reference problems
+std::vector<Expression<double>> candidate_trees() {
+    auto x1 = make_feature<double>(0);
+    auto x2 = make_feature<double>(1);
+    auto c = [](double v) { return make_constant(v); };
+    return {
+            make_binary(1, make_binary(0, make_binary(0, x1, x1), x2), x2),
+            make_binary(1, make_binary(0, c(2.4), x1), make_unary(0, make_binary(0, c(1.31), x2))),
+            make_binary(0, make_unary(1, make_binary(0, c(-1.0), make_binary(0, x1, x1))), x2),
+            make_binary(2, make_binary(0, c(0.7), x1), make_unary(0, x2)),
+    };
+}
+
+TEST_CASE("Single precision losses track double precision", "[Precision][Scoring]") {
+    Options options;
+    auto X = random_features(5000, 20);
+    for (const ReferenceProblem& problem : reference_problems()) {
+        INFO(problem.name);
+        Dataset<double, double, Matrix<double>> dataset(X, reference_targets(problem, X));
+        auto single = to_precision<float>(dataset);
+        for (const auto& tree : candidate_trees()) {
+            double expected = eval_loss(tree, dataset, options);
+            double actual = eval_loss(to_precision<float>(tree), single, options);
+            REQUIRE(std::abs(actual - expected) <= 1e-5 * std::max(1.0, expected));
+        }
+    }
+}
+
+TEST_CASE("Single precision losses are summed in double", "[Precision][Scoring]") {
+    // A float running sum of these 2^20 equal terms is off by over 1% relative
+    Options options;
+    const int n = 1 << 20;
+    Matrix<float> X(1, n);
+    std::vector<float> y(n, 0.1f);
+    Dataset<float, double, Matrix<float>> dataset(X, y);
+    auto tree = make_constant(0.0f);
+    double expected = static_cast<double>(0.1f) * static_cast<double>(0.1f);
+
+    REQUIRE(std::abs(eval_loss(tree, dataset, options) - expected) <= 1e-12);
+    Options two_pass = options;
+    two_pass.fused_scoring = false;
+    REQUIRE(std::abs(eval_loss(tree, dataset, two_pass) - expected) <= 1e-12);
+    REQUIRE(std::abs(static_cast<double>(dataset.avg_y.value()) - 0.1) <= 1e-7);
+}
+
+TEST_CASE("Single precision gradients track double precision", "[Precision][Gradient]") {
+    Options options;
+    auto X = random_features(3000, 21);
+    auto problem = reference_problems()[1];
+    Dataset<double, double, Matrix<double>> dataset(X, reference_targets(problem, X));
+    auto single = to_precision<float>(dataset);
+    auto tree = candidate_trees()[1];
+    std::vector<double> expected;
+    std::vector<float> actual;
+    eval_loss_and_gradient(tree, dataset, options, expected);
+    eval_loss_and_gradient(to_precision<float>(tree), single, options, actual);
+    REQUIRE(actual.size() == expected.size());
+    for (std::size_t k = 0; k < expected.size(); ++k)
+        REQUIRE(std::abs(actual[k] - expected[k]) <= 1e-4 * std::max(1.0, std::abs(expected[k])));
+}
+
+TEST_CASE("The search precision is selected by the options", "[Precision]") {
+    Options options;
+    auto X = random_features(100, 22);
+    std::vector<double> w(100, 0.5);
+    Dataset<double, double, Matrix<double>> dataset(X, reference_targets(reference_problems()[0], X), w);
+    dataset.baseline_loss = 3.0;
+
+    auto element_size = [](const auto& data) { return sizeof(data.X.values[0]); };
+    REQUIRE(with_precision(dataset, options, element_size) == sizeof(double));
+    options.precision = 32;
+    REQUIRE(with_precision(dataset, options, element_size) == sizeof(float));
+    options.precision = 16;
+    REQUIRE_THROWS_AS(with_precision(dataset, options, element_size), std::invalid_argument);
+
+    auto single = to_precision<float>(dataset);
+    REQUIRE(single.weighted);
+    REQUIRE(single.weights.value()[7] == 0.5f);
+    REQUIRE(single.y.value()[3] == static_cast<float>(dataset.y.value()[3]));
+    REQUIRE(single.baseline_loss == 3.0);
+    REQUIRE(single.varMap == dataset.varMap);
+}
@@ -0,0 +1,125 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include "turingforge/Expression.h"
+#include "options.h"
+#include "fixtures.h"
+#include "turingforge/Racing.h"
+#include "turingforge/Scoring.h"
+
+// x1 * x2, plus `offset` * x1 unless it is zero
+Expression<double> product_tree(double offset) {
+    auto product = make_binary(0, make_feature<double>(0), make_feature<double>(1));
+    if (offset == 0)
+        return product;
+    return make_binary(1, product, make_binary(0, make_constant(offset), make_feature<double>(0)));
+}
+
+TEST_CASE("Racing rejects clearly worse children early", "[Racing][Scoring]") {
+    Options options;
+    options.racing = true;
+    options.racing_rows = 500;
+    const int n = 20000;
+    auto X = random_features(n, 11);
+    std::vector<double> y(n), w(n);
+    for (int row = 0; row < n; ++row) {
+        y[row] = X(0, row) * X(1, row);
+        w[row] = 1 + row % 3;
+    }
+    Dataset<double, double, Matrix<double>> dataset(X, y, w);
+    init_racing(dataset, options, 5);
+    REQUIRE(dataset.shuffled_rows != nullptr);
+
+    auto parent = product_tree(0.1);
+
+    // A child identical to its parent races every stage and is then scored
+    // on the remaining rows alone
+    auto same = race(dataset, parent, parent, options);
+    REQUIRE(same.competitive);
+    REQUIRE(std::abs(same.loss - eval_loss(parent, dataset, options)) <= 1e-12 * same.loss);
+    REQUIRE(std::abs(same.score - score_func(dataset, parent, options).first) <= 1e-12 * same.score);
+    REQUIRE(same.num_evals == 1 + 8000.0 / n);
+
+    // A better child is kept and gets its full loss
+    auto better = product_tree(0);
+    auto result = race(dataset, better, parent, options);
+    REQUIRE(result.competitive);
+    REQUIRE(std::abs(result.loss - eval_loss(better, dataset, options)) < 1e-12);
+
+    // A much worse child is dropped after the first stage
+    auto worse = product_tree(3.0);
+    result = race(dataset, worse, parent, options);
+    REQUIRE_FALSE(result.competitive);
+    REQUIRE(std::isinf(result.score));
+    REQUIRE(result.num_evals == 2.0 * options.racing_rows / n);
+
+    // As is a child whose predictions are not finite
+    auto infinite = make_binary(0, make_constant(1e300), make_constant(1e300));
+    result = race(dataset, infinite, parent, options);
+    REQUIRE_FALSE(result.competitive);
+    REQUIRE(result.num_evals <= 2.0 * options.racing_rows / n);
+}
+
+TEST_CASE("Racing reads and fills the fitness memo", "[Racing][FitnessMemo]") {
+    Options options;
+    options.racing = true;
+    options.racing_rows = 500;
+    options.fitness_memo_size = 100;
+    const int n = 10000;
+    auto X = random_features(n, 13);
+    std::vector<double> y(n);
+    for (int row = 0; row < n; ++row)
+        y[row] = X(0, row) * X(1, row);
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    init_racing(dataset, options, 5);
+    init_fitness_memo(dataset, options);
+    auto parent = product_tree(0.1);
+
+    // A dropped child is not memoized
+    REQUIRE_FALSE(race(dataset, product_tree(3.0), parent, options).competitive);
+    REQUIRE(dataset.fitness_memo->stats().insertions == 0);
+
+    // A survivor is, and a duplicate of it costs one lookup
+    auto first = race(dataset, product_tree(0), parent, options);
+    REQUIRE(first.competitive);
+    REQUIRE(dataset.fitness_memo->stats().insertions == 1);
+    auto duplicate = race(dataset, product_tree(0), parent, options);
+    REQUIRE(duplicate.competitive);
+    REQUIRE(duplicate.score == first.score);
+    REQUIRE(duplicate.loss == first.loss);
+    REQUIRE(duplicate.num_evals == 0);
+    REQUIRE(dataset.fitness_memo->stats().hits == 1);
+}
+
+TEST_CASE("Racing falls back to full scoring", "[Racing][Scoring]") {
+    Options options;
+    options.racing = true;
+    options.racing_rows = 500;
+    const int n = 2000;
+    auto X = random_features(n, 12);
+    std::vector<double> y(n);
+    for (int row = 0; row < n; ++row)
+        y[row] = X(0, row) * X(1, row);
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    auto parent = product_tree(0);
+    auto worse = product_tree(3.0);
+
+    // Without the shuffled rows
+    auto result = race(dataset, worse, parent, options);
+    REQUIRE(result.competitive);
+    REQUIRE(result.loss == eval_loss(worse, dataset, options));
+    REQUIRE(result.num_evals == 1);
+
+    // And on a dataset no larger than the first stage
+    init_racing(dataset, options, 5);
+    options.racing_rows = n;
+    result = race(dataset, worse, parent, options);
+    REQUIRE(result.competitive);
+    REQUIRE(result.num_evals == 1);
+
+    options.racing = false;
+    init_racing(dataset, options);
+    REQUIRE(dataset.shuffled_rows == nullptr);
+}
@@ -0,0 +1,230 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "turingforge/Expression.h"
+#include "options.h"
+#include "fixtures.h"
+#include "turingforge/MutationFunctions.h"
+#include "turingforge/Scoring.h"
+#include "turingforge/SubtreeCache.h"
+
+bool matches_uncached(const Expression<double>& tree, const Matrix<double>& X, const OperatorEnum& operators,
+                      SubtreeCache<double>& cache) {
+    auto [expected, expected_completion] = eval_tree_array(tree, view(X), operators);
+    std::vector<double> actual(expected.size());
+    bool actual_completion = eval_tree_array(tree, view(X), operators, actual.data(), cache);
+    // Both evaluators stop at the first non-finite tile
+    std::size_t rows = evaluated_rows(expected);
+    for (std::size_t row = 0; row < rows; ++row) {
+        if (!same(actual[row], expected[row]))
+            return false;
+    }
+    return actual_completion == expected_completion;
+}
+
+TEST_CASE("Subtree hashes are canonical", "[SubtreeCache]") {
+    Options options;
+    auto x1 = make_feature<double>(0);
+    auto x2 = make_feature<double>(1);
+    auto root_hash = [&](const Expression<double>& tree) { return subtree_hashes(tree, options.operators).back(); };
+
+    // MULT and PLUS are commutative, SUB is not
+    REQUIRE(root_hash(make_binary(0, x1, x2)) == root_hash(make_binary(0, x2, x1)));
+    REQUIRE(root_hash(make_binary(1, x1, x2)) == root_hash(make_binary(1, x2, x1)));
+    REQUIRE(root_hash(make_binary(2, x1, x2)) != root_hash(make_binary(2, x2, x1)));
+    REQUIRE(root_hash(make_binary(0, x1, x2)) != root_hash(make_binary(1, x1, x2)));
+
+    // Constants hash by value, whatever their slot
+    auto shifted = make_binary(1, make_constant(5.0), make_unary(0, make_binary(0, make_constant(2.0), x1)));
+    auto plain = make_unary(0, make_binary(0, make_constant(2.0), x1));
+    REQUIRE(subtree_hashes(shifted, options.operators)[shifted.root() - 1] == root_hash(plain));
+    REQUIRE(root_hash(make_binary(0, make_constant(2.0), x1)) != root_hash(make_binary(0, make_constant(3.0), x1)));
+}
+
+TEST_CASE("Canonical forms tell subtrees with equal hashes apart", "[SubtreeCache]") {
+    Options options;
+    auto x1 = make_feature<double>(0);
+    auto x2 = make_feature<double>(1);
+    auto form = [&](const Expression<double>& tree) {
+        return canonical_form(tree, tree.root(), subtree_hashes(tree, options.operators), options.operators);
+    };
+    REQUIRE(form(make_binary(0, x1, x2)) == form(make_binary(0, x2, x1)));
+    REQUIRE(form(make_binary(2, x1, x2)) != form(make_binary(2, x2, x1)));
+    REQUIRE(form(make_binary(0, make_constant(2.0), x1)) != form(make_binary(0, make_constant(3.0), x1)));
+
+    // A column stored under the hash of another subtree is not served
+    auto X = random_features(100);
+    SubtreeCache<double> cache(view(X), options.operators, 1 << 20);
+    auto column = std::make_shared<const UninitializedVector<double>>(100, 1.0);
+    cache.insert(42, form(make_unary(0, x1)), column);
+    REQUIRE(cache.find(42, form(make_unary(0, x1))) == column);
+    REQUIRE(cache.find(42, form(make_unary(1, x1))) == nullptr);
+    REQUIRE(cache.stats().collisions == 1);
+}
+
+TEST_CASE("Cached evaluation matches the tree evaluator", "[SubtreeCache]") {
+    std::srand(5);
+    Options options;
+    for (int n : {1, 300, 1000}) {
+        auto X = random_features(n, n);
+        SubtreeCache<double> cache(view(X), options.operators, 1 << 20);
+        std::vector<Expression<double>> trees;
+        for (int i = 0; i < 200; ++i)
+            trees.push_back(gen_random_tree_fixed_size<double>(1 + i % 30, options, 2));
+
+        // Subtrees get columns from their second sighting, and are read from the third
+        SubtreeCacheStats stats[3];
+        for (auto& pass : stats) {
+            for (const auto& tree : trees)
+                REQUIRE(matches_uncached(tree, X, options.operators, cache));
+            pass = cache.stats();
+        }
+        REQUIRE(stats[2].hits > stats[1].hits);
+        REQUIRE(stats[2].bytes_saved > stats[1].bytes_saved);
+        REQUIRE(stats[2].bytes_saved <= stats[2].hits * n * sizeof(double));
+        REQUIRE(stats[2].bytes_used <= (1 << 20));
+    }
+}
+
+TEST_CASE("A mutated constant reuses its sibling subtrees", "[SubtreeCache]") {
+    Options options;
+    auto X = random_features(500);
+    SubtreeCache<double> cache(view(X), options.operators, 1 << 20);
+    auto x1 = make_feature<double>(0);
+    auto x2 = make_feature<double>(1);
+    // cos(x1 * x2) + exp(x2) * 1.5
+    auto parent = make_binary(1, make_unary(0, make_binary(0, x1, x2)), make_binary(0, make_unary(1, x2), make_constant(1.5)));
+    // A subtree seen once does not get a column, one seen again does
+    REQUIRE(matches_uncached(parent, X, options.operators, cache));
+    REQUIRE(cache.stats().insertions == 0);
+    REQUIRE(matches_uncached(parent, X, options.operators, cache));
+    REQUIRE(cache.stats().hits == 0);
+    REQUIRE(cache.stats().insertions == 5);
+
+    auto child = parent;
+    child.constants[0] = 1.6;
+    REQUIRE(matches_uncached(child, X, options.operators, cache));
+    // The root and the product with the constant are new; cos(x1 * x2) and exp(x2) are reused
+    auto stats = cache.stats();
+    REQUIRE(stats.hits == 2);
+    REQUIRE(stats.insertions == 5);
+    REQUIRE(stats.bytes_saved == 2 * 500 * sizeof(double));
+    REQUIRE(matches_uncached(child, X, options.operators, cache));
+    REQUIRE(cache.stats().insertions == 7);
+    REQUIRE(matches_uncached(child, X, options.operators, cache));
+    REQUIRE(cache.stats().hits == 5);
+}
+
+TEST_CASE("The cache stays within its memory budget", "[SubtreeCache]") {
+    std::srand(6);
+    Options options;
+    const int n = 400;
+    auto X = random_features(n);
+    const std::size_t budget = 3 * n * sizeof(double);
+    SubtreeCache<double> cache(view(X), options.operators, budget);
+    for (int i = 0; i < 100; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(10, options, 2);
+        for (int pass = 0; pass < 2; ++pass) {
+            REQUIRE(matches_uncached(tree, X, options.operators, cache));
+            REQUIRE(cache.stats().bytes_used <= budget);
+        }
+    }
+    REQUIRE(cache.stats().evictions > 0);
+
+    SubtreeCache<double> tiny(view(X), options.operators, n * sizeof(double) - 1);
+    REQUIRE(matches_uncached(make_unary(0, make_feature<double>(0)), X, options.operators, tiny));
+    REQUIRE(tiny.stats().insertions == 0);
+}
+
+TEST_CASE("Scoring through the dataset's subtree cache", "[SubtreeCache][Scoring]") {
+    std::srand(7);
+    Options options;
+    options.subtree_cache_bytes = 1 << 22;
+    const int n = 800;
+    auto X = random_features(n, 8);
+    std::vector<double> y(n);
+    std::vector<double> w(n);
+    for (int row = 0; row < n; ++row) {
+        y[row] = X(0, row) * X(0, row) - X(1, row);
+        w[row] = 1.0 + (row % 3);
+    }
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    Dataset<double, double, Matrix<double>> weighted(X, y, w);
+    init_subtree_cache(dataset, options);
+    init_subtree_cache(weighted, options);
+    REQUIRE(dataset.subtree_cache);
+
+    Options uncached = options;
+    uncached.subtree_cache_bytes = 0;
+    for (int i = 0; i < 200; ++i) {
+        auto tree = gen_random_tree_fixed_size<double>(1 + i % 20, options, 2);
+        for (const auto* data : {&dataset, &weighted}) {
+            double expected = eval_loss(tree, *data, uncached);
+            double actual = eval_loss(tree, *data, options);
+            if (std::isinf(expected))
+                REQUIRE(std::isinf(actual));
+            else
+                REQUIRE(std::abs(actual - expected) <= 1e-12 * std::max(1.0, std::abs(expected)));
+        }
+    }
+    REQUIRE(dataset.subtree_cache->stats().hits > 0);
+
+    options.subtree_cache_bytes = 0;
+    init_subtree_cache(dataset, options);
+    REQUIRE_FALSE(dataset.subtree_cache);
+}
+
+TEST_CASE("Cached scoring keeps the early stops of the fused path", "[SubtreeCache][Scoring]") {
+    Options options;
+    const int n = 3000;
+    auto X = random_features(n, 9);
+    std::vector<double> y(n);
+    for (int row = 0; row < n; ++row)
+        y[row] = X(0, row) * X(1, row);
+    Dataset<double, double, Matrix<double>> dataset(X, y);
+    auto x1 = make_feature<double>(0);
+    auto x2 = make_feature<double>(1);
+    auto tree = make_binary(1, make_unary(0, make_binary(0, x1, x2)), make_unary(1, x2));
+
+    // A column larger than the budget bypasses the cache
+    options.subtree_cache_bytes = n * sizeof(double) - 1;
+    init_subtree_cache(dataset, options);
+    eval_loss(tree, dataset, options);
+    REQUIRE(dataset.subtree_cache->stats().misses == 0);
+
+    options.subtree_cache_bytes = 1 << 22;
+    init_subtree_cache(dataset, options);
+    Options uncached = options;
+    uncached.subtree_cache_bytes = 0;
+    double expected = eval_loss(tree, dataset, uncached);
+
+    // A bounded evaluation that stops early adds no partial columns
+    double bounded = eval_loss(tree, dataset, options, expected / 10);
+    REQUIRE(bounded > expected / 10);
+    REQUIRE(bounded < expected);
+    REQUIRE(dataset.subtree_cache->stats().insertions == 0);
+
+    // Neither does a tree with a non-finite output
+    auto invalid = make_binary(1, make_unary(0, make_binary(0, x1, x2)), make_unary(1, make_constant(1e3)));
+    REQUIRE(std::isinf(eval_loss(invalid, dataset, options)));
+    REQUIRE(dataset.subtree_cache->stats().insertions == 0);
+
+    // A complete evaluation, serial or on the reduction pool, fills the cache
+    // with the subtrees seen before, and the next one reads from it
+    double actual = eval_loss(tree, dataset, options);
+    REQUIRE(std::abs(actual - expected) <= 1e-12 * expected);
+    REQUIRE(dataset.subtree_cache->stats().insertions == 4);
+    options.reduction_threads = 2;
+    uncached.reduction_threads = 2;
+    REQUIRE(std::abs(eval_loss(tree, dataset, options) - eval_loss(tree, dataset, uncached)) <= 1e-12 * expected);
+    REQUIRE(dataset.subtree_cache->stats().hits == 1);
+    init_subtree_cache(dataset, options);
+    for (int pass = 0; pass < 2; ++pass)
+        REQUIRE(std::abs(eval_loss(tree, dataset, options) - eval_loss(tree, dataset, uncached)) <= 1e-12 * expected);
+    REQUIRE(dataset.subtree_cache->stats().insertions == 4);
+}
@@ -0,0 +1,219 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/reporters/catch_reporter_event_listener.hpp>
+#include <catch2/reporters/catch_reporter_registrars.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "turingforge/Loss/LossFunctions.h"
+
+// Every loss is timed at each of these row counts, in float64 and float32,
+// unweighted and weighted, through the scalar call and the batched `sum`.
+// Run a subset by tag, e.g. `bench_loss "[Margin]" --benchmark-samples 20`.
+// The results are also written as JSON to the file named by the environment
+// variable LOSS_BENCHMARK_JSON, or to bench_loss.json.
+const std::vector<std::size_t> BENCHMARK_SIZES = {1'000, 10'000, 100'000, 1'000'000, 10'000'000};
+
+struct LossBenchmark {
+    std::string loss;
+    std::string precision;
+    bool weighted;
+    std::string path;
+    std::size_t rows;
+};
+
+// Parameters of every benchmark by name, for the JSON report
+std::map<std::string, LossBenchmark>& loss_benchmarks() {
+    static std::map<std::string, LossBenchmark> benchmarks;
+    return benchmarks;
+}
+
+std::string register_benchmark(const LossBenchmark& benchmark) {
+    std::string name = benchmark.loss + ", " + benchmark.precision + (benchmark.weighted ? ", weighted, " : ", ")
+                       + benchmark.path + " x " + std::to_string(benchmark.rows) + " rows";
+    loss_benchmarks()[name] = benchmark;
+    return name;
+}
+
+// Writes the mean time and the throughput of every loss benchmark that ran
+class LossBenchmarkReport : public Catch::EventListenerBase {
+public:
+    using Catch::EventListenerBase::EventListenerBase;
+
+    void benchmarkEnded(const Catch::BenchmarkStats<>& stats) override {
+        auto found = loss_benchmarks().find(stats.info.name);
+        if (found == loss_benchmarks().end())
+            return;
+        results.push_back({found->second, std::chrono::duration<double, std::nano>(stats.mean.point).count(),
+                           std::chrono::duration<double, std::nano>(stats.standardDeviation.point).count()});
+    }
+
+    void testRunEnded(const Catch::TestRunStats&) override {
+        if (results.empty())
+            return;
+        const char* path = std::getenv("LOSS_BENCHMARK_JSON");
+        std::ofstream out(path == nullptr ? "bench_loss.json" : path);
+        out << "{\n  \"benchmarks\": [";
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"loss\": \"" << r.benchmark.loss << "\", \"precision\": \""
+                << r.benchmark.precision << "\", \"weighted\": " << (r.benchmark.weighted ? "true" : "false")
+                << ", \"path\": \"" << r.benchmark.path << "\", \"rows\": " << r.benchmark.rows
+                << ", \"mean_ns\": " << r.mean_ns << ", \"std_dev_ns\": " << r.std_dev_ns
+                << ", \"elements_per_ns\": " << static_cast<double>(r.benchmark.rows) / r.mean_ns << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+private:
+    struct Result {
+        LossBenchmark benchmark;
+        double mean_ns;
+        double std_dev_ns;
+    };
+    std::vector<Result> results;
+};
+
+CATCH_REGISTER_LISTENER(LossBenchmarkReport)
+
+template <typename T>
+struct LossData {
+    std::vector<T> outputs;
+    std::vector<T> targets;
+    std::vector<T> weights;
+};
+
+// The largest benchmark's worth of rows, drawn from `output` and `target`
+template <typename Output, typename Target>
+LossData<double> loss_data(Output output, Target target) {
+    const std::size_t n = BENCHMARK_SIZES.back();
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<double> weight(0.1, 2.0);
+    LossData<double> data;
+    data.outputs.resize(n);
+    data.targets.resize(n);
+    data.weights.resize(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        data.outputs[i] = output(gen);
+        data.targets[i] = target(gen);
+        data.weights[i] = weight(gen);
+    }
+    return data;
+}
+
+template <typename T>
+LossData<T> converted(const LossData<double>& data) {
+    return {std::vector<T>(data.outputs.begin(), data.outputs.end()),
+            std::vector<T>(data.targets.begin(), data.targets.end()),
+            std::vector<T>(data.weights.begin(), data.weights.end())};
+}
+
+// One call of the loss per row, as before the batched kernels
+template <typename  L, typename T>
+double scalar_sum(const L& loss, std::span<const T> outputs, std::span<const T> targets) {
+    double s = 0;
+    for (std::size_t i = 0; i < outputs.size(); ++i)
+        s += loss(static_cast<double>(outputs[i]), static_cast<double>(targets[i]));
+    return s;
+}
+
+template <typename  L, typename T>
+double scalar_sum(const L& loss, std::span<const T> outputs, std::span<const T> targets, std::span<const T> weights) {
+    double s = 0;
+    for (std::size_t i = 0; i < outputs.size(); ++i)
+        s += static_cast<double>(weights[i]) * loss(static_cast<double>(outputs[i]), static_cast<double>(targets[i]));
+    return s;
+}
+
+template <typename  L, typename T>
+void benchmark_loss(const std::string& name, const L& loss, const LossData<T>& data) {
+    const std::string precision = sizeof(T) == 4 ? "float32" : "float64";
+    for (std::size_t n : BENCHMARK_SIZES) {
+        std::span<const T> o(data.outputs.data(), n), t(data.targets.data(), n), w(data.weights.data(), n);
+        BENCHMARK(register_benchmark({name, precision, false, "scalar", n})) {
+            return scalar_sum(loss, o, t);
+        };
+        BENCHMARK(register_benchmark({name, precision, false, "batched", n})) {
+            return sum(loss, o, t);
+        };
+        BENCHMARK(register_benchmark({name, precision, true, "scalar", n})) {
+            return scalar_sum(loss, o, t, w);
+        };
+        BENCHMARK(register_benchmark({name, precision, true, "batched", n})) {
+            return sum(loss, o, t, w, false);
+        };
+    }
+}
+
+template <typename T>
+void benchmark_distance_losses(const LossData<T>& data) {
+    benchmark_loss("LPDistLoss(3)", LPDistLoss(3), data);
+    benchmark_loss("L1DistLoss", L1DistLoss(), data);
+    benchmark_loss("L2DistLoss", L2DistLoss(), data);
+    benchmark_loss("PeriodicLoss(2)", PeriodicLoss(2), data);
+    benchmark_loss("HuberLoss(1)", HuberLoss(1), data);
+    benchmark_loss("L1EpsilonInsLoss(1)", L1EpsilonInsLoss(1), data);
+    benchmark_loss("EpsilonInsLoss(0.5)", EpsilonInsLoss(0.5), data);
+    benchmark_loss("L2EpsilonInsLoss(1)", L2EpsilonInsLoss(1), data);
+    benchmark_loss("LogitDistLoss", LogitDistLoss(), data);
+    benchmark_loss("QuantileLoss(0.7)", QuantileLoss(0.7), data);
+    benchmark_loss("LogCoshLoss", LogCoshLoss(), data);
+}
+
+template <typename T>
+void benchmark_margin_losses(const LossData<T>& data) {
+    benchmark_loss("ZeroOneLoss", ZeroOneLoss(), data);
+    benchmark_loss("PerceptronLoss", PerceptronLoss(), data);
+    benchmark_loss("LogitMarginLoss", LogitMarginLoss(), data);
+    benchmark_loss("L1HingeLoss", L1HingeLoss(), data);
+    benchmark_loss("L2HingeLoss", L2HingeLoss(), data);
+    benchmark_loss("SmoothedL1HingeLoss(0.5)", SmoothedL1HingeLoss(0.5), data);
+    benchmark_loss("ModifiedHuberLoss", ModifiedHuberLoss(), data);
+    benchmark_loss("L2MarginLoss", L2MarginLoss(), data);
+    benchmark_loss("ExpLoss", ExpLoss(), data);
+    benchmark_loss("SigmoidLoss", SigmoidLoss(), data);
+    benchmark_loss("DWDMarginLoss(2)", DWDMarginLoss(2), data);
+}
+
+TEST_CASE("Distance-based loss throughput", "[!benchmark][Distance]") {
+    std::normal_distribution<double> output(0, 3), target(0, 1);
+    auto data = loss_data(output, target);
+    benchmark_distance_losses(data);
+    benchmark_distance_losses(converted<float>(data));
+}
+
+TEST_CASE("Margin-based loss throughput", "[!benchmark][Margin]") {
+    std::normal_distribution<double> output(0, 2);
+    std::bernoulli_distribution positive(0.5);
+    auto data = loss_data(output, [&](std::mt19937& gen) { return positive(gen) ? 1.0 : -1.0; });
+    benchmark_margin_losses(data);
+    benchmark_margin_losses(converted<float>(data));
+}
+
+TEST_CASE("Other loss throughput", "[!benchmark][Other]") {
+    // Each loss on its own domain: class labels, counts against log-rates, and probabilities
+    std::uniform_int_distribution<int> label(0, 9);
+    auto labels = loss_data([&](std::mt19937& gen) { return double(label(gen)); },
+                            [&](std::mt19937& gen) { return double(label(gen)); });
+    benchmark_loss("MisclassLoss", MisclassLoss(), labels);
+    benchmark_loss("MisclassLoss", MisclassLoss(), converted<float>(labels));
+
+    std::normal_distribution<double> log_rate(0, 1);
+    std::poisson_distribution<int> count(2);
+    auto counts = loss_data(log_rate, [&](std::mt19937& gen) { return double(count(gen)); });
+    benchmark_loss("PoissonLoss", PoissonLoss(), counts);
+    benchmark_loss("PoissonLoss", PoissonLoss(), converted<float>(counts));
+
+    std::uniform_real_distribution<double> probability(0.01, 0.99), target(0, 1);
+    auto probabilities = loss_data(probability, target);
+    benchmark_loss("CrossEntropyLoss", CrossEntropyLoss(), probabilities);
+    benchmark_loss("CrossEntropyLoss", CrossEntropyLoss(), converted<float>(probabilities));
+}
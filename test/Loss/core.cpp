@@ -1,6 +1,17 @@
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "turingforge/Loss/Accumulator.h"
 #include "turingforge/Loss/LossFunctions.h"
+#include "turingforge/Loss/Parallel.h"
 
 #define STRUCT_NAME_TO_STRING(struct_type) #struct_type
 
@@ -166,6 +177,90 @@ void test_value(Loss& l, Function f, const std::vector<double>& o_vec, const std
 //    }
 //}
 
+// Compare the batched sums over every pair of `o_vec` and `t_vec` with the
+// scalar loss, unweighted and weighted, in double and single precision
+template<typename Loss>
+void test_batched(const Loss& l, const std::vector<double>& o_vec, const std::vector<double>& t_vec) {
+    std::vector<double> outputs, targets, weights;
+    for (const auto& o : o_vec) {
+        for (const auto& t : t_vec) {
+            outputs.push_back(o);
+            targets.push_back(t);
+            weights.push_back(0.1 + static_cast<double>(weights.size() % 7));
+        }
+    }
+    double expected = 0;
+    double expected_weighted = 0;
+    double weight_sum = 0;
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        double value = l(outputs[i], targets[i]);
+        CAPTURE(outputs[i], targets[i]);
+        REQUIRE(sum(l, std::span<const double>(&outputs[i], 1), std::span<const double>(&targets[i], 1)) == value);
+        expected += value;
+        expected_weighted += weights[i] * value;
+        weight_sum += weights[i];
+    }
+    auto close = [](double a, double b) { return std::abs(a - b) <= 1e-10 * std::max(1.0, std::abs(b)); };
+    std::span<const double> o(outputs), t(targets), w(weights);
+    REQUIRE(close(sum(l, o, t), expected));
+    REQUIRE(close(mean(l, o, t), expected / static_cast<double>(outputs.size())));
+    REQUIRE(close(sum(l, o, t, w, false), expected_weighted));
+    REQUIRE(close(sum(l, o, t, w), expected_weighted / weight_sum));
+    REQUIRE(close(sum(l, outputs.data(), targets.data(), weights.data(), outputs.size()), expected_weighted));
+
+    // Single precision inputs are promoted, so the sums only differ by the rounding of the inputs
+    std::vector<float> outputs32(outputs.begin(), outputs.end()), targets32(targets.begin(), targets.end());
+    double expected32 = 0;
+    for (size_t i = 0; i < outputs32.size(); ++i)
+        expected32 += l(static_cast<double>(outputs32[i]), static_cast<double>(targets32[i]));
+    REQUIRE(close(sum(l, std::span<const float>(outputs32), std::span<const float>(targets32)), expected32));
+}
+
+// Compare the batched derivatives with the scalar `deriv` and `deriv2` methods
+// over every pair of `o_vec` and `t_vec`
+template<typename Loss>
+void test_batched_derivs(const Loss& l, const std::vector<double>& o_vec, const std::vector<double>& t_vec) {
+    std::vector<double> outputs, targets, weights;
+    for (const auto& o : o_vec) {
+        for (const auto& t : t_vec) {
+            outputs.push_back(o);
+            targets.push_back(t);
+            weights.push_back(0.25 + static_cast<double>(weights.size() % 5));
+        }
+    }
+    auto same = [](double a, double b) {
+        return (std::isnan(a) && std::isnan(b)) || a == b || std::abs(a - b) <= 1e-12 * std::max(1.0, std::abs(b));
+    };
+    const std::size_t n = outputs.size();
+    std::vector<double> gradient(n), hessian(n), weighted_gradient(n), weighted_hessian(n), gradient_only(n);
+    std::span<const double> o(outputs), t(targets), w(weights);
+    double value = sum_with_derivs(l, o, t, std::span<double>(gradient), std::span<double>(hessian));
+    double weighted = sum_with_derivs(l, o, t, w, std::span<double>(weighted_gradient),
+                                      std::span<double>(weighted_hessian));
+    REQUIRE(same(sum_with_derivs(l, o, t, std::span<double>(gradient_only)), value));
+    REQUIRE(same(value, sum(l, o, t)));
+    REQUIRE(same(weighted, sum(l, o, t, w, false)));
+    // The two-argument methods, through the virtual interface where the loss hides them
+    auto scalar = [&](auto method, double o, double t) {
+        if constexpr (std::is_base_of_v<SupervisedLoss, Loss>)
+            return method(static_cast<const SupervisedLoss&>(l), o, t);
+        else
+            return method(l, o, t);
+    };
+    for (size_t i = 0; i < n; ++i) {
+        CAPTURE(outputs[i], targets[i]);
+        double d = scalar([](const auto& s, double o, double t) { return s.deriv(o, t); }, outputs[i], targets[i]);
+        double d2 = scalar([](const auto& s, double o, double t) { return s.deriv2(o, t); }, outputs[i], targets[i]);
+        REQUIRE(same(gradient[i], d));
+        REQUIRE(same(gradient_only[i], d));
+        REQUIRE(same(hessian[i], d2));
+        REQUIRE(same(weighted_gradient[i], weights[i] * d));
+        REQUIRE(same(weighted_hessian[i], weights[i] * d2));
+        REQUIRE(same(deriv(l, outputs[i], targets[i]), d));
+        REQUIRE(same(deriv2(l, outputs[i], targets[i]), d2));
+    }
+}
+
 TEST_CASE("Test margin-based loss against reference function", "[MarginLoss]") {
     auto _zerooneloss = [](double o, double t) {
         return (std::signbit(o * t) ? 1.0 : 0.0);
@@ -571,4 +666,340 @@ TEST_CASE("Test margin-based loss against reference function", "[MarginLoss]") {
 //        REQUIRE(misclassloss<float>(c[0], c[1]) == Approx(1.0f));
 //        REQUIRE(misclassloss<float>(c, c).size() == c.size());
 //    }
-//}
\ No newline at end of file
+//}
+
+TEST_CASE("Batched losses match the scalar losses", "[Batched]") {
+    auto o_dist = generateRange(-10, 10, 0.3);
+    std::vector<double> t_dist = {-10.0, -0.5, 0.2, 3.0, 10.0};
+    auto o_margin = generateRange(-10, 10, 0.2);
+    std::vector<double> t_margin = {-1.0, 1.0};
+
+    SECTION("Distance-based") {
+        test_batched(LPDistLoss(0.5), o_dist, t_dist);
+        test_batched(LPDistLoss(3), o_dist, t_dist);
+        test_batched(L1DistLoss(), o_dist, t_dist);
+        test_batched(L2DistLoss(), o_dist, t_dist);
+        test_batched(PeriodicLoss(2), o_dist, t_dist);
+        test_batched(HuberLoss(1), o_dist, t_dist);
+        test_batched(L1EpsilonInsLoss(1), o_dist, t_dist);
+        test_batched(EpsilonInsLoss(0.5), o_dist, t_dist);
+        test_batched(L2EpsilonInsLoss(1), o_dist, t_dist);
+        test_batched(LogitDistLoss(), o_dist, t_dist);
+        test_batched(QuantileLoss(0.7), o_dist, t_dist);
+        test_batched(LogCoshLoss(), o_dist, t_dist);
+    }
+
+    SECTION("Margin-based") {
+        test_batched(ZeroOneLoss(), o_margin, t_margin);
+        test_batched(PerceptronLoss(), o_margin, t_margin);
+        test_batched(LogitMarginLoss(), o_margin, t_margin);
+        test_batched(L1HingeLoss(), o_margin, t_margin);
+        test_batched(HingeLoss(), o_margin, t_margin);
+        test_batched(L2HingeLoss(), o_margin, t_margin);
+        test_batched(SmoothedL1HingeLoss(0.5), o_margin, t_margin);
+        test_batched(ModifiedHuberLoss(), o_margin, t_margin);
+        test_batched(L2MarginLoss(), o_margin, t_margin);
+        test_batched(ExpLoss(), o_margin, t_margin);
+        test_batched(SigmoidLoss(), o_margin, t_margin);
+        test_batched(DWDMarginLoss(2), generateRange(0.1, 10, 0.2), t_margin);
+    }
+
+    SECTION("Other") {
+        test_batched(MisclassLoss(), generateRange(0, 10, 1), generateRange(0, 10, 1));
+        test_batched(PoissonLoss(), generateRange(-5, 5, 0.25), generateRange(0, 10, 1));
+        test_batched(CrossEntropyLoss(), generateRange(0.05, 0.95, 0.05), std::vector<double>{0.0, 0.3, 1.0});
+    }
+
+    SECTION("Scaled and weighted") {
+        test_batched(ScaledLoss<L2DistLoss>(L2DistLoss(), 2.5), o_dist, t_dist);
+        test_batched(ScaledLoss<HuberLoss>(HuberLoss(1), 0.5), o_dist, t_dist);
+        test_batched(WeightedMarginLoss<HingeLoss>(HingeLoss(), 0.2), o_margin, t_margin);
+        test_batched(WeightedMarginLoss<LogitMarginLoss>(LogitMarginLoss(), 0.7), o_margin, t_margin);
+    }
+
+    SECTION("Stacked meta-losses") {
+        using WeightedHinge = WeightedMarginLoss<L2HingeLoss>;
+        test_batched(ScaledLoss<WeightedHinge>(WeightedHinge(L2HingeLoss(), 0.3), 2.0), o_margin, t_margin);
+        test_batched(ScaledLoss<ScaledLoss<WeightedHinge>>(
+                ScaledLoss<WeightedHinge>(WeightedHinge(L2HingeLoss(), 0.3), 4.0), 0.5), o_margin, t_margin);
+        test_batched(ScaledLoss<ScaledLoss<HuberLoss>>(ScaledLoss<HuberLoss>(HuberLoss(1), 2.0), 0.25), o_dist, t_dist);
+    }
+
+    SECTION("Mismatched sizes") {
+        std::vector<double> outputs(3), targets(4);
+        REQUIRE_THROWS_AS(sum(L2DistLoss(), std::span<const double>(outputs), std::span<const double>(targets)),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("Runtime selected losses match the static losses", "[Batched]") {
+    auto outputs = generateRange(-10, 10, 0.1);
+    std::vector<double> targets(outputs.size()), weights(outputs.size());
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        targets[i] = i % 2 == 0 ? 1.0 : -1.0;
+        weights[i] = 0.5 + static_cast<double>(i % 3);
+    }
+    std::span<const double> o(outputs), t(targets), w(weights);
+
+    auto check = [&](auto l) {
+        AnyLoss any = l;
+        CAPTURE(any.loss.index());
+        REQUIRE(any.holds<decltype(l)>());
+        REQUIRE(sum(any, o, t) == sum(l, o, t));
+        REQUIRE(sum(any, o, t, w) == sum(l, o, t, w));
+        REQUIRE(mean(any, outputs, targets) == mean(l, outputs, targets));
+        for (size_t i = 0; i < outputs.size(); i += 17) {
+            REQUIRE(any(outputs[i], targets[i]) == l(outputs[i], targets[i]));
+            REQUIRE(any.deriv(outputs[i], targets[i]) == deriv(l, outputs[i], targets[i]));
+        }
+    };
+    check(L2DistLoss());
+    check(L1DistLoss());
+    check(HuberLoss(1.5));
+    check(QuantileLoss(0.3));
+    check(LogCoshLoss());
+    check(HingeLoss());
+    check(LogitMarginLoss());
+    check(SmoothedL1HingeLoss(0.5));
+    check(PoissonLoss());
+
+    AnyLoss loss;
+    REQUIRE(loss.holds<L2DistLoss>());
+    loss = HuberLoss(1.0);
+    REQUIRE(visit_loss(loss, [](const auto& l) { return std::is_same_v<std::decay_t<decltype(l)>, HuberLoss>; }));
+}
+
+TEST_CASE("Batched derivatives match the scalar derivatives", "[Batched]") {
+    // The losses and ranges of the derivative checks in properties.cpp and above
+    auto o_range = generateRange(-10, 10, 0.2);
+    o_range.push_back(0.0);
+    o_range.push_back(1.0);
+    std::vector<double> t_dist = {-10.0, 0.2, 10.0};
+    std::vector<double> t_margin = {-1.0, 1.0};
+
+    SECTION("Distance-based") {
+        test_batched_derivs(L2DistLoss(), o_range, t_dist);
+        test_batched_derivs(L1DistLoss(), o_range, t_dist);
+        for (double p : {0.5, 1.0, 1.5, 2.0, 3.0})
+            test_batched_derivs(LPDistLoss(p), o_range, t_dist);
+        test_batched_derivs(LogitDistLoss(), o_range, t_dist);
+        test_batched_derivs(L1EpsilonInsLoss(0.5), o_range, t_dist);
+        test_batched_derivs(EpsilonInsLoss(1.5), o_range, t_dist);
+        test_batched_derivs(L2EpsilonInsLoss(0.5), o_range, t_dist);
+        test_batched_derivs(L2EpsilonInsLoss(1.5), o_range, t_dist);
+        test_batched_derivs(PeriodicLoss(1), o_range, t_dist);
+        test_batched_derivs(PeriodicLoss(1.5), o_range, t_dist);
+        test_batched_derivs(HuberLoss(1), o_range, t_dist);
+        test_batched_derivs(HuberLoss(1.5), o_range, t_dist);
+        for (double tau : {0.2, 0.5, 0.8})
+            test_batched_derivs(QuantileLoss(tau), o_range, t_dist);
+        test_batched_derivs(LogCoshLoss(), o_range, t_dist);
+    }
+
+    SECTION("Margin-based") {
+        test_batched_derivs(LogitMarginLoss(), o_range, t_margin);
+        test_batched_derivs(L1HingeLoss(), o_range, t_margin);
+        test_batched_derivs(L2HingeLoss(), o_range, t_margin);
+        test_batched_derivs(PerceptronLoss(), o_range, t_margin);
+        for (double gamma : {0.5, 1.0, 2.0})
+            test_batched_derivs(SmoothedL1HingeLoss(gamma), o_range, t_margin);
+        test_batched_derivs(ModifiedHuberLoss(), o_range, t_margin);
+        test_batched_derivs(ZeroOneLoss(), o_range, t_margin);
+        test_batched_derivs(L2MarginLoss(), o_range, t_margin);
+        test_batched_derivs(ExpLoss(), o_range, t_margin);
+        test_batched_derivs(SigmoidLoss(), o_range, t_margin);
+        for (double q : {0.5, 1.0, 2.0})
+            test_batched_derivs(DWDMarginLoss(q), o_range, t_margin);
+    }
+
+    SECTION("Scaled and runtime selected") {
+        test_batched_derivs(ScaledLoss<HuberLoss>(HuberLoss(1), 2.0), o_range, t_dist);
+        test_batched_derivs(ScaledLoss<LogitMarginLoss>(LogitMarginLoss(), 0.5), o_range, t_margin);
+        test_batched_derivs(WeightedMarginLoss<L2HingeLoss>(L2HingeLoss(), 0.2), o_range, t_margin);
+        test_batched_derivs(ScaledLoss<WeightedMarginLoss<L2HingeLoss>>(
+                WeightedMarginLoss<L2HingeLoss>(L2HingeLoss(), 0.2), 3.0), o_range, t_margin);
+        test_batched_derivs(WeightedMarginLoss<WeightedMarginLoss<LogitMarginLoss>>(
+                WeightedMarginLoss<LogitMarginLoss>(LogitMarginLoss(), 0.7), 0.4), o_range, t_margin);
+        test_batched_derivs(AnyLoss(LogCoshLoss()), o_range, t_dist);
+        test_batched_derivs(AnyLoss(SmoothedL1HingeLoss(1)), o_range, t_margin);
+    }
+
+    SECTION("Single precision buffers") {
+        std::vector<float> outputs(o_range.begin(), o_range.end()), targets(outputs.size(), 0.2f);
+        std::vector<float> gradient(outputs.size()), hessian(outputs.size());
+        HuberLoss l(1);
+        sum_with_derivs(l, std::span<const float>(outputs), std::span<const float>(targets),
+                        std::span<float>(gradient), std::span<float>(hessian));
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            REQUIRE(gradient[i] == static_cast<float>(l.deriv(double(outputs[i]) - double(targets[i]))));
+            REQUIRE(hessian[i] == static_cast<float>(l.deriv2(double(outputs[i]) - double(targets[i]))));
+        }
+    }
+}
+
+TEST_CASE("Parallel reduction is independent of the thread count", "[Parallel]") {
+    // Several blocks, the last one partial
+    const std::size_t n = 5 * REDUCTION_BLOCK_SIZE + 1234;
+    std::mt19937 gen(0);
+    std::normal_distribution<double> normal;
+    std::uniform_real_distribution<double> uniform(0.1, 2.0);
+    std::vector<double> outputs(n), targets(n), weights(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        outputs[i] = normal(gen);
+        targets[i] = normal(gen);
+        weights[i] = uniform(gen);
+    }
+    std::span<const double> o(outputs), t(targets), w(weights);
+    HuberLoss l(1);
+
+    double naive = 0, naive_weighted = 0, weight = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        naive += l(outputs[i], targets[i]);
+        naive_weighted += weights[i] * l(outputs[i], targets[i]);
+        weight += weights[i];
+    }
+
+    double serial = parallel_sum(l, o, t);
+    double serial_weighted = parallel_sum(l, o, t, w, false);
+    double serial_mean = parallel_mean(l, o, t, w);
+    REQUIRE(std::abs(serial - naive) <= 1e-10 * naive);
+    REQUIRE(std::abs(serial_weighted - naive_weighted) <= 1e-10 * naive_weighted);
+    REQUIRE(std::abs(serial_mean - naive_weighted / weight) <= 1e-10 * serial_mean);
+    REQUIRE(std::abs(parallel_mean(l, o, t) - naive / n) <= 1e-10 * serial / n);
+
+    for (std::size_t threads : {1, 2, 3, 8}) {
+        CAPTURE(threads);
+        ThreadPool pool(threads);
+        REQUIRE(parallel_sum(l, o, t, &pool) == serial);
+        REQUIRE(parallel_sum(l, o, t, w, false, &pool) == serial_weighted);
+        REQUIRE(parallel_mean(l, o, t, w, &pool) == serial_mean);
+        REQUIRE(parallel_sum(AnyLoss(l), o, t, &pool) == serial);
+    }
+
+    SECTION("Errors") {
+        ThreadPool pool(4);
+        REQUIRE_THROWS_AS(parallel_sum(l, o, t.first(n - 1), &pool), std::invalid_argument);
+        std::vector<double> zeros(n, 0.0);
+        REQUIRE_THROWS_AS(parallel_mean(l, o, t, std::span<const double>(zeros), &pool), std::invalid_argument);
+        // Outputs outside [0, 1] make the cross entropy throw inside the blocks
+        REQUIRE_THROWS_AS(parallel_sum(CrossEntropyLoss(), o, t, &pool), std::domain_error);
+        // The pool is still usable afterwards
+        REQUIRE(parallel_sum(l, o, t, &pool) == serial);
+    }
+}
+
+TEST_CASE("Streaming accumulator does not depend on the chunking", "[Accumulator]") {
+    const std::size_t n = 100003;
+    std::mt19937 gen(1);
+    std::normal_distribution<double> normal;
+    std::uniform_real_distribution<double> uniform(0.1, 2.0);
+    std::vector<double> outputs(n), targets(n), weights(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        outputs[i] = normal(gen);
+        targets[i] = normal(gen);
+        weights[i] = uniform(gen);
+    }
+    std::span<const double> o(outputs), t(targets), w(weights);
+    LogCoshLoss l;
+
+    LossAccumulator<LogCoshLoss> whole, whole_weighted;
+    whole.add(o, t);
+    whole_weighted.add(o, t, w);
+    REQUIRE(whole.count() == n);
+    REQUIRE(whole.weight() == n);
+    REQUIRE(std::abs(whole.sum() - sum(l, o, t)) <= 1e-10 * whole.sum());
+    REQUIRE(std::abs(whole.mean() - mean(l, o, t)) <= 1e-10 * whole.mean());
+    REQUIRE(std::abs(whole_weighted.sum() - sum(l, o, t, w, false)) <= 1e-10 * whole_weighted.sum());
+    REQUIRE(std::abs(whole_weighted.mean() - sum(l, o, t, w, true)) <= 1e-10 * whole_weighted.mean());
+
+    for (std::size_t chunk : {1, 7, 255, 256, 257, 4096, 65536}) {
+        CAPTURE(chunk);
+        LossAccumulator<LogCoshLoss> chunked, chunked_weighted;
+        for (std::size_t begin = 0; begin < n; begin += chunk) {
+            std::size_t m = std::min(chunk, n - begin);
+            chunked.add(o.subspan(begin, m), t.subspan(begin, m));
+            chunked_weighted.add(o.subspan(begin, m), t.subspan(begin, m), w.subspan(begin, m));
+        }
+        REQUIRE(chunked.sum() == whole.sum());
+        REQUIRE(chunked_weighted.sum() == whole_weighted.sum());
+        REQUIRE(chunked_weighted.mean() == whole_weighted.mean());
+    }
+
+    SECTION("Runtime selected loss and single precision") {
+        LossAccumulator<AnyLoss> any(AnyLoss{l});
+        any.add(o, t);
+        REQUIRE(any.sum() == whole.sum());
+
+        std::vector<float> single_outputs(outputs.begin(), outputs.end()), single_targets(targets.begin(), targets.end());
+        LossAccumulator<LogCoshLoss, float> single;
+        single.add(std::span<const float>(single_outputs), std::span<const float>(single_targets));
+        REQUIRE(std::abs(single.mean() - whole.mean()) <= 1e-5 * whole.mean());
+    }
+
+    SECTION("Reset and errors") {
+        LossAccumulator<LogCoshLoss> acc;
+        REQUIRE_THROWS_AS(acc.mean(), std::invalid_argument);
+        REQUIRE_THROWS_AS(acc.add(o, t.first(10)), std::invalid_argument);
+        std::vector<double> zeros(10, 0.0);
+        acc.add(o.first(10), t.first(10), std::span<const double>(zeros));
+        REQUIRE(acc.count() == 10);
+        REQUIRE_THROWS_AS(acc.mean(), std::invalid_argument);
+        acc.reset();
+        acc.add(o, t);
+        REQUIRE(acc.sum() == whole.sum());
+    }
+}
+
+TEST_CASE("Multi-quantile loss matches one QuantileLoss per quantile", "[MultiQuantile]") {
+    std::mt19937 gen(3);
+    std::normal_distribution<double> dist(0, 2);
+    std::uniform_real_distribution<double> weight(0, 3);
+    std::vector<double> outputs(1003), targets(1003), weights(1003);
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        outputs[i] = dist(gen);
+        targets[i] = i % 10 == 0 ? outputs[i] : dist(gen);
+        weights[i] = weight(gen);
+    }
+    std::span<const double> o(outputs), t(targets), w(weights);
+    auto close = [](double a, double b) { return std::abs(a - b) <= 1e-12 * std::max(1.0, std::abs(b)); };
+
+    MultiQuantileLoss loss({0.1, 0.5, 0.9, 0.0, 1.0});
+    auto sums = sum(loss, o, t);
+    auto means = mean(loss, o, t);
+    auto weighted = sum(loss, o, t, w, false);
+    auto normalized = sum(loss, o, t, w);
+    auto weighted_means = mean(loss, o, t, w);
+    REQUIRE(sums.size() == loss.size());
+    for (size_t k = 0; k < loss.size(); ++k) {
+        QuantileLoss single(loss.taus[k]);
+        CAPTURE(single.tau);
+        REQUIRE(close(sums[k], sum(single, o, t)));
+        REQUIRE(close(means[k], mean(single, o, t)));
+        REQUIRE(close(weighted[k], sum(single, o, t, w, false)));
+        REQUIRE(close(normalized[k], sum(single, o, t, w)));
+        REQUIRE(close(weighted_means[k], mean(single, o, t, w)));
+    }
+    auto unnormalized_means = mean(loss, o, t, w, false);
+    REQUIRE(close(unnormalized_means[2], weighted[2]));
+    std::vector<double> zeros(weights.size(), 0.0);
+    REQUIRE_THROWS_AS(mean(loss, o, t, std::span<const double>(zeros)), std::invalid_argument);
+
+    // Float inputs are promoted as for the other losses
+    std::vector<float> outputs32(outputs.begin(), outputs.end()), targets32(targets.begin(), targets.end());
+    auto sums32 = sum(loss, std::span<const float>(outputs32), std::span<const float>(targets32));
+    REQUIRE(close(sums32[1], sum(QuantileLoss(0.5), std::span<const float>(outputs32), std::span<const float>(targets32))));
+
+    outputs[7] = std::numeric_limits<double>::quiet_NaN();
+    for (double l : sum(loss, o, t))
+        REQUIRE(std::isnan(l));
+    REQUIRE_THROWS_AS(MultiQuantileLoss({0.5, 1.5}), std::invalid_argument);
+    REQUIRE_THROWS_AS(sum(loss, o, t.first(10)), std::invalid_argument);
+}
+
+TEST_CASE("Distance and margin traits see through the meta-losses", "[Traits]") {
+    static_assert(is_distance_loss_v<HuberLoss> && !is_margin_loss_v<HuberLoss>);
+    static_assert(is_distance_loss_v<ScaledLoss<LogCoshLoss>>);
+    static_assert(is_margin_loss_v<ScaledLoss<L2HingeLoss>> && !is_distance_loss_v<L2HingeLoss>);
+    static_assert(!is_margin_loss_v<WeightedMarginLoss<L2HingeLoss>>);
+    static_assert(!is_distance_loss_v<PoissonLoss> && !is_margin_loss_v<PoissonLoss>);
+}
@@ -0,0 +1,144 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "turingforge/Loss/LossFunctions.h"
+
+// Distance in units in the last place between two finite doubles
+std::int64_t ulp_distance(double a, double b) {
+    auto ordered = [](double x) {
+        auto i = std::bit_cast<std::int64_t>(x);
+        return i < 0 ? std::numeric_limits<std::int64_t>::min() - i : i;
+    };
+    std::int64_t d = ordered(a) - ordered(b);
+    return d < 0 ? -d : d;
+}
+
+template <typename Fast, typename Reference>
+void test_ulp(Fast fast, Reference reference, double lo, double hi, std::int64_t max_ulp) {
+    std::mt19937_64 gen(0);
+    std::uniform_real_distribution<double> dist(lo, hi);
+    for (int i = 0; i < 200000; ++i) {
+        double x = dist(gen);
+        CAPTURE(x);
+        REQUIRE(ulp_distance(fast(x), reference(x)) <= max_ulp);
+    }
+}
+
+TEST_CASE("Fast math stays within its documented error", "[FastMath]") {
+    auto exp = [](double x) { return std::exp(x); };
+    auto expm1 = [](double x) { return std::expm1(x); };
+    auto log = [](double x) { return std::log(x); };
+    auto log1p = [](double x) { return std::log1p(x); };
+    auto tanh = [](double x) { return std::tanh(x); };
+
+    test_ulp(fast_exp, exp, FAST_MATH_EXP_MIN, FAST_MATH_EXP_MAX, 1);
+    test_ulp(fast_exp, exp, -1, 1, 1);
+    test_ulp(fast_expm1, expm1, -50, FAST_MATH_EXP_MAX, 2);
+    test_ulp(fast_expm1, expm1, -1, 1, 2);
+    test_ulp(fast_expm1, expm1, -1e-6, 1e-6, 2);
+    // log over the whole positive range, subnormals included
+    test_ulp([](double x) { return fast_log(std::exp(x)); }, [](double x) { return std::log(std::exp(x)); },
+             -744, 709, 1);
+    test_ulp(fast_log, log, 0.5, 2, 1);
+    test_ulp(fast_log1p, log1p, -0.999999, 10, 1);
+    test_ulp(fast_log1p, log1p, -1e-3, 1e-3, 1);
+    test_ulp(fast_tanh, tanh, -25, 25, 4);
+    test_ulp(fast_tanh, tanh, -1e-3, 1e-3, 4);
+
+    constexpr double inf = std::numeric_limits<double>::infinity();
+    constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+    REQUIRE(fast_exp(1000) == inf);
+    REQUIRE(fast_exp(-1000) == 0);
+    REQUIRE(fast_exp(0) == 1);
+    REQUIRE(std::isnan(fast_exp(nan)));
+    REQUIRE(fast_expm1(1000) == inf);
+    REQUIRE(fast_expm1(-1000) == -1);
+    REQUIRE(fast_log(0) == -inf);
+    REQUIRE(fast_log(1) == 0);
+    REQUIRE(fast_log(inf) == inf);
+    REQUIRE(std::isnan(fast_log(-1)));
+    REQUIRE(std::isnan(fast_log(nan)));
+    REQUIRE(fast_log1p(-1) == -inf);
+    REQUIRE(fast_log1p(1e-300) == 1e-300);
+    REQUIRE(std::isnan(fast_log1p(-2)));
+    REQUIRE(fast_tanh(100) == 1);
+    REQUIRE(fast_tanh(-100) == -1);
+    REQUIRE(std::isnan(fast_tanh(nan)));
+}
+
+// The fast loss against `L` over a grid, for values and both derivatives
+template <typename  L>
+void test_fast_loss(const L& l, const std::vector<double>& o_vec, const std::vector<double>& t_vec) {
+    FastMathLoss<L> fast(l);
+    for (double o : o_vec) {
+        for (double t : t_vec) {
+            CAPTURE(o, t);
+            double expected[3] = {_value(l, o, t), _deriv(l, o, t), _deriv2(l, o, t)};
+            double actual[3] = {fast(o, t), fast.deriv(o, t), fast.deriv2(o, t)};
+            for (int i = 0; i < 3; ++i) {
+                CAPTURE(i);
+                // The reference overflows to NaN in some second derivatives
+                if (std::isnan(expected[i]))
+                    continue;
+                REQUIRE(std::abs(actual[i] - expected[i]) <= 1e-13 * std::max(1.0, std::abs(expected[i])));
+            }
+        }
+    }
+
+    // The batched sum runs the same approximations
+    std::vector<double> outputs, targets;
+    for (double o : o_vec) {
+        for (double t : t_vec) {
+            outputs.push_back(o);
+            targets.push_back(t);
+        }
+    }
+    double expected = 0;
+    double scalar = 0;
+    for (std::size_t i = 0; i < outputs.size(); ++i) {
+        expected += _value(l, outputs[i], targets[i]);
+        scalar += fast(outputs[i], targets[i]);
+    }
+    double batched = sum(fast, std::span<const double>(outputs), std::span<const double>(targets));
+    REQUIRE(std::abs(batched - scalar) <= 1e-13 * std::abs(scalar));
+    REQUIRE(std::abs(batched - expected) <= 1e-13 * std::abs(expected));
+    if constexpr (std::is_constructible_v<LossVariant, FastMathLoss<L>>)
+        REQUIRE(sum(AnyLoss(fast), std::span<const double>(outputs), std::span<const double>(targets)) == batched);
+}
+
+TEST_CASE("Fast math losses match the exact losses", "[FastMath]") {
+    std::vector<double> o_range;
+    for (double o = -30; o <= 30; o += 0.1)
+        o_range.push_back(o);
+    std::vector<double> t_dist = {-10.0, 0.2, 10.0};
+    std::vector<double> t_margin = {-1.0, 1.0};
+
+    test_fast_loss(LogitDistLoss(), o_range, t_dist);
+    test_fast_loss(LogCoshLoss(), o_range, t_dist);
+    test_fast_loss(LogitMarginLoss(), o_range, t_margin);
+    test_fast_loss(ExpLoss(), o_range, t_margin);
+    test_fast_loss(SigmoidLoss(), o_range, t_margin);
+    // Losses without an approximation are computed exactly
+    test_fast_loss(HuberLoss(1), o_range, t_dist);
+
+    std::vector<double> probabilities;
+    for (double p = 0.001; p < 1; p += 0.001)
+        probabilities.push_back(p);
+    test_fast_loss(CrossEntropyLoss(), probabilities, {0.0, 0.3, 1.0});
+
+    FastMathLoss<CrossEntropyLoss> cross_entropy;
+    REQUIRE(cross_entropy(1, 1) == 0);
+    REQUIRE(cross_entropy(0, 0) == 0);
+    REQUIRE(cross_entropy(0, 1) == std::numeric_limits<double>::infinity());
+    // Outside [0, 1] the fast cross-entropy is NaN instead of throwing
+    REQUIRE(std::isnan(cross_entropy(1.5, 1)));
+    REQUIRE(std::isnan(cross_entropy(0.5, -1)));
+}
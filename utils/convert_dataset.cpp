@@ -0,0 +1,87 @@
+// Convert a CSV file with a header row into a dataset file for map_dataset.
+//
+//   convert-dataset [--float32] [--target NAME] [--weights NAME] input.csv output.tfd
+//
+// The target is the last column unless named; every other column except the
+// weights is a feature. The stored baseline is the L2 loss of predicting the
+// mean target; searches with another loss update it after mapping.
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "turingforge/CsvLoader.h"
+#include "turingforge/DatasetFile.h"
+#include "turingforge/Loss/LossFunctions.h"
+#include "turingforge/ThreadPool.h"
+
+struct ConvertArguments {
+    bool float32 = false;
+    std::optional<std::string> target;
+    std::optional<std::string> weights;
+    std::string input;
+    std::string output;
+};
+
+ConvertArguments parse_arguments(int argc, char** argv) {
+    ConvertArguments arguments;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--float32") {
+            arguments.float32 = true;
+        } else if ((arg == "--target" || arg == "--weights") && i + 1 < argc) {
+            (arg == "--target" ? arguments.target : arguments.weights) = argv[++i];
+        } else if (arg.starts_with("--")) {
+            throw std::invalid_argument("Unknown option " + std::string(arg));
+        } else {
+            paths.emplace_back(arg);
+        }
+    }
+    if (paths.size() != 2)
+        throw std::invalid_argument("Usage: convert-dataset [--float32] [--target NAME] [--weights NAME] input.csv output.tfd");
+    arguments.input = paths[0];
+    arguments.output = paths[1];
+    return arguments;
+}
+
+template <typename T>
+void convert(const ConvertArguments& arguments) {
+    CsvOptions options;
+    options.target = arguments.target;
+    options.weights = arguments.weights;
+    ThreadPool pool;
+    auto dataset = load_csv<T, T>(arguments.input, options, &pool);
+
+    std::vector<T> prediction(dataset.n, dataset.avg_y.value());
+    std::span<const T> outputs(prediction), targets(dataset.y.value());
+    double baseline = dataset.weighted
+            ? mean(L2DistLoss(), outputs, targets, std::span<const T>(dataset.weights.value()))
+            : mean(L2DistLoss(), outputs, targets);
+    dataset.baseline_loss = static_cast<T>(baseline);
+    dataset.use_baseline = std::isfinite(baseline);
+
+    write_dataset_file(dataset, arguments.output);
+    std::cout << arguments.output << ": " << dataset.n << " rows, " << dataset.nfeatures << " features"
+              << (dataset.weighted ? ", weighted" : "") << ", float" << 8 * sizeof(T) << "\n";
+}
+
+int main(int argc, char** argv) {
+    try {
+        ConvertArguments arguments = parse_arguments(argc, argv);
+        if (arguments.float32)
+            convert<float>(arguments);
+        else
+            convert<double>(arguments);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}